@@ -0,0 +1,216 @@
+#include "AssetLoader.h"
+#include "MeshCodec.h"
+
+#include <chrono>
+#include <cstring>
+
+static bool hasExtension ( const std::string &fileName, const char *extension ) {
+	size_t length = strlen ( extension );
+	return fileName.size ( ) >= length && fileName.compare ( fileName.size ( ) - length, length, extension ) == 0;
+}
+
+
+AssetLoader::AssetLoader ( ) :
+	_jobs ( NULL ),
+	_nextId ( 0 ),
+	_pending ( 0 ),
+	_waited ( 0 ) {
+}
+
+
+AssetLoader::~AssetLoader ( ) {
+	// Les taches en cours ecrivent encore dans le loader, et un niveau
+	// progressif ajoute le suivant a _loads avant de se terminer
+	for ( uint32_t i = 0; ; ++i ) {
+		JobHandle load;
+
+		{
+			std::lock_guard<std::mutex> lock ( _mutex );
+
+			if ( i >= _loads.size ( ) ) {
+				break;
+			}
+
+			load = _loads[i];
+		}
+
+		_jobs->wait ( load );
+	}
+}
+
+
+void AssetLoader::init ( JobSystem *jobs ) {
+	_jobs = jobs;
+}
+
+
+uint32_t AssetLoader::loadMesh ( const std::string &fileName, const Prepare &prepare, uint32_t trianglesPerCluster ) {
+	std::lock_guard<std::mutex> lock ( _mutex );
+
+	uint32_t id = _nextId++;
+	_pending++;
+
+	if ( hasExtension ( fileName, ".pmg" ) ) {
+		_loads.push_back ( _jobs->run ( [this, id, fileName, prepare, trianglesPerCluster] ( ) {
+			std::vector<ProgressiveLevelInfo> levels;
+			ProgressiveMesh::readTable ( fileName, levels );
+
+			loadLevel ( id, fileName, prepare, trianglesPerCluster, levels, 0 );
+		} ) );
+
+		return id;
+	}
+
+	_loads.push_back ( _jobs->run ( [this, id, fileName, prepare, trianglesPerCluster] ( ) {
+		load ( id, fileName, prepare, trianglesPerCluster );
+	} ) );
+
+	return id;
+}
+
+
+// Appele sous le verrou : le chargement est fini avec son dernier niveau
+void AssetLoader::take ( MeshAsset &asset ) {
+	std::swap ( asset, _assets.front ( ) );
+	_assets.pop_front ( );
+
+	if ( asset.level + 1 == asset.levelCount ) {
+		_pending--;
+	}
+}
+
+
+bool AssetLoader::poll ( MeshAsset &asset ) {
+	// Sans worker, personne d'autre ne fera le chargement
+	if ( _jobs->threads ( ) == 1 ) {
+		return wait ( asset );
+	}
+
+	std::lock_guard<std::mutex> lock ( _mutex );
+
+	if ( _assets.empty ( ) ) {
+		return false;
+	}
+
+	take ( asset );
+
+	return true;
+}
+
+
+bool AssetLoader::wait ( MeshAsset &asset ) {
+	// Aide le job system jusqu'a ce qu'un asset soit publie : chaque job
+	// de _loads en publie un avant de se terminer
+	for ( ; ; ) {
+		JobHandle load;
+
+		{
+			std::lock_guard<std::mutex> lock ( _mutex );
+
+			if ( !_assets.empty ( ) ) {
+				take ( asset );
+				return true;
+			}
+
+			if ( _pending == 0 || _waited == _loads.size ( ) ) {
+				return false;
+			}
+
+			load = _loads[_waited++];
+		}
+
+		_jobs->wait ( load );
+	}
+}
+
+
+uint32_t AssetLoader::pending ( ) const {
+	std::lock_guard<std::mutex> lock ( _mutex );
+	return _pending;
+}
+
+
+void AssetLoader::load ( uint32_t id, const std::string &fileName, const Prepare &prepare, uint32_t trianglesPerCluster ) {
+	auto start = std::chrono::high_resolution_clock::now ( );
+
+	// Les scans compresses et les .off ont des normales par face
+	Mesh mesh = hasExtension ( fileName, ".mgc" ) ? MeshCodec::load ( fileName, false, _jobs ) :
+		hasExtension ( fileName, ".off" ) ? Mesh::loadOFF ( fileName, false, _jobs ) : Mesh::loadOBJ ( fileName, false, _jobs );
+
+	if ( prepare ) {
+		prepare ( mesh );
+	}
+
+	mesh.indexData ( _jobs );
+
+	MeshAsset asset;
+	asset.id = id;
+	asset.fileName = fileName;
+	asset.level = 0;
+	asset.levelCount = 1;
+
+	// Les donnees soudees servent au rendu, aux clusters et aux occulteurs
+	mesh.weldIndexData ( asset.vertices, asset.normals, asset.indices );
+	Mesh::calculateBounds ( mesh, asset.bbMin, asset.bbMax );
+	buildClusters ( asset.vertices, asset.indices, trianglesPerCluster, asset.clusters );
+
+	asset.ms = std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - start ).count ( );
+
+	std::lock_guard<std::mutex> lock ( _mutex );
+	_assets.push_back ( std::move ( asset ) );
+}
+
+
+void AssetLoader::loadLevel ( uint32_t id, const std::string &fileName, const Prepare &prepare, uint32_t trianglesPerCluster,
+							  const std::vector<ProgressiveLevelInfo> &levels, uint32_t level ) {
+	auto start = std::chrono::high_resolution_clock::now ( );
+
+	MeshAsset asset;
+	asset.id = id;
+	asset.fileName = fileName;
+	asset.level = level;
+	asset.levelCount = levels.size ( );
+
+	MeshLevel data;
+
+	// Un fichier illisible termine le chargement avec un asset vide
+	if ( levels.empty ( ) || !ProgressiveMesh::loadLevel ( fileName, levels[level], data, _jobs ) ) {
+		asset.levelCount = level + 1;
+		data = MeshLevel ( );
+	}
+
+	// La preparation travaille sur un mesh : il ne prend que les sommets
+	if ( prepare ) {
+		Mesh mesh;
+		mesh._vertices.swap ( data.positions );
+		mesh._vertexCount = mesh._vertices.size ( );
+
+		prepare ( mesh );
+
+		data.positions.swap ( mesh._vertices );
+	}
+
+	Span<const Vector3> positions ( data.positions.data ( ), data.positions.size ( ) );
+	Span<const uint32_t> indices ( data.indices.data ( ), data.indices.size ( ) );
+
+	ProgressiveMesh::calculateNormals ( positions, indices, asset.normals );
+	Mesh::calculateBounds ( positions, asset.bbMin, asset.bbMax );
+	buildClusters ( positions, indices, trianglesPerCluster, asset.clusters );
+
+	asset.vertices.swap ( data.positions );
+	asset.indices.swap ( data.indices );
+
+	asset.ms = std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - start ).count ( );
+
+	bool last = asset.level + 1 == asset.levelCount;
+
+	std::lock_guard<std::mutex> lock ( _mutex );
+	_assets.push_back ( std::move ( asset ) );
+
+	// Le niveau suivant est un autre job : le rendu recoit chaque niveau des qu'il est pret
+	if ( !last ) {
+		_loads.push_back ( _jobs->run ( [this, id, fileName, prepare, trianglesPerCluster, levels, level] ( ) {
+			loadLevel ( id, fileName, prepare, trianglesPerCluster, levels, level + 1 );
+		} ) );
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "Mesh.h"
+#include "HiZ.h"
+#include "JobSystem.h"
+#include "ProgressiveMesh.h"
+
+/////////////////////////////
+// MeshAsset : a mesh read and prepared off the render thread, ready for the arena
+struct MeshAsset {
+	uint32_t id;
+	std::string fileName;
+
+	std::vector<Vector3> vertices;
+	std::vector<Vector3> normals;
+	std::vector<uint32_t> indices;
+
+	Vector3 bbMin, bbMax;
+	std::vector<MeshCluster> clusters;
+
+	// Progressive files publish every level, coarse first : the level
+	// levelCount - 1 is the full mesh. Other files have a single level
+	uint32_t level;
+	uint32_t levelCount;
+
+	double ms;		// load and preparation time on the worker
+};
+
+/////////////////////////////
+// AssetLoader
+// Each mesh is read, transformed, welded and clustered by a job, its stages
+// split again over the job system. Nothing touches GL there : the render
+// thread polls the finished assets and uploads them when it has the time.
+class AssetLoader {
+
+public:
+	// Scale, translate... applied on the worker before indexing
+	typedef std::function<void ( Mesh & )> Prepare;
+
+	AssetLoader ( );
+	~AssetLoader ( );
+
+	void init ( JobSystem *jobs );
+
+	// .obj, .off, compressed .mgc or progressive .pmg file, returns the id of the future asset
+	uint32_t loadMesh ( const std::string &fileName, const Prepare &prepare, uint32_t trianglesPerCluster );
+
+	// Takes a finished asset if any, without blocking
+	bool poll ( MeshAsset &asset );
+
+	// Blocks until an asset is finished, false when nothing is pending
+	bool wait ( MeshAsset &asset );
+
+	// Loads whose last level is not taken yet
+	uint32_t pending ( ) const;
+
+private:
+	void load ( uint32_t id, const std::string &fileName, const Prepare &prepare, uint32_t trianglesPerCluster );
+
+	// One level of a .pmg file, then submits the next one
+	void loadLevel ( uint32_t id, const std::string &fileName, const Prepare &prepare, uint32_t trianglesPerCluster,
+					 const std::vector<ProgressiveLevelInfo> &levels, uint32_t level );
+
+	void take ( MeshAsset &asset );
+
+	JobSystem *_jobs;
+
+	mutable std::mutex _mutex;
+
+	// Every load submitted, waited for on destruction
+	std::vector<JobHandle> _loads;
+	std::deque<MeshAsset> _assets;
+
+	uint32_t _nextId;
+	uint32_t _pending;
+	uint32_t _waited;		// loads already helped by wait()
+};
@@ -0,0 +1,186 @@
+#include "Compression.h"
+
+#include <cstring>
+
+// Plus courte correspondance codee, et table de hachage des sequences de 4 octets
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 16
+#define LZ_MAX_OFFSET 65535
+
+// Les 5 derniers octets sont toujours des litteraux : le decodeur n'a pas
+// a verifier la fin du bloc au milieu d'une correspondance
+#define LZ_LAST_LITERALS 5
+
+static uint32_t read32 ( const uint8_t *p ) {
+	uint32_t value;
+	memcpy ( &value, p, sizeof ( value ) );
+	return value;
+}
+
+
+static uint32_t hashSequence ( uint32_t sequence ) {
+	return ( sequence * 2654435761u ) >> ( 32 - LZ_HASH_BITS );
+}
+
+
+// Longueur au dela des 15 du jeton : octets de 255 puis le reste
+static void writeLength ( std::vector<uint8_t> &out, size_t length ) {
+	while ( length >= 255 ) {
+		out.push_back ( 255 );
+		length -= 255;
+	}
+	out.push_back ( ( uint8_t ) length );
+}
+
+
+static void writeSequence ( std::vector<uint8_t> &out, const uint8_t *literals, size_t literalCount, size_t offset, size_t matchLength ) {
+	size_t match = matchLength >= LZ_MIN_MATCH ? matchLength - LZ_MIN_MATCH : 0;
+
+	uint8_t token = ( uint8_t ) ( ( literalCount < 15 ? literalCount : 15 ) << 4 );
+	if ( matchLength > 0 ) {
+		token |= ( uint8_t ) ( match < 15 ? match : 15 );
+	}
+	out.push_back ( token );
+
+	if ( literalCount >= 15 ) {
+		writeLength ( out, literalCount - 15 );
+	}
+
+	out.insert ( out.end ( ), literals, literals + literalCount );
+
+	// La derniere sequence n'a pas de correspondance
+	if ( matchLength == 0 ) {
+		return;
+	}
+
+	out.push_back ( ( uint8_t ) ( offset & 0xFF ) );
+	out.push_back ( ( uint8_t ) ( offset >> 8 ) );
+
+	if ( match >= 15 ) {
+		writeLength ( out, match - 15 );
+	}
+}
+
+
+size_t lzCompress ( Span<const uint8_t> input, std::vector<uint8_t> &out ) {
+	size_t start = out.size ( );
+	const uint8_t *data = input.data ( );
+	size_t size = input.size ( );
+
+	if ( size <= LZ_LAST_LITERALS + LZ_MIN_MATCH ) {
+		writeSequence ( out, data, size, 0, 0 );
+		return out.size ( ) - start;
+	}
+
+	// Derniere position vue de chaque sequence, +1 : 0 veut dire aucune
+	std::vector<uint32_t> table ( 1 << LZ_HASH_BITS, 0 );
+
+	size_t anchor = 0;
+	size_t limit = size - LZ_LAST_LITERALS - LZ_MIN_MATCH;
+	size_t i = 0;
+
+	while ( i <= limit ) {
+		uint32_t sequence = read32 ( data + i );
+		uint32_t &slot = table[hashSequence ( sequence )];
+		size_t candidate = slot;
+		slot = ( uint32_t ) ( i + 1 );
+
+		if ( candidate == 0 || i - ( candidate - 1 ) > LZ_MAX_OFFSET || read32 ( data + candidate - 1 ) != sequence ) {
+			i++;
+			continue;
+		}
+
+		size_t match = candidate - 1;
+		size_t length = LZ_MIN_MATCH;
+
+		while ( i + length < size - LZ_LAST_LITERALS && data[match + length] == data[i + length] ) {
+			length++;
+		}
+
+		writeSequence ( out, data + anchor, i - anchor, i - match, length );
+
+		i += length;
+		anchor = i;
+	}
+
+	writeSequence ( out, data + anchor, size - anchor, 0, 0 );
+
+	return out.size ( ) - start;
+}
+
+
+static bool readLength ( const uint8_t *&p, const uint8_t *end, size_t &length ) {
+	uint8_t byte;
+
+	do {
+		if ( p >= end ) {
+			return false;
+		}
+		byte = *p++;
+		length += byte;
+	} while ( byte == 255 );
+
+	return true;
+}
+
+
+bool lzDecompress ( Span<const uint8_t> block, uint8_t *out, size_t outSize ) {
+	const uint8_t *p = block.data ( );
+	const uint8_t *end = p + block.size ( );
+	uint8_t *o = out;
+	uint8_t *oend = out + outSize;
+
+	while ( p < end ) {
+		uint8_t token = *p++;
+
+		size_t literals = token >> 4;
+		if ( literals == 15 && !readLength ( p, end, literals ) ) {
+			return false;
+		}
+
+		if ( ( size_t ) ( end - p ) < literals || ( size_t ) ( oend - o ) < literals ) {
+			return false;
+		}
+
+		memcpy ( o, p, literals );
+		o += literals;
+		p += literals;
+
+		// Fin du bloc : la derniere sequence n'a que des litteraux
+		if ( p == end ) {
+			break;
+		}
+
+		if ( end - p < 2 ) {
+			return false;
+		}
+
+		size_t offset = p[0] | ( p[1] << 8 );
+		p += 2;
+
+		size_t length = token & 15;
+		if ( length == 15 && !readLength ( p, end, length ) ) {
+			return false;
+		}
+		length += LZ_MIN_MATCH;
+
+		if ( offset == 0 || offset > ( size_t ) ( o - out ) || ( size_t ) ( oend - o ) < length ) {
+			return false;
+		}
+
+		const uint8_t *match = o - offset;
+
+		// Recouvrement possible quand l'offset est plus court que la copie
+		if ( offset >= length ) {
+			memcpy ( o, match, length );
+			o += length;
+		}
+		else {
+			for ( size_t k = 0; k < length; ++k ) {
+				*o++ = match[k];
+			}
+		}
+	}
+
+	return o == oend;
+}
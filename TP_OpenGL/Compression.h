@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "Span.h"
+
+/////////////////////////////
+// LZ block compression
+// Byte oriented LZ77 in the spirit of LZ4 : every sequence is a token (4 bits
+// of literal length, 4 bits of match length), the literals, a 16 bit offset.
+// No entropy stage : decoding is a loop of copies, several GB/s.
+
+// Appends the compressed block to out, returns its size
+size_t lzCompress ( Span<const uint8_t> input, std::vector<uint8_t> &out );
+
+// Decodes a block into exactly outSize bytes, false if the block is corrupt
+bool lzDecompress ( Span<const uint8_t> block, uint8_t *out, size_t outSize );
+
+/////////////////////////////
+// Varint : 7 bits per byte, the high bit set while more bytes follow
+
+inline void writeVarint ( std::vector<uint8_t> &out, uint32_t value ) {
+	while ( value >= 0x80 ) {
+		out.push_back ( ( uint8_t ) ( value | 0x80 ) );
+		value >>= 7;
+	}
+	out.push_back ( ( uint8_t ) value );
+}
+
+// NULL when the varint runs past end
+inline const uint8_t *readVarint ( const uint8_t *data, const uint8_t *end, uint32_t &value ) {
+	value = 0;
+
+	for ( uint32_t shift = 0; shift < 35 && data < end; shift += 7 ) {
+		uint8_t byte = *data++;
+		value |= ( uint32_t ) ( byte & 0x7F ) << shift;
+
+		if ( ( byte & 0x80 ) == 0 ) {
+			return data;
+		}
+	}
+
+	return NULL;
+}
+
+// Signed values around 0 on small unsigned ones : 0, -1, 1, -2, ...
+inline uint32_t zigzag ( int32_t value ) {
+	return ( ( uint32_t ) value << 1 ) ^ ( uint32_t ) ( value >> 31 );
+}
+
+inline int32_t unzigzag ( uint32_t value ) {
+	return ( int32_t ) ( value >> 1 ) ^ -( int32_t ) ( value & 1 );
+}
@@ -0,0 +1,232 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Temps vise : une marge sous le budget absorbe les variations d'une image a l'autre
+#define DYNAMIC_RES_HEADROOM 0.9
+
+// Part de l'ecart a l'echelle ideale rattrapee par image : vite en cas de
+// depassement, lentement sinon pour ne pas osciller
+#define DYNAMIC_RES_DOWN_RATE 0.5f
+#define DYNAMIC_RES_UP_RATE 0.1f
+
+// Sous l'echelle complete, les tailles sont des multiples de 8 pixels
+#define DYNAMIC_RES_GRANULARITY 8
+
+DynamicResolution::DynamicResolution ( ) :
+	_budget ( 16.0 ),
+	_minScale ( 0.5f ),
+	_maxScale ( 1.0f ),
+	_scale ( 1.0f ),
+	_targetWidth ( 0 ),
+	_targetHeight ( 0 ),
+	_width ( 0 ),
+	_height ( 0 ),
+	_frame ( 0 ),
+	_lastMs ( 0.0 ),
+	_trace ( NULL ) {
+	for ( uint32_t q = 0; q < DYNAMIC_RES_QUERIES; ++q ) {
+		_pending[q] = false;
+	}
+
+	resetStats ( );
+}
+
+
+DynamicResolution::~DynamicResolution ( ) {
+	if ( _trace != NULL ) {
+		fclose ( _trace );
+	}
+}
+
+
+void DynamicResolution::init ( double budgetMs, float minScale, float maxScale ) {
+	_budget = budgetMs;
+	_maxScale = std::min ( std::max ( maxScale, 0.05f ), 1.0f );
+	_minScale = std::min ( std::max ( minScale, 0.05f ), _maxScale );
+	_scale = _maxScale;
+
+	for ( uint32_t q = 0; q < DYNAMIC_RES_QUERIES; ++q ) {
+		_queries[q] = createQuery ( GL_TIME_ELAPSED );
+		_pending[q] = false;
+	}
+
+	// Bilineaire, sans rien lire hors de la partie dessinee (voir upscale.fsl)
+	_sampler = createSampler ( );
+	GLuint sampler = _sampler.id ( );
+	glSamplerParameteri ( sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glSamplerParameteri ( sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glSamplerParameteri ( sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glSamplerParameteri ( sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+	_vao = createVertexArray ( );
+
+	resetStats ( );
+}
+
+
+void DynamicResolution::release ( ) {
+	_sampler.reset ( );
+	_vao.reset ( );
+
+	for ( uint32_t q = 0; q < DYNAMIC_RES_QUERIES; ++q ) {
+		_queries[q].reset ( );
+		_pending[q] = false;
+	}
+
+	_targetWidth = _targetHeight = 0;
+
+	if ( _trace != NULL ) {
+		fclose ( _trace );
+		_trace = NULL;
+	}
+}
+
+
+bool DynamicResolution::openTrace ( const char *fileName ) {
+	_trace = fopen ( fileName, "w" );
+
+	if ( _trace == NULL ) {
+		printf ( "Impossible to open %s\n", fileName );
+		return false;
+	}
+
+	fprintf ( _trace, "frame,gpu_ms,budget_ms,scale,width,height\n" );
+	return true;
+}
+
+
+void DynamicResolution::resetStats ( ) {
+	_stats.frames = 0;
+	_stats.overBudget = 0;
+	_stats.changes = 0;
+	_stats.gpuMs = 0.0;
+	_stats.scale = 0.0;
+	_stats.minScale = 1.0f;
+	_stats.maxScale = 0.0f;
+}
+
+
+// Le temps GPU suit le nombre de pixels, soit le carre de l'echelle :
+// l'echelle ideale est celle de l'image mesuree corrigee par la racine du rapport
+void DynamicResolution::control ( double ms, float scale ) {
+	double target = _budget * DYNAMIC_RES_HEADROOM;
+	float ideal = ms > 0.0 ? scale * ( float ) sqrt ( target / ms ) : _maxScale;
+	ideal = std::min ( std::max ( ideal, _minScale ), _maxScale );
+
+	if ( ms > target ) {
+		_scale += std::min ( ideal - _scale, 0.0f ) * DYNAMIC_RES_DOWN_RATE;
+	}
+	// Remonte seulement avec une vraie marge : pas d'aller-retour autour du budget
+	else if ( ms < target * DYNAMIC_RES_HEADROOM ) {
+		_scale += std::max ( ideal - _scale, 0.0f ) * DYNAMIC_RES_UP_RATE;
+	}
+
+	_scale = std::min ( std::max ( _scale, _minScale ), _maxScale );
+}
+
+
+void DynamicResolution::begin ( GLsizei width, GLsizei height ) {
+	uint32_t slot = _frame % DYNAMIC_RES_QUERIES;
+
+	// Les resultats sont lus dans l'ordre des images. Seule la plus ancienne,
+	// dont la requete est reutilisee, peut faire attendre le GPU
+	for ( uint32_t i = 0; i < DYNAMIC_RES_QUERIES; ++i ) {
+		uint32_t q = ( _frame + i ) % DYNAMIC_RES_QUERIES;
+
+		if ( !_pending[q] ) {
+			continue;
+		}
+
+		GLint available = 0;
+		glGetQueryObjectiv ( _queries[q].id ( ), GL_QUERY_RESULT_AVAILABLE, &available );
+
+		if ( !available && i > 0 ) {
+			break;
+		}
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v ( _queries[q].id ( ), GL_QUERY_RESULT, &elapsed );
+		_pending[q] = false;
+
+		// Le temps de l'image qui alloue la cible n'est pas representatif, et
+		// certains pilotes (llvmpipe) ne donnent rien de valide pour la premiere
+		if ( _queryResized[q] ) {
+			continue;
+		}
+
+		_lastMs = elapsed / 1e6;
+		control ( _lastMs, _queryScale[q] );
+
+		_stats.frames++;
+		_stats.overBudget += _lastMs > _budget ? 1 : 0;
+		_stats.gpuMs += _lastMs;
+		_stats.scale += _queryScale[q];
+		_stats.minScale = std::min ( _stats.minScale, _queryScale[q] );
+		_stats.maxScale = std::max ( _stats.maxScale, _queryScale[q] );
+
+		if ( _trace != NULL ) {
+			fprintf ( _trace, "%u,%.3f,%.3f,%.4f,%d,%d\n", _queryFrame[q], _lastMs, _budget, _queryScale[q], _querySize[q][0], _querySize[q][1] );
+		}
+	}
+
+	// La cible est refaite par le graphe a la meme image
+	bool resized = width != _targetWidth || height != _targetHeight;
+	_targetWidth = width;
+	_targetHeight = height;
+
+	GLsizei previousWidth = _width, previousHeight = _height;
+
+	if ( _scale >= 1.0f ) {
+		_width = width;
+		_height = height;
+	}
+	else {
+		_width = std::max ( ( GLsizei ) ( width * _scale / DYNAMIC_RES_GRANULARITY + 0.5f ) * DYNAMIC_RES_GRANULARITY, DYNAMIC_RES_GRANULARITY );
+		_height = std::max ( ( GLsizei ) ( height * _scale / DYNAMIC_RES_GRANULARITY + 0.5f ) * DYNAMIC_RES_GRANULARITY, DYNAMIC_RES_GRANULARITY );
+		_width = std::min ( _width, width );
+		_height = std::min ( _height, height );
+	}
+
+	_stats.changes += ( _frame > 0 && ( _width != previousWidth || _height != previousHeight ) ) ? 1 : 0;
+
+	_queryFrame[slot] = _frame;
+	_queryScale[slot] = _scale;
+	_querySize[slot][0] = _width;
+	_querySize[slot][1] = _height;
+	_queryResized[slot] = resized;
+
+	glBeginQuery ( GL_TIME_ELAPSED, _queries[slot].id ( ) );
+}
+
+
+void DynamicResolution::end ( ) {
+	glEndQuery ( GL_TIME_ELAPSED );
+
+	_pending[_frame % DYNAMIC_RES_QUERIES] = true;
+	_frame++;
+}
+
+
+void DynamicResolution::upscale ( GLStateCache &state, GLuint program, GLuint color, GLsizei width, GLsizei height, float sharpness ) const {
+	state.viewport ( 0, 0, width, height );
+	state.depthFunc ( GL_ALWAYS );
+	state.depthMask ( GL_FALSE );
+	state.colorMask ( GL_TRUE );
+
+	state.useProgram ( program );
+
+	state.bindTexture ( 0, color );
+	state.bindSampler ( 0, _sampler.id ( ) );
+
+	glProgramUniform1i ( program, glGetUniformLocation ( program, "scene_color" ), 0 );
+	glProgramUniform2f ( program, glGetUniformLocation ( program, "source_size" ), ( float ) _width, ( float ) _height );
+	glProgramUniform2f ( program, glGetUniformLocation ( program, "source_ratio" ), ( float ) _width / width, ( float ) _height / height );
+	glProgramUniform2f ( program, glGetUniformLocation ( program, "target_texel" ), 1.0f / _targetWidth, 1.0f / _targetHeight );
+	glProgramUniform1f ( program, glGetUniformLocation ( program, "sharpness" ), sharpness );
+
+	state.bindVertexArray ( _vao.id ( ) );
+
+	glDrawArrays ( GL_TRIANGLES, 0, 3 );
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdio>
+#include <stdint.h>
+
+#include "GL/glew.h"
+
+#include "GLState.h"
+#include "GpuResource.h"
+
+// GPU timers in flight : a result is read back this many frames after its frame
+#define DYNAMIC_RES_QUERIES 4
+
+/////////////////////////////
+// DynamicResolutionStats : since the last resetStats
+struct DynamicResolutionStats {
+	uint32_t frames;			// frames whose GPU time was read back
+	uint32_t overBudget;
+	uint32_t changes;			// frames drawn at a different size than the previous one
+	double gpuMs;				// sum of the GPU times
+	double scale;				// sum of the scales
+	float minScale;
+	float maxScale;
+};
+
+/////////////////////////////
+// DynamicResolution
+// The scene is drawn into an offscreen target at a fraction of the
+// framebuffer size, then stretched onto the backbuffer. The target is a
+// transient of the render graph, at the framebuffer size : only its lower
+// left corner is drawn. A GL_TIME_ELAPSED
+// query spans every frame; its result, read a few frames later, moves the
+// scale toward the one whose GPU time fits the budget. The GPU time is taken
+// as proportional to the pixels drawn, so the scale follows the square root
+// of the time ratio, quickly down and slowly up.
+class DynamicResolution {
+
+public:
+	DynamicResolution ( );
+	~DynamicResolution ( );
+
+	// budgetMs : GPU time aimed at per frame, scales in ]0,1]
+	void init ( double budgetMs, float minScale, float maxScale );
+	void release ( );
+
+	// One CSV line per frame read back : frame, GPU ms, scale, size
+	bool openTrace ( const char *fileName );
+
+	// Takes the timings ready, picks the size of this frame for a target of
+	// width x height and starts its timer
+	void begin ( GLsizei width, GLsizei height );
+	void end ( );
+
+	// Draws the color of the target onto the bound framebuffer, width x height
+	// pixels. The program is upscale.vsl/fsl, SHARPEN or not
+	void upscale ( GLStateCache &state, GLuint program, GLuint color, GLsizei width, GLsizei height, float sharpness ) const;
+
+	// Part of the target drawn this frame
+	GLsizei width ( ) const { return _width; }
+	GLsizei height ( ) const { return _height; }
+	float scale ( ) const { return _scale; }
+
+	// GPU time of the last frame read back
+	double lastGpuMs ( ) const { return _lastMs; }
+	double budget ( ) const { return _budget; }
+
+	const DynamicResolutionStats &stats ( ) const { return _stats; }
+	void resetStats ( );
+
+private:
+	void control ( double ms, float scale );
+
+	double _budget;
+	float _minScale;
+	float _maxScale;
+	float _scale;
+
+	// Whole target, and the part drawn this frame
+	GLsizei _targetWidth;
+	GLsizei _targetHeight;
+	GLsizei _width;
+	GLsizei _height;
+
+	Sampler _sampler;
+	VertexArray _vao;		// no attribute : the triangle comes from gl_VertexID
+
+	Query _queries[DYNAMIC_RES_QUERIES];
+	bool _pending[DYNAMIC_RES_QUERIES];
+	uint32_t _queryFrame[DYNAMIC_RES_QUERIES];
+	float _queryScale[DYNAMIC_RES_QUERIES];
+	GLsizei _querySize[DYNAMIC_RES_QUERIES][2];
+	bool _queryResized[DYNAMIC_RES_QUERIES];		// the target was allocated in the frame
+	uint32_t _frame;
+	double _lastMs;
+
+	FILE *_trace;
+
+	DynamicResolutionStats _stats;
+};
@@ -0,0 +1,140 @@
+#include "FrameLoop.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#define FRAME_HISTOGRAM_BIN 0.1		// ms
+#define FRAME_HISTOGRAM_BINS 2500
+
+// Au dela, le retard est abandonne plutot que rattrape
+#define FRAME_MAX_ELAPSED 0.25
+
+FrameHistogram::FrameHistogram ( ) :
+	_bins ( FRAME_HISTOGRAM_BINS, 0 ) {
+	clear ( );
+}
+
+
+void FrameHistogram::clear ( ) {
+	std::fill ( _bins.begin ( ), _bins.end ( ), 0 );
+	_count = 0;
+	_total = 0.0;
+	_max = 0.0;
+}
+
+
+void FrameHistogram::add ( double ms ) {
+	uint32_t bin = std::min ( ( uint32_t ) ( std::max ( ms, 0.0 ) / FRAME_HISTOGRAM_BIN ), ( uint32_t ) FRAME_HISTOGRAM_BINS - 1 );
+
+	_bins[bin]++;
+	_count++;
+	_total += ms;
+	_max = std::max ( _max, ms );
+}
+
+
+double FrameHistogram::percentile ( double p ) const {
+	if ( _count == 0 ) {
+		return 0.0;
+	}
+
+	uint32_t rank = ( uint32_t ) std::ceil ( p / 100.0 * _count );
+	uint32_t seen = 0;
+
+	for ( uint32_t i = 0; i < _bins.size ( ); ++i ) {
+		seen += _bins[i];
+
+		// Le dernier bin n'a pas de borne : le maximum en tient lieu
+		if ( seen >= std::max ( rank, 1u ) ) {
+			return i + 1 < _bins.size ( ) ? std::min ( ( i + 1 ) * FRAME_HISTOGRAM_BIN, _max ) : _max;
+		}
+	}
+
+	return _max;
+}
+
+
+void FrameHistogram::print ( const char *name ) const {
+	printf ( "%-12s %6u frames  mean %7.2f  p50 %7.2f  p95 %7.2f  p99 %7.2f  max %7.2f ms\n", name, _count,
+			 mean ( ), percentile ( 50 ), percentile ( 95 ), percentile ( 99 ), _max );
+}
+
+
+FrameLoop::FrameLoop ( ) :
+	_step ( 1.0 / 60.0 ),
+	_frameCap ( 0.0 ),
+	_previous ( 0.0 ),
+	_frameStart ( 0.0 ),
+	_accumulator ( 0.0 ) {
+}
+
+
+FrameLoop::~FrameLoop ( ) {
+}
+
+
+void FrameLoop::init ( double updateRate, double frameCap, bool vsync ) {
+	_step = 1.0 / updateRate;
+	_frameCap = frameCap;
+
+	glfwSwapInterval ( vsync ? 1 : 0 );
+
+	_previous = glfwGetTime ( );
+	_accumulator = 0.0;
+}
+
+
+uint32_t FrameLoop::begin ( ) {
+	_frameStart = glfwGetTime ( );
+
+	double elapsed = std::min ( _frameStart - _previous, FRAME_MAX_ELAPSED );
+
+	if ( _cpuTimes.count ( ) > 0 ) {
+		_frameTimes.add ( ( _frameStart - _previous ) * 1000.0 );
+	}
+	_previous = _frameStart;
+
+	_accumulator += elapsed;
+
+	uint32_t updates = 0;
+	while ( _accumulator >= _step ) {
+		_accumulator -= _step;
+		updates++;
+	}
+
+	return updates;
+}
+
+
+void FrameLoop::end ( ) {
+	double now = glfwGetTime ( );
+
+	_cpuTimes.add ( ( now - _frameStart ) * 1000.0 );
+
+	if ( _frameCap <= 0.0 ) {
+		return;
+	}
+
+	double target = _frameStart + 1.0 / _frameCap;
+
+	// Sommeil grossier puis attente active pour la derniere milliseconde
+	if ( target - now > 0.002 ) {
+		std::this_thread::sleep_for ( std::chrono::duration<double> ( target - now - 0.001 ) );
+	}
+
+	while ( glfwGetTime ( ) < target ) {
+		std::this_thread::yield ( );
+	}
+}
+
+
+void FrameLoop::print ( ) const {
+	_frameTimes.print ( "frame time" );
+	_cpuTimes.print ( "cpu time" );
+}
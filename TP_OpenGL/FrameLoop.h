@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+/////////////////////////////
+// FrameHistogram
+// Durations in 0.1 ms bins up to 250 ms, percentiles read from the
+// cumulated bins. Longer frames land in the last bin.
+class FrameHistogram {
+
+public:
+	FrameHistogram ( );
+
+	void clear ( );
+	void add ( double ms );
+
+	// Upper bound of the bin holding the p-th percentile (p in [0,100])
+	double percentile ( double p ) const;
+
+	uint32_t count ( ) const { return _count; }
+	double mean ( ) const { return _count > 0 ? _total / _count : 0.0; }
+	double max ( ) const { return _max; }
+
+	void print ( const char *name ) const;
+
+private:
+	std::vector<uint32_t> _bins;
+	uint32_t _count;
+	double _total;
+	double _max;
+};
+
+/////////////////////////////
+// FrameLoop
+// Fixed timestep : the simulation advances by step() as many times as the
+// elapsed time allows, and the frame is drawn with alpha() between the two
+// last states. The frame is then capped or synchronised to the display.
+class FrameLoop {
+
+public:
+	FrameLoop ( );
+	~FrameLoop ( );
+
+	// updateRate : updates per second, frameCap : frames per second (0 : none)
+	void init ( double updateRate, double frameCap, bool vsync );
+
+	// Returns the number of updates to run before drawing this frame
+	uint32_t begin ( );
+
+	// After the swap : waits for the frame cap and records the frame time
+	void end ( );
+
+	double step ( ) const { return _step; }
+	double alpha ( ) const { return _accumulator / _step; }
+
+	// Time between two frames, and time spent working in a frame
+	const FrameHistogram &frameTimes ( ) const { return _frameTimes; }
+	const FrameHistogram &cpuTimes ( ) const { return _cpuTimes; }
+
+	void print ( ) const;
+
+private:
+	double _step;
+	double _frameCap;
+
+	double _previous;		// start of the previous frame
+	double _frameStart;
+	double _accumulator;
+
+	FrameHistogram _frameTimes;
+	FrameHistogram _cpuTimes;
+};
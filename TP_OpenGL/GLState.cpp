@@ -0,0 +1,144 @@
+#include "GLState.h"
+
+// Valeur qui ne correspond a aucun etat : force le prochain appel
+#define UNKNOWN 0xFFFFFFFFu
+
+GLStateCache::GLStateCache ( ) {
+	invalidate ( );
+	resetStats ( );
+}
+
+
+void GLStateCache::invalidate ( ) {
+	_program = UNKNOWN;
+	_fbo = UNKNOWN;
+	_vao = UNKNOWN;
+
+	for ( uint32_t i = 0; i < GL_STATE_TEXTURE_UNITS; ++i ) {
+		_textures[i] = UNKNOWN;
+		_samplers[i] = UNKNOWN;
+	}
+
+	_viewport[0] = _viewport[1] = _viewport[2] = _viewport[3] = -1;
+	_depthFunc = UNKNOWN;
+	_depthMask = -1;
+	_colorMask = -1;
+	_depthTest = -1;
+	_scissorTest = -1;
+	_cullFace = -1;
+}
+
+
+void GLStateCache::resetStats ( ) {
+	_stats.issued = 0;
+	_stats.redundant = 0;
+}
+
+
+bool GLStateCache::changed ( bool same ) {
+	if ( same ) {
+		_stats.redundant++;
+		return false;
+	}
+
+	_stats.issued++;
+	return true;
+}
+
+
+void GLStateCache::useProgram ( GLuint program ) {
+	if ( changed ( _program == program ) ) {
+		glUseProgram ( program );
+		_program = program;
+	}
+}
+
+
+void GLStateCache::bindFramebuffer ( GLuint fbo ) {
+	if ( changed ( _fbo == fbo ) ) {
+		glBindFramebuffer ( GL_DRAW_FRAMEBUFFER, fbo );
+		_fbo = fbo;
+	}
+}
+
+
+void GLStateCache::bindVertexArray ( GLuint vao ) {
+	if ( changed ( _vao == vao ) ) {
+		glBindVertexArray ( vao );
+		_vao = vao;
+	}
+}
+
+
+void GLStateCache::bindTexture ( GLuint unit, GLuint texture ) {
+	if ( changed ( _textures[unit] == texture ) ) {
+		glBindTextureUnit ( unit, texture );
+		_textures[unit] = texture;
+	}
+}
+
+
+void GLStateCache::bindSampler ( GLuint unit, GLuint sampler ) {
+	if ( changed ( _samplers[unit] == sampler ) ) {
+		glBindSampler ( unit, sampler );
+		_samplers[unit] = sampler;
+	}
+}
+
+
+void GLStateCache::viewport ( GLint x, GLint y, GLsizei width, GLsizei height ) {
+	bool same = _viewport[0] == x && _viewport[1] == y && _viewport[2] == width && _viewport[3] == height;
+
+	if ( changed ( same ) ) {
+		glViewport ( x, y, width, height );
+		_viewport[0] = x;
+		_viewport[1] = y;
+		_viewport[2] = width;
+		_viewport[3] = height;
+	}
+}
+
+
+void GLStateCache::depthFunc ( GLenum func ) {
+	if ( changed ( _depthFunc == func ) ) {
+		glDepthFunc ( func );
+		_depthFunc = func;
+	}
+}
+
+
+void GLStateCache::depthMask ( GLboolean mask ) {
+	if ( changed ( _depthMask == mask ) ) {
+		glDepthMask ( mask );
+		_depthMask = mask;
+	}
+}
+
+
+void GLStateCache::colorMask ( GLboolean mask ) {
+	if ( changed ( _colorMask == mask ) ) {
+		glColorMask ( mask, mask, mask, mask );
+		_colorMask = mask;
+	}
+}
+
+
+void GLStateCache::enable ( GLenum capability, bool enabled ) {
+	GLint *state;
+
+	switch ( capability ) {
+	case GL_DEPTH_TEST:		state = &_depthTest; break;
+	case GL_SCISSOR_TEST:	state = &_scissorTest; break;
+	case GL_CULL_FACE:		state = &_cullFace; break;
+	default:
+		// Etat non suivi : toujours transmis
+		_stats.issued++;
+		enabled ? glEnable ( capability ) : glDisable ( capability );
+		return;
+	}
+
+	if ( changed ( *state == ( GLint ) enabled ) ) {
+		enabled ? glEnable ( capability ) : glDisable ( capability );
+		*state = enabled;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "GL/glew.h"
+
+#define GL_STATE_TEXTURE_UNITS 16
+
+/////////////////////////////
+// GLStateStats
+struct GLStateStats {
+	uint32_t issued;		// calls forwarded to the driver
+	uint32_t redundant;		// calls skipped because the state was already set
+};
+
+/////////////////////////////
+// GLStateCache
+// Shadow copy of the bindings and fixed function state touched by the
+// passes. A call that would not change anything is counted and skipped.
+class GLStateCache {
+
+public:
+	GLStateCache ( );
+
+	void useProgram ( GLuint program );
+	void bindFramebuffer ( GLuint fbo );
+	void bindVertexArray ( GLuint vao );
+	void bindTexture ( GLuint unit, GLuint texture );
+	void bindSampler ( GLuint unit, GLuint sampler );
+	void viewport ( GLint x, GLint y, GLsizei width, GLsizei height );
+	void depthFunc ( GLenum func );
+	void depthMask ( GLboolean mask );
+	void colorMask ( GLboolean mask );
+	void enable ( GLenum capability, bool enabled );
+
+	// Forget everything, to be called after GL code that bypasses the cache
+	void invalidate ( );
+
+	void resetStats ( );
+	const GLStateStats &stats ( ) const { return _stats; }
+
+private:
+	bool changed ( bool same );
+
+	GLuint _program;
+	GLuint _fbo;
+	GLuint _vao;
+	GLuint _textures[GL_STATE_TEXTURE_UNITS];
+	GLuint _samplers[GL_STATE_TEXTURE_UNITS];
+	GLint _viewport[4];
+	GLenum _depthFunc;
+	GLint _depthMask;
+	GLint _colorMask;
+	GLint _depthTest;
+	GLint _scissorTest;
+	GLint _cullFace;
+
+	GLStateStats _stats;
+};
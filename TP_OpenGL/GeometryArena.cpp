@@ -0,0 +1,320 @@
+#include "GeometryArena.h"
+#include "Instancing.h"
+
+#include <algorithm>
+
+/////////////////////////////
+// FreeList
+
+FreeList::FreeList ( ) :
+	_capacity ( 0 ),
+	_used ( 0 ) {
+}
+
+
+void FreeList::init ( uint32_t capacity ) {
+	_free.clear ( );
+	_free[0] = capacity;
+	_capacity = capacity;
+	_used = 0;
+}
+
+
+bool FreeList::allocate ( uint32_t size, uint32_t &offset ) {
+	for ( std::map<uint32_t, uint32_t>::iterator it = _free.begin ( ); it != _free.end ( ); ++it ) {
+		if ( it->second < size ) {
+			continue;
+		}
+
+		offset = it->first;
+
+		uint32_t remaining = it->second - size;
+		_free.erase ( it );
+
+		if ( remaining > 0 ) {
+			_free[offset + size] = remaining;
+		}
+
+		_used += size;
+		return true;
+	}
+
+	return false;
+}
+
+
+void FreeList::free ( uint32_t offset, uint32_t size ) {
+	_used -= size;
+
+	std::map<uint32_t, uint32_t>::iterator next = _free.lower_bound ( offset );
+
+	// Fusion avec le bloc libre suivant
+	if ( next != _free.end ( ) && offset + size == next->first ) {
+		size += next->second;
+		next = _free.erase ( next );
+	}
+
+	// Fusion avec le bloc libre precedent
+	if ( next != _free.begin ( ) ) {
+		std::map<uint32_t, uint32_t>::iterator prev = next;
+		--prev;
+
+		if ( prev->first + prev->second == offset ) {
+			prev->second += size;
+			return;
+		}
+	}
+
+	_free[offset] = size;
+}
+
+
+/////////////////////////////
+// GeometryArena
+
+GeometryArena::GeometryArena ( ) :
+	_instanceBuffer ( 0 ) {
+}
+
+
+GeometryArena::~GeometryArena ( ) {
+}
+
+
+void GeometryArena::init ( uint32_t vertexCapacity, uint32_t indexCapacity ) {
+	_vertices.init ( vertexCapacity );
+	_indices.init ( indexCapacity );
+
+	_positionBuffer = createBuffer ( );
+	glNamedBufferData ( _positionBuffer.id ( ), vertexCapacity * sizeof ( Vector3 ), NULL, GL_STATIC_DRAW );
+
+	_normalBuffer = createBuffer ( );
+	glNamedBufferData ( _normalBuffer.id ( ), vertexCapacity * sizeof ( Vector3 ), NULL, GL_STATIC_DRAW );
+
+	_indexBuffer = createBuffer ( );
+	glNamedBufferData ( _indexBuffer.id ( ), indexCapacity * sizeof ( uint32_t ), NULL, GL_STATIC_DRAW );
+
+	_vao = createVertexArray ( );
+	GLuint vao = _vao.id ( );
+
+	setAttributes ( vao );
+
+	glVertexArrayVertexBuffer ( vao, 0, _positionBuffer.id ( ), 0, sizeof ( Vector3 ) );
+	glVertexArrayVertexBuffer ( vao, 1, _normalBuffer.id ( ), 0, sizeof ( Vector3 ) );
+	glVertexArrayElementBuffer ( vao, _indexBuffer.id ( ) );
+}
+
+
+void GeometryArena::setAttributes ( GLuint vao ) {
+	// Positions
+	glEnableVertexArrayAttrib ( vao, 1 );
+	glVertexArrayAttribFormat ( vao, 1, 3, GL_FLOAT, GL_FALSE, 0 );
+	glVertexArrayAttribBinding ( vao, 1, 0 );
+
+	// Normals
+	glEnableVertexArrayAttrib ( vao, 2 );
+	glVertexArrayAttribFormat ( vao, 2, 3, GL_FLOAT, GL_FALSE, 0 );
+	glVertexArrayAttribBinding ( vao, 2, 1 );
+
+	// Instances : model matrix and color
+	for ( uint32_t i = 0; i < 4; ++i ) {
+		glEnableVertexArrayAttrib ( vao, INSTANCE_MODEL_LOCATION + i );
+		glVertexArrayAttribFormat ( vao, INSTANCE_MODEL_LOCATION + i, 4, GL_FLOAT, GL_FALSE, i * sizeof ( glm::vec4 ) );
+		glVertexArrayAttribBinding ( vao, INSTANCE_MODEL_LOCATION + i, 2 );
+	}
+
+	glEnableVertexArrayAttrib ( vao, INSTANCE_COLOR_LOCATION );
+	glVertexArrayAttribFormat ( vao, INSTANCE_COLOR_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof ( glm::mat4 ) );
+	glVertexArrayAttribBinding ( vao, INSTANCE_COLOR_LOCATION, 2 );
+
+	glVertexArrayBindingDivisor ( vao, 2, 1 );
+}
+
+
+bool GeometryArena::allocate ( const Mesh &mesh, GeometryAllocation &allocation ) {
+	std::vector<Vector3> vertices;
+	std::vector<Vector3> normals;
+	std::vector<uint32_t> indices;
+
+	mesh.weldIndexData ( vertices, normals, indices );
+
+	return allocate ( vertices, normals, indices, allocation );
+}
+
+
+bool GeometryArena::allocate ( Span<const Vector3> vertices, Span<const Vector3> normals,
+							   Span<const uint32_t> indices, GeometryAllocation &allocation ) {
+	if ( !reserve ( vertices.size ( ), indices.size ( ), allocation ) ) {
+		return false;
+	}
+
+	size_t progress = 0;
+	upload ( allocation, vertices, normals, indices, progress, ( size_t ) -1 );
+
+	return true;
+}
+
+
+bool GeometryArena::reserve ( uint32_t vertexCount, uint32_t indexCount, GeometryAllocation &allocation ) {
+	allocation.vertexCount = vertexCount;
+	allocation.indexCount = indexCount;
+
+	if ( !_vertices.allocate ( allocation.vertexCount, allocation.firstVertex ) ) {
+		printf ( "Geometry arena: out of vertex space (%u requested)\n", allocation.vertexCount );
+		return false;
+	}
+
+	if ( !_indices.allocate ( allocation.indexCount, allocation.firstIndex ) ) {
+		printf ( "Geometry arena: out of index space (%u requested)\n", allocation.indexCount );
+		_vertices.free ( allocation.firstVertex, allocation.vertexCount );
+		return false;
+	}
+
+	return true;
+}
+
+
+bool GeometryArena::upload ( const GeometryAllocation &allocation, Span<const Vector3> vertices, Span<const Vector3> normals,
+							 Span<const uint32_t> indices, size_t &progress, size_t budget ) {
+	// Les indices restent relatifs au mesh : baseVertex fait le decalage
+	struct Part {
+		GLuint buffer;
+		size_t offset;
+		size_t size;
+		const void *data;
+	};
+
+	Part parts[3] = {
+		{ _positionBuffer.id ( ), allocation.firstVertex * sizeof ( Vector3 ), allocation.vertexCount * sizeof ( Vector3 ), vertices.data ( ) },
+		{ _normalBuffer.id ( ), allocation.firstVertex * sizeof ( Vector3 ), allocation.vertexCount * sizeof ( Vector3 ), normals.data ( ) },
+		{ _indexBuffer.id ( ), allocation.firstIndex * sizeof ( uint32_t ), allocation.indexCount * sizeof ( uint32_t ), indices.data ( ) }
+	};
+
+	size_t start = 0;
+
+	for ( uint32_t i = 0; i < 3; ++i ) {
+		const Part &part = parts[i];
+
+		// La partie deja copiee est sautee, la suite prend ce qui reste du budget
+		if ( progress < start + part.size && budget > 0 ) {
+			size_t done = progress - start;
+			size_t count = std::min ( part.size - done, budget );
+
+			glNamedBufferSubData ( part.buffer, part.offset + done, count, ( const uint8_t* ) part.data + done );
+
+			progress += count;
+			budget -= count;
+		}
+
+		start += part.size;
+	}
+
+	return progress == start;
+}
+
+
+void GeometryArena::free ( const GeometryAllocation &allocation ) {
+	_vertices.free ( allocation.firstVertex, allocation.vertexCount );
+	_indices.free ( allocation.firstIndex, allocation.indexCount );
+}
+
+
+void GeometryArena::release ( ) {
+	_vao.reset ( );
+	_positionBuffer.reset ( );
+	_normalBuffer.reset ( );
+	_indexBuffer.reset ( );
+	_instanceBuffer = 0;
+}
+
+
+void GeometryArena::setInstanceBuffer ( GLuint buffer ) {
+	if ( buffer == _instanceBuffer ) {
+		return;
+	}
+
+	_instanceBuffer = buffer;
+	glVertexArrayVertexBuffer ( _vao.id ( ), 2, buffer, 0, sizeof ( Instance ) );
+}
+
+
+/////////////////////////////
+// DrawCommandBuilder
+
+uint32_t DrawCommandBuilder::drawCalls = 0;
+bool DrawCommandBuilder::separateDraws = false;
+
+DrawCommandBuilder::DrawCommandBuilder ( ) :
+	_capacity ( 0 ) {
+}
+
+
+DrawCommandBuilder::~DrawCommandBuilder ( ) {
+}
+
+
+void DrawCommandBuilder::clear ( ) {
+	_commands.clear ( );
+}
+
+
+void DrawCommandBuilder::add ( const GeometryAllocation &geometry, uint32_t instanceCount, uint32_t baseInstance ) {
+	if ( instanceCount == 0 || geometry.indexCount == 0 ) {
+		return;
+	}
+
+	DrawCommand command = {
+		geometry.indexCount,
+		instanceCount,
+		geometry.firstIndex,
+		( GLint ) geometry.firstVertex,
+		baseInstance
+	};
+
+	_commands.push_back ( command );
+}
+
+
+void DrawCommandBuilder::draw ( ) {
+	if ( _commands.empty ( ) ) {
+		return;
+	}
+
+	if ( separateDraws ) {
+		for ( uint32_t c = 0; c < _commands.size ( ); ++c ) {
+			const DrawCommand &command = _commands[c];
+
+			for ( uint32_t i = 0; i < command.instanceCount; ++i ) {
+				glDrawElementsInstancedBaseVertexBaseInstance ( GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+																( void* ) ( command.firstIndex * sizeof ( uint32_t ) ),
+																1, command.baseVertex, command.baseInstance + i );
+			}
+
+			drawCalls += command.instanceCount;
+		}
+
+		return;
+	}
+
+	if ( _commands.size ( ) > _capacity ) {
+		_capacity = _commands.size ( ) * 2;
+
+		// L'ancien buffer est detruit par l'affectation
+		_buffer = createBuffer ( );
+		glNamedBufferData ( _buffer.id ( ), _capacity * sizeof ( DrawCommand ), NULL, GL_DYNAMIC_DRAW );
+	}
+
+	glNamedBufferSubData ( _buffer.id ( ), 0, _commands.size ( ) * sizeof ( DrawCommand ), &_commands[0] );
+
+	glBindBuffer ( GL_DRAW_INDIRECT_BUFFER, _buffer.id ( ) );
+	glMultiDrawElementsIndirect ( GL_TRIANGLES, GL_UNSIGNED_INT, 0, _commands.size ( ), 0 );
+	glBindBuffer ( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	drawCalls++;
+}
+
+
+void DrawCommandBuilder::release ( ) {
+	_buffer.reset ( );
+	_capacity = 0;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+#include "GL/glew.h"
+
+#include "Mesh.h"
+#include "GpuResource.h"
+#include "Span.h"
+
+/////////////////////////////
+// FreeList : first fit allocator of ranges, neighbouring free ranges are merged
+class FreeList {
+
+public:
+	FreeList ( );
+
+	void init ( uint32_t capacity );
+
+	bool allocate ( uint32_t size, uint32_t &offset );
+	void free ( uint32_t offset, uint32_t size );
+
+	uint32_t capacity ( ) const { return _capacity; }
+	uint32_t used ( ) const { return _used; }
+
+private:
+	// offset -> size of each free range
+	std::map<uint32_t, uint32_t> _free;
+	uint32_t _capacity;
+	uint32_t _used;
+};
+
+/////////////////////////////
+// GeometryAllocation : where a mesh lives in the arena
+struct GeometryAllocation {
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+/////////////////////////////
+// GeometryArena
+// Every mesh is suballocated in the same position, normal and index buffers
+// and read through a single VAO : binding 0 positions, 1 normals, 2 instances.
+class GeometryArena {
+
+public:
+	GeometryArena ( );
+	~GeometryArena ( );
+
+	void init ( uint32_t vertexCapacity, uint32_t indexCapacity );
+
+	bool allocate ( const Mesh &mesh, GeometryAllocation &allocation );
+	bool allocate ( Span<const Vector3> vertices, Span<const Vector3> normals,
+					Span<const uint32_t> indices, GeometryAllocation &allocation );
+	void free ( const GeometryAllocation &allocation );
+
+	// Space only, filled by upload() over several frames
+	bool reserve ( uint32_t vertexCount, uint32_t indexCount, GeometryAllocation &allocation );
+
+	// Copies at most budget bytes of the mesh into its allocation, from
+	// progress : the bytes already copied, positions then normals then
+	// indices. True once the whole mesh is there
+	bool upload ( const GeometryAllocation &allocation, Span<const Vector3> vertices, Span<const Vector3> normals,
+				  Span<const uint32_t> indices, size_t &progress, size_t budget );
+
+	void release ( );
+
+	// Per-instance attributes (Instance layout) for every draw of the arena
+	void setInstanceBuffer ( GLuint buffer );
+
+	// Attribute formats of the arena VAO, for the VAOs read by the same shaders
+	static void setAttributes ( GLuint vao );
+
+	GLuint vao ( ) const { return _vao.id ( ); }
+
+	const FreeList &vertices ( ) const { return _vertices; }
+	const FreeList &indices ( ) const { return _indices; }
+
+private:
+	VertexArray _vao;
+	Buffer _positionBuffer;
+	Buffer _normalBuffer;
+	Buffer _indexBuffer;
+	GLuint _instanceBuffer;		// owned by the instance buffer
+
+	FreeList _vertices;
+	FreeList _indices;
+};
+
+/////////////////////////////
+// DrawCommand : layout expected by glMultiDrawElementsIndirect
+struct DrawCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+/////////////////////////////
+// DrawCommandBuilder
+// Collects the draws of a pass and submits them with one indirect call.
+class DrawCommandBuilder {
+
+public:
+	DrawCommandBuilder ( );
+	~DrawCommandBuilder ( );
+
+	void clear ( );
+	void add ( const GeometryAllocation &geometry, uint32_t instanceCount, uint32_t baseInstance );
+
+	// The arena VAO must be bound
+	void draw ( );
+
+	uint32_t count ( ) const { return _commands.size ( ); }
+
+	void release ( );
+
+	static uint32_t drawCalls;
+
+	// One draw call per instance instead, reference for the benchmark
+	static bool separateDraws;
+
+private:
+	Buffer _buffer;
+	uint32_t _capacity;
+
+	std::vector<DrawCommand> _commands;
+};
@@ -0,0 +1,612 @@
+#include "GeometryBenchmark.h"
+#include "MeshCodec.h"
+#include "MeshGenerator.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <thread>
+
+// Fichiers temporaires des etapes d'entree / sortie
+#define BENCH_OFF_FILE "bench_geometry.off"
+#define BENCH_OBJ_FILE "bench_geometry.obj"
+#define BENCH_MGC_FILE "bench_geometry.mgc"
+
+// Stages, in the order of the JSON output
+enum BenchStage {
+	STAGE_GENERATE,
+	STAGE_SAVE_OFF,
+	STAGE_LOAD_OFF,
+	STAGE_LOAD_OBJ,
+	STAGE_CALCULATE_MAX,
+	STAGE_CENTER_NORMALIZE,
+	STAGE_FACE_NORMALS,
+	STAGE_VERTEX_NORMALS,
+	STAGE_INDEX_DATA,
+	STAGE_COUNT
+};
+
+static const char *stageNames[STAGE_COUNT] = {
+	"generate", "saveOFF", "loadOFF", "loadOBJ", "calculateMax",
+	"centerNormalizeMesh", "calculateFaceNormals", "calculateVertexNormals", "indexData"
+};
+
+// One generated mesh, its timings over every run
+struct BenchMesh {
+	const char *generator;
+	uint32_t parameter;			// subdivisions, or vertices per side
+	uint32_t vertices;
+	uint32_t triangles;
+	uint32_t runs;
+	long offBytes;
+	long objBytes;
+	double min[STAGE_COUNT];
+	double sum[STAGE_COUNT];
+};
+
+static double elapsed ( std::chrono::high_resolution_clock::time_point start ) {
+	return std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - start ).count ( );
+}
+
+
+static long fileSize ( const char *fileName ) {
+	FILE *file = fopen ( fileName, "rb" );
+	if ( file == NULL ) {
+		return 0;
+	}
+
+	fseek ( file, 0, SEEK_END );
+	long size = ftell ( file );
+	fclose ( file );
+
+	return size;
+}
+
+
+// OBJ with one normal per vertex : loadOBJ only reads the faces of files with normals or uvs
+static void saveOBJ ( const char *fileName, const Mesh &mesh ) {
+	FILE *file = fopen ( fileName, "w" );
+	if ( file == NULL ) {
+		return;
+	}
+
+	for ( uint32_t i = 0; i < mesh._vertexCount; ++i ) {
+		fprintf ( file, "v %f %f %f\n", mesh._vertices[i].x, mesh._vertices[i].y, mesh._vertices[i].z );
+	}
+
+	for ( uint32_t i = 0; i < mesh._vertexCount; ++i ) {
+		fprintf ( file, "vn %f %f %f\n", mesh._indexNormals[i].x, mesh._indexNormals[i].y, mesh._indexNormals[i].z );
+	}
+
+	for ( uint32_t k = 0; k < mesh._facesCount; ++k ) {
+		const uint32_t *v = mesh.faceVertices ( k );
+		fprintf ( file, "f %u//%u %u//%u %u//%u\n", v[0] + 1, v[0] + 1, v[1] + 1, v[1] + 1, v[2] + 1, v[2] + 1 );
+	}
+
+	fclose ( file );
+}
+
+
+static void record ( BenchMesh &result, BenchStage stage, double ms ) {
+	result.min[stage] = std::min ( result.min[stage], ms );
+	result.sum[stage] += ms;
+}
+
+
+// Every stage on one mesh, runs times : the generated mesh is copied for each processing stage
+static BenchMesh measure ( const char *generator, uint32_t parameter, const std::function<Mesh ( )> &generate, JobSystem &jobs ) {
+	BenchMesh result;
+	result.generator = generator;
+	result.parameter = parameter;
+	std::fill ( result.min, result.min + STAGE_COUNT, 1e30 );
+	std::fill ( result.sum, result.sum + STAGE_COUNT, 0.0 );
+
+	auto start = std::chrono::high_resolution_clock::now ( );
+	Mesh reference = generate ( );
+	record ( result, STAGE_GENERATE, elapsed ( start ) );
+
+	result.vertices = reference._vertexCount;
+	result.triangles = reference._facesCount;
+
+	// Les gros maillages ne sont mesures qu'une fois
+	result.runs = result.triangles > 2000000 ? 1 : result.triangles > 200000 ? 3 : 5;
+
+	for ( uint32_t r = 0; r < result.runs; ++r ) {
+		if ( r > 0 ) {
+			start = std::chrono::high_resolution_clock::now ( );
+			Mesh again = generate ( );
+			record ( result, STAGE_GENERATE, elapsed ( start ) );
+		}
+
+		start = std::chrono::high_resolution_clock::now ( );
+		Mesh::saveOFF ( BENCH_OFF_FILE, reference );
+		record ( result, STAGE_SAVE_OFF, elapsed ( start ) );
+
+		// Lecture complete : normalisation et normales par sommet comprises
+		{
+			start = std::chrono::high_resolution_clock::now ( );
+			Mesh loaded = Mesh::loadOFF ( BENCH_OFF_FILE, true, &jobs );
+			record ( result, STAGE_LOAD_OFF, elapsed ( start ) );
+		}
+
+		Mesh mesh = reference.clone ( );
+
+		start = std::chrono::high_resolution_clock::now ( );
+		double max = Mesh::calculateMax ( mesh, &jobs );
+		record ( result, STAGE_CALCULATE_MAX, elapsed ( start ) );
+
+		start = std::chrono::high_resolution_clock::now ( );
+		Mesh::centerNormalizeMesh ( mesh, max, &jobs );
+		record ( result, STAGE_CENTER_NORMALIZE, elapsed ( start ) );
+
+		start = std::chrono::high_resolution_clock::now ( );
+		Mesh::calculateFaceNormals ( mesh, &jobs );
+		record ( result, STAGE_FACE_NORMALS, elapsed ( start ) );
+
+		start = std::chrono::high_resolution_clock::now ( );
+		Mesh::calculateVertexNormals ( mesh, &jobs );
+		record ( result, STAGE_VERTEX_NORMALS, elapsed ( start ) );
+
+		// Le fichier OBJ a besoin des normales par sommet
+		if ( r == 0 ) {
+			saveOBJ ( BENCH_OBJ_FILE, mesh );
+		}
+
+		start = std::chrono::high_resolution_clock::now ( );
+		mesh.indexData ( &jobs );
+		record ( result, STAGE_INDEX_DATA, elapsed ( start ) );
+
+		mesh = Mesh ( );
+
+		start = std::chrono::high_resolution_clock::now ( );
+		Mesh obj = Mesh::loadOBJ ( BENCH_OBJ_FILE, false, &jobs );
+		record ( result, STAGE_LOAD_OBJ, elapsed ( start ) );
+	}
+
+	result.offBytes = fileSize ( BENCH_OFF_FILE );
+	result.objBytes = fileSize ( BENCH_OBJ_FILE );
+
+	remove ( BENCH_OFF_FILE );
+	remove ( BENCH_OBJ_FILE );
+
+	return result;
+}
+
+
+static void writeJSON ( FILE *file, const std::vector<BenchMesh> &results, uint64_t maxTriangles, uint32_t threads ) {
+	char date[32];
+	time_t now = time ( NULL );
+	strftime ( date, sizeof ( date ), "%Y-%m-%dT%H:%M:%SZ", gmtime ( &now ) );
+
+	fprintf ( file, "{\n" );
+	fprintf ( file, "  \"benchmark\": \"geometry\",\n" );
+	fprintf ( file, "  \"date\": \"%s\",\n", date );
+	fprintf ( file, "  \"threads\": %u,\n", threads );
+	fprintf ( file, "  \"max_triangles\": %llu,\n", ( unsigned long long ) maxTriangles );
+	fprintf ( file, "  \"meshes\": [\n" );
+
+	for ( uint32_t i = 0; i < results.size ( ); ++i ) {
+		const BenchMesh &mesh = results[i];
+
+		fprintf ( file, "    {\n" );
+		fprintf ( file, "      \"generator\": \"%s\",\n", mesh.generator );
+		fprintf ( file, "      \"parameter\": %u,\n", mesh.parameter );
+		fprintf ( file, "      \"vertices\": %u,\n", mesh.vertices );
+		fprintf ( file, "      \"triangles\": %u,\n", mesh.triangles );
+		fprintf ( file, "      \"runs\": %u,\n", mesh.runs );
+		fprintf ( file, "      \"off_bytes\": %ld,\n", mesh.offBytes );
+		fprintf ( file, "      \"obj_bytes\": %ld,\n", mesh.objBytes );
+		fprintf ( file, "      \"stages\": {\n" );
+
+		// Meilleur temps et moyenne, en ms ; debit en millions de triangles par seconde
+		for ( uint32_t s = 0; s < STAGE_COUNT; ++s ) {
+			double mean = mesh.sum[s] / mesh.runs;
+			fprintf ( file, "        \"%s\": { \"min_ms\": %.3f, \"mean_ms\": %.3f, \"mtris_per_s\": %.2f }%s\n", stageNames[s], mesh.min[s], mean,
+					  mesh.min[s] > 0.0 ? mesh.triangles / mesh.min[s] / 1000.0 : 0.0, s + 1 < STAGE_COUNT ? "," : "" );
+		}
+
+		fprintf ( file, "      }\n" );
+		fprintf ( file, "    }%s\n", i + 1 < results.size ( ) ? "," : "" );
+	}
+
+	fprintf ( file, "  ]\n" );
+	fprintf ( file, "}\n" );
+}
+
+
+bool benchmarkGeometry ( const char *output, uint64_t maxTriangles, uint32_t threads ) {
+	JobSystem jobs;
+	jobs.init ( threads );
+
+	// Les etapes ecrivent leur progression sur std::cout : le JSON reste propre
+	std::cout.setstate ( std::ios::failbit );
+
+	std::vector<BenchMesh> results;
+
+	// Budgets de triangles multiplies par 4 : une subdivision d'icosphere de plus
+	for ( uint32_t subdivisions = 4; MeshGenerator::icosphereTriangles ( subdivisions ) <= maxTriangles; ++subdivisions ) {
+		uint64_t triangles = MeshGenerator::icosphereTriangles ( subdivisions );
+
+		// Meme nombre de triangles : cote de la grille
+		uint32_t side = ( uint32_t ) sqrt ( triangles / 2.0 ) + 1;
+
+		fprintf ( stderr, "%llu triangles...\n", ( unsigned long long ) triangles );
+
+		results.push_back ( measure ( "icosphere", subdivisions, [subdivisions] ( ) {
+			return MeshGenerator::icosphere ( subdivisions );
+		}, jobs ) );
+
+		results.push_back ( measure ( "grid", side, [side] ( ) {
+			return MeshGenerator::grid ( side, side );
+		}, jobs ) );
+
+		results.push_back ( measure ( "noisy", side, [side] ( ) {
+			return MeshGenerator::noisySurface ( side, side, 0.35f, 1 );
+		}, jobs ) );
+	}
+
+	std::cout.clear ( );
+
+	FILE *file = output != NULL ? fopen ( output, "w" ) : stdout;
+
+	if ( file == NULL ) {
+		printf ( "Impossible to open %s\n", output );
+		return false;
+	}
+
+	writeJSON ( file, results, maxTriangles, jobs.threads ( ) );
+
+	if ( file != stdout ) {
+		fclose ( file );
+		fprintf ( stderr, "Results written to %s\n", output );
+	}
+
+	return true;
+}
+
+
+// Decoding time with a number of threads
+struct CodecDecode {
+	uint32_t threads;
+	double ms;
+};
+
+// One mesh through the codec
+struct CodecMesh {
+	std::string name;
+	uint32_t vertices;
+	uint32_t triangles;
+	long offBytes;
+	size_t mgcBytes;
+	double encodeMs;
+	double loadOffMs;
+	double loadMgcMs;
+	bool roundTrip;
+	double maxErrorSteps;
+	std::vector<CodecDecode> decodes;
+};
+
+
+// Cellule de la grille de quantification d'une position
+struct CodecKey {
+	int32_t q[3];
+
+	bool operator<( const CodecKey &k ) const {
+		return q[0] != k.q[0] ? q[0] < k.q[0] : q[1] != k.q[1] ? q[1] < k.q[1] : q[2] < k.q[2];
+	}
+
+	bool operator==( const CodecKey &k ) const {
+		return q[0] == k.q[0] && q[1] == k.q[1] && q[2] == k.q[2];
+	}
+};
+
+// Triangle by the cells of its corners, smallest rotation first : the winding is kept
+struct CodecTriangle {
+	CodecKey corners[3];
+
+	bool operator<( const CodecTriangle &t ) const {
+		for ( uint32_t i = 0; i < 3; ++i ) {
+			if ( !( corners[i] == t.corners[i] ) ) {
+				return corners[i] < t.corners[i];
+			}
+		}
+		return false;
+	}
+
+	bool operator==( const CodecTriangle &t ) const {
+		return corners[0] == t.corners[0] && corners[1] == t.corners[1] && corners[2] == t.corners[2];
+	}
+};
+
+static CodecKey quantize ( const Vector3 &p, const MeshCodecHeader &header ) {
+	CodecKey key;
+	for ( uint32_t k = 0; k < 3; ++k ) {
+		key.q[k] = header.step[k] > 0.0f ? ( int32_t ) floor ( ( p[k] - header.min[k] ) / header.step[k] + 0.5f ) : 0;
+		key.q[k] = std::max ( 0, std::min ( key.q[k], ( int32_t ) ( ( 1u << header.bits ) - 1 ) ) );
+	}
+	return key;
+}
+
+
+static void codecTriangles ( const std::vector<Vector3> &positions, const std::vector<uint32_t> &indices, const MeshCodecHeader &header,
+							 std::vector<CodecTriangle> &triangles ) {
+	triangles.resize ( indices.size ( ) / 3 );
+
+	for ( size_t t = 0; t < triangles.size ( ); ++t ) {
+		CodecKey keys[3];
+		for ( uint32_t i = 0; i < 3; ++i ) {
+			keys[i] = quantize ( positions[indices[3 * t + i]], header );
+		}
+
+		// Plus petite des trois rotations : deux coins peuvent tomber dans la meme cellule
+		for ( uint32_t r = 0; r < 3; ++r ) {
+			CodecTriangle rotated;
+			for ( uint32_t i = 0; i < 3; ++i ) {
+				rotated.corners[i] = keys[( r + i ) % 3];
+			}
+
+			if ( r == 0 || rotated < triangles[t] ) {
+				triangles[t] = rotated;
+			}
+		}
+	}
+
+	std::sort ( triangles.begin ( ), triangles.end ( ) );
+}
+
+
+// The codec renumbers the vertices and reorders the triangles : the decoded
+// mesh must have the same vertices and the same triangles, winding included,
+// once positions are put back on the quantization grid. Every position must
+// be within half a step of a source position of its cell.
+static bool verifyRoundTrip ( const Mesh &source, const std::vector<Vector3> &positions, const std::vector<uint32_t> &indices,
+							  const MeshCodecHeader &header, double &maxErrorSteps ) {
+	std::vector<uint32_t> sourceIndices;
+	MeshCodec::triangulate ( source, sourceIndices );
+
+	maxErrorSteps = 0.0;
+
+	if ( sourceIndices.size ( ) != indices.size ( ) || positions.size ( ) != source._vertexCount ) {
+		return false;
+	}
+
+	for ( size_t i = 0; i < indices.size ( ); ++i ) {
+		if ( indices[i] >= positions.size ( ) ) {
+			return false;
+		}
+	}
+
+	// Sommets tries par cellule : les deux listes doivent se correspondre une a une
+	std::vector<std::pair<CodecKey, Vector3> > sourceVertices, decodedVertices;
+	for ( uint32_t v = 0; v < positions.size ( ); ++v ) {
+		sourceVertices.push_back ( std::make_pair ( quantize ( source._vertices[v], header ), source._vertices[v] ) );
+		decodedVertices.push_back ( std::make_pair ( quantize ( positions[v], header ), positions[v] ) );
+	}
+
+	auto byKey = [] ( const std::pair<CodecKey, Vector3> &a, const std::pair<CodecKey, Vector3> &b ) {
+		return a.first < b.first;
+	};
+	std::sort ( sourceVertices.begin ( ), sourceVertices.end ( ), byKey );
+	std::sort ( decodedVertices.begin ( ), decodedVertices.end ( ), byKey );
+
+	double tolerance = 0.5;
+
+	for ( uint32_t v = 0; v < positions.size ( ); ++v ) {
+		if ( !( sourceVertices[v].first == decodedVertices[v].first ) ) {
+			return false;
+		}
+
+		for ( uint32_t k = 0; k < 3; ++k ) {
+			if ( header.step[k] > 0.0f ) {
+				// Arrondis des flottants en plus du demi pas
+				float extent = std::max ( fabsf ( header.min[k] ), fabsf ( sourceVertices[v].second[k] ) );
+				tolerance = std::max ( tolerance, 0.5 + extent * 1e-6 / header.step[k] );
+
+				maxErrorSteps = std::max ( maxErrorSteps, ( double ) fabsf ( decodedVertices[v].second[k] - sourceVertices[v].second[k] ) / header.step[k] );
+			}
+		}
+	}
+
+	if ( maxErrorSteps > tolerance ) {
+		return false;
+	}
+
+	std::vector<CodecTriangle> sourceTriangles, decodedTriangles;
+	codecTriangles ( source._vertices, sourceIndices, header, sourceTriangles );
+	codecTriangles ( positions, indices, header, decodedTriangles );
+
+	return sourceTriangles == decodedTriangles;
+}
+
+
+static CodecMesh measureCodec ( const std::string &name, const Mesh &mesh, long offBytes, uint32_t bits, uint32_t cores ) {
+	CodecMesh result;
+	result.name = name;
+	result.vertices = mesh._vertexCount;
+	result.triangles = mesh._facesCount;
+	result.offBytes = offBytes;
+	result.encodeMs = 1e30;
+	result.loadOffMs = 1e30;
+	result.loadMgcMs = 1e30;
+
+	uint32_t runs = mesh._facesCount > 2000000 ? 2 : 5;
+
+	JobSystem jobs;
+	jobs.init ( cores );
+
+	std::vector<uint8_t> data;
+
+	for ( uint32_t r = 0; r < runs; ++r ) {
+		auto start = std::chrono::high_resolution_clock::now ( );
+		MeshCodec::encode ( mesh, data, bits, MESH_CODEC_CHUNK, &jobs );
+		result.encodeMs = std::min ( result.encodeMs, elapsed ( start ) );
+	}
+
+	result.mgcBytes = data.size ( );
+
+	Span<const uint8_t> span ( data.data ( ), data.size ( ) );
+	MeshCodecHeader header;
+	MeshCodec::readHeader ( span, header );
+
+	std::vector<Vector3> positions;
+	std::vector<uint32_t> indices;
+
+	result.roundTrip = MeshCodec::decode ( span, positions, indices, &jobs ) &&
+		verifyRoundTrip ( mesh, positions, indices, header, result.maxErrorSteps );
+
+	// Decodage seul, de 1 thread a tous les coeurs
+	for ( uint32_t threads = 1; ; threads = std::min ( threads * 2, cores ) ) {
+		JobSystem decodeJobs;
+		decodeJobs.init ( threads );
+
+		CodecDecode decode;
+		decode.threads = threads;
+		decode.ms = 1e30;
+
+		for ( uint32_t r = 0; r < runs; ++r ) {
+			auto start = std::chrono::high_resolution_clock::now ( );
+			MeshCodec::decode ( span, positions, indices, &decodeJobs );
+			decode.ms = std::min ( decode.ms, elapsed ( start ) );
+		}
+
+		result.decodes.push_back ( decode );
+
+		if ( threads == cores ) {
+			break;
+		}
+	}
+
+	// Chargement complet des deux fichiers : lecture, normalisation, normales des faces
+	FILE *file = fopen ( BENCH_MGC_FILE, "wb" );
+	if ( file != NULL ) {
+		fwrite ( data.data ( ), 1, data.size ( ), file );
+		fclose ( file );
+	}
+
+	for ( uint32_t r = 0; r < runs; ++r ) {
+		auto start = std::chrono::high_resolution_clock::now ( );
+		Mesh off = Mesh::loadOFF ( name, false, &jobs );
+		result.loadOffMs = std::min ( result.loadOffMs, elapsed ( start ) );
+
+		start = std::chrono::high_resolution_clock::now ( );
+		Mesh mgc = MeshCodec::load ( BENCH_MGC_FILE, false, &jobs );
+		result.loadMgcMs = std::min ( result.loadMgcMs, elapsed ( start ) );
+	}
+
+	remove ( BENCH_MGC_FILE );
+
+	return result;
+}
+
+
+static void writeCodecJSON ( FILE *file, const std::vector<CodecMesh> &results, uint32_t bits, uint32_t threads ) {
+	char date[32];
+	time_t now = time ( NULL );
+	strftime ( date, sizeof ( date ), "%Y-%m-%dT%H:%M:%SZ", gmtime ( &now ) );
+
+	fprintf ( file, "{\n" );
+	fprintf ( file, "  \"benchmark\": \"codec\",\n" );
+	fprintf ( file, "  \"date\": \"%s\",\n", date );
+	fprintf ( file, "  \"threads\": %u,\n", threads );
+	fprintf ( file, "  \"bits\": %u,\n", bits );
+	fprintf ( file, "  \"meshes\": [\n" );
+
+	for ( uint32_t i = 0; i < results.size ( ); ++i ) {
+		const CodecMesh &mesh = results[i];
+
+		// Sortie du decodeur : positions et liste de triangles
+		double outputBytes = mesh.vertices * 12.0 + mesh.triangles * 12.0;
+
+		fprintf ( file, "    {\n" );
+		fprintf ( file, "      \"name\": \"%s\",\n", mesh.name.c_str ( ) );
+		fprintf ( file, "      \"vertices\": %u,\n", mesh.vertices );
+		fprintf ( file, "      \"triangles\": %u,\n", mesh.triangles );
+		fprintf ( file, "      \"off_bytes\": %ld,\n", mesh.offBytes );
+		fprintf ( file, "      \"mgc_bytes\": %llu,\n", ( unsigned long long ) mesh.mgcBytes );
+		fprintf ( file, "      \"ratio\": %.2f,\n", mesh.mgcBytes > 0 ? ( double ) mesh.offBytes / mesh.mgcBytes : 0.0 );
+		fprintf ( file, "      \"bits_per_triangle\": %.2f,\n", mesh.triangles > 0 ? mesh.mgcBytes * 8.0 / mesh.triangles : 0.0 );
+		fprintf ( file, "      \"round_trip\": %s,\n", mesh.roundTrip ? "true" : "false" );
+		fprintf ( file, "      \"max_error_steps\": %.3f,\n", mesh.maxErrorSteps );
+		fprintf ( file, "      \"encode_ms\": %.3f,\n", mesh.encodeMs );
+		fprintf ( file, "      \"load_off_ms\": %.3f,\n", mesh.loadOffMs );
+		fprintf ( file, "      \"load_mgc_ms\": %.3f,\n", mesh.loadMgcMs );
+		fprintf ( file, "      \"decode\": [\n" );
+
+		for ( uint32_t d = 0; d < mesh.decodes.size ( ); ++d ) {
+			const CodecDecode &decode = mesh.decodes[d];
+			fprintf ( file, "        { \"threads\": %u, \"ms\": %.3f, \"mb_per_s\": %.1f }%s\n", decode.threads, decode.ms,
+					  outputBytes / decode.ms / 1000.0, d + 1 < mesh.decodes.size ( ) ? "," : "" );
+		}
+
+		fprintf ( file, "      ]\n" );
+		fprintf ( file, "    }%s\n", i + 1 < results.size ( ) ? "," : "" );
+	}
+
+	fprintf ( file, "  ]\n" );
+	fprintf ( file, "}\n" );
+}
+
+
+bool benchmarkCodec ( const char *output, const std::vector<std::string> &files, uint32_t bits, uint32_t threads ) {
+	uint32_t cores = threads > 0 ? threads : std::max ( std::thread::hardware_concurrency ( ), 1u );
+
+	std::cout.setstate ( std::ios::failbit );
+
+	std::vector<CodecMesh> results;
+
+	for ( uint32_t i = 0; i < files.size ( ); ++i ) {
+		fprintf ( stderr, "%s...\n", files[i].c_str ( ) );
+
+		long offBytes = fileSize ( files[i].c_str ( ) );
+		if ( offBytes == 0 ) {
+			fprintf ( stderr, "Impossible to open %s\n", files[i].c_str ( ) );
+			continue;
+		}
+
+		Mesh mesh = Mesh::loadOFF ( files[i], false );
+		results.push_back ( measureCodec ( files[i], mesh, offBytes, bits, cores ) );
+	}
+
+	// Maillages generes, ecrits en OFF pour la comparaison
+	for ( uint32_t g = 0; g < 2; ++g ) {
+		Mesh mesh = g == 0 ? MeshGenerator::icosphere ( 8 ) : MeshGenerator::noisySurface ( 1024, 1024, 0.35f, 1 );
+		std::string name = g == 0 ? "icosphere_8.off" : "noisy_1024.off";
+
+		fprintf ( stderr, "%s...\n", name.c_str ( ) );
+
+		Mesh::saveOFF ( name, mesh );
+		results.push_back ( measureCodec ( name, Mesh::loadOFF ( name, false ), fileSize ( name.c_str ( ) ), bits, cores ) );
+		remove ( name.c_str ( ) );
+	}
+
+	std::cout.clear ( );
+
+	FILE *file = output != NULL ? fopen ( output, "w" ) : stdout;
+
+	if ( file == NULL ) {
+		printf ( "Impossible to open %s\n", output );
+		return false;
+	}
+
+	writeCodecJSON ( file, results, bits, cores );
+
+	if ( file != stdout ) {
+		fclose ( file );
+		fprintf ( stderr, "Results written to %s\n", output );
+	}
+
+	// Un aller-retour rate fait echouer le benchmark
+	bool ok = true;
+	for ( uint32_t i = 0; i < results.size ( ); ++i ) {
+		if ( !results[i].roundTrip ) {
+			fprintf ( stderr, "Round trip failed on %s\n", results[i].name.c_str ( ) );
+			ok = false;
+		}
+	}
+
+	return ok;
+}
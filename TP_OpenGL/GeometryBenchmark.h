@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Times every stage of the mesh pipeline (file I/O, normalization, normals,
+// indexing) on generated meshes of growing size, up to maxTriangles, with
+// threads workers (0 : one per core). The results are written as JSON to
+// output, or to stdout when output is NULL. No GL context is needed.
+bool benchmarkGeometry ( const char *output, uint64_t maxTriangles, uint32_t threads );
+
+// Compressed geometry (MeshCodec) on the OFF files and two generated meshes :
+// compression ratio against the OFF text, encode and decode time from 1 to
+// threads workers, full load time of both formats. Every decoded mesh is
+// checked against its source, false when one round trip fails.
+bool benchmarkCodec ( const char *output, const std::vector<std::string> &files, uint32_t bits, uint32_t threads );
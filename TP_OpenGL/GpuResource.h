@@ -0,0 +1,130 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "GL/glew.h"
+
+/////////////////////////////
+// GpuHandle
+// Owns one GL object name and deletes it with the handle. Move only : a
+// name has exactly one owner and is never deleted twice. The deletion needs
+// a current context, so the owners are released before glfwTerminate.
+template <typename Deleter>
+class GpuHandle {
+
+public:
+	GpuHandle ( ) : _id ( 0 ) { }
+	explicit GpuHandle ( GLuint id ) : _id ( id ) { }
+
+	GpuHandle ( GpuHandle &&other ) : _id ( other._id ) {
+		other._id = 0;
+	}
+
+	GpuHandle &operator=( GpuHandle &&other ) {
+		if ( this != &other ) {
+			reset ( other._id );
+			other._id = 0;
+		}
+		return *this;
+	}
+
+	~GpuHandle ( ) {
+		reset ( );
+	}
+
+	GLuint id ( ) const { return _id; }
+
+	// Gives up the ownership without deleting
+	GLuint release ( ) {
+		GLuint id = _id;
+		_id = 0;
+		return id;
+	}
+
+	void reset ( GLuint id = 0 ) {
+		if ( _id != 0 ) {
+			Deleter::destroy ( _id );
+		}
+		_id = id;
+	}
+
+private:
+	GpuHandle ( const GpuHandle & ) = delete;
+	GpuHandle &operator=( const GpuHandle & ) = delete;
+
+	GLuint _id;
+};
+
+struct BufferDeleter		{ static void destroy ( GLuint id ) { glDeleteBuffers ( 1, &id ); } };
+struct VertexArrayDeleter	{ static void destroy ( GLuint id ) { glDeleteVertexArrays ( 1, &id ); } };
+struct TextureDeleter		{ static void destroy ( GLuint id ) { glDeleteTextures ( 1, &id ); } };
+struct FramebufferDeleter	{ static void destroy ( GLuint id ) { glDeleteFramebuffers ( 1, &id ); } };
+struct SamplerDeleter		{ static void destroy ( GLuint id ) { glDeleteSamplers ( 1, &id ); } };
+struct QueryDeleter			{ static void destroy ( GLuint id ) { glDeleteQueries ( 1, &id ); } };
+
+typedef GpuHandle<BufferDeleter> Buffer;
+typedef GpuHandle<VertexArrayDeleter> VertexArray;
+typedef GpuHandle<TextureDeleter> Texture;
+typedef GpuHandle<FramebufferDeleter> Framebuffer;
+typedef GpuHandle<SamplerDeleter> Sampler;
+typedef GpuHandle<QueryDeleter> Query;
+
+inline Buffer createBuffer ( ) {
+	GLuint id;
+	glCreateBuffers ( 1, &id );
+	return Buffer ( id );
+}
+
+inline VertexArray createVertexArray ( ) {
+	GLuint id;
+	glCreateVertexArrays ( 1, &id );
+	return VertexArray ( id );
+}
+
+inline Texture createTexture ( GLenum target ) {
+	GLuint id;
+	glCreateTextures ( target, 1, &id );
+	return Texture ( id );
+}
+
+inline Framebuffer createFramebuffer ( ) {
+	GLuint id;
+	glCreateFramebuffers ( 1, &id );
+	return Framebuffer ( id );
+}
+
+inline Sampler createSampler ( ) {
+	GLuint id;
+	glCreateSamplers ( 1, &id );
+	return Sampler ( id );
+}
+
+inline Query createQuery ( GLenum target ) {
+	GLuint id;
+	glCreateQueries ( target, 1, &id );
+	return Query ( id );
+}
+
+/////////////////////////////
+// GpuMesh : the vertex buffers, index buffer and VAO of one mesh, released together
+struct GpuMesh {
+	Buffer positions;
+	Buffer normals;
+	Buffer uvs;
+	Buffer indices;
+	VertexArray vao;
+
+	uint32_t vertexCount;
+	uint32_t indexCount;
+
+	GpuMesh ( ) : vertexCount ( 0 ), indexCount ( 0 ) { }
+
+	void release ( ) {
+		vao.reset ( );
+		positions.reset ( );
+		normals.reset ( );
+		uvs.reset ( );
+		indices.reset ( );
+		vertexCount = indexCount = 0;
+	}
+};
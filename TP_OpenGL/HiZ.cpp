@@ -0,0 +1,297 @@
+#include "HiZ.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool projectBox ( const glm::mat4 &mvp, const glm::vec3 &min, const glm::vec3 &max, ScreenBox &box, bool &crosses ) {
+	// Bit i : le coin est du mauvais cote du plan i
+	uint32_t outside = 0x3F;
+
+	glm::vec3 ndcMin ( 1e30f, 1e30f, 1e30f );
+	glm::vec3 ndcMax ( -1e30f, -1e30f, -1e30f );
+
+	crosses = false;
+
+	for ( uint32_t i = 0; i < 8; ++i ) {
+		glm::vec4 clip = mvp * glm::vec4 (
+			( i & 1 ) ? max.x : min.x,
+			( i & 2 ) ? max.y : min.y,
+			( i & 4 ) ? max.z : min.z,
+			1.0f );
+
+		uint32_t planes = 0;
+		planes |= clip.x < -clip.w ? 0x01 : 0;
+		planes |= clip.x >  clip.w ? 0x02 : 0;
+		planes |= clip.y < -clip.w ? 0x04 : 0;
+		planes |= clip.y >  clip.w ? 0x08 : 0;
+		planes |= clip.z < -clip.w ? 0x10 : 0;
+		planes |= clip.z >  clip.w ? 0x20 : 0;
+		outside &= planes;
+
+		if ( clip.w <= 1e-5f ) {
+			crosses = true;
+			continue;
+		}
+
+		glm::vec3 ndc = glm::vec3 ( clip ) / clip.w;
+		ndcMin = glm::min ( ndcMin, ndc );
+		ndcMax = glm::max ( ndcMax, ndc );
+	}
+
+	// Tous les coins derriere un meme plan
+	if ( outside != 0 ) {
+		return false;
+	}
+
+	box.min = glm::vec2 ( ndcMin.x * 0.5f + 0.5f, ndcMin.y * 0.5f + 0.5f );
+	box.max = glm::vec2 ( ndcMax.x * 0.5f + 0.5f, ndcMax.y * 0.5f + 0.5f );
+	box.nearDepth = std::max ( ndcMin.z * 0.5f + 0.5f, 0.0f );
+
+	return true;
+}
+
+
+DepthPyramid::DepthPyramid ( ) :
+	_viewProjection ( 1.0f ) {
+}
+
+
+DepthPyramid::~DepthPyramid ( ) {
+}
+
+
+void DepthPyramid::build ( const float *depth, uint32_t width, uint32_t height, const glm::mat4 &viewProjection ) {
+	_viewProjection = viewProjection;
+
+	if ( width == 0 || height == 0 ) {
+		_levels.clear ( );
+		_widths.clear ( );
+		_heights.clear ( );
+		return;
+	}
+
+	// Meme taille d'une image a l'autre : les niveaux gardent leur memoire
+	uint32_t count = 1;
+	for ( uint32_t w = width, h = height; w > 1 || h > 1; w = ( w + 1 ) / 2, h = ( h + 1 ) / 2 ) {
+		count++;
+	}
+
+	_levels.resize ( count );
+	_widths.resize ( count );
+	_heights.resize ( count );
+
+	_levels[0].assign ( depth, depth + width * height );
+	_widths[0] = width;
+	_heights[0] = height;
+
+	for ( uint32_t level = 1; level < count; ++level ) {
+		uint32_t w = ( width + 1 ) / 2;
+		uint32_t h = ( height + 1 ) / 2;
+
+		const std::vector<float> &src = _levels[level - 1];
+		std::vector<float> &dst = _levels[level];
+		dst.resize ( w * h );
+
+		for ( uint32_t y = 0; y < h; ++y ) {
+			uint32_t y0 = 2 * y;
+			uint32_t y1 = std::min ( 2 * y + 1, height - 1 );
+
+			for ( uint32_t x = 0; x < w; ++x ) {
+				uint32_t x0 = 2 * x;
+				uint32_t x1 = std::min ( 2 * x + 1, width - 1 );
+
+				dst[y * w + x] = std::max (
+					std::max ( src[y0 * width + x0], src[y0 * width + x1] ),
+					std::max ( src[y1 * width + x0], src[y1 * width + x1] ) );
+			}
+		}
+
+		_widths[level] = w;
+		_heights[level] = h;
+
+		width = w;
+		height = h;
+	}
+}
+
+
+bool DepthPyramid::visible ( const glm::mat4 &model, const glm::vec3 &min, const glm::vec3 &max ) const {
+	if ( _levels.empty ( ) ) {
+		return true;
+	}
+
+	ScreenBox box;
+	bool crosses;
+
+	// Hors du champ de la pyramide : aucune information
+	if ( !projectBox ( _viewProjection * model, min, max, box, crosses ) || crosses ) {
+		return true;
+	}
+
+	return visible ( box );
+}
+
+
+bool DepthPyramid::visible ( const ScreenBox &box ) const {
+	if ( _levels.empty ( ) ) {
+		return true;
+	}
+
+	int width = _widths[0];
+	int height = _heights[0];
+
+	int x0 = std::min ( std::max ( ( int ) std::floor ( box.min.x * width ), 0 ), width - 1 );
+	int x1 = std::min ( std::max ( ( int ) std::floor ( box.max.x * width ), 0 ), width - 1 );
+	int y0 = std::min ( std::max ( ( int ) std::floor ( box.min.y * height ), 0 ), height - 1 );
+	int y1 = std::min ( std::max ( ( int ) std::floor ( box.max.y * height ), 0 ), height - 1 );
+
+	// Premier niveau ou la boite couvre au plus 2x2 texels
+	uint32_t level = 0;
+	while ( level + 1 < _levels.size ( ) && ( ( x1 >> level ) - ( x0 >> level ) > 1 || ( y1 >> level ) - ( y0 >> level ) > 1 ) ) {
+		level++;
+	}
+
+	float farthest = 0.0f;
+
+	for ( int y = y0 >> level; y <= y1 >> level; ++y ) {
+		for ( int x = x0 >> level; x <= x1 >> level; ++x ) {
+			farthest = std::max ( farthest, depth ( level, x, y ) );
+		}
+	}
+
+	return box.nearDepth <= farthest;
+}
+
+
+OccluderRasterizer::OccluderRasterizer ( ) :
+	_width ( 0 ),
+	_height ( 0 ),
+	_triangles ( 0 ) {
+}
+
+
+OccluderRasterizer::~OccluderRasterizer ( ) {
+}
+
+
+void OccluderRasterizer::resize ( uint32_t width, uint32_t height ) {
+	_width = width;
+	_height = height;
+	_depth.resize ( width * height );
+
+	clear ( );
+}
+
+
+void OccluderRasterizer::clear ( ) {
+	std::fill ( _depth.begin ( ), _depth.end ( ), 1.0f );
+	_triangles = 0;
+}
+
+
+static inline float edge ( const glm::vec3 &a, const glm::vec3 &b, float x, float y ) {
+	return ( b.x - a.x ) * ( y - a.y ) - ( b.y - a.y ) * ( x - a.x );
+}
+
+
+void OccluderRasterizer::draw ( Span<const glm::vec3> positions, Span<const uint32_t> indices, const glm::mat4 &mvp ) {
+	std::vector<glm::vec4> &clip = _clip;
+	clip.resize ( positions.size ( ) );
+
+	for ( uint32_t i = 0; i < positions.size ( ); ++i ) {
+		clip[i] = mvp * glm::vec4 ( positions[i], 1.0f );
+	}
+
+	for ( uint32_t t = 0; t + 2 < indices.size ( ); t += 3 ) {
+		glm::vec3 s[3];
+		bool skip = false;
+
+		for ( uint32_t k = 0; k < 3; ++k ) {
+			const glm::vec4 &c = clip[indices[t + k]];
+
+			if ( c.w <= 1e-5f ) {
+				skip = true;
+				break;
+			}
+
+			// Coordonnees fenetre, z dans [0,1]
+			s[k] = glm::vec3 (
+				( c.x / c.w * 0.5f + 0.5f ) * _width,
+				( c.y / c.w * 0.5f + 0.5f ) * _height,
+				c.z / c.w * 0.5f + 0.5f );
+		}
+
+		if ( skip ) {
+			continue;
+		}
+
+		float area = edge ( s[0], s[1], s[2].x, s[2].y );
+
+		if ( std::fabs ( area ) < 1e-8f ) {
+			continue;
+		}
+
+		// Les deux faces sont dessinees
+		if ( area < 0.0f ) {
+			std::swap ( s[1], s[2] );
+			area = -area;
+		}
+
+		int x0 = std::max ( ( int ) std::floor ( std::min ( std::min ( s[0].x, s[1].x ), s[2].x ) ), 0 );
+		int x1 = std::min ( ( int ) std::ceil ( std::max ( std::max ( s[0].x, s[1].x ), s[2].x ) ), ( int ) _width - 1 );
+		int y0 = std::max ( ( int ) std::floor ( std::min ( std::min ( s[0].y, s[1].y ), s[2].y ) ), 0 );
+		int y1 = std::min ( ( int ) std::ceil ( std::max ( std::max ( s[0].y, s[1].y ), s[2].y ) ), ( int ) _height - 1 );
+
+		if ( x0 > x1 || y0 > y1 ) {
+			continue;
+		}
+
+		_triangles++;
+
+		for ( int y = y0; y <= y1; ++y ) {
+			float py = y + 0.5f;
+
+			for ( int x = x0; x <= x1; ++x ) {
+				float px = x + 0.5f;
+
+				float w0 = edge ( s[1], s[2], px, py );
+				float w1 = edge ( s[2], s[0], px, py );
+				float w2 = edge ( s[0], s[1], px, py );
+
+				if ( w0 < 0.0f || w1 < 0.0f || w2 < 0.0f ) {
+					continue;
+				}
+
+				float z = ( w0 * s[0].z + w1 * s[1].z + w2 * s[2].z ) / area;
+				float &d = _depth[y * _width + x];
+
+				if ( z >= 0.0f && z < d ) {
+					d = z;
+				}
+			}
+		}
+	}
+}
+
+
+void buildClusters ( Span<const glm::vec3> positions, Span<const uint32_t> indices,
+					 uint32_t trianglesPerCluster, std::vector<MeshCluster> &clusters ) {
+	clusters.clear ( );
+
+	uint32_t step = std::max ( trianglesPerCluster, 1u ) * 3;
+
+	for ( uint32_t first = 0; first < indices.size ( ); first += step ) {
+		MeshCluster cluster;
+		cluster.firstIndex = first;
+		cluster.indexCount = std::min ( step, ( uint32_t ) indices.size ( ) - first );
+		cluster.min = glm::vec3 ( 1e30f, 1e30f, 1e30f );
+		cluster.max = glm::vec3 ( -1e30f, -1e30f, -1e30f );
+
+		for ( uint32_t i = first; i < first + cluster.indexCount; ++i ) {
+			cluster.min = glm::min ( cluster.min, positions[indices[i]] );
+			cluster.max = glm::max ( cluster.max, positions[indices[i]] );
+		}
+
+		clusters.push_back ( cluster );
+	}
+}
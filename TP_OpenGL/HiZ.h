@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+#include "Span.h"
+
+// CPU side of the occlusion culling : no GL call in here, so the tests
+// run on machines without a GPU.
+
+/////////////////////////////
+// ScreenBox : a box projected in window space
+struct ScreenBox {
+	glm::vec2 min;		// [0,1] window coordinates
+	glm::vec2 max;
+	float nearDepth;	// [0,1] depth of the nearest corner
+};
+
+// Projects the box [min, max] with mvp.
+// Returns false when the box is entirely outside the frustum; crosses
+// is set when it straddles the near plane and cannot be projected
+bool projectBox ( const glm::mat4 &mvp, const glm::vec3 &min, const glm::vec3 &max, ScreenBox &box, bool &crosses );
+
+/////////////////////////////
+// DepthPyramid
+// Max depth mip chain : a texel of level n holds the farthest depth of the
+// 2^n x 2^n pixels it covers. A box nearer than every texel it overlaps
+// may be visible, a box behind all of them is hidden.
+class DepthPyramid {
+
+public:
+	DepthPyramid ( );
+	~DepthPyramid ( );
+
+	// depth in [0,1], rows from the bottom (glReadPixels order), rendered with viewProjection
+	void build ( const float *depth, uint32_t width, uint32_t height, const glm::mat4 &viewProjection );
+
+	// The box [min, max] seen through model may be visible
+	bool visible ( const glm::mat4 &model, const glm::vec3 &min, const glm::vec3 &max ) const;
+	bool visible ( const ScreenBox &box ) const;
+
+	bool empty ( ) const { return _levels.empty ( ); }
+	uint32_t levels ( ) const { return _levels.size ( ); }
+	uint32_t width ( uint32_t level ) const { return _widths[level]; }
+	uint32_t height ( uint32_t level ) const { return _heights[level]; }
+	float depth ( uint32_t level, uint32_t x, uint32_t y ) const { return _levels[level][y * _widths[level] + x]; }
+
+	const glm::mat4 &viewProjection ( ) const { return _viewProjection; }
+
+private:
+	std::vector<std::vector<float> > _levels;
+	std::vector<uint32_t> _widths;
+	std::vector<uint32_t> _heights;
+
+	glm::mat4 _viewProjection;
+};
+
+/////////////////////////////
+// OccluderRasterizer
+// Depth only rasterizer for a handful of large occluders at low resolution.
+// Triangles crossing the near plane are skipped : an occluder that is not
+// drawn only hides less.
+class OccluderRasterizer {
+
+public:
+	OccluderRasterizer ( );
+	~OccluderRasterizer ( );
+
+	void resize ( uint32_t width, uint32_t height );
+	void clear ( );
+
+	void draw ( Span<const glm::vec3> positions, Span<const uint32_t> indices, const glm::mat4 &mvp );
+
+	const float *depth ( ) const { return &_depth[0]; }
+	uint32_t width ( ) const { return _width; }
+	uint32_t height ( ) const { return _height; }
+
+	uint32_t triangles ( ) const { return _triangles; }
+
+private:
+	uint32_t _width;
+	uint32_t _height;
+	std::vector<float> _depth;
+
+	// Clip positions of the occluder being drawn, kept between draws
+	std::vector<glm::vec4> _clip;
+
+	uint32_t _triangles;	// rasterized since the last clear
+};
+
+/////////////////////////////
+// MeshCluster : a run of triangles of a mesh and its bounds
+struct MeshCluster {
+	uint32_t firstIndex;	// relative to the mesh
+	uint32_t indexCount;
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+// Cuts the index buffer in runs of trianglesPerCluster triangles
+void buildClusters ( Span<const glm::vec3> positions, Span<const uint32_t> indices,
+					 uint32_t trianglesPerCluster, std::vector<MeshCluster> &clusters );
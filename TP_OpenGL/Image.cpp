@@ -0,0 +1,88 @@
+#include "Image.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstdio>
+
+// Lignes par tache
+#define IMAGE_GRAIN 64
+
+bool decodeBMP ( const char * imagepath, Image &image, JobSystem *jobs ) {
+
+	// Data read from the header of the BMP file
+	unsigned char header[54];
+	unsigned int dataPos;
+	unsigned int imageSize;
+	unsigned int width, height;
+	// Actual RGB data
+	std::vector<unsigned char> data;
+
+	// Open the file
+	FILE * file = fopen ( imagepath, "rb" );
+	if ( !file ) {
+		printf ( "%s could not be opened. Are you in the right directory ?\n", imagepath );
+		return false;
+	}
+
+	// Read the header, i.e. the 54 first bytes
+
+	// If less than 54 bytes are read, problem
+	if ( fread ( header, 1, 54, file ) != 54 ) {
+		fclose ( file );
+		printf ( "Not a correct BMP file\n" );
+		return false;
+	}
+	// A BMP files always begins with "BM"
+	if ( header[0] != 'B' || header[1] != 'M' ) {
+		fclose ( file );
+		printf ( "Not a correct BMP file\n" );
+		return false;
+	}
+	// Make sure this is a 24bpp file
+	if ( *( int* ) &( header[0x1E] ) != 0 ) { fclose ( file ); printf ( "Not a correct BMP file\n" ); return false; }
+	if ( *( int* ) &( header[0x1C] ) != 24 ) { fclose ( file ); printf ( "Not a correct BMP file\n" ); return false; }
+
+	// Read the information about the image
+	dataPos = *( int* ) &( header[0x0A] );
+	imageSize = *( int* ) &( header[0x22] );
+	width = *( int* ) &( header[0x12] );
+	height = *( int* ) &( header[0x16] );
+
+	// Rows are padded to 4 bytes
+	unsigned int stride = ( width * 3 + 3 ) & ~3u;
+
+	// Some BMP files are misformatted, guess missing information
+	if ( imageSize == 0 )    imageSize = stride * height; // 3 bytes per pixel : Blue, Green and Red
+	if ( dataPos == 0 )      dataPos = 54; // The BMP header is done that way
+
+	// Create a buffer
+	data.resize ( std::max ( imageSize, stride * height ) );
+
+	// Read the actual data from the file into the buffer
+	fseek ( file, dataPos, SEEK_SET );
+	fread ( &data[0], 1, imageSize, file );
+
+	// Everything is in memory now, the file wan be closed
+	fclose ( file );
+
+	// BGR -> RGBA, each task converts a band of rows
+	image.width = width;
+	image.height = height;
+	image.pixels.resize ( width * height * 4 );
+
+	parallelFor ( jobs, 0, height, IMAGE_GRAIN, [&image, &data, stride] ( uint32_t first, uint32_t last ) {
+		for ( uint32_t y = first; y < last; ++y ) {
+			const unsigned char *src = &data[y * stride];
+			uint8_t *dst = &image.pixels[y * image.width * 4];
+
+			for ( uint32_t x = 0; x < image.width; ++x ) {
+				dst[4 * x + 0] = src[3 * x + 2];
+				dst[4 * x + 1] = src[3 * x + 1];
+				dst[4 * x + 2] = src[3 * x + 0];
+				dst[4 * x + 3] = 255;
+			}
+		}
+	} );
+
+	return true;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+class JobSystem;
+
+/////////////////////////////
+// Image : RGBA8 pixels decoded on the CPU, first row at the bottom as GL expects
+struct Image {
+	uint32_t width;
+	uint32_t height;
+	std::vector<uint8_t> pixels;
+};
+
+// Rows are converted in parallel when a job system is given. Prints only
+// errors : the job benchmark times it
+bool decodeBMP ( const char * imagepath, Image &image, JobSystem *jobs = NULL );
@@ -0,0 +1,168 @@
+#include "Instancing.h"
+#include "LinearArena.h"
+#include "StreamBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+InstanceBuffer::InstanceBuffer ( ) :
+	_capacity ( 0 ),
+	_dirtyFirst ( 0 ),
+	_dirtyEnd ( 0 ) {
+}
+
+
+InstanceBuffer::~InstanceBuffer ( ) {
+}
+
+
+void InstanceBuffer::init ( uint32_t capacity ) {
+	_capacity = capacity > 0 ? capacity : 1;
+
+	_instances.reserve ( _capacity );
+
+	_buffer = createBuffer ( );
+	glNamedBufferData ( _buffer.id ( ), _capacity * sizeof ( Instance ), NULL, GL_DYNAMIC_DRAW );
+}
+
+
+void InstanceBuffer::release ( ) {
+	_buffer.reset ( );
+	_capacity = 0;
+	std::vector<Instance> ( ).swap ( _instances );
+}
+
+
+void InstanceBuffer::clear ( ) {
+	_instances.clear ( );
+	_dirtyFirst = _dirtyEnd = 0;
+}
+
+
+void InstanceBuffer::touch ( uint32_t first, uint32_t end ) {
+	if ( _dirtyFirst == _dirtyEnd ) {
+		_dirtyFirst = first;
+		_dirtyEnd = end;
+		return;
+	}
+
+	_dirtyFirst = std::min ( _dirtyFirst, first );
+	_dirtyEnd = std::max ( _dirtyEnd, end );
+}
+
+
+uint32_t InstanceBuffer::add ( const glm::mat4 &model, const Vector3 &color ) {
+	Instance instance = { model, glm::vec4 ( color, 1.0f ) };
+
+	_instances.push_back ( instance );
+	touch ( _instances.size ( ) - 1, _instances.size ( ) );
+
+	return _instances.size ( ) - 1;
+}
+
+
+void InstanceBuffer::set ( uint32_t id, const glm::mat4 &model ) {
+	_instances[id].model = model;
+	touch ( id, id + 1 );
+}
+
+
+void InstanceBuffer::upload ( StreamBuffer *staging ) {
+	if ( _dirtyFirst == _dirtyEnd ) {
+		return;
+	}
+
+	// Nouveau buffer : tout est a envoyer
+	if ( _instances.size ( ) > _capacity ) {
+		while ( _capacity < _instances.size ( ) ) {
+			_capacity *= 2;
+		}
+
+		_buffer = createBuffer ( );
+		glNamedBufferData ( _buffer.id ( ), _capacity * sizeof ( Instance ), NULL, GL_DYNAMIC_DRAW );
+
+		_dirtyFirst = 0;
+		_dirtyEnd = _instances.size ( );
+	}
+
+	GLintptr offset = _dirtyFirst * sizeof ( Instance );
+	GLsizeiptr size = ( _dirtyEnd - _dirtyFirst ) * sizeof ( Instance );
+
+	GLintptr source = 0;
+	void *data = staging != NULL ? staging->allocate ( size, source ) : NULL;
+
+	if ( data != NULL ) {
+		memcpy ( data, &_instances[_dirtyFirst], size );
+		glCopyNamedBufferSubData ( staging->buffer ( ), _buffer.id ( ), source, offset, size );
+	}
+	else {
+		glNamedBufferSubData ( _buffer.id ( ), offset, size, &_instances[_dirtyFirst] );
+	}
+
+	_dirtyFirst = _dirtyEnd = 0;
+}
+
+
+bool InstanceBuffer::sortFrontToBack ( uint32_t first, uint32_t count, const Vector3 &eye, LinearArena &scratch, uint32_t *ids ) {
+	ArenaVector<std::pair<float, uint32_t> > order ( count, std::pair<float, uint32_t> ( ), ArenaAllocator<std::pair<float, uint32_t> > ( &scratch ) );
+
+	for ( uint32_t k = 0; k < count; ++k ) {
+		Vector3 d = Vector3 ( _instances[first + k].model[3] ) - eye;
+		order[k] = std::make_pair ( glm::dot ( d, d ), first + k );
+	}
+
+	std::sort ( order.begin ( ), order.end ( ) );
+
+	// Rien a envoyer si l'ordre n'a pas change
+	bool changed = false;
+	for ( uint32_t k = 0; k < count && !changed; ++k ) {
+		changed = order[k].second != first + k;
+	}
+
+	if ( !changed ) {
+		return false;
+	}
+
+	ArenaVector<Instance> sorted ( ( ArenaAllocator<Instance> ( &scratch ) ) );
+	sorted.reserve ( count );
+	for ( uint32_t k = 0; k < count; ++k ) {
+		sorted.push_back ( _instances[order[k].second] );
+	}
+
+	std::copy ( sorted.begin ( ), sorted.end ( ), _instances.begin ( ) + first );
+	touch ( first, first + count );
+
+	if ( ids != NULL ) {
+		ArenaVector<uint32_t> sortedIds ( count, 0, ArenaAllocator<uint32_t> ( &scratch ) );
+		for ( uint32_t k = 0; k < count; ++k ) {
+			sortedIds[k] = ids[order[k].second];
+		}
+
+		std::copy ( sortedIds.begin ( ), sortedIds.end ( ), ids + first );
+	}
+
+	return true;
+}
+
+
+void InstanceBuffer::calculateBounds ( uint32_t first, uint32_t count, const Vector3 &bbMin, const Vector3 &bbMax, Vector3 &min, Vector3 &max ) const {
+	min = Vector3 (  1e30f,  1e30f,  1e30f );
+	max = Vector3 ( -1e30f, -1e30f, -1e30f );
+
+	for ( uint32_t k = first; k < first + count; ++k ) {
+		const glm::mat4 &model = _instances[k].model;
+
+		for ( uint32_t i = 0; i < 8; ++i ) {
+			glm::vec4 corner (
+				( i & 1 ) ? bbMax.x : bbMin.x,
+				( i & 2 ) ? bbMax.y : bbMin.y,
+				( i & 4 ) ? bbMax.z : bbMin.z,
+				1.0f );
+
+			Vector3 p = Vector3 ( model * corner );
+
+			min = glm::min ( min, p );
+			max = glm::max ( max, p );
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "GL/glew.h"
+
+#include "Mesh.h"
+#include "GpuResource.h"
+
+class LinearArena;
+class StreamBuffer;
+
+// Vertex attribute locations of the per-instance data (basic.vsl, shadowmap.vsl)
+#define INSTANCE_MODEL_LOCATION 3	// mat4 : locations 3, 4, 5, 6
+#define INSTANCE_COLOR_LOCATION 7
+
+/////////////////////////////
+// Instance : layout of one element of the instance buffer
+struct Instance {
+	glm::mat4 model;
+	glm::vec4 color;
+};
+
+/////////////////////////////
+// InstanceBuffer
+// Per-instance transforms and colors of every mesh, read by the vertex shader
+// with a divisor of 1. The instances of a mesh are contiguous and addressed by
+// the baseInstance of its draw command. Only the range of the modified
+// instances is sent, through a stream buffer when one is given.
+class InstanceBuffer {
+
+public:
+	InstanceBuffer ( );
+	~InstanceBuffer ( );
+
+	void init ( uint32_t capacity );
+	void release ( );
+
+	void clear ( );
+	uint32_t add ( const glm::mat4 &model, const Vector3 &color );
+	void set ( uint32_t id, const glm::mat4 &model );
+
+	// Sends the modified instances to the GPU, grows the buffer if needed.
+	// staging : they are written in its region of the frame and copied by
+	// the GPU, the buffer drawn by the frames in flight is never updated
+	// by the CPU. Without it, or when its region is full, glNamedBufferSubData
+	void upload ( StreamBuffer *staging = NULL );
+
+	// Orders the instances [first, first + count) by distance of their origin to the eye,
+	// ids (indexed like the instances) follows the same permutation. The temporaries
+	// come from scratch. False if nothing moved
+	bool sortFrontToBack ( uint32_t first, uint32_t count, const Vector3 &eye, LinearArena &scratch, uint32_t *ids = NULL );
+
+	// Bounding box of the instances [first, first + count) of a mesh of bounds [bbMin, bbMax]
+	void calculateBounds ( uint32_t first, uint32_t count, const Vector3 &bbMin, const Vector3 &bbMax, Vector3 &min, Vector3 &max ) const;
+
+	const Instance &instance ( uint32_t id ) const { return _instances[id]; }
+	uint32_t count ( ) const { return _instances.size ( ); }
+	GLuint buffer ( ) const { return _buffer.id ( ); }
+
+private:
+	// Adds [first, end) to the instances to send
+	void touch ( uint32_t first, uint32_t end );
+
+	Buffer _buffer;
+	uint32_t _capacity;
+
+	// Modified instances [_dirtyFirst, _dirtyEnd), empty when equal
+	uint32_t _dirtyFirst;
+	uint32_t _dirtyEnd;
+
+	std::vector<Instance> _instances;
+};
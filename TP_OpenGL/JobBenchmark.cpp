@@ -0,0 +1,101 @@
+#include "JobBenchmark.h"
+#include "Image.h"
+#include "JobSystem.h"
+#include "LinearArena.h"
+#include "Mesh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+bool benchmarkJobs ( uint32_t threads ) {
+	const uint32_t runs = 5;
+
+	uint32_t cores = threads > 0 ? threads : std::max ( std::thread::hardware_concurrency ( ), 1u );
+
+	// Les etapes sont mesurees sur une copie du mesh deja lu, sans leurs
+	// messages qui noieraient le tableau. Le chargement complet sur un thread
+	// donne aussi le nombre d'allocations d'un mesh
+	uint64_t allocations = memoryStats ( ).allocations;
+	Mesh reference = Mesh::loadOFF ( "buddha.off", true );
+	allocations = memoryStats ( ).allocations - allocations;
+	std::cout.setstate ( std::ios::failbit );
+
+	printf ( "buddha.off: %u vertices, %u faces, %llu heap allocations to load, %u runs\n", reference._vertexCount, reference._facesCount,
+			 ( unsigned long long ) allocations, runs );
+	printf ( "%8s %10s %12s %14s %12s %10s %12s %10s %8s\n", "threads", "normalize", "face normals", "vertex normals",
+			 "index data", "loadOFF", "bmp decode", "stolen", "speedup" );
+
+	double serial = 0.0;
+
+	// Resultats a un thread, la reference des suivants
+	Mesh serialMesh;
+	Image serialImage;
+	bool ok = true;
+
+	for ( uint32_t workers = 1; ; workers = std::min ( workers * 2, cores ) ) {
+		JobSystem jobs;
+		jobs.init ( workers );
+
+		double normalize = 0.0, faceNormals = 0.0, vertexNormals = 0.0, index = 0.0, load = 0.0, decode = 0.0;
+
+		for ( uint32_t r = 0; r < runs; ++r ) {
+			Mesh mesh = reference.clone ( );
+
+			auto t0 = std::chrono::high_resolution_clock::now ( );
+			Mesh::centerNormalizeMesh ( mesh, Mesh::calculateMax ( mesh, &jobs ), &jobs );
+			auto t1 = std::chrono::high_resolution_clock::now ( );
+			Mesh::calculateFaceNormals ( mesh, &jobs );
+			auto t2 = std::chrono::high_resolution_clock::now ( );
+			Mesh::calculateVertexNormals ( mesh, &jobs );
+			auto t3 = std::chrono::high_resolution_clock::now ( );
+			mesh.indexData ( &jobs );
+			auto t4 = std::chrono::high_resolution_clock::now ( );
+			Mesh loaded = Mesh::loadOFF ( "buddha.off", true, &jobs );
+			auto t5 = std::chrono::high_resolution_clock::now ( );
+			Image image;
+			decodeBMP ( "uvtemplate.bmp", image, &jobs );
+			auto t6 = std::chrono::high_resolution_clock::now ( );
+
+			normalize += std::chrono::duration<double, std::milli> ( t1 - t0 ).count ( );
+			faceNormals += std::chrono::duration<double, std::milli> ( t2 - t1 ).count ( );
+			vertexNormals += std::chrono::duration<double, std::milli> ( t3 - t2 ).count ( );
+			index += std::chrono::duration<double, std::milli> ( t4 - t3 ).count ( );
+			load += std::chrono::duration<double, std::milli> ( t5 - t4 ).count ( );
+			decode += std::chrono::duration<double, std::milli> ( t6 - t5 ).count ( );
+
+			if ( workers == 1 && r == 0 ) {
+				serialMesh = std::move ( loaded );
+				serialImage = std::move ( image );
+			}
+			else if ( loaded._vertices != serialMesh._vertices || loaded._normals != serialMesh._normals ||
+					  loaded._indexVertices != serialMesh._indexVertices || loaded._indexNormals != serialMesh._indexNormals ||
+					  image.pixels != serialImage.pixels ) {
+				ok = false;
+			}
+		}
+
+		double stages = ( normalize + faceNormals + vertexNormals + index ) / runs;
+		if ( workers == 1 ) {
+			serial = stages;
+		}
+
+		// Temps en ms par execution, acceleration des etapes par rapport a 1 thread
+		printf ( "%8u %10.3f %12.3f %14.3f %12.3f %10.3f %12.3f %10u %7.2fx\n", workers, normalize / runs, faceNormals / runs,
+				 vertexNormals / runs, index / runs, load / runs, decode / runs, jobs.stolen ( ), serial / stages );
+
+		if ( workers == cores ) {
+			break;
+		}
+	}
+
+	std::cout.clear ( );
+
+	if ( !ok ) {
+		fprintf ( stderr, "The mesh or the image loaded on several threads differs from the one thread load\n" );
+	}
+
+	return ok;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+// Loading of buddha.off from 1 to threads workers (0 : one per core) : each
+// stage, then the whole loadOFF, and the decode of a texture, as a table on
+// stdout. The mesh and the image of every thread count are checked against
+// those of one thread, false when one differs. No GL context is needed.
+bool benchmarkJobs ( uint32_t threads );
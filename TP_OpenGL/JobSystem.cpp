@@ -0,0 +1,230 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem ( ) :
+	_queued ( 0 ),
+	_quit ( false ),
+	_executed ( 0 ),
+	_stolen ( 0 ) {
+	_queues.push_back ( std::unique_ptr<Queue> ( new Queue ( ) ) );
+}
+
+
+JobSystem::~JobSystem ( ) {
+	shutdown ( );
+}
+
+
+void JobSystem::init ( uint32_t threads ) {
+	shutdown ( );
+
+	if ( threads == 0 ) {
+		threads = std::max ( std::thread::hardware_concurrency ( ), 1u );
+	}
+
+	_quit = false;
+
+	_queues.clear ( );
+	for ( uint32_t i = 0; i < threads; ++i ) {
+		_queues.push_back ( std::unique_ptr<Queue> ( new Queue ( ) ) );
+	}
+
+	// Les identifiants sont connus avant qu'un worker ne cherche sa file
+	std::lock_guard<std::mutex> lock ( _sleepMutex );
+
+	for ( uint32_t i = 0; i + 1 < threads; ++i ) {
+		_workers.push_back ( std::thread ( &JobSystem::work, this, i ) );
+		_workerIds.push_back ( _workers.back ( ).get_id ( ) );
+	}
+}
+
+
+void JobSystem::shutdown ( ) {
+	{
+		std::lock_guard<std::mutex> lock ( _sleepMutex );
+		_quit = true;
+	}
+	_wake.notify_all ( );
+
+	for ( uint32_t i = 0; i < _workers.size ( ); ++i ) {
+		_workers[i].join ( );
+	}
+
+	_workers.clear ( );
+	_workerIds.clear ( );
+}
+
+
+JobHandle JobSystem::run ( const Task &task ) {
+	return run ( task, std::vector<JobHandle> ( ) );
+}
+
+
+JobHandle JobSystem::run ( const Task &task, const std::vector<JobHandle> &dependencies ) {
+	JobHandle job = std::make_shared<Job> ( );
+	job->task = task;
+	job->dependencies = dependencies.size ( ) + 1;
+	job->done = false;
+
+	for ( uint32_t i = 0; i < dependencies.size ( ); ++i ) {
+		std::lock_guard<std::mutex> lock ( dependencies[i]->mutex );
+
+		if ( dependencies[i]->done ) {
+			job->dependencies--;
+		}
+		else {
+			dependencies[i]->continuations.push_back ( job );
+		}
+	}
+
+	// Le +1 initial : la tache ne part pas avant d'avoir vu toutes ses dependances
+	if ( --job->dependencies == 0 ) {
+		submit ( job );
+	}
+
+	return job;
+}
+
+
+void JobSystem::wait ( const JobHandle &job ) {
+	uint32_t index = queueIndex ( );
+
+	for ( ;; ) {
+		{
+			std::lock_guard<std::mutex> lock ( job->mutex );
+			if ( job->done ) {
+				return;
+			}
+		}
+
+		if ( !execute ( index ) ) {
+			std::this_thread::yield ( );
+		}
+	}
+}
+
+
+void JobSystem::parallelFor ( uint32_t begin, uint32_t end, uint32_t grain, const RangeTask &task ) {
+	if ( begin >= end ) {
+		return;
+	}
+
+	grain = std::max ( grain, 1u );
+
+	std::vector<JobHandle> chunks;
+	chunks.reserve ( ( end - begin + grain - 1 ) / grain );
+
+	for ( uint32_t first = begin; first < end; first += grain ) {
+		uint32_t last = std::min ( first + grain, end );
+		chunks.push_back ( run ( [&task, first, last] ( ) { task ( first, last ); } ) );
+	}
+
+	for ( uint32_t i = 0; i < chunks.size ( ); ++i ) {
+		wait ( chunks[i] );
+	}
+}
+
+
+uint32_t JobSystem::queueIndex ( ) const {
+	std::thread::id id = std::this_thread::get_id ( );
+
+	for ( uint32_t i = 0; i < _workerIds.size ( ); ++i ) {
+		if ( _workerIds[i] == id ) {
+			return i;
+		}
+	}
+
+	return _queues.size ( ) - 1;
+}
+
+
+void JobSystem::submit ( const JobHandle &job ) {
+	Queue &queue = *_queues[queueIndex ( )];
+
+	{
+		std::lock_guard<std::mutex> lock ( queue.mutex );
+		queue.jobs.push_back ( job );
+	}
+
+	{
+		std::lock_guard<std::mutex> lock ( _sleepMutex );
+		_queued++;
+	}
+	_wake.notify_one ( );
+}
+
+
+bool JobSystem::execute ( uint32_t index ) {
+	JobHandle job;
+
+	// Sa propre file par l'arriere : le travail le plus recent, encore en cache
+	{
+		Queue &queue = *_queues[index];
+		std::lock_guard<std::mutex> lock ( queue.mutex );
+
+		if ( !queue.jobs.empty ( ) ) {
+			job = queue.jobs.back ( );
+			queue.jobs.pop_back ( );
+		}
+	}
+
+	// Sinon vol par l'avant chez les autres : les plus gros morceaux restants
+	for ( uint32_t i = 1; !job && i < _queues.size ( ); ++i ) {
+		Queue &queue = *_queues[( index + i ) % _queues.size ( )];
+		std::lock_guard<std::mutex> lock ( queue.mutex );
+
+		if ( !queue.jobs.empty ( ) ) {
+			job = queue.jobs.front ( );
+			queue.jobs.pop_front ( );
+			_stolen++;
+		}
+	}
+
+	if ( !job ) {
+		return false;
+	}
+
+	_queued--;
+
+	job->task ( );
+	finish ( job );
+
+	_executed++;
+
+	return true;
+}
+
+
+void JobSystem::finish ( const JobHandle &job ) {
+	std::vector<JobHandle> continuations;
+
+	{
+		std::lock_guard<std::mutex> lock ( job->mutex );
+		job->done = true;
+		std::swap ( continuations, job->continuations );
+	}
+
+	for ( uint32_t i = 0; i < continuations.size ( ); ++i ) {
+		if ( --continuations[i]->dependencies == 0 ) {
+			submit ( continuations[i] );
+		}
+	}
+}
+
+
+void JobSystem::work ( uint32_t index ) {
+	{
+		// Attend que init ait enregistre les identifiants
+		std::lock_guard<std::mutex> lock ( _sleepMutex );
+	}
+
+	while ( !_quit ) {
+		if ( execute ( index ) ) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock ( _sleepMutex );
+		_wake.wait ( lock, [this] { return _quit || _queued > 0; } );
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+/////////////////////////////
+// Job : a task and the jobs waiting for it
+struct Job {
+	std::function<void ( )> task;
+
+	// Unfinished dependencies, plus one until the job is submitted
+	std::atomic<uint32_t> dependencies;
+
+	std::mutex mutex;
+	bool done;
+	std::vector<std::shared_ptr<Job> > continuations;
+};
+
+typedef std::shared_ptr<Job> JobHandle;
+
+/////////////////////////////
+// JobSystem
+// Work stealing : every worker pushes and pops at the back of its own deque
+// and steals at the front of the others when it is empty. Threads that are
+// not workers share one more deque and help while they wait.
+class JobSystem {
+
+public:
+	typedef std::function<void ( )> Task;
+	typedef std::function<void ( uint32_t, uint32_t )> RangeTask;
+
+	JobSystem ( );
+	~JobSystem ( );
+
+	// threads : total count including the calling thread (0 : one per core)
+	void init ( uint32_t threads );
+	void shutdown ( );
+
+	// Starts once every dependency is finished
+	JobHandle run ( const Task &task );
+	JobHandle run ( const Task &task, const std::vector<JobHandle> &dependencies );
+
+	// Runs other jobs until this one is finished
+	void wait ( const JobHandle &job );
+
+	// task ( first, last ) on chunks of at most grain indices of [begin, end)
+	void parallelFor ( uint32_t begin, uint32_t end, uint32_t grain, const RangeTask &task );
+
+	uint32_t threads ( ) const { return _workers.size ( ) + 1; }
+
+	uint32_t executed ( ) const { return _executed; }
+	uint32_t stolen ( ) const { return _stolen; }
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<JobHandle> jobs;
+	};
+
+	void work ( uint32_t index );
+	uint32_t queueIndex ( ) const;
+
+	void submit ( const JobHandle &job );
+	bool execute ( uint32_t index );
+	void finish ( const JobHandle &job );
+
+	std::vector<std::thread> _workers;
+	std::vector<std::thread::id> _workerIds;
+
+	// One per worker, the last one is shared by the other threads
+	std::vector<std::unique_ptr<Queue> > _queues;
+
+	std::mutex _sleepMutex;
+	std::condition_variable _wake;
+	std::atomic<uint32_t> _queued;
+	std::atomic<bool> _quit;
+
+	std::atomic<uint32_t> _executed;
+	std::atomic<uint32_t> _stolen;
+};
+
+// Runs on the job system if there is one, else on the calling thread
+inline void parallelFor ( JobSystem *jobs, uint32_t begin, uint32_t end, uint32_t grain, const JobSystem::RangeTask &task ) {
+	if ( jobs != NULL && jobs->threads ( ) > 1 ) {
+		jobs->parallelFor ( begin, end, grain, task );
+	}
+	else if ( begin < end ) {
+		task ( begin, end );
+	}
+}
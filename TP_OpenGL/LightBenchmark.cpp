@@ -0,0 +1,172 @@
+#include "LightBenchmark.h"
+#include "LightClusters.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// Assignations mesurees par configuration, la meilleure est gardee
+#define BENCH_LIGHT_RUNS 20
+
+// One assignment configuration
+struct LightRun {
+	std::string mode;			// "scalar" or "sse"
+	uint32_t threads;
+	double ms;
+	bool match;					// same ranges and indices as the scalar run
+};
+
+// One light count
+struct LightCount {
+	uint32_t lights;
+	LightClusterStats stats;
+	uint32_t usedClusters;		// with at least one light
+	std::vector<LightRun> runs;
+};
+
+static LightRun measure ( LightClusters &clusters, const std::vector<ClusterLight> &lights, const glm::mat4 &view,
+						  bool simd, uint32_t threads, const LightClusters *reference ) {
+	JobSystem jobs;
+	jobs.init ( threads );
+
+	LightClusters::simd = simd;
+
+	LightRun run;
+	run.mode = simd ? "sse" : "scalar";
+	run.threads = threads;
+	run.ms = 1e30;
+
+	for ( uint32_t r = 0; r < BENCH_LIGHT_RUNS; ++r ) {
+		clusters.assign ( lights, view, &jobs );
+		run.ms = std::min ( run.ms, clusters.stats ( ).ms );
+	}
+
+	run.match = reference == NULL || ( clusters.indices ( ) == reference->indices ( ) &&
+		memcmp ( clusters.ranges ( ).data ( ), reference->ranges ( ).data ( ), LIGHT_CLUSTERS_COUNT * sizeof ( ClusterRange ) ) == 0 );
+
+	LightClusters::simd = true;
+
+	return run;
+}
+
+
+static void writeLightsJSON ( FILE *file, const std::vector<LightCount> &results, uint32_t threads ) {
+	char date[32];
+	time_t now = time ( NULL );
+	strftime ( date, sizeof ( date ), "%Y-%m-%dT%H:%M:%SZ", gmtime ( &now ) );
+
+	fprintf ( file, "{\n" );
+	fprintf ( file, "  \"benchmark\": \"lights\",\n" );
+	fprintf ( file, "  \"date\": \"%s\",\n", date );
+	fprintf ( file, "  \"threads\": %u,\n", threads );
+	fprintf ( file, "  \"clusters\": [%u, %u, %u],\n", LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z );
+	fprintf ( file, "  \"counts\": [\n" );
+
+	for ( uint32_t i = 0; i < results.size ( ); ++i ) {
+		const LightCount &count = results[i];
+
+		fprintf ( file, "    {\n" );
+		fprintf ( file, "      \"lights\": %u,\n", count.lights );
+		fprintf ( file, "      \"visible_lights\": %u,\n", count.stats.visibleLights );
+		fprintf ( file, "      \"indices\": %u,\n", count.stats.indices );
+		fprintf ( file, "      \"used_clusters\": %u,\n", count.usedClusters );
+		fprintf ( file, "      \"mean_per_used_cluster\": %.2f,\n", count.usedClusters > 0 ? ( double ) count.stats.indices / count.usedClusters : 0.0 );
+		fprintf ( file, "      \"max_per_cluster\": %u,\n", count.stats.maxPerCluster );
+		fprintf ( file, "      \"box_tests\": %u,\n", count.stats.tests );
+		fprintf ( file, "      \"runs\": [\n" );
+
+		for ( uint32_t r = 0; r < count.runs.size ( ); ++r ) {
+			const LightRun &run = count.runs[r];
+			fprintf ( file, "        { \"mode\": \"%s\", \"threads\": %u, \"ms\": %.4f, \"speedup\": %.2f, \"match\": %s }%s\n",
+					  run.mode.c_str ( ), run.threads, run.ms, count.runs[0].ms / run.ms, run.match ? "true" : "false",
+					  r + 1 < count.runs.size ( ) ? "," : "" );
+		}
+
+		fprintf ( file, "      ]\n" );
+		fprintf ( file, "    }%s\n", i + 1 < results.size ( ) ? "," : "" );
+	}
+
+	fprintf ( file, "  ]\n" );
+	fprintf ( file, "}\n" );
+}
+
+
+bool benchmarkLights ( const char *output, uint32_t maxLights, uint32_t threads ) {
+	uint32_t cores = threads > 0 ? threads : std::max ( std::thread::hardware_concurrency ( ), 1u );
+
+	// La camera du rendu, a 20 unites du centre d'une scene de 20 x 6 x 20
+	glm::mat4 projection = glm::perspective ( 45.0f, 1.0f, 0.1f, 100.0f );
+	glm::mat4 view = glm::lookAt ( glm::vec3 ( 0.0f, 0.0f, 20.0f ), glm::vec3 ( 0.0f, 0.0f, 0.0f ), glm::vec3 ( 0.0f, 1.0f, 0.0f ) );
+
+	const uint32_t counts[] = { 100, 500, 1000, 2500, 5000, 10000, 20000, 50000 };
+
+	std::vector<LightCount> results;
+
+	for ( uint32_t c = 0; c < sizeof ( counts ) / sizeof ( counts[0] ) && counts[c] <= maxLights; ++c ) {
+		fprintf ( stderr, "%u lights...\n", counts[c] );
+
+		std::vector<ClusterLight> lights;
+		LightClusters::scatter ( counts[c], glm::vec3 ( -10.0f, -3.0f, -10.0f ), glm::vec3 ( 10.0f, 3.0f, 10.0f ), 0.5f, 2.0f, 10.0f, 1, lights );
+
+		LightClusters reference;
+		reference.setProjection ( projection, 0.1f, 100.0f );
+
+		LightClusters clusters;
+		clusters.setProjection ( projection, 0.1f, 100.0f );
+
+		LightCount count;
+		count.lights = counts[c];
+		count.runs.push_back ( measure ( reference, lights, view, false, 1, NULL ) );
+		count.stats = reference.stats ( );
+
+		count.usedClusters = 0;
+		for ( uint32_t k = 0; k < LIGHT_CLUSTERS_COUNT; ++k ) {
+			count.usedClusters += reference.ranges ( )[k].count > 0;
+		}
+
+		for ( uint32_t t = 1; ; t = std::min ( t * 2, cores ) ) {
+			count.runs.push_back ( measure ( clusters, lights, view, true, t, &reference ) );
+
+			if ( t == cores ) {
+				break;
+			}
+		}
+
+		results.push_back ( count );
+	}
+
+	FILE *file = output != NULL ? fopen ( output, "w" ) : stdout;
+
+	if ( file == NULL ) {
+		printf ( "Impossible to open %s\n", output );
+		return false;
+	}
+
+	writeLightsJSON ( file, results, cores );
+
+	if ( file != stdout ) {
+		fclose ( file );
+		fprintf ( stderr, "Results written to %s\n", output );
+	}
+
+	// Des listes differentes du scalaire font echouer le benchmark
+	bool ok = true;
+	for ( uint32_t i = 0; i < results.size ( ); ++i ) {
+		for ( uint32_t r = 0; r < results[i].runs.size ( ); ++r ) {
+			if ( !results[i].runs[r].match ) {
+				fprintf ( stderr, "%u lights: %s on %u threads differs from the scalar assignment\n", results[i].lights,
+						  results[i].runs[r].mode.c_str ( ), results[i].runs[r].threads );
+				ok = false;
+			}
+		}
+	}
+
+	return ok;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+
+// Light assignment of the clustered lighting (LightClusters) for 100 up to
+// maxLights lights spread in the view : time with the scalar tests on one
+// thread, then with the SSE tests from 1 to threads workers (0 : one per
+// core), and the cluster occupancy. Every run is checked against the scalar
+// lists, false when one differs. The results are written as JSON to
+// output, or to stdout when output is NULL. No GL context is needed.
+bool benchmarkLights ( const char *output, uint32_t maxLights, uint32_t threads );
@@ -0,0 +1,318 @@
+#include "LightClusters.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// SSE fait partie de toutes les cibles x86 et x64, les autres gardent le code scalaire
+#if defined ( _M_X64 ) || defined ( _M_IX86 ) || defined ( __SSE__ )
+#define LIGHT_CLUSTERS_SSE
+#include <xmmintrin.h>
+#endif
+
+#define LIGHT_CLUSTERS_TILES ( LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y )
+
+bool LightClusters::simd = true;
+
+LightClusters::LightClusters ( ) :
+	_sliceScale ( 0.0f ),
+	_sliceBias ( 0.0f ),
+	_projectionX ( 1.0f ),
+	_projectionY ( 1.0f ),
+	_near ( 0.1f ),
+	_far ( 100.0f ),
+	_sliceOffsets ( LIGHT_CLUSTERS_Z + 1, 0 ),
+	_sliceBases ( LIGHT_CLUSTERS_Z + 1, 0 ),
+	_slicePairs ( LIGHT_CLUSTERS_Z ),
+	_sliceIndices ( LIGHT_CLUSTERS_Z ),
+	_sliceTests ( LIGHT_CLUSTERS_Z, 0 ),
+	_ranges ( LIGHT_CLUSTERS_COUNT ) {
+	memset ( &_stats, 0, sizeof ( _stats ) );
+	memset ( _ranges.data ( ), 0, _ranges.size ( ) * sizeof ( ClusterRange ) );
+}
+
+
+LightClusters::~LightClusters ( ) {
+}
+
+
+static uint32_t tileOf ( float ndc, uint32_t tiles ) {
+	int tile = ( int ) floorf ( ( ndc + 1.0f ) * 0.5f * tiles );
+	return ( uint32_t ) std::min ( std::max ( tile, 0 ), ( int ) tiles - 1 );
+}
+
+
+void LightClusters::setProjection ( const glm::mat4 &projection, float nearPlane, float farPlane ) {
+	_projectionX = projection[0][0];
+	_projectionY = projection[1][1];
+	_near = nearPlane;
+	_far = farPlane;
+
+	float range = logf ( farPlane / nearPlane );
+	_sliceScale = LIGHT_CLUSTERS_Z / range;
+	_sliceBias = -LIGHT_CLUSTERS_Z * logf ( nearPlane ) / range;
+
+	_minX.resize ( LIGHT_CLUSTERS_COUNT );
+	_maxX.resize ( LIGHT_CLUSTERS_COUNT );
+	_minY.resize ( LIGHT_CLUSTERS_COUNT );
+	_maxY.resize ( LIGHT_CLUSTERS_COUNT );
+	_minZ.resize ( LIGHT_CLUSTERS_COUNT );
+	_maxZ.resize ( LIGHT_CLUSTERS_COUNT );
+
+	// En vue, x = ndc * profondeur / projection : la boite d'une tuile va de sa profondeur proche a la lointaine
+	for ( uint32_t z = 0; z < LIGHT_CLUSTERS_Z; ++z ) {
+		float dn = nearPlane * powf ( farPlane / nearPlane, ( float ) z / LIGHT_CLUSTERS_Z );
+		float df = nearPlane * powf ( farPlane / nearPlane, ( float ) ( z + 1 ) / LIGHT_CLUSTERS_Z );
+
+		for ( uint32_t y = 0; y < LIGHT_CLUSTERS_Y; ++y ) {
+			float y0 = -1.0f + 2.0f * y / LIGHT_CLUSTERS_Y;
+			float y1 = -1.0f + 2.0f * ( y + 1 ) / LIGHT_CLUSTERS_Y;
+
+			for ( uint32_t x = 0; x < LIGHT_CLUSTERS_X; ++x ) {
+				float x0 = -1.0f + 2.0f * x / LIGHT_CLUSTERS_X;
+				float x1 = -1.0f + 2.0f * ( x + 1 ) / LIGHT_CLUSTERS_X;
+
+				uint32_t c = ( z * LIGHT_CLUSTERS_Y + y ) * LIGHT_CLUSTERS_X + x;
+				_minX[c] = std::min ( x0 * dn, x0 * df ) / _projectionX;
+				_maxX[c] = std::max ( x1 * dn, x1 * df ) / _projectionX;
+				_minY[c] = std::min ( y0 * dn, y0 * df ) / _projectionY;
+				_maxY[c] = std::max ( y1 * dn, y1 * df ) / _projectionY;
+				_minZ[c] = dn;
+				_maxZ[c] = df;
+			}
+		}
+	}
+}
+
+
+void LightClusters::assign ( Span<const ClusterLight> lights, const glm::mat4 &view, JobSystem *jobs ) {
+	auto start = std::chrono::high_resolution_clock::now ( );
+
+	_bounds.clear ( );
+
+	// Sphere en vue, puis les tuiles et tranches de sa boite : x / profondeur est
+	// extreme aux coins, la projection de la sphere y est contenue
+	for ( uint32_t i = 0; i < lights.size ( ); ++i ) {
+		const ClusterLight &light = lights[i];
+		glm::vec4 p = view * glm::vec4 ( glm::vec3 ( light.position ), 1.0f );
+
+		float depth = -p.z;
+		float radius = light.position.w;
+
+		if ( radius <= 0.0f || depth + radius < _near || depth - radius > _far ) {
+			continue;
+		}
+
+		float dn = std::max ( depth - radius, _near );
+		float df = std::min ( depth + radius, _far );
+
+		float minX = std::min ( ( p.x - radius ) / dn, ( p.x - radius ) / df ) * _projectionX;
+		float maxX = std::max ( ( p.x + radius ) / dn, ( p.x + radius ) / df ) * _projectionX;
+		float minY = std::min ( ( p.y - radius ) / dn, ( p.y - radius ) / df ) * _projectionY;
+		float maxY = std::max ( ( p.y + radius ) / dn, ( p.y + radius ) / df ) * _projectionY;
+
+		if ( maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f ) {
+			continue;
+		}
+
+		LightBounds bounds;
+		bounds.x = p.x;
+		bounds.y = p.y;
+		bounds.depth = depth;
+		bounds.radius = radius;
+		bounds.light = i;
+		bounds.x0 = tileOf ( minX, LIGHT_CLUSTERS_X );
+		bounds.x1 = tileOf ( maxX, LIGHT_CLUSTERS_X );
+		bounds.y0 = tileOf ( minY, LIGHT_CLUSTERS_Y );
+		bounds.y1 = tileOf ( maxY, LIGHT_CLUSTERS_Y );
+		bounds.z0 = ( uint32_t ) std::min ( std::max ( floorf ( logf ( dn ) * _sliceScale + _sliceBias ), 0.0f ), LIGHT_CLUSTERS_Z - 1.0f );
+		bounds.z1 = ( uint32_t ) std::min ( std::max ( floorf ( logf ( df ) * _sliceScale + _sliceBias ), 0.0f ), LIGHT_CLUSTERS_Z - 1.0f );
+
+		_bounds.push_back ( bounds );
+	}
+
+	// Tri par denombrement des lumieres dans les tranches qu'elles touchent : les
+	// compteurs deviennent les fins, puis les debuts au remplissage a rebours
+	std::fill ( _sliceOffsets.begin ( ), _sliceOffsets.end ( ), 0 );
+
+	for ( uint32_t b = 0; b < _bounds.size ( ); ++b ) {
+		for ( uint32_t z = _bounds[b].z0; z <= _bounds[b].z1; ++z ) {
+			_sliceOffsets[z]++;
+		}
+	}
+
+	for ( uint32_t z = 1; z <= LIGHT_CLUSTERS_Z; ++z ) {
+		_sliceOffsets[z] += _sliceOffsets[z - 1];
+	}
+
+	_sliceLights.resize ( _sliceOffsets[LIGHT_CLUSTERS_Z] );
+
+	for ( uint32_t b = _bounds.size ( ); b > 0; --b ) {
+		for ( uint32_t z = _bounds[b - 1].z0; z <= _bounds[b - 1].z1; ++z ) {
+			_sliceLights[--_sliceOffsets[z]] = b - 1;
+		}
+	}
+
+	// Une tache par tranche : chacune ecrit ses propres clusters
+	parallelFor ( jobs, 0, LIGHT_CLUSTERS_Z, 1, [this] ( uint32_t first, uint32_t last ) {
+		for ( uint32_t z = first; z < last; ++z ) {
+			assignSlice ( z );
+		}
+	} );
+
+	// Les listes des tranches mises bout a bout
+	for ( uint32_t z = 0; z < LIGHT_CLUSTERS_Z; ++z ) {
+		_sliceBases[z + 1] = _sliceBases[z] + _sliceIndices[z].size ( );
+	}
+
+	_indices.resize ( _sliceBases[LIGHT_CLUSTERS_Z] );
+
+	parallelFor ( jobs, 0, LIGHT_CLUSTERS_Z, 4, [this] ( uint32_t first, uint32_t last ) {
+		for ( uint32_t z = first; z < last; ++z ) {
+			ClusterRange *ranges = &_ranges[z * LIGHT_CLUSTERS_TILES];
+
+			for ( uint32_t t = 0; t < LIGHT_CLUSTERS_TILES; ++t ) {
+				ranges[t].offset += _sliceBases[z];
+			}
+
+			if ( !_sliceIndices[z].empty ( ) ) {
+				memcpy ( &_indices[_sliceBases[z]], _sliceIndices[z].data ( ), _sliceIndices[z].size ( ) * sizeof ( uint32_t ) );
+			}
+		}
+	} );
+
+	_stats.lights = lights.size ( );
+	_stats.visibleLights = _bounds.size ( );
+	_stats.indices = _indices.size ( );
+	_stats.maxPerCluster = 0;
+	_stats.tests = 0;
+
+	for ( uint32_t c = 0; c < LIGHT_CLUSTERS_COUNT; ++c ) {
+		_stats.maxPerCluster = std::max ( _stats.maxPerCluster, _ranges[c].count );
+	}
+	for ( uint32_t z = 0; z < LIGHT_CLUSTERS_Z; ++z ) {
+		_stats.tests += _sliceTests[z];
+	}
+
+	_stats.ms = std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - start ).count ( );
+}
+
+
+void LightClusters::assignSlice ( uint32_t slice ) {
+	ClusterRange *ranges = &_ranges[slice * LIGHT_CLUSTERS_TILES];
+	std::vector<uint32_t> &pairs = _slicePairs[slice];
+	uint32_t tests = 0;
+
+	pairs.clear ( );
+
+	for ( uint32_t t = 0; t < LIGHT_CLUSTERS_TILES; ++t ) {
+		ranges[t].count = 0;
+	}
+
+	for ( uint32_t i = _sliceOffsets[slice]; i < _sliceOffsets[slice + 1]; ++i ) {
+		const LightBounds &bounds = _bounds[_sliceLights[i]];
+		float radius2 = bounds.radius * bounds.radius;
+
+		for ( uint32_t y = bounds.y0; y <= bounds.y1; ++y ) {
+			uint32_t tile = y * LIGHT_CLUSTERS_X;
+			uint32_t row = slice * LIGHT_CLUSTERS_TILES + tile;
+
+#ifdef LIGHT_CLUSTERS_SSE
+			if ( simd ) {
+				__m128 zero = _mm_setzero_ps ( );
+				__m128 cx = _mm_set1_ps ( bounds.x );
+				__m128 cy = _mm_set1_ps ( bounds.y );
+				__m128 cz = _mm_set1_ps ( bounds.depth );
+				__m128 r2 = _mm_set1_ps ( radius2 );
+
+				// Quatre tuiles alignees par test, les voies hors de [x0, x1] sont masquees
+				for ( uint32_t x = bounds.x0 & ~3u; x <= bounds.x1; x += 4 ) {
+					uint32_t c = row + x;
+
+					__m128 dx = _mm_max_ps ( _mm_max_ps ( _mm_sub_ps ( _mm_loadu_ps ( &_minX[c] ), cx ), _mm_sub_ps ( cx, _mm_loadu_ps ( &_maxX[c] ) ) ), zero );
+					__m128 dy = _mm_max_ps ( _mm_max_ps ( _mm_sub_ps ( _mm_loadu_ps ( &_minY[c] ), cy ), _mm_sub_ps ( cy, _mm_loadu_ps ( &_maxY[c] ) ) ), zero );
+					__m128 dz = _mm_max_ps ( _mm_max_ps ( _mm_sub_ps ( _mm_loadu_ps ( &_minZ[c] ), cz ), _mm_sub_ps ( cz, _mm_loadu_ps ( &_maxZ[c] ) ) ), zero );
+					__m128 d2 = _mm_add_ps ( _mm_add_ps ( _mm_mul_ps ( dx, dx ), _mm_mul_ps ( dy, dy ) ), _mm_mul_ps ( dz, dz ) );
+
+					uint32_t lo = bounds.x0 > x ? bounds.x0 - x : 0;
+					uint32_t hi = std::min ( bounds.x1 - x, 3u );
+					uint32_t mask = ( uint32_t ) _mm_movemask_ps ( _mm_cmple_ps ( d2, r2 ) ) & ( ( 2u << hi ) - ( 1u << lo ) );
+
+					tests += hi + 1 - lo;
+
+					for ( uint32_t k = lo; k <= hi; ++k ) {
+						if ( mask & ( 1u << k ) ) {
+							pairs.push_back ( tile + x + k );
+							pairs.push_back ( bounds.light );
+							ranges[tile + x + k].count++;
+						}
+					}
+				}
+
+				continue;
+			}
+#endif
+
+			for ( uint32_t x = bounds.x0; x <= bounds.x1; ++x ) {
+				uint32_t c = row + x;
+
+				float dx = std::max ( std::max ( _minX[c] - bounds.x, bounds.x - _maxX[c] ), 0.0f );
+				float dy = std::max ( std::max ( _minY[c] - bounds.y, bounds.y - _maxY[c] ), 0.0f );
+				float dz = std::max ( std::max ( _minZ[c] - bounds.depth, bounds.depth - _maxZ[c] ), 0.0f );
+
+				tests++;
+
+				if ( dx * dx + dy * dy + dz * dz <= radius2 ) {
+					pairs.push_back ( tile + x );
+					pairs.push_back ( bounds.light );
+					ranges[tile + x].count++;
+				}
+			}
+		}
+	}
+
+	// Fins des listes, puis remplissage a rebours : l'ordre des lumieres est garde
+	uint32_t end = 0;
+	for ( uint32_t t = 0; t < LIGHT_CLUSTERS_TILES; ++t ) {
+		end += ranges[t].count;
+		ranges[t].offset = end;
+	}
+
+	std::vector<uint32_t> &indices = _sliceIndices[slice];
+	indices.resize ( end );
+
+	for ( size_t p = pairs.size ( ); p > 0; p -= 2 ) {
+		indices[--ranges[pairs[p - 2]].offset] = pairs[p - 1];
+	}
+
+	_sliceTests[slice] = tests;
+}
+
+
+// Hachage entier vers [0, 1)
+static float hashUnit ( uint32_t i, uint32_t seed ) {
+	uint32_t h = i * 374761393u + seed * 2246822519u;
+	h = ( h ^ ( h >> 13 ) ) * 1274126177u;
+	h ^= h >> 16;
+	return ( h & 0xFFFFFF ) / 16777216.0f;
+}
+
+
+void LightClusters::scatter ( uint32_t count, const glm::vec3 &min, const glm::vec3 &max, float minRadius, float maxRadius,
+							  float intensity, uint32_t seed, std::vector<ClusterLight> &lights ) {
+	lights.resize ( count );
+
+	for ( uint32_t i = 0; i < count; ++i ) {
+		glm::vec3 t ( hashUnit ( i * 8, seed ), hashUnit ( i * 8 + 1, seed ), hashUnit ( i * 8 + 2, seed ) );
+		float radius = minRadius + ( maxRadius - minRadius ) * hashUnit ( i * 8 + 3, seed );
+
+		// Couleurs saturees : la plus forte composante vaut 1
+		glm::vec3 color ( hashUnit ( i * 8 + 4, seed ), hashUnit ( i * 8 + 5, seed ), hashUnit ( i * 8 + 6, seed ) );
+		color /= std::max ( std::max ( color.x, color.y ), std::max ( color.z, 0.001f ) );
+
+		lights[i].position = glm::vec4 ( min + ( max - min ) * t, radius );
+		lights[i].color = glm::vec4 ( color * intensity, 0.0f );
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+#include "Span.h"
+
+class JobSystem;
+
+// CPU side of the clustered lighting : no GL call in here
+
+// Clusters of the view frustum : tiles of the screen times depth slices.
+// Same values as in basic.fsl
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 16
+#define LIGHT_CLUSTERS_Z 24
+#define LIGHT_CLUSTERS_COUNT ( LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z )
+
+/////////////////////////////
+// ClusterLight : a point light whose influence ends at its radius.
+// Layout std430 of the ClusterLights buffer of basic.fsl
+struct ClusterLight {
+	glm::vec4 position;		// world space, w : radius
+	glm::vec4 color;		// rgb : color * intensity
+};
+
+/////////////////////////////
+// ClusterRange : the lights of one cluster in the index list.
+// Layout std430 of the ClusterRanges buffer of basic.fsl
+struct ClusterRange {
+	uint32_t offset;
+	uint32_t count;
+};
+
+/////////////////////////////
+// LightClusterStats : counters of the last assignment
+struct LightClusterStats {
+	uint32_t lights;
+	uint32_t visibleLights;		// touching the frustum
+	uint32_t indices;			// light indices of every cluster
+	uint32_t maxPerCluster;
+	uint32_t tests;				// sphere / cluster box tests
+	double ms;
+};
+
+/////////////////////////////
+// LightClusters
+// The frustum is cut in LIGHT_CLUSTERS_X x LIGHT_CLUSTERS_Y screen tiles and
+// LIGHT_CLUSTERS_Z slices, exponentially thicker from near to far. Every
+// frame the lights are moved to view space, binned in the slices their
+// sphere overlaps, then each slice (a job) tests its lights against the
+// view space boxes of its clusters, four tiles at a time with SSE. The
+// result is a compact list of light indices and one range per cluster,
+// sorted by light within a cluster : the fragment shader only loops over
+// the lights of its cluster.
+class LightClusters {
+
+public:
+	LightClusters ( );
+	~LightClusters ( );
+
+	// Symmetric perspective : the cluster boxes only depend on it
+	void setProjection ( const glm::mat4 &projection, float nearPlane, float farPlane );
+
+	void assign ( Span<const ClusterLight> lights, const glm::mat4 &view, JobSystem *jobs = NULL );
+
+	// LIGHT_CLUSTERS_COUNT ranges, x first, then y, then the slice
+	const std::vector<ClusterRange> &ranges ( ) const { return _ranges; }
+	const std::vector<uint32_t> &indices ( ) const { return _indices; }
+
+	// Slice of a view depth : log ( depth ) * sliceScale + sliceBias
+	float sliceScale ( ) const { return _sliceScale; }
+	float sliceBias ( ) const { return _sliceBias; }
+
+	const LightClusterStats &stats ( ) const { return _stats; }
+
+	// False : the scalar tests, reference of the SSE ones
+	static bool simd;
+
+	// count lights spread in the box, the same ones for a seed
+	static void scatter ( uint32_t count, const glm::vec3 &min, const glm::vec3 &max, float minRadius, float maxRadius,
+						  float intensity, uint32_t seed, std::vector<ClusterLight> &lights );
+
+private:
+	// A visible light in view space and the clusters its bounds cover
+	struct LightBounds {
+		float x, y, depth, radius;
+		uint32_t light;
+		uint32_t x0, x1, y0, y1, z0, z1;
+	};
+
+	void assignSlice ( uint32_t slice );
+
+	float _sliceScale;
+	float _sliceBias;
+	float _projectionX;			// projection[0][0] and [1][1]
+	float _projectionY;
+	float _near;
+	float _far;
+
+	// View space boxes of the clusters, one array per bound
+	std::vector<float> _minX, _maxX, _minY, _maxY, _minZ, _maxZ;
+
+	std::vector<LightBounds> _bounds;
+	std::vector<uint32_t> _sliceOffsets;		// lights of each slice in _sliceLights
+	std::vector<uint32_t> _sliceLights;
+	std::vector<uint32_t> _sliceBases;			// part of each slice in _indices
+
+	// Per slice : ( tile, light ) pairs found, then its part of the index list
+	std::vector<std::vector<uint32_t> > _slicePairs;
+	std::vector<std::vector<uint32_t> > _sliceIndices;
+	std::vector<uint32_t> _sliceTests;
+
+	std::vector<ClusterRange> _ranges;
+	std::vector<uint32_t> _indices;
+
+	LightClusterStats _stats;
+};
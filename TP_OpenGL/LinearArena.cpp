@@ -0,0 +1,243 @@
+#include "LinearArena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined ( __APPLE__ )
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+/****************************************************************
+******* Allocation counting ***************************************
+***************************************************************/
+
+// Zero-initialised before any constructor runs : operator new may be
+// called by the static initialisation of other files
+static std::atomic<uint64_t> s_allocations;
+static std::atomic<uint64_t> s_frees;
+static std::atomic<uint64_t> s_bytes;
+static std::atomic<uint64_t> s_peak;
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec ( thread )
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+static THREAD_LOCAL uint64_t t_allocations;
+
+// Les blocs sont ceux de malloc, sans en-tete : leur taille est demandee a
+// l'allocateur. Un autre operator delete (sized, aligne, d'un sanitizer)
+// peut donc les liberer
+#if defined ( _MSC_VER )
+#define usableSize( pointer ) _msize ( pointer )
+#elif defined ( __APPLE__ )
+#define usableSize( pointer ) malloc_size ( pointer )
+#else
+#define usableSize( pointer ) malloc_usable_size ( pointer )
+#endif
+
+static void *countedAllocate ( size_t size ) {
+	void *pointer = malloc ( std::max<size_t> ( size, 1 ) );
+
+	if ( pointer == NULL ) {
+		return NULL;
+	}
+
+	s_allocations++;
+	t_allocations++;
+	uint64_t bytes = s_bytes += usableSize ( pointer );
+
+	uint64_t peak = s_peak;
+	while ( bytes > peak && !s_peak.compare_exchange_weak ( peak, bytes ) ) {
+	}
+
+	return pointer;
+}
+
+static void countedFree ( void *pointer ) {
+	if ( pointer == NULL ) {
+		return;
+	}
+
+	s_frees++;
+	s_bytes -= usableSize ( pointer );
+
+	free ( pointer );
+}
+
+void *operator new ( size_t size ) {
+	void *pointer = countedAllocate ( size );
+
+	if ( pointer == NULL ) {
+		throw std::bad_alloc ( );
+	}
+
+	return pointer;
+}
+
+void *operator new[] ( size_t size ) {
+	return operator new ( size );
+}
+
+void *operator new ( size_t size, const std::nothrow_t & ) throw ( ) {
+	return countedAllocate ( size );
+}
+
+void *operator new[] ( size_t size, const std::nothrow_t & ) throw ( ) {
+	return countedAllocate ( size );
+}
+
+void operator delete ( void *pointer ) throw ( ) {
+	countedFree ( pointer );
+}
+
+void operator delete[] ( void *pointer ) throw ( ) {
+	countedFree ( pointer );
+}
+
+void operator delete ( void *pointer, const std::nothrow_t & ) throw ( ) {
+	countedFree ( pointer );
+}
+
+void operator delete[] ( void *pointer, const std::nothrow_t & ) throw ( ) {
+	countedFree ( pointer );
+}
+
+// Les formes sized de C++14, appelees par les bibliotheques compilees avec.
+// Les formes alignees de C++17 restent celles du runtime : elles n'allouent
+// pas avec les operator new ci-dessus
+#if !defined ( _MSC_VER ) || _MSC_VER >= 1900
+void operator delete ( void *pointer, size_t ) throw ( ) {
+	countedFree ( pointer );
+}
+
+void operator delete[] ( void *pointer, size_t ) throw ( ) {
+	countedFree ( pointer );
+}
+#endif
+
+MemoryStats memoryStats ( ) {
+	MemoryStats stats;
+	stats.allocations = s_allocations;
+	stats.frees = s_frees;
+	stats.bytes = s_bytes;
+	stats.peak = s_peak;
+
+	return stats;
+}
+
+void resetMemoryPeak ( ) {
+	s_peak = s_bytes.load ( );
+}
+
+uint64_t threadAllocations ( ) {
+	return t_allocations;
+}
+
+/****************************************************************
+******* LinearArena ***********************************************
+***************************************************************/
+
+LinearArena::LinearArena ( ) :
+	_used ( 0 ),
+	_peak ( 0 ),
+	_allocations ( 0 ) {
+}
+
+
+LinearArena::~LinearArena ( ) {
+	release ( );
+}
+
+
+void LinearArena::init ( size_t capacity ) {
+	release ( );
+
+	Block block = { new char[capacity], capacity, 0 };
+	_blocks.push_back ( block );
+}
+
+
+void *LinearArena::allocate ( size_t size, size_t alignment ) {
+	if ( _blocks.empty ( ) ) {
+		init ( std::max ( size + alignment, ( size_t ) 64 * 1024 ) );
+	}
+
+	Block *block = &_blocks.back ( );
+
+	size_t offset = ( block->top + alignment - 1 ) & ~( alignment - 1 );
+
+	// Bloc plein : un nouveau, au moins deux fois plus grand
+	if ( offset + size > block->size ) {
+		size_t capacity = std::max ( block->size * 2, size + alignment );
+		Block next = { new char[capacity], capacity, 0 };
+		_blocks.push_back ( next );
+
+		block = &_blocks.back ( );
+		offset = 0;
+	}
+
+	_used += offset + size - block->top;
+	_peak = std::max ( _peak, _used );
+	_allocations++;
+
+	block->top = offset + size;
+
+	return block->data + offset;
+}
+
+
+void LinearArena::free ( void *pointer, size_t size ) {
+	if ( _blocks.empty ( ) ) {
+		return;
+	}
+
+	Block &block = _blocks.back ( );
+
+	if ( ( char* ) pointer + size == block.data + block.top ) {
+		block.top -= size;
+		_used -= size;
+	}
+}
+
+
+void LinearArena::reset ( ) {
+	if ( _blocks.size ( ) > 1 ) {
+		size_t total = capacity ( );
+		release ( );
+		init ( total );
+	}
+
+	if ( !_blocks.empty ( ) ) {
+		_blocks[0].top = 0;
+	}
+
+	_used = 0;
+	_allocations = 0;
+}
+
+
+void LinearArena::release ( ) {
+	for ( uint32_t i = 0; i < _blocks.size ( ); ++i ) {
+		delete[] _blocks[i].data;
+	}
+
+	_blocks.clear ( );
+	_used = 0;
+}
+
+
+size_t LinearArena::capacity ( ) const {
+	size_t total = 0;
+
+	for ( uint32_t i = 0; i < _blocks.size ( ); ++i ) {
+		total += _blocks[i].size;
+	}
+
+	return total;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+
+/////////////////////////////
+// MemoryStats
+// Every operator new / delete of the program is counted, with the live and
+// peak byte counts as sized by malloc. resetMemoryPeak() starts a new measure
+// from the live size.
+struct MemoryStats {
+	uint64_t allocations;
+	uint64_t frees;
+	uint64_t bytes;
+	uint64_t peak;
+};
+
+MemoryStats memoryStats ( );
+void resetMemoryPeak ( );
+
+// Allocations made by the calling thread only : the driver threads allocate too
+uint64_t threadAllocations ( );
+
+/////////////////////////////
+// LinearArena
+// Bump allocator : allocations are never freed one by one, reset() drops
+// them all at once. When a reset follows an overflow into several blocks,
+// they are replaced by one block of the total size, so that a steady
+// workload ends up with a single allocation.
+class LinearArena {
+
+public:
+	LinearArena ( );
+	~LinearArena ( );
+
+	void init ( size_t capacity );
+
+	void *allocate ( size_t size, size_t alignment = 16 );
+
+	// Only the last allocation can be given back, which lets a vector grow in place
+	void free ( void *pointer, size_t size );
+
+	void reset ( );
+	void release ( );
+
+	size_t used ( ) const { return _used; }
+	size_t peak ( ) const { return _peak; }
+	size_t capacity ( ) const;
+	uint32_t blocks ( ) const { return _blocks.size ( ); }
+	uint32_t allocations ( ) const { return _allocations; }
+
+private:
+	struct Block {
+		char *data;
+		size_t size;
+		size_t top;
+	};
+
+	LinearArena ( const LinearArena & );
+	LinearArena &operator=( const LinearArena & );
+
+	std::vector<Block> _blocks;
+
+	size_t _used;
+	size_t _peak;
+	uint32_t _allocations;
+};
+
+/////////////////////////////
+// ArenaAllocator : STL allocator drawing from a LinearArena
+template <typename T>
+class ArenaAllocator {
+
+public:
+	typedef T value_type;
+	typedef T *pointer;
+	typedef const T *const_pointer;
+	typedef T &reference;
+	typedef const T &const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template <typename U>
+	struct rebind {
+		typedef ArenaAllocator<U> other;
+	};
+
+	ArenaAllocator ( LinearArena *arena ) : _arena ( arena ) { }
+
+	template <typename U>
+	ArenaAllocator ( const ArenaAllocator<U> &other ) : _arena ( other.arena ( ) ) { }
+
+	T *allocate ( size_t count ) {
+		return ( T* ) _arena->allocate ( count * sizeof ( T ), std::alignment_of<T>::value < 16 ? 16 : std::alignment_of<T>::value );
+	}
+
+	void deallocate ( T *pointer, size_t count ) {
+		_arena->free ( pointer, count * sizeof ( T ) );
+	}
+
+	LinearArena *arena ( ) const { return _arena; }
+
+	template <typename U>
+	bool operator==( const ArenaAllocator<U> &other ) const { return _arena == other.arena ( ); }
+
+	template <typename U>
+	bool operator!=( const ArenaAllocator<U> &other ) const { return _arena != other.arena ( ); }
+
+private:
+	LinearArena *_arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
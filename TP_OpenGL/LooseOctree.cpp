@@ -0,0 +1,246 @@
+#include "LooseOctree.h"
+
+#include <algorithm>
+#include <chrono>
+
+LooseOctree::LooseOctree ( ) :
+	_count ( 0 ),
+	_maxDepth ( 0 ) {
+	_stats = OctreeStats ( );
+}
+
+
+LooseOctree::~LooseOctree ( ) {
+}
+
+
+void LooseOctree::init ( const glm::vec3 &center, float halfSize, uint32_t maxDepth ) {
+	_nodes.clear ( );
+	_objects.clear ( );
+	_count = 0;
+	_maxDepth = maxDepth;
+
+	Node root;
+	root.center = center;
+	root.halfSize = halfSize;
+	std::fill ( root.children, root.children + 8, -1 );
+
+	_nodes.push_back ( root );
+}
+
+
+void LooseOctree::clear ( ) {
+	for ( uint32_t i = 0; i < _nodes.size ( ); ++i ) {
+		_nodes[i].objects.clear ( );
+	}
+
+	_objects.clear ( );
+	_count = 0;
+}
+
+
+int32_t LooseOctree::findNode ( const glm::vec3 &min, const glm::vec3 &max ) {
+	glm::vec3 center = ( min + max ) * 0.5f;
+	glm::vec3 extent = ( max - min ) * 0.5f;
+	float radius = std::max ( extent.x, std::max ( extent.y, extent.z ) );
+
+	// Centre hors de la racine : l'objet reste dans la racine
+	glm::vec3 d = glm::abs ( center - _nodes[0].center );
+	if ( std::max ( d.x, std::max ( d.y, d.z ) ) > _nodes[0].halfSize ) {
+		return 0;
+	}
+
+	int32_t node = 0;
+
+	for ( uint32_t depth = 0; depth < _maxDepth; ++depth ) {
+		float half = _nodes[node].halfSize * 0.5f;
+
+		if ( radius > half ) {
+			break;
+		}
+
+		uint32_t child =
+			( center.x >= _nodes[node].center.x ? 1 : 0 ) |
+			( center.y >= _nodes[node].center.y ? 2 : 0 ) |
+			( center.z >= _nodes[node].center.z ? 4 : 0 );
+
+		if ( _nodes[node].children[child] < 0 ) {
+			Node cell;
+			cell.center = _nodes[node].center + glm::vec3 (
+				( child & 1 ) ? half : -half,
+				( child & 2 ) ? half : -half,
+				( child & 4 ) ? half : -half );
+			cell.halfSize = half;
+			std::fill ( cell.children, cell.children + 8, -1 );
+
+			// push_back peut deplacer les noeuds : on passe par les indices
+			_nodes.push_back ( cell );
+			_nodes[node].children[child] = _nodes.size ( ) - 1;
+		}
+
+		node = _nodes[node].children[child];
+	}
+
+	return node;
+}
+
+
+void LooseOctree::insert ( uint32_t id, const glm::vec3 &min, const glm::vec3 &max ) {
+	if ( id >= _objects.size ( ) ) {
+		Object empty = { glm::vec3 ( 0.0f ), glm::vec3 ( 0.0f ), -1, 0 };
+		_objects.resize ( id + 1, empty );
+	}
+
+	if ( _objects[id].node >= 0 ) {
+		update ( id, min, max );
+		return;
+	}
+
+	int32_t node = findNode ( min, max );
+
+	Object &object = _objects[id];
+	object.min = min;
+	object.max = max;
+	object.node = node;
+	object.slot = _nodes[node].objects.size ( );
+
+	_nodes[node].objects.push_back ( id );
+	_count++;
+}
+
+
+void LooseOctree::update ( uint32_t id, const glm::vec3 &min, const glm::vec3 &max ) {
+	if ( !contains ( id ) ) {
+		insert ( id, min, max );
+		return;
+	}
+
+	// Le plus souvent l'objet reste dans sa cellule
+	if ( findNode ( min, max ) == _objects[id].node ) {
+		_objects[id].min = min;
+		_objects[id].max = max;
+		return;
+	}
+
+	remove ( id );
+	insert ( id, min, max );
+}
+
+
+void LooseOctree::remove ( uint32_t id ) {
+	if ( !contains ( id ) ) {
+		return;
+	}
+
+	Object &object = _objects[id];
+	std::vector<uint32_t> &list = _nodes[object.node].objects;
+
+	// Le dernier de la liste prend sa place
+	uint32_t last = list.back ( );
+	list[object.slot] = last;
+	_objects[last].slot = object.slot;
+	list.pop_back ( );
+
+	object.node = -1;
+	_count--;
+}
+
+
+int LooseOctree::classify ( const glm::vec3 &min, const glm::vec3 &max ) const {
+	int result = 2;
+
+	for ( uint32_t p = 0; p < 6; ++p ) {
+		const glm::vec4 &plane = _planes[p];
+
+		// Coins le plus loin et le plus pres dans la direction de la normale
+		glm::vec3 positive (
+			plane.x >= 0.0f ? max.x : min.x,
+			plane.y >= 0.0f ? max.y : min.y,
+			plane.z >= 0.0f ? max.z : min.z );
+		glm::vec3 negative (
+			plane.x >= 0.0f ? min.x : max.x,
+			plane.y >= 0.0f ? min.y : max.y,
+			plane.z >= 0.0f ? min.z : max.z );
+
+		if ( glm::dot ( glm::vec3 ( plane ), positive ) + plane.w < 0.0f ) {
+			return 0;
+		}
+
+		if ( glm::dot ( glm::vec3 ( plane ), negative ) + plane.w < 0.0f ) {
+			result = 1;
+		}
+	}
+
+	return result;
+}
+
+
+void LooseOctree::visit ( int32_t index, bool inside, ArenaVector<uint32_t> &visible ) {
+	const Node &node = _nodes[index];
+
+	_stats.nodesVisited++;
+
+	for ( uint32_t i = 0; i < node.objects.size ( ); ++i ) {
+		uint32_t id = node.objects[i];
+
+		if ( inside ) {
+			_stats.objectsAccepted++;
+			visible.push_back ( id );
+			continue;
+		}
+
+		_stats.objectsTested++;
+
+		if ( classify ( _objects[id].min, _objects[id].max ) != 0 ) {
+			visible.push_back ( id );
+		}
+	}
+
+	for ( uint32_t c = 0; c < 8; ++c ) {
+		int32_t child = node.children[c];
+
+		if ( child < 0 ) {
+			continue;
+		}
+
+		if ( inside ) {
+			visit ( child, true, visible );
+			continue;
+		}
+
+		// Cellule lache : deux fois sa taille
+		const Node &cell = _nodes[child];
+		glm::vec3 loose ( cell.halfSize * 2.0f );
+
+		int test = classify ( cell.center - loose, cell.center + loose );
+
+		if ( test != 0 ) {
+			visit ( child, test == 2, visible );
+		}
+	}
+}
+
+
+void LooseOctree::query ( const glm::mat4 &viewProjection, ArenaVector<uint32_t> &visible ) {
+	auto start = std::chrono::high_resolution_clock::now ( );
+
+	_stats = OctreeStats ( );
+
+	// Plans du frustum (Gribb & Hartmann) : lignes de la matrice
+	const glm::mat4 &m = viewProjection;
+	glm::vec4 rows[4];
+	for ( uint32_t r = 0; r < 4; ++r ) {
+		rows[r] = glm::vec4 ( m[0][r], m[1][r], m[2][r], m[3][r] );
+	}
+
+	for ( uint32_t i = 0; i < 3; ++i ) {
+		_planes[i * 2 + 0] = rows[3] + rows[i];
+		_planes[i * 2 + 1] = rows[3] - rows[i];
+	}
+
+	if ( !_nodes.empty ( ) ) {
+		visit ( 0, false, visible );
+	}
+
+	_stats.ms = std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - start ).count ( );
+}
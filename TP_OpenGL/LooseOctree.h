@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+#include "LinearArena.h"
+
+/////////////////////////////
+// OctreeStats : counters of the last query
+struct OctreeStats {
+	uint32_t nodesVisited;
+	uint32_t objectsTested;		// boxes tested against the frustum one by one
+	uint32_t objectsAccepted;	// taken with a node entirely inside, untested
+	double ms;
+};
+
+/////////////////////////////
+// LooseOctree
+// Each object lives in the deepest cell at least as large as itself, the
+// one holding its center. Cells are tested with twice their size, so an
+// object never straddles two cells and moving it rarely changes its cell.
+// Objects outside the root are kept in the root, which is never culled.
+class LooseOctree {
+
+public:
+	LooseOctree ( );
+	~LooseOctree ( );
+
+	void init ( const glm::vec3 &center, float halfSize, uint32_t maxDepth );
+	void clear ( );
+
+	// Ids are chosen by the caller, they index a dense table
+	void insert ( uint32_t id, const glm::vec3 &min, const glm::vec3 &max );
+	void update ( uint32_t id, const glm::vec3 &min, const glm::vec3 &max );
+	void remove ( uint32_t id );
+
+	bool contains ( uint32_t id ) const { return id < _objects.size ( ) && _objects[id].node >= 0; }
+
+	// Appends the ids of the objects intersecting the frustum of viewProjection
+	void query ( const glm::mat4 &viewProjection, ArenaVector<uint32_t> &visible );
+
+	// A box against the frustum of the last query, without the tree : the
+	// brute force reference of query
+	bool intersects ( const glm::vec3 &min, const glm::vec3 &max ) const { return classify ( min, max ) != 0; }
+
+	uint32_t objects ( ) const { return _count; }
+	uint32_t nodes ( ) const { return _nodes.size ( ); }
+	const OctreeStats &stats ( ) const { return _stats; }
+
+private:
+	struct Node {
+		glm::vec3 center;
+		float halfSize;
+		int32_t children[8];
+		std::vector<uint32_t> objects;
+	};
+
+	struct Object {
+		glm::vec3 min;
+		glm::vec3 max;
+		int32_t node;			// -1 : not in the tree
+		uint32_t slot;			// position in the object list of its node
+	};
+
+	int32_t findNode ( const glm::vec3 &min, const glm::vec3 &max );
+
+	// 0 : outside, 1 : intersects, 2 : inside
+	int classify ( const glm::vec3 &min, const glm::vec3 &max ) const;
+
+	void visit ( int32_t node, bool inside, ArenaVector<uint32_t> &visible );
+
+	std::vector<Node> _nodes;
+	std::vector<Object> _objects;
+	uint32_t _count;
+	uint32_t _maxDepth;
+
+	glm::vec4 _planes[6];
+	OctreeStats _stats;
+};
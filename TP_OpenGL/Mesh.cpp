@@ -1,18 +1,109 @@
 #include "Mesh.h"
+#include "JobSystem.h"
+#include "LinearArena.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+// Sommets ou faces par tache
+#define MESH_GRAIN 4096
+
+
+Mesh::Mesh ( ) :
+	_center ( 0.0f ),
+	_indexVertexCount ( 0 ),
+	_vertexCount ( 0 ),
+	_facesCount ( 0 ),
+	_edgesCount ( 0 ) {
+}
 
 
-Mesh::Mesh ( ) {
+Mesh::Mesh ( Mesh &&other ) :
+	_name ( std::move ( other._name ) ),
+	_type ( std::move ( other._type ) ),
+	_vertices ( std::move ( other._vertices ) ),
+	_indexVertices ( std::move ( other._indexVertices ) ),
+	_uvs ( std::move ( other._uvs ) ),
+	_indexUvs ( std::move ( other._indexUvs ) ),
+	_normals ( std::move ( other._normals ) ),
+	_indexNormals ( std::move ( other._indexNormals ) ),
+	_edges ( std::move ( other._edges ) ),
+	_faceOffsets ( std::move ( other._faceOffsets ) ),
+	_vertexIndices ( std::move ( other._vertexIndices ) ),
+	_uvIndices ( std::move ( other._uvIndices ) ),
+	_normalIndices ( std::move ( other._normalIndices ) ),
+	_center ( other._center ),
+	_indexVertexCount ( other._indexVertexCount ),
+	_vertexCount ( other._vertexCount ),
+	_facesCount ( other._facesCount ),
+	_edgesCount ( other._edgesCount ) {
 }
 
 
 Mesh::~Mesh ( ) {
 }
 
+
+Mesh &Mesh::operator=( Mesh &&other ) {
+	if ( this != &other ) {
+		_name = std::move ( other._name );
+		_type = std::move ( other._type );
+		_vertices = std::move ( other._vertices );
+		_indexVertices = std::move ( other._indexVertices );
+		_uvs = std::move ( other._uvs );
+		_indexUvs = std::move ( other._indexUvs );
+		_normals = std::move ( other._normals );
+		_indexNormals = std::move ( other._indexNormals );
+		_edges = std::move ( other._edges );
+		_faceOffsets = std::move ( other._faceOffsets );
+		_vertexIndices = std::move ( other._vertexIndices );
+		_uvIndices = std::move ( other._uvIndices );
+		_normalIndices = std::move ( other._normalIndices );
+		_center = other._center;
+		_indexVertexCount = other._indexVertexCount;
+		_vertexCount = other._vertexCount;
+		_facesCount = other._facesCount;
+		_edgesCount = other._edgesCount;
+	}
+
+	return *this;
+}
+
+
+// Copie explicite : toutes les donnees sont dupliquees
+Mesh Mesh::clone ( ) const {
+	Mesh mesh;
+	mesh._name = _name;
+	mesh._type = _type;
+	mesh._vertices = _vertices;
+	mesh._indexVertices = _indexVertices;
+	mesh._uvs = _uvs;
+	mesh._indexUvs = _indexUvs;
+	mesh._normals = _normals;
+	mesh._indexNormals = _indexNormals;
+	mesh._edges = _edges;
+	mesh._faceOffsets = _faceOffsets;
+	mesh._vertexIndices = _vertexIndices;
+	mesh._uvIndices = _uvIndices;
+	mesh._normalIndices = _normalIndices;
+	mesh._center = _center;
+	mesh._indexVertexCount = _indexVertexCount;
+	mesh._vertexCount = _vertexCount;
+	mesh._facesCount = _facesCount;
+	mesh._edgesCount = _edgesCount;
+
+	return mesh;
+}
+
 // Charge un fichier OBJ
-Mesh Mesh::loadOBJ ( const std::string &fileName, bool indexData ) {
+Mesh Mesh::loadOBJ ( const std::string &fileName, bool indexData, JobSystem *jobs ) {
 	Mesh mesh = Mesh ( );
 
-	FILE * file = fopen ( fileName.c_str ( ), "r" );
+	FILE * file = fopen ( fileName.c_str ( ), "rb" );
 
 	if ( file == NULL ) {
 		printf ( "Impossible to open the file !\n" );
@@ -23,28 +114,72 @@ Mesh Mesh::loadOBJ ( const std::string &fileName, bool indexData ) {
 
 	mesh._type = "OBJ";
 
-	mesh._vertices	= std::vector<Vector3> ( );
-	mesh._uvs		= std::vector<Vector2> ( );
-	mesh._normals	= std::vector<Vector3> ( );
-	mesh._faces		= std::vector<Face> ( );
+	// Le texte du fichier est le seul temporaire du chargement : une seule
+	// allocation dans l'arene, liberee d'un coup a la sortie
+	fseek ( file, 0, SEEK_END );
+	size_t fileSize = ftell ( file );
+	fseek ( file, 0, SEEK_SET );
+
+	LinearArena arena;
+	arena.init ( fileSize + 1 );
+
+	char *text = ( char* ) arena.allocate ( fileSize + 1, 1 );
+	size_t length = fread ( text, 1, fileSize, file );
+	text[length] = '\0';
+
+	fclose ( file );
+
+	// Premier passage : chaque ligne devient une chaine, et on compte les
+	// elements de chaque type pour reserver les tableaux exactement
+	uint32_t vertexCount = 0, uvCount = 0, normalCount = 0, faceCount = 0;
+
+	for ( char *line = text; line < text + length; ) {
+		char *end = ( char* ) memchr ( line, '\n', text + length - line );
+		if ( end == NULL ) {
+			end = text + length;
+		}
+		*end = '\0';
+
+		if ( line[0] == 'v' && line[1] == ' ' ) vertexCount++;
+		else if ( line[0] == 'v' && line[1] == 't' ) uvCount++;
+		else if ( line[0] == 'v' && line[1] == 'n' ) normalCount++;
+		else if ( line[0] == 'f' && line[1] == ' ' ) faceCount++;
+
+		line = end + 1;
+	}
+
+	mesh._vertices.reserve ( vertexCount );
+	mesh._uvs.reserve ( uvCount );
+	mesh._normals.reserve ( normalCount );
+	// Les normales par face sont ajoutees aux fichiers qui n'en ont pas
+	mesh._faceOffsets.reserve ( ( size_t ) faceCount + 1 );
+	mesh._faceOffsets.push_back ( 0 );
+	mesh._vertexIndices.reserve ( 3 * ( size_t ) faceCount );
+	mesh._normalIndices.reserve ( 3 * ( size_t ) faceCount );
+
+	if ( uvCount > 0 ) {
+		mesh._uvIndices.reserve ( 3 * ( size_t ) faceCount );
+	}
 
 	Vector3 center;
 
 	bool addUVs		= false;
 	bool addNormal	= false;
 
-	while ( 1 ) {
+	for ( char *line = text; line < text + length; line += strlen ( line ) + 1 ) {
 		char lineHeader[128];
+		int read = 0;
 
 		// read the first word of the line
-		int res = fscanf ( file, "%s", lineHeader );
-		if ( res == EOF )
-			break; // EOF = End Of File. Quit the loop.
+		if ( sscanf ( line, "%127s%n", lineHeader, &read ) != 1 )
+			continue; // Empty line
+
+		const char *data = line + read;
 
 		if ( strcmp ( lineHeader, "v" ) == 0 ) {
 			Vector3 vertex;
 			
-			fscanf ( file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z );
+			sscanf ( data, "%f %f %f", &vertex.x, &vertex.y, &vertex.z );
 			
 			mesh._vertices.push_back ( vertex );
 
@@ -53,7 +188,7 @@ Mesh Mesh::loadOBJ ( const std::string &fileName, bool indexData ) {
 		else if ( strcmp ( lineHeader, "vt" ) == 0 ) {
 			glm::vec2 uv;
 			
-			fscanf ( file, "%f %f\n", &uv.x, &uv.y );
+			sscanf ( data, "%f %f", &uv.x, &uv.y );
 			
 			mesh._uvs.push_back ( uv );
 
@@ -62,7 +197,7 @@ Mesh Mesh::loadOBJ ( const std::string &fileName, bool indexData ) {
 		else if ( strcmp ( lineHeader, "vn" ) == 0 ) {
 			glm::vec3 normal;
 			
-			fscanf ( file, "%f %f %f\n", &normal.x, &normal.y, &normal.z );
+			sscanf ( data, "%f %f %f", &normal.x, &normal.y, &normal.z );
 			
 			mesh._normals.push_back ( normal );
 
@@ -71,126 +206,105 @@ Mesh Mesh::loadOBJ ( const std::string &fileName, bool indexData ) {
 		else if ( strcmp ( lineHeader, "f" ) == 0 && addNormal && addUVs ) {
 			unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
 
-			fscanf ( file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2] );
-
-			Face face;
-			face._verticesCount = 3;
-			face._vertexIndices.push_back ( vertexIndex[0] - 1);
-			face._vertexIndices.push_back ( vertexIndex[1] - 1 );
-			face._vertexIndices.push_back ( vertexIndex[2] - 1 );
-			face._uvIndices.push_back ( uvIndex[0] - 1 );
-			face._uvIndices.push_back ( uvIndex[1] - 1 );
-			face._uvIndices.push_back ( uvIndex[2] - 1 );
-			face._normalIndices.push_back ( normalIndex[0] - 1 );
-			face._normalIndices.push_back ( normalIndex[1] - 1 );
-			face._normalIndices.push_back ( normalIndex[2] - 1 );
-
-			mesh._faces.push_back ( face );
+			sscanf ( data, "%d/%d/%d %d/%d/%d %d/%d/%d", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2] );
+
+			for ( uint32_t i = 0; i < 3; ++i ) {
+				mesh._vertexIndices.push_back ( vertexIndex[i] - 1 );
+				mesh._uvIndices.push_back ( uvIndex[i] - 1 );
+				mesh._normalIndices.push_back ( normalIndex[i] - 1 );
+			}
+			mesh._faceOffsets.push_back ( mesh._vertexIndices.size ( ) );
 		}
 		else if ( strcmp ( lineHeader, "f" ) == 0 && addUVs ) {
 			unsigned int vertexIndex[3], uvIndex[3];
 
-			fscanf ( file, "%d/%d %d/%d %d/%d\n", &vertexIndex[0], &uvIndex[0], &vertexIndex[1], &uvIndex[1], &vertexIndex[2], &uvIndex[2] );
-
-			Face face;
-			face._verticesCount = 3;
-			face._vertexIndices.push_back ( vertexIndex[0] - 1 );
-			face._vertexIndices.push_back ( vertexIndex[1] - 1 );
-			face._vertexIndices.push_back ( vertexIndex[2] - 1 );
-			face._uvIndices.push_back ( uvIndex[0] - 1 );
-			face._uvIndices.push_back ( uvIndex[1] - 1 );
-			face._uvIndices.push_back ( uvIndex[2] - 1 );
+			sscanf ( data, "%d/%d %d/%d %d/%d", &vertexIndex[0], &uvIndex[0], &vertexIndex[1], &uvIndex[1], &vertexIndex[2], &uvIndex[2] );
 
-			mesh._faces.push_back ( face );
+			for ( uint32_t i = 0; i < 3; ++i ) {
+				mesh._vertexIndices.push_back ( vertexIndex[i] - 1 );
+				mesh._uvIndices.push_back ( uvIndex[i] - 1 );
+			}
+			mesh._faceOffsets.push_back ( mesh._vertexIndices.size ( ) );
 		}
 		else if ( strcmp ( lineHeader, "f" ) == 0 && addNormal ) {
 			unsigned int vertexIndex[3], normalIndex[3];
 
-			fscanf ( file, "%d//%d %d//%d %d//%d\n", &vertexIndex[0], &normalIndex[0], &vertexIndex[1], &normalIndex[1], &vertexIndex[2], &normalIndex[2] );
+			sscanf ( data, "%d//%d %d//%d %d//%d", &vertexIndex[0], &normalIndex[0], &vertexIndex[1], &normalIndex[1], &vertexIndex[2], &normalIndex[2] );
 
-			Face face;
-			face._verticesCount = 3;
-			face._vertexIndices.push_back ( vertexIndex[0] - 1 );
-			face._vertexIndices.push_back ( vertexIndex[1] - 1 );
-			face._vertexIndices.push_back ( vertexIndex[2] - 1 );
-			face._normalIndices.push_back ( normalIndex[0] - 1 );
-			face._normalIndices.push_back ( normalIndex[1] - 1 );
-			face._normalIndices.push_back ( normalIndex[2] - 1 );
-
-			mesh._faces.push_back ( face );
+			for ( uint32_t i = 0; i < 3; ++i ) {
+				mesh._vertexIndices.push_back ( vertexIndex[i] - 1 );
+				mesh._normalIndices.push_back ( normalIndex[i] - 1 );
+			}
+			mesh._faceOffsets.push_back ( mesh._vertexIndices.size ( ) );
 		}
 	}
 
 	mesh._vertexCount = mesh._vertices.size ( );
-	mesh._facesCount = mesh._faces.size ( );
+	mesh._facesCount = mesh._faceOffsets.size ( ) - 1;
 
 	// Calcule du centre de gravit
 	center /= mesh._vertexCount;
 	mesh._center = center;
 
-	double max = calculateMax ( mesh );
+	double max = calculateMax ( mesh, jobs );
 
-	centerNormalizeMesh ( mesh, max );
+	centerNormalizeMesh ( mesh, max, jobs );
 
 	if ( !addNormal ) {
 		// Calcule des normales par face
 		std::cout << "Calculate normals...\n";
 		mesh._normals = std::vector<Vector3> ( mesh._facesCount );
+		mesh._normalIndices.resize ( mesh._vertexIndices.size ( ) );
+
 		for ( uint32_t k = 0; k < mesh._facesCount; ++k ) {
-			Face face = mesh._faces[k];
+			const uint32_t *v = mesh.faceVertices ( k );
 
-			face._normalIndices.push_back ( k );
-			face._normalIndices.push_back ( k );
-			face._normalIndices.push_back ( k );
+			for ( uint32_t c = mesh._faceOffsets[k]; c < mesh._faceOffsets[k + 1]; ++c ) {
+				mesh._normalIndices[c] = k;
+			}
 			
-			Vector3 normal = glm::normalize ( glm::cross ( mesh._vertices[face._vertexIndices[1]] - mesh._vertices[face._vertexIndices[0]], mesh._vertices[face._vertexIndices[2]] - mesh._vertices[face._vertexIndices[0]] ) );
+			Vector3 normal = glm::normalize ( glm::cross ( mesh._vertices[v[1]] - mesh._vertices[v[0]], mesh._vertices[v[2]] - mesh._vertices[v[0]] ) );
 			mesh._normals[k] = normal;
 		}
 	}	
 
 	if ( indexData ) {
-		mesh.indexData ( );
+		mesh.indexData ( jobs );
 	}
 
 	return mesh;
 }
 
 
-void Mesh::indexData ( ) {
-	// Calcule des vertices indexs
-	std::cout << "Calculate index vertices...\n";
-	_indexVertices = std::vector<Vector3> ( );
-	for ( uint32_t k = 0; k < _facesCount; ++k ) {
-		Face face = _faces[k];
+void Mesh::indexData ( JobSystem *jobs ) {
+	// Les coins des faces sont deja a plat : le coin c va en c
+	uint32_t corners = cornerCount ( );
 
-		for ( uint32_t i = 0; i < face._verticesCount; ++i ) {
-			int index = face._vertexIndices[i];
-			_indexVertices.push_back ( _vertices[index] );
-		}
-	}
-
-	_indexVertexCount = _indexVertices.size ( );
+	// Calcule des vertices et des normales indexs
+	std::cout << "Calculate index vertices...\n";
+	_indexVertices = std::vector<Vector3> ( corners );
+	_indexVertexCount = corners;
 
-	// Calcule des normales indexs
 	std::cout << "Calculate index normals...\n";
-	_indexNormals = std::vector<Vector3> ( );
-	for ( uint32_t k = 0; k < _facesCount; ++k ) {
-		Face face = _faces[k];
+	_indexNormals = std::vector<Vector3> ( corners );
 
-		for ( uint32_t i = 0; i < face._verticesCount; ++i ) {
-			int index = face._normalIndices[i];
-			_indexNormals.push_back ( _normals[index] );
+	parallelFor ( jobs, 0, _facesCount, MESH_GRAIN, [this] ( uint32_t first, uint32_t last ) {
+		for ( uint32_t c = _faceOffsets[first]; c < _faceOffsets[last]; ++c ) {
+			_indexVertices[c] = _vertices[_vertexIndices[c]];
+			_indexNormals[c] = _normals[_normalIndices[c]];
 		}
-	}
+	} );
 }
 
 
 // Rcupere un triangle  partir d'une face
-Triangle Mesh::getTriangle ( const Face &face ) {
+Triangle Mesh::getTriangle ( uint32_t face ) const {
+	const uint32_t *v = faceVertices ( face );
+
 	Triangle res = {
-		_vertices[face._vertexIndices[0]],
-		_vertices[face._vertexIndices[1]],
-		_vertices[face._vertexIndices[2]]
+		_vertices[v[0]],
+		_vertices[v[1]],
+		_vertices[v[2]]
 	};
 
 	return res;
@@ -207,29 +321,59 @@ void Mesh::saveOFF ( const std::string &fileName, const Mesh &mesh ) {
 		file << mesh._vertices[i];
 	}
 
-	for ( uint32_t i = 0; i < mesh._facesCount; ++i ) {
-		file << mesh._faces[i];
+	for ( uint32_t k = 0; k < mesh._facesCount; ++k ) {
+		file << mesh.faceSize ( k ) << " ";
+		for ( uint32_t i = 0; i < mesh.faceSize ( k ); ++i ) {
+			file << mesh.faceVertices ( k )[i] << " ";
+		}
+		file << std::endl;
 	}
 
 	file.close ( );
 }
 
 // Charge un fichier .OFF
-Mesh Mesh::loadOFF ( const std::string &fileName, bool calculateNormalVertex ) {
+Mesh Mesh::loadOFF ( const std::string &fileName, bool calculateNormalVertex, JobSystem *jobs ) {
 	std::cout << "Loading file...\n";
 
-	// Ouverture du fichier dans un stream
-	std::ifstream file ( fileName );
-
 	Mesh mesh;
 
 	mesh._name = fileName;
 
+	FILE * file = fopen ( fileName.c_str ( ), "rb" );
+
+	if ( file == NULL ) {
+		printf ( "Impossible to open %s\n", fileName.c_str ( ) );
+		return mesh;
+	}
+
+	// Comme loadOBJ : le texte est lu d'un bloc dans l'arene, qui sert
+	// ensuite a l'adjacence des normales. Les tableaux du mesh sont alloues
+	// une fois chacun
+	fseek ( file, 0, SEEK_END );
+	size_t fileSize = ftell ( file );
+	fseek ( file, 0, SEEK_SET );
+
+	LinearArena arena;
+	arena.init ( fileSize + 1 );
+
+	char *text = ( char* ) arena.allocate ( fileSize + 1, 1 );
+	size_t length = fread ( text, 1, fileSize, file );
+	text[length] = '\0';
+
+	fclose ( file );
+
 	// Type
-	file >> mesh._type;
+	char *p = text;
+	while ( isspace ( ( unsigned char ) *p ) ) p++;
+	char *type = p;
+	while ( *p != '\0' && !isspace ( ( unsigned char ) *p ) ) p++;
+	mesh._type.assign ( type, p );
 
 	// Infos
-	file >> mesh._vertexCount >> mesh._facesCount >> mesh._edgesCount;
+	mesh._vertexCount = strtoul ( p, &p, 10 );
+	mesh._facesCount = strtoul ( p, &p, 10 );
+	mesh._edgesCount = strtoul ( p, &p, 10 );
 
 	Vector3 center;
 
@@ -237,7 +381,9 @@ Mesh Mesh::loadOFF ( const std::string &fileName, bool calculateNormalVertex ) {
 	mesh._vertices = std::vector<Vector3> ( mesh._vertexCount );
 	for ( uint32_t i = 0; i < mesh._vertexCount; ++i ) {
 		Vector3 v;
-		file >> v.x >> v.y >> v.z;
+		v.x = strtof ( p, &p );
+		v.y = strtof ( p, &p );
+		v.z = strtof ( p, &p );
 		center += v;
 		mesh._vertices[i] = v;
 	}
@@ -247,52 +393,29 @@ Mesh Mesh::loadOFF ( const std::string &fileName, bool calculateNormalVertex ) {
 	mesh._center = center;
 
 	// Read faces
-	mesh._faces = std::vector<Face> ( mesh._facesCount );
+	mesh._faceOffsets = std::vector<uint32_t> ( mesh._facesCount + 1, 0 );
+	mesh._vertexIndices.reserve ( 3 * ( size_t ) mesh._facesCount );
+
 	for ( uint32_t j = 0; j < mesh._facesCount; ++j ) {
-		Face f;
-		file >> f._verticesCount;
-		f._vertexIndices = std::vector<uint32_t> ( f._verticesCount );
+		uint32_t count = strtoul ( p, &p, 10 );
 
-		for ( uint32_t k = 0; k < f._verticesCount; ++k ) {
-			file >> f._vertexIndices[k];
+		for ( uint32_t k = 0; k < count; ++k ) {
+			mesh._vertexIndices.push_back ( strtoul ( p, &p, 10 ) );
 		}
 
-		mesh._faces[j] = f;
+		mesh._faceOffsets[j + 1] = mesh._vertexIndices.size ( );
 	}
 
-	double max = calculateMax ( mesh );
+	double max = calculateMax ( mesh, jobs );
 
-	centerNormalizeMesh ( mesh, max );
+	centerNormalizeMesh ( mesh, max, jobs );
 
-	// Calcule des normales par face
-	std::cout << "Calculate face normals...\n";
-	mesh._normals = std::vector<Vector3> ( mesh._facesCount );
-	for ( uint32_t k = 0; k < mesh._facesCount; ++k ) {
-		Face face = mesh._faces[k];
-		
-		Vector3 normal = glm::normalize ( glm::cross ( mesh._vertices[face._vertexIndices[1]] - mesh._vertices[face._vertexIndices[0]], mesh._vertices[face._vertexIndices[2]] - mesh._vertices[face._vertexIndices[0]] ) );
-		mesh._normals[k] = normal;
-	}
+	calculateFaceNormals ( mesh, jobs );
 
 	if ( calculateNormalVertex ) {
-		// Calcule des normales par vertex
-		std::cout << "Calculate vertex normals...\n";
-		mesh._indexNormals = std::vector<Vector3> ( mesh._vertexCount );
-		for ( uint32_t idx = 0; idx < mesh._vertexCount; ++idx ) {
-			Vector3 normal = { .0f, .0f, .0f };
-
-			for ( uint32_t m = 0; m < mesh._facesCount; ++m ) {
-				Face face = mesh._faces[m];
-
-				for ( uint32_t n = 0; n < face._verticesCount; ++n ) {
-					if ( face._vertexIndices[n] == idx ) {
-						normal += mesh._normals[m];
-					}
-				}
-			}
-
-			mesh._indexNormals[idx] = glm::normalize ( normal );
-		}
+		// Le texte n'est plus lu
+		arena.reset ( );
+		calculateVertexNormals ( mesh, jobs, &arena );
 	}
 	
 	//buildEdges ( mesh );
@@ -301,34 +424,264 @@ Mesh Mesh::loadOFF ( const std::string &fileName, bool calculateNormalVertex ) {
 }
 
 // Centre et normalise le mesh
-void Mesh::centerNormalizeMesh ( Mesh &mesh, const double &max ) {
+void Mesh::centerNormalizeMesh ( Mesh &mesh, const double &max, JobSystem *jobs ) {
 	std::cout << "Center & Normalize Mesh...\n";
-	float p = 1.0f / mesh._vertexCount;
 	double inv = 1 / max;
 
+	parallelFor ( jobs, 0, mesh._vertexCount, MESH_GRAIN, [&mesh, inv] ( uint32_t first, uint32_t last ) {
+		for ( uint32_t i = first; i < last; ++i ) {
+			mesh._vertices[i] -= mesh._center;
+			mesh._vertices[i] *= inv;
+		}
+	} );
+}
+
+// Normales par face, chaque face pointe sur la sienne
+void Mesh::calculateFaceNormals ( Mesh &mesh, JobSystem *jobs ) {
+	std::cout << "Calculate face normals...\n";
+	mesh._normals = std::vector<Vector3> ( mesh._facesCount );
+	mesh._normalIndices.resize ( mesh.cornerCount ( ) );
+
+	parallelFor ( jobs, 0, mesh._facesCount, MESH_GRAIN, [&mesh] ( uint32_t first, uint32_t last ) {
+		for ( uint32_t k = first; k < last; ++k ) {
+			const uint32_t *v = mesh.faceVertices ( k );
+
+			for ( uint32_t c = mesh._faceOffsets[k]; c < mesh._faceOffsets[k + 1]; ++c ) {
+				mesh._normalIndices[c] = k;
+			}
+
+			mesh._normals[k] = glm::normalize ( glm::cross ( mesh._vertices[v[1]] - mesh._vertices[v[0]], mesh._vertices[v[2]] - mesh._vertices[v[0]] ) );
+		}
+	} );
+}
+
+// Normales par vertex dans _indexNormals : moyenne des faces voisines.
+// L'adjacence vertex -> faces evite de parcourir toutes les faces par vertex
+void Mesh::calculateVertexNormals ( Mesh &mesh, JobSystem *jobs, LinearArena *scratch ) {
+	std::cout << "Calculate vertex normals...\n";
+
+	uint32_t corners = mesh.cornerCount ( );
+
+	// Une allocation pour les trois tableaux, alignes sur 16 octets
+	LinearArena local;
+	if ( scratch == NULL ) {
+		local.init ( ( 2 * ( size_t ) mesh._vertexCount + 1 + corners ) * sizeof ( uint32_t ) + 3 * 16 );
+		scratch = &local;
+	}
+
+	ArenaAllocator<uint32_t> allocator ( scratch );
+
+	ArenaVector<uint32_t> offsets ( mesh._vertexCount + 1, 0, allocator );
+	for ( uint32_t c = 0; c < corners; ++c ) {
+		offsets[mesh._vertexIndices[c] + 1]++;
+	}
+
 	for ( uint32_t i = 0; i < mesh._vertexCount; ++i ) {
-		mesh._vertices[i] -= mesh._center;
-		mesh._vertices[i] *= inv;
+		offsets[i + 1] += offsets[i];
+	}
+
+	ArenaVector<uint32_t> adjacency ( offsets[mesh._vertexCount], 0, allocator );
+	ArenaVector<uint32_t> cursor ( offsets.begin ( ), offsets.end ( ) - 1, allocator );
+
+	for ( uint32_t k = 0; k < mesh._facesCount; ++k ) {
+		for ( uint32_t c = mesh._faceOffsets[k]; c < mesh._faceOffsets[k + 1]; ++c ) {
+			adjacency[cursor[mesh._vertexIndices[c]]++] = k;
+		}
 	}
+
+	mesh._indexNormals = std::vector<Vector3> ( mesh._vertexCount );
+
+	parallelFor ( jobs, 0, mesh._vertexCount, MESH_GRAIN, [&mesh, &offsets, &adjacency] ( uint32_t first, uint32_t last ) {
+		for ( uint32_t idx = first; idx < last; ++idx ) {
+			Vector3 normal = { .0f, .0f, .0f };
+
+			for ( uint32_t a = offsets[idx]; a < offsets[idx + 1]; ++a ) {
+				normal += mesh._normals[adjacency[a]];
+			}
+
+			mesh._indexNormals[idx] = glm::normalize ( normal );
+		}
+	} );
 }
 
 // Calcule le max
-double Mesh::calculateMax ( Mesh &mesh ) {
+double Mesh::calculateMax ( Mesh &mesh, JobSystem *jobs ) {
 	std::cout << "Calculate max...\n";
-	float p = 1.0f / mesh._vertexCount;
-	double max = 0;
 
-	for ( uint32_t i = 0; i < mesh._vertexCount; ++i ) {
-		// Calcule coordonnes max absolue
-		Vector3 vertex = mesh._vertices[i];
-		double abs;
-		abs = fabs ( vertex.x - mesh._center.x );
-		max = max > abs ? max : abs;
-		abs = fabs ( vertex.y - mesh._center.y );
-		max = max > abs ? max : abs;
-		abs = fabs ( vertex.z - mesh._center.z );
-		max = max > abs ? max : abs;
+	// Un maximum par tache, reduits ensuite
+	std::vector<double> maxima ( ( mesh._vertexCount + MESH_GRAIN - 1 ) / MESH_GRAIN + 1, 0.0 );
+
+	parallelFor ( jobs, 0, mesh._vertexCount, MESH_GRAIN, [&mesh, &maxima] ( uint32_t first, uint32_t last ) {
+		double max = 0;
+
+		for ( uint32_t i = first; i < last; ++i ) {
+			// Calcule coordonnes max absolue
+			const Vector3 &vertex = mesh._vertices[i];
+			double abs;
+			abs = fabs ( vertex.x - mesh._center.x );
+			max = max > abs ? max : abs;
+			abs = fabs ( vertex.y - mesh._center.y );
+			max = max > abs ? max : abs;
+			abs = fabs ( vertex.z - mesh._center.z );
+			max = max > abs ? max : abs;
+		}
+
+		maxima[first / MESH_GRAIN] = max;
+	} );
+
+	return *std::max_element ( maxima.begin ( ), maxima.end ( ) );
+}
+
+// Calcule la boite englobante
+void Mesh::calculateBounds ( const Mesh &mesh, Vector3 &min, Vector3 &max ) {
+	calculateBounds ( Span<const Vector3> ( mesh._vertices.empty ( ) ? NULL : &mesh._vertices[0], mesh._vertexCount ), min, max );
+}
+
+
+void Mesh::calculateBounds ( Span<const Vector3> vertices, Vector3 &min, Vector3 &max ) {
+	min = Vector3 (  1e30f,  1e30f,  1e30f );
+	max = Vector3 ( -1e30f, -1e30f, -1e30f );
+
+	for ( uint32_t i = 0; i < vertices.size ( ); ++i ) {
+		min = glm::min ( min, vertices[i] );
+		max = glm::max ( max, vertices[i] );
+	}
+}
+
+
+// Cle de soudure : position et normale d'un sommet indexe
+struct WeldKey {
+	Vector3 vertex;
+	Vector3 normal;
+
+	bool operator==( const WeldKey &k ) const {
+		return vertex == k.vertex && normal == k.normal;
+	}
+};
+
+struct WeldKeyHash {
+	size_t operator()( const WeldKey &k ) const {
+		const uint32_t *bits = ( const uint32_t* ) &k;
+		size_t h = 2166136261u;
+		for ( uint32_t i = 0; i < sizeof ( WeldKey ) / sizeof ( uint32_t ); ++i ) {
+			h = ( h ^ bits[i] ) * 16777619u;
+		}
+		return h;
+	}
+};
+
+// Fusionne les sommets identiques des donnees indexees (indexData)
+void Mesh::weldIndexData ( std::vector<Vector3> &vertices, std::vector<Vector3> &normals, std::vector<uint32_t> &indices ) const {
+	std::unordered_map<WeldKey, uint32_t, WeldKeyHash> unique;
+	unique.reserve ( _indexVertexCount );
+
+	vertices.clear ( );
+	normals.clear ( );
+	indices.clear ( );
+	indices.reserve ( _indexVertexCount );
+
+	for ( uint32_t i = 0; i < _indexVertexCount; ++i ) {
+		WeldKey key = { _indexVertices[i], _indexNormals[i] };
+
+		std::unordered_map<WeldKey, uint32_t, WeldKeyHash>::iterator it = unique.find ( key );
+
+		if ( it == unique.end ( ) ) {
+			uint32_t index = vertices.size ( );
+			unique[key] = index;
+			vertices.push_back ( key.vertex );
+			normals.push_back ( key.normal );
+			indices.push_back ( index );
+		}
+		else {
+			indices.push_back ( it->second );
+		}
+	}
+}
+
+
+// Un seul sommet par position : les normales des faces voisines se rejoignent
+void Mesh::weldPositions ( std::vector<Vector3> &vertices, std::vector<uint32_t> &indices ) {
+	std::unordered_map<uint64_t, std::vector<uint32_t> > buckets;
+	std::vector<Vector3> welded;
+	std::vector<uint32_t> remap ( vertices.size ( ) );
+
+	for ( uint32_t i = 0; i < vertices.size ( ); ++i ) {
+		const uint32_t *bits = ( const uint32_t* ) &vertices[i];
+		uint64_t h = 14695981039346656037ull;
+		for ( uint32_t k = 0; k < 3; ++k ) {
+			h = ( h ^ bits[k] ) * 1099511628211ull;
+		}
+
+		std::vector<uint32_t> &bucket = buckets[h];
+
+		uint32_t b = 0;
+		while ( b < bucket.size ( ) && welded[bucket[b]] != vertices[i] ) {
+			b++;
+		}
+
+		if ( b == bucket.size ( ) ) {
+			bucket.push_back ( welded.size ( ) );
+			welded.push_back ( vertices[i] );
+		}
+
+		remap[i] = bucket[b];
 	}
 
-	return max;
+	for ( uint32_t i = 0; i < indices.size ( ); ++i ) {
+		indices[i] = remap[indices[i]];
+	}
+
+	vertices.swap ( welded );
+}
+
+
+// Faces de chaque sommet, dans l'ordre des faces : offsets[v] a offsets[v + 1]
+void Mesh::buildAdjacency ( Span<const uint32_t> indices, uint32_t vertexCount, std::vector<uint32_t> &offsets, std::vector<uint32_t> &faces ) {
+	offsets.assign ( vertexCount + 1, 0 );
+
+	for ( size_t i = 0; i < indices.size ( ); ++i ) {
+		offsets[indices[i] + 1]++;
+	}
+
+	for ( uint32_t v = 0; v < vertexCount; ++v ) {
+		offsets[v + 1] += offsets[v];
+	}
+
+	faces.resize ( indices.size ( ) );
+	std::vector<uint32_t> cursor ( offsets.begin ( ), offsets.end ( ) - 1 );
+
+	for ( size_t i = 0; i < indices.size ( ); ++i ) {
+		faces[cursor[indices[i]]++] = ( uint32_t ) ( i / 3 );
+	}
+}
+
+
+void Mesh::calculateFaceNormals ( Span<const Vector3> vertices, Span<const uint32_t> indices, Vector3 *faceNormals, JobSystem *jobs ) {
+	parallelFor ( jobs, 0, ( uint32_t ) ( indices.size ( ) / 3 ), MESH_GRAIN, [&] ( uint32_t first, uint32_t last ) {
+		for ( uint32_t t = first; t < last; ++t ) {
+			const Vector3 &a = vertices[indices[3 * t]];
+			Vector3 n = glm::cross ( vertices[indices[3 * t + 1]] - a, vertices[indices[3 * t + 2]] - a );
+			float length = glm::length ( n );
+
+			faceNormals[t] = length > 0.0f ? n / length : Vector3 ( 0.0f, 0.0f, 0.0f );
+		}
+	} );
+}
+
+
+// Moyenne des normales unitaires des faces voisines, comme calculateVertexNormals ( Mesh& )
+void Mesh::calculateVertexNormals ( Span<const Vector3> faceNormals, Span<const uint32_t> offsets, Span<const uint32_t> faces,
+									Vector3 *normals, JobSystem *jobs ) {
+	parallelFor ( jobs, 0, ( uint32_t ) ( offsets.size ( ) - 1 ), MESH_GRAIN, [&] ( uint32_t first, uint32_t last ) {
+		for ( uint32_t v = first; v < last; ++v ) {
+			Vector3 normal ( 0.0f, 0.0f, 0.0f );
+
+			for ( uint32_t a = offsets[v]; a < offsets[v + 1]; ++a ) {
+				normal += faceNormals[faces[a]];
+			}
+
+			float length = glm::length ( normal );
+			normals[v] = length > 0.0f ? normal / length : Vector3 ( 0.0f, 1.0f, 0.0f );
+		}
+	} );
 }
@@ -1,18 +1,22 @@
 #pragma once
 
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <vector>
 #include <stdint.h>
 
-#include "GL/glew.h"   
+#include <glm/glm.hpp>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtx/transform.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
-#include <glm\glm\glm.hpp>
-#include <glm\glm\vec3.hpp>
-#include <glm\glm\mat4x4.hpp>
-#include <glm\glm\gtx\transform.hpp>
-#include <glm\glm\gtc\matrix_transform.hpp>
+#include "Span.h"
+
+class JobSystem;
+class LinearArena;
 
 typedef glm::vec3 Vector3;
 typedef glm::vec2 Vector2;
@@ -31,15 +35,6 @@ struct Edge {
 };
 /////////////////////////////
 
-/////////////////////////////
-// Face
-struct Face {
-	uint32_t _verticesCount;
-	std::vector<uint32_t> _vertexIndices;
-	std::vector<uint32_t> _uvIndices;
-	std::vector<uint32_t> _normalIndices;
-};
-
 /////////////////////////////
 // Triangle
 struct Triangle {
@@ -50,17 +45,25 @@ struct Triangle {
 
 /////////////////////////////
 // Mesh
+// Move only : a mesh holds every array of a model, a copy must be asked
+// for with clone(). Once the GPU buffers are filled it can be dropped.
 class Mesh {
 
 public:
 	Mesh ( );
+	Mesh ( Mesh &&other );
 	~Mesh ( );
 
-	static Mesh loadOBJ ( const std::string &fileName, bool indexData );
-	static Mesh loadOFF ( const std::string &fileName, bool calculateNormalVertex );
+	Mesh &operator=( Mesh &&other );
+
+	Mesh clone ( ) const;
+
+	// Without a job system, every stage runs on the calling thread
+	static Mesh loadOBJ ( const std::string &fileName, bool indexData, JobSystem *jobs = NULL );
+	static Mesh loadOFF ( const std::string &fileName, bool calculateNormalVertex, JobSystem *jobs = NULL );
 	static void saveOFF ( const std::string &fileName, const Mesh &mesh );
 
-	Triangle getTriangle ( const Face &face );
+	Triangle getTriangle ( uint32_t face ) const;
 
 	std::string _name;
 	std::string _type;
@@ -70,8 +73,14 @@ public:
 	std::vector<Vector2> _indexUvs;
 	std::vector<Vector3> _normals;
 	std::vector<Vector3> _indexNormals;
-	std::vector<Face> _faces;
 	std::vector<Edge> _edges;
+
+	// Faces, flat : the corners of face k are _faceOffsets[k] to
+	// _faceOffsets[k + 1] of the index arrays. _uvIndices is empty without uvs
+	std::vector<uint32_t> _faceOffsets;
+	std::vector<uint32_t> _vertexIndices;
+	std::vector<uint32_t> _uvIndices;
+	std::vector<uint32_t> _normalIndices;
 	
 	Vector3 _center;
 	uint32_t
@@ -80,14 +89,41 @@ public:
 		_facesCount,
 		_edgesCount;
 
+	uint32_t cornerCount ( ) const { return _faceOffsets.empty ( ) ? 0 : _faceOffsets[_facesCount]; }
+	uint32_t faceSize ( uint32_t face ) const { return _faceOffsets[face + 1] - _faceOffsets[face]; }
+	const uint32_t *faceVertices ( uint32_t face ) const { return &_vertexIndices[_faceOffsets[face]]; }
+
+	// Appends a face of count corners, its vertex indices only
+	void addFace ( const uint32_t *vertices, uint32_t count ) {
+		if ( _faceOffsets.empty ( ) ) {
+			_faceOffsets.push_back ( 0 );
+		}
+
+		_vertexIndices.insert ( _vertexIndices.end ( ), vertices, vertices + count );
+		_faceOffsets.push_back ( _vertexIndices.size ( ) );
+	}
+
 	void rotate ( float angle, Vector3 normal ) {
 		std::cout << "Rotating mesh...\n";
 
-		for ( unsigned int i = 0; i < _vertexCount; i++ ) {
-			glm::mat4 trans = glm::rotate ( glm::mat4 ( 1.0f ), angle, normal );
-			glm::vec4 tmpPoint = glm::vec4 ( _vertices[i], 1.f ) * trans;
-			
-			_vertices[i] = Vector3 ( tmpPoint / tmpPoint.w );
+		rotate ( Span<const Vector3> ( _vertices.data ( ), _vertexCount ), _vertices.data ( ), angle, normal );
+	}
+
+	// Same rotation from points to out (may be points), silent : called every frame.
+	// Without a translation the w of the points does not matter, normals go through too
+	static void rotate ( Span<const Vector3> points, Vector3 *out, float angle, Vector3 normal ) {
+		glm::mat4 trans = glm::rotate ( glm::mat4 ( 1.0f ), angle, normal );
+
+		for ( size_t i = 0; i < points.size ( ); i++ ) {
+			out[i] = Vector3 ( glm::vec4 ( points[i], 0.f ) * trans );
+		}
+	}
+
+	// Points pushed along their normal by a wave travelling up y, of
+	// amplitude units and frequency waves per unit, at phase radians
+	static void wave ( Span<const Vector3> points, Span<const Vector3> normals, Vector3 *out, float amplitude, float frequency, float phase ) {
+		for ( size_t i = 0; i < points.size ( ); i++ ) {
+			out[i] = points[i] + normals[i] * ( amplitude * sinf ( frequency * points[i].y + phase ) );
 		}
 	}
 
@@ -107,22 +143,31 @@ public:
 		}
 	}
 
-	void indexData ( );
-
-	static double calculateMax ( Mesh &mesh );
-	static void centerNormalizeMesh ( Mesh &mesh, const double &max );
+	void indexData ( JobSystem *jobs = NULL );
+	void weldIndexData ( std::vector<Vector3> &vertices, std::vector<Vector3> &normals, std::vector<uint32_t> &indices ) const;
+
+	static double calculateMax ( Mesh &mesh, JobSystem *jobs = NULL );
+	static void calculateBounds ( const Mesh &mesh, Vector3 &min, Vector3 &max );
+	static void calculateBounds ( Span<const Vector3> vertices, Vector3 &min, Vector3 &max );
+	static void centerNormalizeMesh ( Mesh &mesh, const double &max, JobSystem *jobs = NULL );
+	static void calculateFaceNormals ( Mesh &mesh, JobSystem *jobs = NULL );
+	// The adjacency is built in scratch when given, else in an arena of its own
+	static void calculateVertexNormals ( Mesh &mesh, JobSystem *jobs = NULL, LinearArena *scratch = NULL );
+
+	// Triangle lists, the reference of the compute shaders (MeshCompute). A
+	// degenerate triangle has a null normal, a vertex without area gets +y
+	static void weldPositions ( std::vector<Vector3> &vertices, std::vector<uint32_t> &indices );
+	static void buildAdjacency ( Span<const uint32_t> indices, uint32_t vertexCount, std::vector<uint32_t> &offsets, std::vector<uint32_t> &faces );
+	static void calculateFaceNormals ( Span<const Vector3> vertices, Span<const uint32_t> indices, Vector3 *faceNormals, JobSystem *jobs = NULL );
+	static void calculateVertexNormals ( Span<const Vector3> faceNormals, Span<const uint32_t> offsets, Span<const uint32_t> faces,
+										 Vector3 *normals, JobSystem *jobs = NULL );
 	static void removeFaces ( Mesh &mesh, int count );
 	static void buildEdges ( Mesh & mesh );
-};
 
-inline std::ostream& operator<<( std::ostream& os, const Face& obj ) {
-	os << obj._verticesCount << " ";
-	for ( uint32_t i = 0; i < obj._verticesCount; ++i ) {
-		os << obj._vertexIndices[i] << " ";
-	}
-	os << std::endl;
-	return os;
-}
+private:
+	Mesh ( const Mesh & ) = delete;
+	Mesh &operator=( const Mesh & ) = delete;
+};
 
 inline std::ostream& operator<<( std::ostream& os, const Vector3& obj ) {
 	os << obj.x << " " << obj.y << " " << obj.z;
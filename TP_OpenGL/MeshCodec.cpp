@@ -0,0 +1,789 @@
+#include "MeshCodec.h"
+#include "Compression.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#define MESH_CODEC_MAGIC "MGC1"
+#define MESH_CODEC_VERSION 1
+
+// Les codes tiennent sur un quartet : 15 aretes et 14 sommets adressables,
+// les valeurs restantes signalent un triangle ou un sommet hors FIFO
+#define EDGE_FIFO 16
+#define VERTEX_FIFO 16
+#define EDGE_CODES 15
+#define VERTEX_CODES 14
+#define VERTEX_EXPLICIT 15
+
+#define NO_VERTEX 0xFFFFFFFFu
+
+// Entry of the chunk table, after the header
+struct ChunkEntry {
+	uint32_t firstTriangle;
+	uint32_t triangleCount;
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+	uint32_t connectivitySize;		// connectivity, then positions
+	uint32_t rawSize;
+	uint32_t compressedSize;
+};
+
+// Edge a -> b as the neighbouring triangle walks it, d the opposite vertex
+struct FifoEdge {
+	uint32_t a, b, d;
+};
+
+// Parallelogram of a new vertex : a + b - d, or delta with the previous vertex
+struct Prediction {
+	uint32_t a, b, d;
+};
+
+/////////////////////////////
+// Fifos
+// Recent edges and vertices, the same on both sides : index 0 is the last pushed
+struct Fifos {
+	FifoEdge edges[EDGE_FIFO];
+	uint32_t vertices[VERTEX_FIFO];
+	uint32_t edgePushes;
+	uint32_t vertexPushes;
+
+	void reset ( ) {
+		edgePushes = 0;
+		vertexPushes = 0;
+	}
+
+	uint32_t edgeCount ( ) const { return std::min ( edgePushes, ( uint32_t ) EDGE_CODES ); }
+	uint32_t vertexCount ( ) const { return std::min ( vertexPushes, ( uint32_t ) VERTEX_CODES ); }
+
+	const FifoEdge &edge ( uint32_t i ) const { return edges[( edgePushes - 1 - i ) & ( EDGE_FIFO - 1 )]; }
+	uint32_t vertex ( uint32_t i ) const { return vertices[( vertexPushes - 1 - i ) & ( VERTEX_FIFO - 1 )]; }
+
+	void pushEdge ( uint32_t a, uint32_t b, uint32_t d ) {
+		FifoEdge &e = edges[edgePushes++ & ( EDGE_FIFO - 1 )];
+		e.a = a;
+		e.b = b;
+		e.d = d;
+	}
+
+	void pushVertex ( uint32_t v ) {
+		vertices[vertexPushes++ & ( VERTEX_FIFO - 1 )] = v;
+	}
+
+	// Triangle a b c : ses aretes vues des voisins. L'arete partagee a deja ses deux triangles
+	void pushTriangle ( uint32_t a, uint32_t b, uint32_t c, bool shared ) {
+		if ( !shared ) {
+			pushEdge ( b, a, c );
+			pushVertex ( a );
+			pushVertex ( b );
+		}
+
+		pushEdge ( c, b, a );
+		pushEdge ( a, c, b );
+		pushVertex ( c );
+	}
+};
+
+
+static Prediction noPrediction ( ) {
+	Prediction p;
+	p.a = p.b = p.d = NO_VERTEX;
+	return p;
+}
+
+
+// Le parallelogramme n'utilise que des sommets du chunk : les chunks se decodent independamment
+static Prediction parallelogram ( uint32_t a, uint32_t b, uint32_t d, uint32_t firstVertex ) {
+	if ( a < firstVertex || b < firstVertex || d < firstVertex ) {
+		return noPrediction ( );
+	}
+
+	Prediction p;
+	p.a = a;
+	p.b = b;
+	p.d = d;
+	return p;
+}
+
+
+// Position quantifiee attendue du sommet local du chunk
+static void predict ( const Prediction &p, uint32_t firstVertex, const int32_t *quantized, uint32_t local, int32_t maxQ, int32_t out[3] ) {
+	if ( p.a != NO_VERTEX ) {
+		const int32_t *a = quantized + 3 * ( p.a - firstVertex );
+		const int32_t *b = quantized + 3 * ( p.b - firstVertex );
+		const int32_t *d = quantized + 3 * ( p.d - firstVertex );
+
+		for ( uint32_t k = 0; k < 3; ++k ) {
+			out[k] = std::max ( 0, std::min ( a[k] + b[k] - d[k], maxQ ) );
+		}
+	}
+	else if ( local > 0 ) {
+		const int32_t *previous = quantized + 3 * ( local - 1 );
+		out[0] = previous[0];
+		out[1] = previous[1];
+		out[2] = previous[2];
+	}
+	else {
+		out[0] = out[1] = out[2] = 0;
+	}
+}
+
+
+// Parcours en profondeur des triangles par leurs aretes : chaque triangle
+// suit un voisin deja code, son arete partagee est dans la FIFO du decodeur
+static void optimizeOrder ( std::vector<uint32_t> &triangles, uint32_t vertexCount ) {
+	uint32_t triangleCount = triangles.size ( ) / 3;
+
+	// Triangles de chaque sommet
+	std::vector<uint32_t> offsets ( vertexCount + 1, 0 );
+	for ( size_t i = 0; i < triangles.size ( ); ++i ) {
+		offsets[triangles[i] + 1]++;
+	}
+	for ( uint32_t v = 0; v < vertexCount; ++v ) {
+		offsets[v + 1] += offsets[v];
+	}
+
+	std::vector<uint32_t> adjacency ( triangles.size ( ) );
+	std::vector<uint32_t> cursor ( offsets.begin ( ), offsets.end ( ) - 1 );
+	for ( size_t i = 0; i < triangles.size ( ); ++i ) {
+		adjacency[cursor[triangles[i]]++] = i / 3;
+	}
+
+	// Voisin de l'arete e (v[e] -> v[e+1]) : le triangle qui la parcourt en sens inverse
+	std::vector<uint32_t> neighbors ( triangles.size ( ), NO_VERTEX );
+
+	for ( uint32_t t = 0; t < triangleCount; ++t ) {
+		for ( uint32_t e = 0; e < 3; ++e ) {
+			uint32_t a = triangles[3 * t + e], b = triangles[3 * t + ( e + 1 ) % 3];
+
+			for ( uint32_t i = offsets[b]; i < offsets[b + 1] && neighbors[3 * t + e] == NO_VERTEX; ++i ) {
+				const uint32_t *u = &triangles[3 * adjacency[i]];
+
+				for ( uint32_t k = 0; k < 3; ++k ) {
+					if ( adjacency[i] != t && u[k] == b && u[( k + 1 ) % 3] == a ) {
+						neighbors[3 * t + e] = adjacency[i];
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	// Un ordre deja en bandes (grilles, maillages optimises) est garde : le
+	// parcours en profondeur y eloigne les sommets reutilises
+	uint32_t sharing = 0;
+	for ( uint32_t t = 1; t < triangleCount; ++t ) {
+		const uint32_t *n = &neighbors[3 * t];
+		sharing += n[0] == t - 1 || n[1] == t - 1 || n[2] == t - 1;
+	}
+
+	if ( sharing >= triangleCount * 3ull / 4 ) {
+		return;
+	}
+
+	std::vector<uint8_t> emitted ( triangleCount, 0 );
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> stack;
+	order.reserve ( triangleCount );
+
+	for ( uint32_t seed = 0; seed < triangleCount; ++seed ) {
+		if ( emitted[seed] ) {
+			continue;
+		}
+
+		emitted[seed] = 1;
+		order.push_back ( seed );
+		stack.push_back ( seed );
+
+		while ( !stack.empty ( ) ) {
+			uint32_t current = stack.back ( ), next = NO_VERTEX;
+
+			for ( uint32_t e = 0; e < 3 && next == NO_VERTEX; ++e ) {
+				uint32_t n = neighbors[3 * current + e];
+				if ( n != NO_VERTEX && !emitted[n] ) {
+					next = n;
+				}
+			}
+
+			if ( next == NO_VERTEX ) {
+				stack.pop_back ( );
+				continue;
+			}
+
+			emitted[next] = 1;
+			order.push_back ( next );
+			stack.push_back ( next );
+		}
+	}
+
+	std::vector<uint32_t> sorted ( triangles.size ( ) );
+	for ( uint32_t t = 0; t < triangleCount; ++t ) {
+		sorted[3 * t] = triangles[3 * order[t]];
+		sorted[3 * t + 1] = triangles[3 * order[t] + 1];
+		sorted[3 * t + 2] = triangles[3 * order[t] + 2];
+	}
+
+	triangles.swap ( sorted );
+}
+
+
+static void append ( std::vector<uint8_t> &out, const void *data, size_t size ) {
+	const uint8_t *bytes = ( const uint8_t* ) data;
+	out.insert ( out.end ( ), bytes, bytes + size );
+}
+
+
+void MeshCodec::triangulate ( const Mesh &mesh, std::vector<uint32_t> &triangles ) {
+	triangles.clear ( );
+	triangles.reserve ( ( size_t ) mesh._facesCount * 3 );
+
+	for ( uint32_t f = 0; f < mesh._facesCount; ++f ) {
+		const uint32_t *v = mesh.faceVertices ( f );
+
+		for ( uint32_t k = 1; k + 1 < mesh.faceSize ( f ); ++k ) {
+			triangles.push_back ( v[0] );
+			triangles.push_back ( v[k] );
+			triangles.push_back ( v[k + 1] );
+		}
+	}
+}
+
+
+bool MeshCodec::encode ( const Mesh &mesh, std::vector<uint8_t> &out, uint32_t bits, uint32_t trianglesPerChunk, JobSystem *jobs ) {
+	std::vector<uint32_t> triangles;
+	triangulate ( mesh, triangles );
+
+	Span<const Vector3> positions ( mesh._vertices.empty ( ) ? NULL : &mesh._vertices[0], mesh._vertexCount );
+
+	return encode ( positions, Span<const uint32_t> ( triangles.data ( ), triangles.size ( ) ), out, bits, trianglesPerChunk, jobs );
+}
+
+
+bool MeshCodec::encode ( Span<const Vector3> positions, Span<const uint32_t> indices, std::vector<uint8_t> &out, uint32_t bits,
+						 uint32_t trianglesPerChunk, JobSystem *jobs ) {
+	if ( bits < 1 || bits > 24 || trianglesPerChunk == 0 || indices.size ( ) % 3 != 0 ) {
+		printf ( "Invalid mesh codec parameters: %u bits, %u triangles per chunk, %u indices\n", bits, trianglesPerChunk,
+				 ( uint32_t ) indices.size ( ) );
+		return false;
+	}
+
+	uint32_t vertexCount = positions.size ( );
+
+	for ( size_t i = 0; i < indices.size ( ); ++i ) {
+		if ( indices[i] >= vertexCount ) {
+			printf ( "Triangle %u references vertex %u of %u\n", ( uint32_t ) ( i / 3 ), indices[i], vertexCount );
+			return false;
+		}
+	}
+
+	std::vector<uint32_t> triangles ( indices.data ( ), indices.data ( ) + indices.size ( ) );
+
+	uint32_t triangleCount = triangles.size ( ) / 3;
+
+	optimizeOrder ( triangles, vertexCount );
+
+	// Connectivite : les sommets sont renumerotes dans l'ordre de leur premiere utilisation
+	std::vector<uint32_t> remap ( vertexCount, NO_VERTEX );
+	std::vector<uint32_t> order;
+	std::vector<Prediction> predictions;
+	order.reserve ( vertexCount );
+	predictions.reserve ( vertexCount );
+
+	std::vector<ChunkEntry> chunks;
+	std::vector<std::vector<uint8_t> > streams;
+
+	uint32_t next = 0;
+	Fifos fifos;
+
+	for ( uint32_t first = 0; first < triangleCount; first += trianglesPerChunk ) {
+		ChunkEntry chunk;
+		chunk.firstTriangle = first;
+		chunk.triangleCount = std::min ( trianglesPerChunk, triangleCount - first );
+		chunk.firstVertex = next;
+
+		streams.push_back ( std::vector<uint8_t> ( ) );
+		std::vector<uint8_t> &stream = streams.back ( );
+		stream.reserve ( chunk.triangleCount * 2 );
+
+		fifos.reset ( );
+
+		for ( uint32_t t = first; t < first + chunk.triangleCount; ++t ) {
+			const uint32_t *v = &triangles[3 * t];
+
+			// Arete recente du triangle, dans son sens de parcours
+			uint32_t edge = EDGE_CODES, rotation = 0;
+
+			for ( uint32_t i = 0; i < fifos.edgeCount ( ) && edge == EDGE_CODES; ++i ) {
+				const FifoEdge &e = fifos.edge ( i );
+
+				for ( uint32_t r = 0; r < 3; ++r ) {
+					if ( remap[v[r]] == e.a && remap[v[( r + 1 ) % 3]] == e.b ) {
+						edge = i;
+						rotation = r;
+						break;
+					}
+				}
+			}
+
+			if ( edge < EDGE_CODES ) {
+				FifoEdge e = fifos.edge ( edge );
+				uint32_t old = v[( rotation + 2 ) % 3];
+				uint32_t c = remap[old];
+				uint8_t code = ( uint8_t ) ( edge << 4 );
+
+				if ( c == NO_VERTEX ) {
+					c = next++;
+					remap[old] = c;
+					order.push_back ( old );
+					predictions.push_back ( parallelogram ( e.a, e.b, e.d, chunk.firstVertex ) );
+					stream.push_back ( code );
+				}
+				else {
+					uint32_t recent = VERTEX_CODES;
+					for ( uint32_t i = 0; i < fifos.vertexCount ( ); ++i ) {
+						if ( fifos.vertex ( i ) == c ) {
+							recent = i;
+							break;
+						}
+					}
+
+					if ( recent < VERTEX_CODES ) {
+						stream.push_back ( code | ( uint8_t ) ( recent + 1 ) );
+					}
+					else {
+						stream.push_back ( code | VERTEX_EXPLICIT );
+						writeVarint ( stream, next - 1 - c );
+					}
+				}
+
+				fifos.pushTriangle ( e.a, e.b, c, true );
+			}
+			else {
+				// Triangle isole : chaque sommet est nouveau (0) ou a une distance de next
+				stream.push_back ( EDGE_CODES << 4 );
+
+				uint32_t w[3];
+				for ( uint32_t r = 0; r < 3; ++r ) {
+					if ( remap[v[r]] == NO_VERTEX ) {
+						remap[v[r]] = next++;
+						order.push_back ( v[r] );
+						predictions.push_back ( noPrediction ( ) );
+						writeVarint ( stream, 0 );
+					}
+					else {
+						writeVarint ( stream, next - remap[v[r]] );
+					}
+
+					w[r] = remap[v[r]];
+				}
+
+				fifos.pushTriangle ( w[0], w[1], w[2], false );
+			}
+		}
+
+		chunk.vertexCount = next - chunk.firstVertex;
+		chunk.connectivitySize = stream.size ( );
+		chunks.push_back ( chunk );
+	}
+
+	// Les sommets hors des faces terminent le dernier chunk
+	if ( next < vertexCount ) {
+		if ( chunks.empty ( ) ) {
+			ChunkEntry chunk;
+			chunk.firstTriangle = triangleCount;
+			chunk.triangleCount = 0;
+			chunk.firstVertex = next;
+			chunk.connectivitySize = 0;
+			chunks.push_back ( chunk );
+			streams.push_back ( std::vector<uint8_t> ( ) );
+		}
+
+		for ( uint32_t v = 0; v < vertexCount; ++v ) {
+			if ( remap[v] == NO_VERTEX ) {
+				remap[v] = next++;
+				order.push_back ( v );
+				predictions.push_back ( noPrediction ( ) );
+			}
+		}
+
+		chunks.back ( ).vertexCount = next - chunks.back ( ).firstVertex;
+	}
+
+	// Quantification sur la boite englobante
+	MeshCodecHeader header;
+	header.vertexCount = vertexCount;
+	header.triangleCount = triangleCount;
+	header.chunkCount = chunks.size ( );
+	header.bits = bits;
+
+	Vector3 min, max;
+	Mesh::calculateBounds ( positions, min, max );
+
+	int32_t maxQ = ( int32_t ) ( ( 1u << bits ) - 1 );
+
+	for ( uint32_t k = 0; k < 3; ++k ) {
+		header.min[k] = vertexCount > 0 ? min[k] : 0.0f;
+		header.step[k] = vertexCount > 0 ? ( max[k] - min[k] ) / maxQ : 0.0f;
+	}
+
+	// Positions et compression, un chunk par tache
+	std::vector<std::vector<uint8_t> > blocks ( chunks.size ( ) );
+
+	parallelFor ( jobs, 0, chunks.size ( ), 1, [&] ( uint32_t firstChunk, uint32_t lastChunk ) {
+		for ( uint32_t c = firstChunk; c < lastChunk; ++c ) {
+			ChunkEntry &chunk = chunks[c];
+			std::vector<uint8_t> &stream = streams[c];
+			std::vector<int32_t> quantized ( 3 * ( size_t ) chunk.vertexCount );
+
+			for ( uint32_t i = 0; i < chunk.vertexCount; ++i ) {
+				uint32_t index = chunk.firstVertex + i;
+				const Vector3 &p = positions[order[index]];
+				int32_t *q = &quantized[3 * i];
+
+				for ( uint32_t k = 0; k < 3; ++k ) {
+					q[k] = header.step[k] > 0.0f ? ( int32_t ) floor ( ( p[k] - header.min[k] ) / header.step[k] + 0.5f ) : 0;
+					q[k] = std::max ( 0, std::min ( q[k], maxQ ) );
+				}
+
+				int32_t predicted[3];
+				predict ( predictions[index], chunk.firstVertex, quantized.data ( ), i, maxQ, predicted );
+
+				for ( uint32_t k = 0; k < 3; ++k ) {
+					writeVarint ( stream, zigzag ( q[k] - predicted[k] ) );
+				}
+			}
+
+			chunk.rawSize = stream.size ( );
+			chunk.compressedSize = lzCompress ( Span<const uint8_t> ( stream.data ( ), stream.size ( ) ), blocks[c] );
+		}
+	} );
+
+	out.clear ( );
+	append ( out, MESH_CODEC_MAGIC, 4 );
+
+	uint32_t version = MESH_CODEC_VERSION;
+	append ( out, &version, sizeof ( version ) );
+	append ( out, &header, sizeof ( header ) );
+
+	if ( !chunks.empty ( ) ) {
+		append ( out, &chunks[0], chunks.size ( ) * sizeof ( ChunkEntry ) );
+	}
+
+	for ( uint32_t c = 0; c < blocks.size ( ); ++c ) {
+		out.insert ( out.end ( ), blocks[c].begin ( ), blocks[c].end ( ) );
+	}
+
+	return true;
+}
+
+
+bool MeshCodec::readHeader ( Span<const uint8_t> data, MeshCodecHeader &header ) {
+	if ( data.size ( ) < 8 + sizeof ( MeshCodecHeader ) || memcmp ( data.data ( ), MESH_CODEC_MAGIC, 4 ) != 0 ) {
+		printf ( "Not a compressed mesh\n" );
+		return false;
+	}
+
+	uint32_t version;
+	memcpy ( &version, data.data ( ) + 4, sizeof ( version ) );
+
+	if ( version != MESH_CODEC_VERSION ) {
+		printf ( "Unsupported compressed mesh version %u\n", version );
+		return false;
+	}
+
+	memcpy ( &header, data.data ( ) + 8, sizeof ( header ) );
+
+	if ( header.bits < 1 || header.bits > 24 ) {
+		printf ( "Corrupt compressed mesh header\n" );
+		return false;
+	}
+
+	return true;
+}
+
+
+// Un chunk vers ses plages de positions et d'indices
+static bool decodeChunk ( Span<const uint8_t> block, const ChunkEntry &chunk, const MeshCodecHeader &header, Vector3 *positions, uint32_t *indices ) {
+	std::vector<uint8_t> raw ( chunk.rawSize );
+
+	if ( !lzDecompress ( block, raw.data ( ), raw.size ( ) ) ) {
+		return false;
+	}
+
+	const uint8_t *p = raw.data ( );
+	const uint8_t *connectivityEnd = p + chunk.connectivitySize;
+	const uint8_t *end = p + raw.size ( );
+
+	uint32_t first = chunk.firstVertex;
+	uint32_t last = first + chunk.vertexCount;
+	uint32_t next = first;
+
+	std::vector<Prediction> predictions ( chunk.vertexCount, noPrediction ( ) );
+
+	Fifos fifos;
+	fifos.reset ( );
+
+	uint32_t *out = indices + ( size_t ) chunk.firstTriangle * 3;
+
+	for ( uint32_t t = 0; t < chunk.triangleCount; ++t, out += 3 ) {
+		if ( p >= connectivityEnd ) {
+			return false;
+		}
+
+		uint8_t code = *p++;
+		uint32_t edge = code >> 4;
+
+		if ( edge < EDGE_CODES ) {
+			if ( edge >= fifos.edgeCount ( ) ) {
+				return false;
+			}
+
+			FifoEdge e = fifos.edge ( edge );
+			uint32_t vertex = code & 15;
+			uint32_t c;
+
+			if ( vertex == 0 ) {
+				if ( next >= last ) {
+					return false;
+				}
+
+				c = next++;
+				predictions[c - first] = parallelogram ( e.a, e.b, e.d, first );
+			}
+			else if ( vertex <= VERTEX_CODES ) {
+				if ( vertex - 1 >= fifos.vertexCount ( ) ) {
+					return false;
+				}
+
+				c = fifos.vertex ( vertex - 1 );
+			}
+			else {
+				uint32_t distance;
+				p = readVarint ( p, connectivityEnd, distance );
+
+				if ( p == NULL || distance >= next ) {
+					return false;
+				}
+
+				c = next - 1 - distance;
+			}
+
+			out[0] = e.a;
+			out[1] = e.b;
+			out[2] = c;
+
+			fifos.pushTriangle ( e.a, e.b, c, true );
+		}
+		else {
+			for ( uint32_t r = 0; r < 3; ++r ) {
+				uint32_t distance;
+				p = readVarint ( p, connectivityEnd, distance );
+
+				if ( p == NULL || distance > next || ( distance == 0 && next >= last ) ) {
+					return false;
+				}
+
+				out[r] = distance == 0 ? next++ : next - distance;
+			}
+
+			fifos.pushTriangle ( out[0], out[1], out[2], false );
+		}
+	}
+
+	if ( p != connectivityEnd ) {
+		return false;
+	}
+
+	// Positions : residus de la prediction, dans l'ordre des sommets
+	int32_t maxQ = ( int32_t ) ( ( 1u << header.bits ) - 1 );
+	std::vector<int32_t> quantized ( 3 * ( size_t ) chunk.vertexCount );
+
+	for ( uint32_t i = 0; i < chunk.vertexCount; ++i ) {
+		int32_t predicted[3];
+		predict ( predictions[i], first, quantized.data ( ), i, maxQ, predicted );
+
+		int32_t *q = &quantized[3 * i];
+		Vector3 &position = positions[first + i];
+
+		for ( uint32_t k = 0; k < 3; ++k ) {
+			uint32_t residual;
+			p = readVarint ( p, end, residual );
+
+			if ( p == NULL ) {
+				return false;
+			}
+
+			q[k] = predicted[k] + unzigzag ( residual );
+			position[k] = header.min[k] + q[k] * header.step[k];
+		}
+	}
+
+	return p == end;
+}
+
+
+bool MeshCodec::decode ( Span<const uint8_t> data, std::vector<Vector3> &positions, std::vector<uint32_t> &indices, JobSystem *jobs ) {
+	MeshCodecHeader header;
+
+	if ( !readHeader ( data, header ) ) {
+		return false;
+	}
+
+	size_t offset = 8 + sizeof ( MeshCodecHeader );
+
+	if ( ( data.size ( ) - offset ) / sizeof ( ChunkEntry ) < header.chunkCount ) {
+		printf ( "Corrupt compressed mesh: truncated chunk table\n" );
+		return false;
+	}
+
+	std::vector<ChunkEntry> chunks ( header.chunkCount );
+	if ( header.chunkCount > 0 ) {
+		memcpy ( &chunks[0], data.data ( ) + offset, header.chunkCount * sizeof ( ChunkEntry ) );
+	}
+	offset += header.chunkCount * sizeof ( ChunkEntry );
+
+	// Les chunks couvrent triangles et sommets sans trou ; leurs blocs se suivent.
+	// Au moins un octet par triangle, trois par sommet, et LZ n'etend pas un
+	// octet au dela de 255 : les allocations restent bornees par la taille du fichier
+	std::vector<size_t> offsets ( header.chunkCount );
+	uint64_t triangles = 0, vertices = 0;
+
+	for ( uint32_t c = 0; c < header.chunkCount; ++c ) {
+		const ChunkEntry &chunk = chunks[c];
+
+		if ( chunk.firstTriangle != triangles || chunk.firstVertex != vertices || chunk.connectivitySize > chunk.rawSize ||
+			 chunk.compressedSize > data.size ( ) - offset || chunk.rawSize > chunk.compressedSize * 256ull ||
+			 chunk.triangleCount > chunk.connectivitySize || chunk.vertexCount * 3ull > chunk.rawSize - chunk.connectivitySize ) {
+			printf ( "Corrupt compressed mesh: chunk %u\n", c );
+			return false;
+		}
+
+		offsets[c] = offset;
+		offset += chunk.compressedSize;
+		triangles += chunk.triangleCount;
+		vertices += chunk.vertexCount;
+	}
+
+	if ( triangles != header.triangleCount || vertices != header.vertexCount ) {
+		printf ( "Corrupt compressed mesh: %llu triangles, %llu vertices in the chunks\n", ( unsigned long long ) triangles,
+				 ( unsigned long long ) vertices );
+		return false;
+	}
+
+	positions.resize ( header.vertexCount );
+	indices.resize ( ( size_t ) header.triangleCount * 3 );
+
+	std::atomic<uint32_t> failures ( 0 );
+
+	parallelFor ( jobs, 0, header.chunkCount, 1, [&] ( uint32_t firstChunk, uint32_t lastChunk ) {
+		for ( uint32_t c = firstChunk; c < lastChunk; ++c ) {
+			Span<const uint8_t> block ( data.data ( ) + offsets[c], chunks[c].compressedSize );
+
+			if ( !decodeChunk ( block, chunks[c], header, positions.data ( ), indices.data ( ) ) ) {
+				failures++;
+			}
+		}
+	} );
+
+	if ( failures > 0 ) {
+		printf ( "Corrupt compressed mesh: %u chunks failed to decode\n", ( uint32_t ) failures );
+		return false;
+	}
+
+	return true;
+}
+
+
+bool MeshCodec::readFile ( const std::string &fileName, std::vector<uint8_t> &data ) {
+	FILE *file = fopen ( fileName.c_str ( ), "rb" );
+	if ( file == NULL ) {
+		printf ( "Impossible to open %s\n", fileName.c_str ( ) );
+		return false;
+	}
+
+	fseek ( file, 0, SEEK_END );
+	long size = ftell ( file );
+	fseek ( file, 0, SEEK_SET );
+
+	data.resize ( size > 0 ? size : 0 );
+	bool ok = size >= 0 && fread ( data.data ( ), 1, data.size ( ), file ) == data.size ( );
+	fclose ( file );
+
+	if ( !ok ) {
+		printf ( "Impossible to read %s\n", fileName.c_str ( ) );
+	}
+
+	return ok;
+}
+
+
+bool MeshCodec::save ( const std::string &fileName, const Mesh &mesh, uint32_t bits, JobSystem *jobs ) {
+	std::vector<uint8_t> data;
+
+	if ( !encode ( mesh, data, bits, MESH_CODEC_CHUNK, jobs ) ) {
+		return false;
+	}
+
+	FILE *file = fopen ( fileName.c_str ( ), "wb" );
+	if ( file == NULL ) {
+		printf ( "Impossible to open %s\n", fileName.c_str ( ) );
+		return false;
+	}
+
+	bool ok = fwrite ( data.data ( ), 1, data.size ( ), file ) == data.size ( );
+	fclose ( file );
+
+	return ok;
+}
+
+
+Mesh MeshCodec::load ( const std::string &fileName, bool calculateNormalVertex, JobSystem *jobs ) {
+	std::cout << "Loading file...\n";
+
+	Mesh mesh;
+	mesh._name = fileName;
+	mesh._type = "MGC";
+
+	std::vector<uint8_t> data;
+	std::vector<uint32_t> indices;
+
+	if ( !readFile ( fileName, data ) || !decode ( Span<const uint8_t> ( data.data ( ), data.size ( ) ), mesh._vertices, indices, jobs ) ) {
+		mesh._vertices.clear ( );
+		indices.clear ( );
+	}
+
+	mesh._vertexCount = mesh._vertices.size ( );
+	mesh._facesCount = indices.size ( ) / 3;
+	mesh._edgesCount = 0;
+
+	Vector3 center;
+	for ( uint32_t i = 0; i < mesh._vertexCount; ++i ) {
+		center += mesh._vertices[i];
+	}
+	mesh._center = mesh._vertexCount > 0 ? center / ( float ) mesh._vertexCount : center;
+
+	mesh._faceOffsets = std::vector<uint32_t> ( mesh._facesCount + 1 );
+	for ( uint32_t f = 0; f <= mesh._facesCount; ++f ) {
+		mesh._faceOffsets[f] = 3 * f;
+	}
+	mesh._vertexIndices.assign ( indices.begin ( ), indices.begin ( ) + 3 * ( size_t ) mesh._facesCount );
+
+	if ( mesh._vertexCount == 0 ) {
+		return mesh;
+	}
+
+	double max = Mesh::calculateMax ( mesh, jobs );
+
+	Mesh::centerNormalizeMesh ( mesh, max, jobs );
+
+	Mesh::calculateFaceNormals ( mesh, jobs );
+
+	if ( calculateNormalVertex ) {
+		Mesh::calculateVertexNormals ( mesh, jobs );
+	}
+
+	return mesh;
+}
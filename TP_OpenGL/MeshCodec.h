@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "Mesh.h"
+#include "Span.h"
+
+class JobSystem;
+
+// Triangles per chunk : the unit of parallel decoding
+#define MESH_CODEC_CHUNK 32768
+
+// Quantization of the positions, bits per axis
+#define MESH_CODEC_BITS 16
+
+/////////////////////////////
+// MeshCodecHeader
+// Positions are stored as min + q * step, q on bits per axis : a decoded
+// position is at most half a step away from the original one
+struct MeshCodecHeader {
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	uint32_t chunkCount;
+	uint32_t bits;
+	float min[3];
+	float step[3];
+};
+
+/////////////////////////////
+// MeshCodec
+// Compressed geometry (.mgc) : the faces are fan triangulated, reordered so
+// that each triangle follows a neighbour, and cut in chunks of triangles that
+// decode independently. In a chunk, a triangle is coded against a FIFO of the
+// recent edges and vertices (one byte when it shares an edge with a recent
+// triangle), the vertices are renumbered in order of first use and their
+// quantized positions are predicted from the parallelogram of the shared
+// edge. Each chunk is then LZ compressed.
+// The decoded mesh has the same triangles, winding included, but neither
+// their order, their first corner nor the vertex numbering are kept.
+class MeshCodec {
+
+public:
+	static bool encode ( const Mesh &mesh, std::vector<uint8_t> &out, uint32_t bits = MESH_CODEC_BITS,
+						 uint32_t trianglesPerChunk = MESH_CODEC_CHUNK, JobSystem *jobs = NULL );
+	static bool encode ( Span<const Vector3> positions, Span<const uint32_t> indices, std::vector<uint8_t> &out,
+						 uint32_t bits = MESH_CODEC_BITS, uint32_t trianglesPerChunk = MESH_CODEC_CHUNK, JobSystem *jobs = NULL );
+
+	// Flat positions and triangle list, chunks decoded in parallel
+	static bool decode ( Span<const uint8_t> data, std::vector<Vector3> &positions, std::vector<uint32_t> &indices,
+						 JobSystem *jobs = NULL );
+
+	static bool readHeader ( Span<const uint8_t> data, MeshCodecHeader &header );
+
+	static bool save ( const std::string &fileName, const Mesh &mesh, uint32_t bits = MESH_CODEC_BITS, JobSystem *jobs = NULL );
+
+	// Same mesh as loadOFF gives : centered, normalized, with face normals
+	static Mesh load ( const std::string &fileName, bool calculateNormalVertex, JobSystem *jobs = NULL );
+
+	static bool readFile ( const std::string &fileName, std::vector<uint8_t> &data );
+
+	// Faces as a triangle list, polygons cut in fans : the triangles the codec stores
+	static void triangulate ( const Mesh &mesh, std::vector<uint32_t> &triangles );
+};
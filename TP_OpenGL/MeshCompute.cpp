@@ -0,0 +1,236 @@
+#include "MeshCompute.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Liaisons des buffers dans face_normals.csl, vertex_normals.csl et bounds.csl
+#define BINDING_POSITIONS 0
+#define BINDING_INDICES 1
+#define BINDING_FACE_NORMALS 2
+#define BINDING_SUMS 3
+#define BINDING_OFFSETS 4
+#define BINDING_FACES 5
+#define BINDING_NORMALS 6
+#define BINDING_BOUNDS 7
+
+bool MeshCompute::scatter = false;
+
+// Inverse de ordered ( ) dans bounds.csl
+static float unordered ( uint32_t u ) {
+	u = ( u & 0x80000000u ) != 0 ? u & 0x7FFFFFFFu : ~u;
+
+	float f;
+	memcpy ( &f, &u, sizeof ( f ) );
+	return f;
+}
+
+
+static uint32_t groups ( uint32_t count, uint32_t size ) {
+	return ( count + size - 1 ) / size;
+}
+
+
+ComputeMesh::ComputeMesh ( ) :
+	mapped ( NULL ),
+	frame ( 0 ),
+	vertexCount ( 0 ),
+	triangleCount ( 0 ),
+	bbMin ( 0.0f, 0.0f, 0.0f ),
+	bbMax ( 0.0f, 0.0f, 0.0f ) {
+	std::fill ( fences, fences + MESH_COMPUTE_FRAMES, ( GLsync ) 0 );
+}
+
+
+/////////////////////////////
+// MeshCompute
+
+MeshCompute::MeshCompute ( ) :
+	_shaders ( NULL ) {
+	std::fill ( _programs, _programs + PROGRAM_COUNT, 0u );
+}
+
+
+MeshCompute::~MeshCompute ( ) {
+}
+
+
+void MeshCompute::init ( ShaderManager *shaders ) {
+	_shaders = shaders;
+
+	_programs[FACE_NORMALS] = shaders->loadCompute ( "face_normals.csl" );
+	_programs[FACE_NORMALS_SCATTER] = shaders->loadCompute ( "face_normals.csl", "#define SCATTER\n" );
+	_programs[VERTEX_NORMALS] = shaders->loadCompute ( "vertex_normals.csl" );
+	_programs[VERTEX_NORMALS_SCATTER] = shaders->loadCompute ( "vertex_normals.csl", "#define SCATTER\n" );
+	_programs[BOUNDS] = shaders->loadCompute ( "bounds.csl" );
+}
+
+
+void MeshCompute::release ( ) {
+	for ( uint32_t m = 0; m < _meshes.size ( ); ++m ) {
+		ComputeMesh &mesh = _meshes[m];
+
+		for ( uint32_t i = 0; i < MESH_COMPUTE_FRAMES; ++i ) {
+			if ( mesh.fences[i] != 0 ) {
+				glDeleteSync ( mesh.fences[i] );
+			}
+		}
+
+		if ( mesh.mapped != NULL ) {
+			glUnmapNamedBuffer ( mesh.bounds.id ( ) );
+		}
+	}
+
+	_meshes.clear ( );
+}
+
+
+uint32_t MeshCompute::addMesh ( Span<const uint32_t> indices, uint32_t vertexCount ) {
+	_meshes.emplace_back ( );
+	ComputeMesh &mesh = _meshes.back ( );
+
+	mesh.vertexCount = vertexCount;
+	mesh.triangleCount = indices.size ( ) / 3;
+
+	// La topologie ne change pas : l'adjacence est construite une fois
+	std::vector<uint32_t> offsets, faces;
+	Mesh::buildAdjacency ( indices, vertexCount, offsets, faces );
+
+	mesh.indices = createBuffer ( );
+	glNamedBufferStorage ( mesh.indices.id ( ), indices.size ( ) * sizeof ( uint32_t ), indices.data ( ), 0 );
+
+	mesh.offsets = createBuffer ( );
+	glNamedBufferStorage ( mesh.offsets.id ( ), offsets.size ( ) * sizeof ( uint32_t ), &offsets[0], 0 );
+
+	mesh.faces = createBuffer ( );
+	glNamedBufferStorage ( mesh.faces.id ( ), std::max<size_t> ( faces.size ( ), 1 ) * sizeof ( uint32_t ), faces.empty ( ) ? NULL : &faces[0], 0 );
+
+	mesh.faceNormals = createBuffer ( );
+	glNamedBufferStorage ( mesh.faceNormals.id ( ), std::max ( mesh.triangleCount, 1u ) * 4 * sizeof ( float ), NULL, 0 );
+
+	// Les sommes partent de zero, vertex_normals.csl les remet a zero apres usage
+	mesh.sums = createBuffer ( );
+	glNamedBufferStorage ( mesh.sums.id ( ), std::max ( vertexCount, 1u ) * 3 * sizeof ( int32_t ), NULL, 0 );
+	glClearNamedBufferData ( mesh.sums.id ( ), GL_R32I, GL_RED_INTEGER, GL_INT, NULL );
+
+	mesh.normals = createBuffer ( );
+	glNamedBufferStorage ( mesh.normals.id ( ), std::max ( vertexCount, 1u ) * 3 * sizeof ( float ), NULL, 0 );
+
+	// Lu par le CPU seulement, sans copie apres le fence
+	GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLsizeiptr size = MESH_COMPUTE_FRAMES * 6 * sizeof ( uint32_t );
+
+	mesh.bounds = createBuffer ( );
+	glNamedBufferStorage ( mesh.bounds.id ( ), size, NULL, flags );
+	mesh.mapped = ( const uint32_t* ) glMapNamedBufferRange ( mesh.bounds.id ( ), 0, size, flags );
+
+	if ( mesh.mapped == NULL ) {
+		printf ( "Impossible to map the bounds buffer\n" );
+	}
+
+	return _meshes.size ( ) - 1;
+}
+
+
+void MeshCompute::compute ( GLStateCache &state, uint32_t index, GLuint buffer, GLintptr offset ) {
+	ComputeMesh &mesh = _meshes[index];
+
+	if ( mesh.vertexCount == 0 ) {
+		return;
+	}
+
+	// Tout le buffer est lie : l'offset des positions n'a pas l'alignement
+	// de GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, il passe en uniforme
+	GLuint positionOffset = ( GLuint ) ( offset / sizeof ( float ) );
+
+	glBindBufferBase ( GL_SHADER_STORAGE_BUFFER, BINDING_POSITIONS, buffer );
+	glBindBufferBase ( GL_SHADER_STORAGE_BUFFER, BINDING_INDICES, mesh.indices.id ( ) );
+	glBindBufferBase ( GL_SHADER_STORAGE_BUFFER, BINDING_FACE_NORMALS, mesh.faceNormals.id ( ) );
+	glBindBufferBase ( GL_SHADER_STORAGE_BUFFER, BINDING_SUMS, mesh.sums.id ( ) );
+	glBindBufferBase ( GL_SHADER_STORAGE_BUFFER, BINDING_OFFSETS, mesh.offsets.id ( ) );
+	glBindBufferBase ( GL_SHADER_STORAGE_BUFFER, BINDING_FACES, mesh.faces.id ( ) );
+	glBindBufferBase ( GL_SHADER_STORAGE_BUFFER, BINDING_NORMALS, mesh.normals.id ( ) );
+
+	// Normales des faces, eventuellement accumulees dans les sommets
+	GLuint program = this->program ( scatter ? FACE_NORMALS_SCATTER : FACE_NORMALS );
+	state.useProgram ( program );
+	glProgramUniform1ui ( program, glGetUniformLocation ( program, "position_offset" ), positionOffset );
+	glProgramUniform1ui ( program, glGetUniformLocation ( program, "triangle_count" ), mesh.triangleCount );
+	glProgramUniform1f ( program, glGetUniformLocation ( program, "fixed_point" ), MESH_COMPUTE_FIXED_POINT );
+	glDispatchCompute ( groups ( mesh.triangleCount, MESH_COMPUTE_GROUP ), 1, 1 );
+
+	glMemoryBarrier ( GL_SHADER_STORAGE_BARRIER_BIT );
+
+	program = this->program ( scatter ? VERTEX_NORMALS_SCATTER : VERTEX_NORMALS );
+	state.useProgram ( program );
+	glProgramUniform1ui ( program, glGetUniformLocation ( program, "vertex_count" ), mesh.vertexCount );
+	glProgramUniform1f ( program, glGetUniformLocation ( program, "fixed_point" ), MESH_COMPUTE_FIXED_POINT );
+	glDispatchCompute ( groups ( mesh.vertexCount, MESH_COMPUTE_GROUP ), 1, 1 );
+
+	// Boite englobante dans l'emplacement de cette image. Un resultat
+	// jamais lu y est abandonne
+	uint32_t slot = mesh.frame % MESH_COMPUTE_FRAMES;
+
+	if ( mesh.fences[slot] != 0 ) {
+		glDeleteSync ( mesh.fences[slot] );
+		mesh.fences[slot] = 0;
+	}
+
+	if ( mesh.mapped != NULL ) {
+		GLuint empty[2] = { 0xFFFFFFFFu, 0u };
+		glClearNamedBufferSubData ( mesh.bounds.id ( ), GL_R32UI, slot * 6 * sizeof ( uint32_t ), 3 * sizeof ( uint32_t ), GL_RED_INTEGER, GL_UNSIGNED_INT, &empty[0] );
+		glClearNamedBufferSubData ( mesh.bounds.id ( ), GL_R32UI, ( slot * 6 + 3 ) * sizeof ( uint32_t ), 3 * sizeof ( uint32_t ), GL_RED_INTEGER, GL_UNSIGNED_INT, &empty[1] );
+
+		glBindBufferBase ( GL_SHADER_STORAGE_BUFFER, BINDING_BOUNDS, mesh.bounds.id ( ) );
+
+		program = this->program ( BOUNDS );
+		state.useProgram ( program );
+		glProgramUniform1ui ( program, glGetUniformLocation ( program, "position_offset" ), positionOffset );
+		glProgramUniform1ui ( program, glGetUniformLocation ( program, "vertex_count" ), mesh.vertexCount );
+		glProgramUniform1ui ( program, glGetUniformLocation ( program, "bounds_offset" ), slot * 6 );
+		glDispatchCompute ( groups ( mesh.vertexCount, MESH_COMPUTE_BOUNDS_GROUP ), 1, 1 );
+
+		glMemoryBarrier ( GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT );
+		mesh.fences[slot] = glFenceSync ( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+		mesh.frame++;
+	}
+
+	// Les normales sont lues comme attribut par les dessins suivants
+	glMemoryBarrier ( GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT );
+}
+
+
+bool MeshCompute::bounds ( uint32_t index, Vector3 &min, Vector3 &max, bool wait ) {
+	ComputeMesh &mesh = _meshes[index];
+	bool found = false;
+
+	// Du plus ancien au plus recent : le dernier termine gagne
+	for ( uint32_t i = 0; i < MESH_COMPUTE_FRAMES; ++i ) {
+		uint32_t slot = ( mesh.frame + i ) % MESH_COMPUTE_FRAMES;
+
+		if ( mesh.fences[slot] == 0 ) {
+			continue;
+		}
+
+		GLenum status = wait ? glClientWaitSync ( mesh.fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull ) :
+							   glClientWaitSync ( mesh.fences[slot], 0, 0 );
+
+		if ( status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED ) {
+			break;
+		}
+
+		glDeleteSync ( mesh.fences[slot] );
+		mesh.fences[slot] = 0;
+
+		const uint32_t *bounds = mesh.mapped + slot * 6;
+		mesh.bbMin = Vector3 ( unordered ( bounds[0] ), unordered ( bounds[1] ), unordered ( bounds[2] ) );
+		mesh.bbMax = Vector3 ( unordered ( bounds[3] ), unordered ( bounds[4] ), unordered ( bounds[5] ) );
+		found = true;
+	}
+
+	min = mesh.bbMin;
+	max = mesh.bbMax;
+
+	return found;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <deque>
+#include <stdint.h>
+
+#include "GL/glew.h"
+
+#include "Mesh.h"
+#include "GLState.h"
+#include "GpuResource.h"
+#include "ShaderManager.h"
+#include "Span.h"
+
+// Invocations per group of face_normals.csl / vertex_normals.csl, and of bounds.csl
+#define MESH_COMPUTE_GROUP 64
+#define MESH_COMPUTE_BOUNDS_GROUP 256
+
+// Results of the bounds in flight, read back without stalling
+#define MESH_COMPUTE_FRAMES 3
+
+// Scale of the scattered sums : a vertex shared by up to 2047 faces fits an int
+#define MESH_COMPUTE_FIXED_POINT 1048576.0f
+
+/////////////////////////////
+// ComputeMesh : the buffers of one triangle list
+struct ComputeMesh {
+	Buffer indices;
+	Buffer offsets;			// faces of each vertex (gather)
+	Buffer faces;
+	Buffer faceNormals;		// vec4 per triangle
+	Buffer sums;			// fixed point x y z per vertex (scatter)
+	Buffer normals;			// 3 floats per vertex, a vertex buffer
+
+	// MESH_COMPUTE_FRAMES slots of min xyz, max xyz as ordered uints,
+	// mapped for the whole life of the mesh
+	Buffer bounds;
+	const uint32_t *mapped;
+	GLsync fences[MESH_COMPUTE_FRAMES];
+	uint32_t frame;
+
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+
+	Vector3 bbMin;			// last bounds read back
+	Vector3 bbMax;
+
+	ComputeMesh ( );
+
+private:
+	ComputeMesh ( const ComputeMesh & ) = delete;
+	ComputeMesh &operator=( const ComputeMesh & ) = delete;
+};
+
+/////////////////////////////
+// MeshCompute
+// Recomputes on the GPU, from positions already in a GL buffer, what
+// loadOFF computes once on the CPU : the face normals, the vertex normals
+// and the bounding box. The vertex normals either gather the faces of each
+// vertex through an adjacency list built once, in the order of
+// Mesh::calculateVertexNormals, or are scattered by the faces with integer
+// atomics on fixed point sums. The bounds are reduced in shared memory, then
+// merged with atomics, and read back a few frames later.
+// The Mesh functions on triangle lists are the reference (--validate-normals).
+class MeshCompute {
+
+public:
+	MeshCompute ( );
+	~MeshCompute ( );
+
+	// Submits the programs, built with the others by ShaderManager::wait
+	void init ( ShaderManager *shaders );
+	void release ( );
+
+	uint32_t addMesh ( Span<const uint32_t> indices, uint32_t vertexCount );
+
+	// The positions are 3 floats per vertex at offset bytes in buffer, a
+	// multiple of 4. The normals are ready for the draws that follow
+	void compute ( GLStateCache &state, uint32_t mesh, GLuint buffer, GLintptr offset );
+
+	GLuint normals ( uint32_t mesh ) const { return _meshes[mesh].normals.id ( ); }
+	GLuint faceNormals ( uint32_t mesh ) const { return _meshes[mesh].faceNormals.id ( ); }
+
+	// Bounds of the latest compute done by the GPU, false when none finished
+	// since the last call. wait : blocks for the last compute
+	bool bounds ( uint32_t mesh, Vector3 &min, Vector3 &max, bool wait = false );
+
+	// True : the faces scatter their normal, false : each vertex gathers its faces
+	static bool scatter;
+
+private:
+	enum Program {
+		FACE_NORMALS,
+		FACE_NORMALS_SCATTER,
+		VERTEX_NORMALS,
+		VERTEX_NORMALS_SCATTER,
+		BOUNDS,
+		PROGRAM_COUNT
+	};
+
+	GLuint program ( Program p ) const { return _shaders->program ( _programs[p] ); }
+
+	ShaderManager *_shaders;
+	uint32_t _programs[PROGRAM_COUNT];
+
+	// Never moved once added
+	std::deque<ComputeMesh> _meshes;
+};
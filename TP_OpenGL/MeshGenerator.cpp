@@ -0,0 +1,203 @@
+#include "MeshGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+uint64_t MeshGenerator::icosphereTriangles ( uint32_t subdivisions ) {
+	return 20ull << ( 2 * subdivisions );
+}
+
+
+uint64_t MeshGenerator::gridTriangles ( uint32_t width, uint32_t height ) {
+	return width < 2 || height < 2 ? 0 : 2ull * ( width - 1 ) * ( height - 1 );
+}
+
+
+void MeshGenerator::addTriangle ( Mesh &mesh, uint32_t a, uint32_t b, uint32_t c ) {
+	uint32_t vertices[3] = { a, b, c };
+	mesh.addFace ( vertices, 3 );
+}
+
+
+// Compteurs et centre, comme apres la lecture d'un fichier
+void MeshGenerator::finish ( Mesh &mesh ) {
+	mesh._type = "OFF";
+	mesh._vertexCount = mesh._vertices.size ( );
+	mesh._facesCount = mesh._faceOffsets.empty ( ) ? 0 : mesh._faceOffsets.size ( ) - 1;
+	mesh._edgesCount = 0;
+
+	Vector3 center;
+	for ( uint32_t i = 0; i < mesh._vertexCount; ++i ) {
+		center += mesh._vertices[i];
+	}
+
+	mesh._center = mesh._vertexCount > 0 ? center / ( float ) mesh._vertexCount : center;
+}
+
+
+Mesh MeshGenerator::icosphere ( uint32_t subdivisions ) {
+	const float t = ( 1.0f + sqrtf ( 5.0f ) ) * 0.5f;
+
+	std::vector<Vector3> vertices;
+	vertices.reserve ( 10 * ( size_t ) icosphereTriangles ( subdivisions ) / 20 + 2 );
+
+	const float corners[12][3] = {
+		{ -1,  t,  0 }, {  1,  t,  0 }, { -1, -t,  0 }, {  1, -t,  0 },
+		{  0, -1,  t }, {  0,  1,  t }, {  0, -1, -t }, {  0,  1, -t },
+		{  t,  0, -1 }, {  t,  0,  1 }, { -t,  0, -1 }, { -t,  0,  1 }
+	};
+
+	for ( uint32_t i = 0; i < 12; ++i ) {
+		vertices.push_back ( glm::normalize ( Vector3 ( corners[i][0], corners[i][1], corners[i][2] ) ) );
+	}
+
+	std::vector<uint32_t> triangles = {
+		0, 11, 5,	0, 5, 1,	0, 1, 7,	0, 7, 10,	0, 10, 11,
+		1, 5, 9,	5, 11, 4,	11, 10, 2,	10, 7, 6,	7, 1, 8,
+		3, 9, 4,	3, 4, 2,	3, 2, 6,	3, 6, 8,	3, 8, 9,
+		4, 9, 5,	2, 4, 11,	6, 2, 10,	8, 6, 7,	9, 8, 1
+	};
+
+	// Chaque arete n'est coupee qu'une fois : milieu partage par ses deux triangles
+	std::unordered_map<uint64_t, uint32_t> midpoints;
+
+	for ( uint32_t s = 0; s < subdivisions; ++s ) {
+		std::vector<uint32_t> next;
+		next.reserve ( triangles.size ( ) * 4 );
+
+		midpoints.clear ( );
+		midpoints.reserve ( triangles.size ( ) / 2 );
+
+		auto midpoint = [&vertices, &midpoints] ( uint32_t a, uint32_t b ) -> uint32_t {
+			uint64_t key = a < b ? ( ( uint64_t ) a << 32 ) | b : ( ( uint64_t ) b << 32 ) | a;
+
+			std::unordered_map<uint64_t, uint32_t>::const_iterator it = midpoints.find ( key );
+			if ( it != midpoints.end ( ) ) {
+				return it->second;
+			}
+
+			uint32_t index = vertices.size ( );
+			vertices.push_back ( glm::normalize ( ( vertices[a] + vertices[b] ) * 0.5f ) );
+			midpoints[key] = index;
+
+			return index;
+		};
+
+		for ( size_t k = 0; k < triangles.size ( ); k += 3 ) {
+			uint32_t a = triangles[k], b = triangles[k + 1], c = triangles[k + 2];
+			uint32_t ab = midpoint ( a, b ), bc = midpoint ( b, c ), ca = midpoint ( c, a );
+
+			uint32_t children[12] = { a, ab, ca,	b, bc, ab,	c, ca, bc,	ab, bc, ca };
+			next.insert ( next.end ( ), children, children + 12 );
+		}
+
+		triangles.swap ( next );
+	}
+
+	Mesh mesh;
+	mesh._name = "icosphere";
+	mesh._vertices.swap ( vertices );
+	mesh._faceOffsets.reserve ( triangles.size ( ) / 3 + 1 );
+	mesh._vertexIndices.reserve ( triangles.size ( ) );
+
+	for ( size_t k = 0; k < triangles.size ( ); k += 3 ) {
+		addTriangle ( mesh, triangles[k], triangles[k + 1], triangles[k + 2] );
+	}
+
+	finish ( mesh );
+
+	return mesh;
+}
+
+
+Mesh MeshGenerator::grid ( uint32_t width, uint32_t height ) {
+	Mesh mesh;
+	mesh._name = "grid";
+
+	if ( width < 2 || height < 2 ) {
+		finish ( mesh );
+		return mesh;
+	}
+
+	mesh._vertices.reserve ( ( size_t ) width * height );
+	mesh._faceOffsets.reserve ( ( size_t ) gridTriangles ( width, height ) + 1 );
+	mesh._vertexIndices.reserve ( 3 * ( size_t ) gridTriangles ( width, height ) );
+
+	// Cellules carrees, le plus grand cote de -1 a 1
+	float step = 2.0f / ( std::max ( width, height ) - 1 );
+
+	for ( uint32_t j = 0; j < height; ++j ) {
+		for ( uint32_t i = 0; i < width; ++i ) {
+			mesh._vertices.push_back ( Vector3 ( ( i - ( width - 1 ) * 0.5f ) * step, 0.0f, ( j - ( height - 1 ) * 0.5f ) * step ) );
+		}
+	}
+
+	for ( uint32_t j = 0; j + 1 < height; ++j ) {
+		for ( uint32_t i = 0; i + 1 < width; ++i ) {
+			uint32_t v = j * width + i;
+
+			addTriangle ( mesh, v, v + width, v + 1 );
+			addTriangle ( mesh, v + 1, v + width, v + width + 1 );
+		}
+	}
+
+	finish ( mesh );
+
+	return mesh;
+}
+
+
+// Hachage entier vers [0, 1)
+static float hashUnit ( uint32_t x, uint32_t y, uint32_t seed ) {
+	uint32_t h = x * 374761393u + y * 668265263u + seed * 2246822519u;
+	h = ( h ^ ( h >> 13 ) ) * 1274126177u;
+	h ^= h >> 16;
+
+	return ( h & 0xFFFFFF ) / 16777216.0f;
+}
+
+
+// Bruit de valeur lisse, interpolation cubique entre les noeuds entiers
+static float valueNoise ( float x, float y, uint32_t seed ) {
+	float fx = floorf ( x ), fy = floorf ( y );
+	uint32_t ix = ( uint32_t ) ( int32_t ) fx, iy = ( uint32_t ) ( int32_t ) fy;
+
+	float tx = x - fx, ty = y - fy;
+	tx = tx * tx * ( 3.0f - 2.0f * tx );
+	ty = ty * ty * ( 3.0f - 2.0f * ty );
+
+	float a = hashUnit ( ix, iy, seed ), b = hashUnit ( ix + 1, iy, seed );
+	float c = hashUnit ( ix, iy + 1, seed ), d = hashUnit ( ix + 1, iy + 1, seed );
+
+	return ( a + ( b - a ) * tx ) + ( ( c + ( d - c ) * tx ) - ( a + ( b - a ) * tx ) ) * ty;
+}
+
+
+Mesh MeshGenerator::noisySurface ( uint32_t width, uint32_t height, float jitter, uint32_t seed ) {
+	Mesh mesh = grid ( width, height );
+	mesh._name = "noisy";
+
+	float step = 2.0f / ( std::max ( std::max ( width, height ), 2u ) - 1 );
+
+	for ( uint32_t v = 0; v < mesh._vertexCount; ++v ) {
+		Vector3 &p = mesh._vertices[v];
+
+		// Terrain : 5 octaves, du relief large aux details
+		float amplitude = 0.25f, frequency = 2.0f, elevation = 0.0f;
+		for ( uint32_t o = 0; o < 5; ++o ) {
+			elevation += amplitude * ( valueNoise ( ( p.x + 1.0f ) * frequency, ( p.z + 1.0f ) * frequency, seed + o ) - 0.5f );
+			amplitude *= 0.5f;
+			frequency *= 2.0f;
+		}
+
+		// Bruit du capteur, en fraction du pas de la grille
+		p.x += ( hashUnit ( v, 1, seed ) - 0.5f ) * jitter * step;
+		p.y = elevation + ( hashUnit ( v, 2, seed ) - 0.5f ) * jitter * step;
+		p.z += ( hashUnit ( v, 3, seed ) - 0.5f ) * jitter * step;
+	}
+
+	finish ( mesh );
+
+	return mesh;
+}
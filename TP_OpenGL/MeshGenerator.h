@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Mesh.h"
+
+/////////////////////////////
+// MeshGenerator
+// Procedural meshes of any size, in the state loadOFF leaves a file before
+// its processing : _vertices, triangular faces, the counts and _center.
+// The same parameters always give the same mesh.
+class MeshGenerator {
+
+public:
+	// Icosahedron subdivided subdivisions times, on the unit sphere : 20 * 4^n triangles
+	static Mesh icosphere ( uint32_t subdivisions );
+
+	// Flat regular grid of width x height vertices, 2 triangles per cell
+	static Mesh grid ( uint32_t width, uint32_t height );
+
+	// Grid displaced like a range scan : fractal height noise, then every
+	// vertex jittered in the three directions by a sensor noise of amplitude jitter
+	static Mesh noisySurface ( uint32_t width, uint32_t height, float jitter, uint32_t seed );
+
+	// Triangles of the meshes above, to size them from a triangle budget
+	static uint64_t icosphereTriangles ( uint32_t subdivisions );
+	static uint64_t gridTriangles ( uint32_t width, uint32_t height );
+
+private:
+	static void addTriangle ( Mesh &mesh, uint32_t a, uint32_t b, uint32_t c );
+	static void finish ( Mesh &mesh );
+};
@@ -0,0 +1,227 @@
+#include "OcclusionBenchmark.h"
+#include "HiZ.h"
+#include "MeshGenerator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// Resolution du rasterizer de --occlusion cpu (main.cpp)
+#define BENCH_OCCLUSION_SIZE 256
+
+// Mesures par etape, la meilleure est gardee
+#define BENCH_OCCLUSION_RUNS 20
+
+// A box of known visibility
+struct OcclusionCheck {
+	const char *name;
+	glm::vec3 center;
+	bool hidden;		// expected
+	bool culled;		// by the pyramid
+};
+
+// The boxes of the grid
+struct OcclusionCounts {
+	uint32_t boxes;
+	uint32_t outside;	// out of the frustum, or crossing the near plane
+	uint32_t culled;	// by the pyramid
+	uint32_t hidden;	// by the full resolution depth
+	uint32_t wrong;		// culled but not hidden
+};
+
+// Every pixel of the full resolution depth under the box is nearer than the box
+static bool hiddenAtFullResolution ( const OccluderRasterizer &rasterizer, const ScreenBox &box ) {
+	int width = rasterizer.width ( );
+	int height = rasterizer.height ( );
+
+	int x0 = std::min ( std::max ( ( int ) std::floor ( box.min.x * width ), 0 ), width - 1 );
+	int x1 = std::min ( std::max ( ( int ) std::floor ( box.max.x * width ), 0 ), width - 1 );
+	int y0 = std::min ( std::max ( ( int ) std::floor ( box.min.y * height ), 0 ), height - 1 );
+	int y1 = std::min ( std::max ( ( int ) std::floor ( box.max.y * height ), 0 ), height - 1 );
+
+	for ( int y = y0; y <= y1; ++y ) {
+		for ( int x = x0; x <= x1; ++x ) {
+			if ( box.nearDepth <= rasterizer.depth ( )[y * width + x] ) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+static double since ( std::chrono::high_resolution_clock::time_point start ) {
+	return std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - start ).count ( );
+}
+
+
+static void writeOcclusionJSON ( FILE *file, uint32_t triangles, double rasterMs, double pyramidMs, double testMs,
+								 const std::vector<OcclusionCheck> &checks, const OcclusionCounts &counts ) {
+	char date[32];
+	time_t now = time ( NULL );
+	strftime ( date, sizeof ( date ), "%Y-%m-%dT%H:%M:%SZ", gmtime ( &now ) );
+
+	fprintf ( file, "{\n" );
+	fprintf ( file, "  \"benchmark\": \"occlusion\",\n" );
+	fprintf ( file, "  \"date\": \"%s\",\n", date );
+	fprintf ( file, "  \"resolution\": [%u, %u],\n", BENCH_OCCLUSION_SIZE, BENCH_OCCLUSION_SIZE );
+	fprintf ( file, "  \"occluder_triangles\": %u,\n", triangles );
+	fprintf ( file, "  \"raster_ms\": %.4f,\n", rasterMs );
+	fprintf ( file, "  \"pyramid_ms\": %.4f,\n", pyramidMs );
+	fprintf ( file, "  \"checks\": [\n" );
+
+	for ( uint32_t i = 0; i < checks.size ( ); ++i ) {
+		fprintf ( file, "    { \"box\": \"%s\", \"expected\": \"%s\", \"culled\": %s }%s\n", checks[i].name,
+				  checks[i].hidden ? "culled" : "kept", checks[i].culled ? "true" : "false", i + 1 < checks.size ( ) ? "," : "" );
+	}
+
+	fprintf ( file, "  ],\n" );
+	fprintf ( file, "  \"grid\": {\n" );
+	fprintf ( file, "    \"boxes\": %u,\n", counts.boxes );
+	fprintf ( file, "    \"outside\": %u,\n", counts.outside );
+	fprintf ( file, "    \"culled\": %u,\n", counts.culled );
+	fprintf ( file, "    \"hidden_full_resolution\": %u,\n", counts.hidden );
+	fprintf ( file, "    \"culled_not_hidden\": %u,\n", counts.wrong );
+	fprintf ( file, "    \"test_ms\": %.4f\n", testMs );
+	fprintf ( file, "  }\n" );
+	fprintf ( file, "}\n" );
+}
+
+
+bool benchmarkOcclusion ( const char *output, uint32_t boxesPerAxis ) {
+	// Camera a 20 unites, un mur de 8 x 8 a 15 unites devant elle
+	glm::mat4 projection = glm::perspective ( glm::radians ( 45.0f ), 1.0f, 0.1f, 100.0f );
+	glm::mat4 view = glm::lookAt ( glm::vec3 ( 0.0f, 0.0f, 20.0f ), glm::vec3 ( 0.0f, 0.0f, 0.0f ), glm::vec3 ( 0.0f, 1.0f, 0.0f ) );
+	glm::mat4 viewProjection = projection * view;
+
+	Mesh wall = MeshGenerator::grid ( 16, 16 );
+	glm::mat4 model = glm::translate ( glm::mat4 ( 1.0f ), glm::vec3 ( 0.0f, 0.0f, 5.0f ) ) *
+					  glm::rotate ( glm::mat4 ( 1.0f ), glm::radians ( 90.0f ), glm::vec3 ( 1.0f, 0.0f, 0.0f ) ) *
+					  glm::scale ( glm::mat4 ( 1.0f ), glm::vec3 ( 4.0f, 4.0f, 4.0f ) );
+
+	Span<const glm::vec3> positions ( &wall._vertices[0], wall._vertices.size ( ) );
+	Span<const uint32_t> indices ( &wall._vertexIndices[0], wall._vertexIndices.size ( ) );
+
+	OccluderRasterizer rasterizer;
+	rasterizer.resize ( BENCH_OCCLUSION_SIZE, BENCH_OCCLUSION_SIZE );
+
+	DepthPyramid pyramid;
+
+	double rasterMs = 1e30, pyramidMs = 1e30;
+
+	for ( uint32_t r = 0; r < BENCH_OCCLUSION_RUNS; ++r ) {
+		std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now ( );
+		rasterizer.clear ( );
+		rasterizer.draw ( positions, indices, viewProjection * model );
+		rasterMs = std::min ( rasterMs, since ( t0 ) );
+
+		std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now ( );
+		pyramid.build ( rasterizer.depth ( ), rasterizer.width ( ), rasterizer.height ( ), viewProjection );
+		pyramidMs = std::min ( pyramidMs, since ( t1 ) );
+	}
+
+	const glm::vec3 half ( 0.5f, 0.5f, 0.5f );
+	const glm::mat4 identity ( 1.0f );
+
+	// Le mur couvre |x|, |y| < 4 / 15 de la distance : derriere lui, une
+	// boite a 20 unites est cachee jusqu'a 5.3 du centre
+	OcclusionCheck checks[] = {
+		{ "behind", glm::vec3 ( 0.0f, 0.0f, 0.0f ), true, false },
+		{ "behind, off center", glm::vec3 ( 2.5f, -2.5f, -5.0f ), true, false },
+		{ "beside", glm::vec3 ( 7.0f, 0.0f, 0.0f ), false, false },
+		{ "above", glm::vec3 ( 0.0f, 7.0f, 0.0f ), false, false },
+		{ "in front", glm::vec3 ( 0.0f, 0.0f, 10.0f ), false, false }
+	};
+
+	std::vector<OcclusionCheck> results ( checks, checks + sizeof ( checks ) / sizeof ( checks[0] ) );
+	bool ok = true;
+
+	for ( uint32_t i = 0; i < results.size ( ); ++i ) {
+		OcclusionCheck &check = results[i];
+		check.culled = !pyramid.visible ( identity, check.center - half, check.center + half );
+
+		if ( check.culled != check.hidden ) {
+			fprintf ( stderr, "Occlusion: the box %s of the wall is %s\n", check.name, check.culled ? "culled" : "kept" );
+			ok = false;
+		}
+	}
+
+	// Grille de boites autour du mur, devant, a cote et derriere
+	std::vector<ScreenBox> boxes;
+	OcclusionCounts counts = { 0, 0, 0, 0, 0 };
+
+	for ( uint32_t k = 0; k < boxesPerAxis; ++k ) {
+		for ( uint32_t j = 0; j < boxesPerAxis; ++j ) {
+			for ( uint32_t i = 0; i < boxesPerAxis; ++i ) {
+				float step = 1.0f / std::max ( boxesPerAxis - 1, 1u );
+				glm::vec3 center ( -8.0f + 16.0f * i * step, -8.0f + 16.0f * j * step, -10.0f + 24.0f * k * step );
+
+				ScreenBox box;
+				bool crosses;
+
+				counts.boxes++;
+
+				if ( !projectBox ( viewProjection, center - 0.25f, center + 0.25f, box, crosses ) || crosses ) {
+					counts.outside++;
+					continue;
+				}
+
+				boxes.push_back ( box );
+			}
+		}
+	}
+
+	double testMs = 1e30;
+
+	for ( uint32_t r = 0; r < BENCH_OCCLUSION_RUNS; ++r ) {
+		std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now ( );
+
+		uint32_t culled = 0;
+		for ( uint32_t b = 0; b < boxes.size ( ); ++b ) {
+			culled += !pyramid.visible ( boxes[b] );
+		}
+
+		testMs = std::min ( testMs, since ( t0 ) );
+		counts.culled = culled;
+	}
+
+	for ( uint32_t b = 0; b < boxes.size ( ); ++b ) {
+		bool hidden = hiddenAtFullResolution ( rasterizer, boxes[b] );
+
+		counts.hidden += hidden;
+		counts.wrong += !pyramid.visible ( boxes[b] ) && !hidden;
+	}
+
+	// La pyramide est conservative : elle ne cache rien de visible
+	if ( counts.wrong > 0 ) {
+		fprintf ( stderr, "Occlusion: %u boxes culled by the pyramid are visible at full resolution\n", counts.wrong );
+		ok = false;
+	}
+
+	if ( counts.culled == 0 ) {
+		fprintf ( stderr, "Occlusion: no box of the grid is culled\n" );
+		ok = false;
+	}
+
+	FILE *file = output != NULL ? fopen ( output, "w" ) : stdout;
+
+	if ( file == NULL ) {
+		printf ( "Impossible to open %s\n", output );
+		return false;
+	}
+
+	writeOcclusionJSON ( file, rasterizer.triangles ( ), rasterMs, pyramidMs, testMs, results, counts );
+
+	if ( file != stdout ) {
+		fclose ( file );
+		fprintf ( stderr, "Results written to %s\n", output );
+	}
+
+	return ok;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+// CPU occlusion culling (HiZ.h) of --occlusion cpu : a wall is rasterized
+// at the resolution of the program, then boxes of known visibility, behind,
+// beside, above and in front of it, must be culled or kept. A grid of
+// boxes around the wall is then culled with the pyramid and with the full
+// resolution depth : a box culled by the pyramid must be hidden at full
+// resolution. False when a box is misclassified. The counts and times are
+// written as JSON to output, or to stdout when output is NULL. No GL
+// context is needed.
+bool benchmarkOcclusion ( const char *output, uint32_t boxesPerAxis );
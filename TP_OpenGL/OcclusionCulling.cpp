@@ -0,0 +1,230 @@
+#include "OcclusionCulling.h"
+
+#include <chrono>
+
+// Fraction de l'ecran au dela de laquelle on teste aussi les clusters
+#define CLUSTER_CULL_MIN_AREA 0.01f
+
+OcclusionCuller::OcclusionCuller ( ) :
+	_source ( OCCLUSION_OFF ),
+	_frame ( 0 ) {
+	_fences[0] = _fences[1] = 0;
+
+	resetStats ( );
+}
+
+
+OcclusionCuller::~OcclusionCuller ( ) {
+}
+
+
+void OcclusionCuller::init ( OcclusionSource source, uint32_t width, uint32_t height ) {
+	_source = source;
+
+	if ( _source == OCCLUSION_CPU ) {
+		_rasterizer.resize ( width, height );
+	}
+
+	if ( _source == OCCLUSION_GPU ) {
+		_pbos[0] = createBuffer ( );
+		_pbos[1] = createBuffer ( );
+		_sizes[0][0] = _sizes[0][1] = _sizes[1][0] = _sizes[1][1] = 0;
+	}
+}
+
+
+uint32_t OcclusionCuller::addOccluder ( std::vector<glm::vec3> &positions, std::vector<uint32_t> &indices ) {
+	_occluders.push_back ( Occluder ( ) );
+
+	if ( _source == OCCLUSION_CPU ) {
+		_occluders.back ( ).positions.swap ( positions );
+		_occluders.back ( ).indices.swap ( indices );
+	}
+
+	return _occluders.size ( ) - 1;
+}
+
+
+void OcclusionCuller::release ( ) {
+	for ( uint32_t slot = 0; slot < 2; ++slot ) {
+		if ( _fences[slot] != 0 ) {
+			glDeleteSync ( _fences[slot] );
+			_fences[slot] = 0;
+		}
+		_pbos[slot].reset ( );
+	}
+
+	_occluders.clear ( );
+}
+
+
+void OcclusionCuller::rasterize ( const glm::mat4 &viewProjection, const OccluderInstance *occluders, uint32_t count ) {
+	auto start = std::chrono::high_resolution_clock::now ( );
+
+	_rasterizer.clear ( );
+
+	for ( uint32_t i = 0; i < count; ++i ) {
+		const Occluder &occluder = _occluders[occluders[i].occluder];
+		_rasterizer.draw ( occluder.positions, occluder.indices, viewProjection * occluders[i].model );
+	}
+
+	_pyramid.build ( _rasterizer.depth ( ), _rasterizer.width ( ), _rasterizer.height ( ), viewProjection );
+
+	_stats.occluderTriangles += _rasterizer.triangles ( );
+	_stats.ms += std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - start ).count ( );
+}
+
+
+void OcclusionCuller::readback ( GLsizei width, GLsizei height, const glm::mat4 &viewProjection, GLuint framebuffer ) {
+	uint32_t slot = _frame % 2;
+	_frame++;
+
+	// Lecture lancee il y a deux images : normalement deja terminee
+	if ( _fences[slot] != 0 ) {
+		auto start = std::chrono::high_resolution_clock::now ( );
+
+		glClientWaitSync ( _fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED );
+		glDeleteSync ( _fences[slot] );
+		_fences[slot] = 0;
+
+		_readback.resize ( _sizes[slot][0] * _sizes[slot][1] );
+		glGetNamedBufferSubData ( _pbos[slot].id ( ), 0, _readback.size ( ) * sizeof ( float ), &_readback[0] );
+
+		_pyramid.build ( &_readback[0], _sizes[slot][0], _sizes[slot][1], _matrices[slot] );
+
+		_stats.ms += std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - start ).count ( );
+	}
+
+	if ( _sizes[slot][0] != width || _sizes[slot][1] != height ) {
+		glNamedBufferData ( _pbos[slot].id ( ), width * height * sizeof ( float ), NULL, GL_STREAM_READ );
+		_sizes[slot][0] = width;
+		_sizes[slot][1] = height;
+	}
+
+	_matrices[slot] = viewProjection;
+
+	glBindFramebuffer ( GL_READ_FRAMEBUFFER, framebuffer );
+	glBindBuffer ( GL_PIXEL_PACK_BUFFER, _pbos[slot].id ( ) );
+	glReadPixels ( 0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, 0 );
+	glBindBuffer ( GL_PIXEL_PACK_BUFFER, 0 );
+
+	_fences[slot] = glFenceSync ( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+}
+
+
+bool OcclusionCuller::visible ( const glm::mat4 &viewProjection, const glm::mat4 &model, const glm::vec3 &min, const glm::vec3 &max,
+								bool &frustumCulled, float &area ) const {
+	ScreenBox box;
+	bool crosses;
+
+	frustumCulled = !projectBox ( viewProjection * model, min, max, box, crosses );
+
+	if ( frustumCulled ) {
+		return false;
+	}
+
+	if ( crosses ) {
+		area = 1.0f;
+		return true;
+	}
+
+	area = ( box.max.x - box.min.x ) * ( box.max.y - box.min.y );
+
+	// Pyramide de la meme vue : la projection est deja faite
+	if ( _pyramid.viewProjection ( ) == viewProjection ) {
+		return _pyramid.visible ( box );
+	}
+
+	return _pyramid.visible ( model, min, max );
+}
+
+
+void OcclusionCuller::cull ( const OcclusionObject &object, const InstanceBuffer &instances, const glm::mat4 &viewProjection, DrawCommandBuilder &commands ) {
+	auto start = std::chrono::high_resolution_clock::now ( );
+
+	// Suite d'instances visibles consecutives : une seule commande
+	uint32_t runStart = object.baseInstance;
+	uint32_t runCount = 0;
+
+	for ( uint32_t k = object.baseInstance; k < object.baseInstance + object.instanceCount; ++k ) {
+		const glm::mat4 &model = instances.instance ( k ).model;
+
+		bool frustumCulled;
+		float area;
+
+		_stats.objects++;
+
+		// Deja rejetee par l'octree de la scene
+		if ( object.candidates != NULL && object.candidates[k] == 0 ) {
+			_stats.frustumCulled++;
+
+			commands.add ( object.geometry, runCount, runStart );
+			runCount = 0;
+			continue;
+		}
+
+		if ( !visible ( viewProjection, model, object.bbMin, object.bbMax, frustumCulled, area ) ) {
+			if ( frustumCulled ) {
+				_stats.frustumCulled++;
+			}
+			else {
+				_stats.occluded++;
+			}
+
+			commands.add ( object.geometry, runCount, runStart );
+			runCount = 0;
+			continue;
+		}
+
+		if ( object.clusters == NULL || object.clusters->size ( ) < 2 || area < CLUSTER_CULL_MIN_AREA ) {
+			if ( runCount == 0 ) {
+				runStart = k;
+			}
+			runCount++;
+			continue;
+		}
+
+		commands.add ( object.geometry, runCount, runStart );
+		runCount = 0;
+
+		// Grand objet : les clusters visibles consecutifs forment une plage d'indices
+		GeometryAllocation range = object.geometry;
+		range.indexCount = 0;
+
+		for ( uint32_t c = 0; c < object.clusters->size ( ); ++c ) {
+			const MeshCluster &cluster = ( *object.clusters )[c];
+
+			_stats.clusters++;
+
+			if ( !visible ( viewProjection, model, cluster.min, cluster.max, frustumCulled, area ) ) {
+				_stats.clustersCulled++;
+
+				commands.add ( range, 1, k );
+				range.indexCount = 0;
+				continue;
+			}
+
+			if ( range.indexCount == 0 ) {
+				range.firstIndex = object.geometry.firstIndex + cluster.firstIndex;
+			}
+			range.indexCount += cluster.indexCount;
+		}
+
+		commands.add ( range, 1, k );
+	}
+
+	commands.add ( object.geometry, runCount, runStart );
+
+	_stats.ms += std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - start ).count ( );
+}
+
+
+void OcclusionCuller::resetStats ( ) {
+	_stats.objects = 0;
+	_stats.frustumCulled = 0;
+	_stats.occluded = 0;
+	_stats.clusters = 0;
+	_stats.clustersCulled = 0;
+	_stats.occluderTriangles = 0;
+	_stats.ms = 0.0;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "GL/glew.h"
+
+#include "GeometryArena.h"
+#include "HiZ.h"
+#include "Instancing.h"
+
+/////////////////////////////
+// OcclusionSource : where the depth pyramid comes from
+enum OcclusionSource {
+	OCCLUSION_OFF = 0,
+	OCCLUSION_CPU = 1,		// occluders rasterized on the CPU for the current frame
+	OCCLUSION_GPU = 2		// depth buffer of a previous frame, read back asynchronously
+};
+
+/////////////////////////////
+// OcclusionStats : counters of the current frame
+struct OcclusionStats {
+	uint32_t objects;			// instances tested
+	uint32_t frustumCulled;
+	uint32_t occluded;
+	uint32_t clusters;			// clusters tested in the visible instances
+	uint32_t clustersCulled;
+	uint32_t occluderTriangles;
+	double ms;					// CPU time spent rasterizing, building and testing
+};
+
+/////////////////////////////
+// OcclusionObject : the instances of one mesh
+struct OcclusionObject {
+	GeometryAllocation geometry;
+	const std::vector<MeshCluster> *clusters;	// NULL : tested as a whole
+	uint32_t baseInstance;
+	uint32_t instanceCount;
+	glm::vec3 bbMin;
+	glm::vec3 bbMax;
+	const uint8_t *candidates;	// per instance, 0 : already outside the frustum. NULL : all tested
+};
+
+/////////////////////////////
+// OccluderInstance
+struct OccluderInstance {
+	uint32_t occluder;
+	glm::mat4 model;
+};
+
+/////////////////////////////
+// OcclusionCuller
+// Tests the instances, then the clusters of the large ones, against the
+// frustum and a hierarchical Z pyramid, and only emits the visible draws.
+class OcclusionCuller {
+
+public:
+	OcclusionCuller ( );
+	~OcclusionCuller ( );
+
+	// width x height : resolution of the CPU occluder depth buffer
+	void init ( OcclusionSource source, uint32_t width, uint32_t height );
+
+	// The arrays are taken (left empty) when the CPU source needs them, the
+	// other sources never rasterize and keep nothing
+	uint32_t addOccluder ( std::vector<glm::vec3> &positions, std::vector<uint32_t> &indices );
+
+	void release ( );
+
+	// CPU source : draws the occluders seen through viewProjection and rebuilds the pyramid
+	void rasterize ( const glm::mat4 &viewProjection, const OccluderInstance *occluders, uint32_t count );
+
+	// GPU source : reads the depth buffer of the frame just rendered, from
+	// framebuffer (0 : the backbuffer). The pyramid is rebuilt from it two
+	// frames later, without stalling.
+	void readback ( GLsizei width, GLsizei height, const glm::mat4 &viewProjection, GLuint framebuffer = 0 );
+
+	void cull ( const OcclusionObject &object, const InstanceBuffer &instances, const glm::mat4 &viewProjection, DrawCommandBuilder &commands );
+
+	void resetStats ( );
+	const OcclusionStats &stats ( ) const { return _stats; }
+
+	OcclusionSource source ( ) const { return _source; }
+	const DepthPyramid &pyramid ( ) const { return _pyramid; }
+
+private:
+	bool visible ( const glm::mat4 &viewProjection, const glm::mat4 &model, const glm::vec3 &min, const glm::vec3 &max,
+				   bool &frustumCulled, float &area ) const;
+
+	OcclusionSource _source;
+
+	DepthPyramid _pyramid;
+	OccluderRasterizer _rasterizer;
+
+	struct Occluder {
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+	};
+	std::vector<Occluder> _occluders;
+
+	// Double buffered depth read back
+	Buffer _pbos[2];
+	GLsync _fences[2];
+	GLsizei _sizes[2][2];
+	glm::mat4 _matrices[2];
+	uint32_t _frame;
+	std::vector<float> _readback;
+
+	OcclusionStats _stats;
+};
@@ -0,0 +1,221 @@
+#include "ProgressiveMesh.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#define PROGRESSIVE_MAGIC "PMG1"
+#define PROGRESSIVE_VERSION 1
+
+// Cles de cellule sur 21 bits par axe
+#define PROGRESSIVE_MAX_GRID ( 1u << 20 )
+
+#define NO_VERTEX 0xFFFFFFFFu
+
+void ProgressiveMesh::simplify ( Span<const Vector3> positions, Span<const uint32_t> indices, uint32_t grid, MeshLevel &level ) {
+	level.positions.clear ( );
+	level.indices.clear ( );
+
+	Vector3 min, max;
+	Mesh::calculateBounds ( positions, min, max );
+
+	// Cellules cubiques, grid le long du plus grand cote
+	float extent = std::max ( std::max ( max.x - min.x, max.y - min.y ), max.z - min.z );
+	float scale = extent > 0.0f ? grid / extent : 0.0f;
+
+	std::unordered_map<uint64_t, uint32_t> cells;
+	std::vector<uint32_t> remap ( positions.size ( ), NO_VERTEX );
+	std::vector<uint32_t> counts;
+
+	// Seuls les sommets des triangles sont regroupes
+	for ( size_t i = 0; i < indices.size ( ); ++i ) {
+		uint32_t v = indices[i];
+
+		if ( remap[v] != NO_VERTEX ) {
+			continue;
+		}
+
+		const Vector3 &p = positions[v];
+		uint64_t x = std::min ( ( uint32_t ) ( ( p.x - min.x ) * scale ), grid - 1 );
+		uint64_t y = std::min ( ( uint32_t ) ( ( p.y - min.y ) * scale ), grid - 1 );
+		uint64_t z = std::min ( ( uint32_t ) ( ( p.z - min.z ) * scale ), grid - 1 );
+
+		std::pair<std::unordered_map<uint64_t, uint32_t>::iterator, bool> cell = cells.insert ( std::make_pair ( x | ( y << 21 ) | ( z << 42 ),
+																												   ( uint32_t ) counts.size ( ) ) );
+		if ( cell.second ) {
+			level.positions.push_back ( Vector3 ( 0.0f, 0.0f, 0.0f ) );
+			counts.push_back ( 0 );
+		}
+
+		remap[v] = cell.first->second;
+		level.positions[remap[v]] += p;
+		counts[remap[v]]++;
+	}
+
+	for ( uint32_t c = 0; c < counts.size ( ); ++c ) {
+		level.positions[c] /= ( float ) counts[c];
+	}
+
+	for ( size_t t = 0; t + 2 < indices.size ( ); t += 3 ) {
+		uint32_t a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+
+		if ( a != b && b != c && c != a ) {
+			level.indices.push_back ( a );
+			level.indices.push_back ( b );
+			level.indices.push_back ( c );
+		}
+	}
+}
+
+
+void ProgressiveMesh::buildLevels ( Span<const Vector3> positions, Span<const uint32_t> indices, std::vector<MeshLevel> &levels ) {
+	levels.clear ( );
+
+	size_t triangles = indices.size ( ) / 3;
+
+	for ( uint32_t grid = PROGRESSIVE_FIRST_GRID; grid <= PROGRESSIVE_MAX_GRID; grid *= 2 ) {
+		MeshLevel level;
+		simplify ( positions, indices, grid, level );
+
+		if ( level.indices.size ( ) / 3 * 2 > triangles ) {
+			break;
+		}
+
+		levels.push_back ( MeshLevel ( ) );
+		levels.back ( ).positions.swap ( level.positions );
+		levels.back ( ).indices.swap ( level.indices );
+	}
+
+	levels.push_back ( MeshLevel ( ) );
+	levels.back ( ).positions.assign ( positions.data ( ), positions.data ( ) + positions.size ( ) );
+	levels.back ( ).indices.assign ( indices.data ( ), indices.data ( ) + indices.size ( ) );
+}
+
+
+bool ProgressiveMesh::save ( const std::string &fileName, const Mesh &mesh, uint32_t bits, JobSystem *jobs ) {
+	std::vector<uint32_t> triangles;
+	MeshCodec::triangulate ( mesh, triangles );
+
+	std::vector<MeshLevel> levels;
+	buildLevels ( Span<const Vector3> ( mesh._vertices.empty ( ) ? NULL : &mesh._vertices[0], mesh._vertexCount ),
+				  Span<const uint32_t> ( triangles.data ( ), triangles.size ( ) ), levels );
+
+	// Table : offset, taille et triangles de chaque niveau, les niveaux suivent
+	uint32_t levelCount = levels.size ( );
+	std::vector<ProgressiveLevelInfo> table ( levelCount );
+	std::vector<std::vector<uint8_t> > blobs ( levelCount );
+
+	uint64_t offset = 12 + levelCount * sizeof ( ProgressiveLevelInfo );
+
+	for ( uint32_t l = 0; l < levelCount; ++l ) {
+		const MeshLevel &level = levels[l];
+
+		if ( !MeshCodec::encode ( Span<const Vector3> ( level.positions.data ( ), level.positions.size ( ) ),
+								  Span<const uint32_t> ( level.indices.data ( ), level.indices.size ( ) ), blobs[l], bits, MESH_CODEC_CHUNK, jobs ) ) {
+			return false;
+		}
+
+		table[l].offset = offset;
+		table[l].size = blobs[l].size ( );
+		table[l].triangles = level.indices.size ( ) / 3;
+		offset += blobs[l].size ( );
+	}
+
+	FILE *file = fopen ( fileName.c_str ( ), "wb" );
+	if ( file == NULL ) {
+		printf ( "Impossible to open %s\n", fileName.c_str ( ) );
+		return false;
+	}
+
+	uint32_t version = PROGRESSIVE_VERSION;
+	bool ok = fwrite ( PROGRESSIVE_MAGIC, 1, 4, file ) == 4 && fwrite ( &version, sizeof ( version ), 1, file ) == 1 &&
+		fwrite ( &levelCount, sizeof ( levelCount ), 1, file ) == 1 &&
+		fwrite ( table.data ( ), sizeof ( ProgressiveLevelInfo ), levelCount, file ) == levelCount;
+
+	for ( uint32_t l = 0; l < levelCount && ok; ++l ) {
+		ok = fwrite ( blobs[l].data ( ), 1, blobs[l].size ( ), file ) == blobs[l].size ( );
+	}
+
+	fclose ( file );
+
+	return ok;
+}
+
+
+bool ProgressiveMesh::readTable ( const std::string &fileName, std::vector<ProgressiveLevelInfo> &levels ) {
+	FILE *file = fopen ( fileName.c_str ( ), "rb" );
+	if ( file == NULL ) {
+		printf ( "Impossible to open %s\n", fileName.c_str ( ) );
+		return false;
+	}
+
+	fseek ( file, 0, SEEK_END );
+	uint64_t fileSize = ftell ( file );
+	fseek ( file, 0, SEEK_SET );
+
+	char magic[4];
+	uint32_t version = 0, levelCount = 0;
+	bool ok = fread ( magic, 1, 4, file ) == 4 && memcmp ( magic, PROGRESSIVE_MAGIC, 4 ) == 0 &&
+		fread ( &version, sizeof ( version ), 1, file ) == 1 && version == PROGRESSIVE_VERSION &&
+		fread ( &levelCount, sizeof ( levelCount ), 1, file ) == 1 && levelCount > 0 &&
+		levelCount <= ( fileSize - 12 ) / sizeof ( ProgressiveLevelInfo );
+
+	if ( ok ) {
+		levels.resize ( levelCount );
+		ok = fread ( levels.data ( ), sizeof ( ProgressiveLevelInfo ), levelCount, file ) == levelCount;
+	}
+
+	fclose ( file );
+
+	for ( uint32_t l = 0; l < levelCount && ok; ++l ) {
+		ok = levels[l].offset <= fileSize && levels[l].size <= fileSize - levels[l].offset;
+	}
+
+	if ( !ok ) {
+		printf ( "%s is not a valid progressive mesh\n", fileName.c_str ( ) );
+		levels.clear ( );
+	}
+
+	return ok;
+}
+
+
+bool ProgressiveMesh::loadLevel ( const std::string &fileName, const ProgressiveLevelInfo &info, MeshLevel &level, JobSystem *jobs ) {
+	FILE *file = fopen ( fileName.c_str ( ), "rb" );
+	if ( file == NULL ) {
+		printf ( "Impossible to open %s\n", fileName.c_str ( ) );
+		return false;
+	}
+
+	std::vector<uint8_t> data ( info.size );
+	bool ok = fseek ( file, ( long ) info.offset, SEEK_SET ) == 0 && fread ( data.data ( ), 1, data.size ( ), file ) == data.size ( );
+	fclose ( file );
+
+	if ( !ok ) {
+		printf ( "Impossible to read %s\n", fileName.c_str ( ) );
+		return false;
+	}
+
+	return MeshCodec::decode ( Span<const uint8_t> ( data.data ( ), data.size ( ) ), level.positions, level.indices, jobs );
+}
+
+
+void ProgressiveMesh::calculateNormals ( Span<const Vector3> positions, Span<const uint32_t> indices, std::vector<Vector3> &normals ) {
+	normals.assign ( positions.size ( ), Vector3 ( 0.0f, 0.0f, 0.0f ) );
+
+	// Le produit vectoriel non normalise pondere par l'aire
+	for ( size_t t = 0; t + 2 < indices.size ( ); t += 3 ) {
+		const Vector3 &a = positions[indices[t]], &b = positions[indices[t + 1]], &c = positions[indices[t + 2]];
+		Vector3 n = glm::cross ( b - a, c - a );
+
+		normals[indices[t]] += n;
+		normals[indices[t + 1]] += n;
+		normals[indices[t + 2]] += n;
+	}
+
+	for ( size_t v = 0; v < normals.size ( ); ++v ) {
+		float length = glm::length ( normals[v] );
+		normals[v] = length > 0.0f ? normals[v] / length : Vector3 ( 0.0f, 1.0f, 0.0f );
+	}
+}
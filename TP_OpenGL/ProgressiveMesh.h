@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "Mesh.h"
+#include "MeshCodec.h"
+#include "Span.h"
+
+class JobSystem;
+
+// Clustering grid of the coarsest level, cells along the largest side
+#define PROGRESSIVE_FIRST_GRID 16
+
+/////////////////////////////
+// MeshLevel : one level of detail as a triangle list
+struct MeshLevel {
+	std::vector<Vector3> positions;
+	std::vector<uint32_t> indices;
+};
+
+/////////////////////////////
+// ProgressiveLevelInfo : where a level is in a .pmg file
+struct ProgressiveLevelInfo {
+	uint64_t offset;
+	uint32_t size;
+	uint32_t triangles;
+};
+
+/////////////////////////////
+// ProgressiveMesh
+// Levels of detail of a mesh, built by vertex clustering on grids twice as
+// fine each time, up to the mesh itself. A .pmg file stores them from coarse
+// to fine, each one compressed by MeshCodec : a reader draws the first level
+// after a few kilobytes and refines while the next ones arrive.
+class ProgressiveMesh {
+
+public:
+	// The vertices of a grid cell merge on their mean, the collapsed triangles are dropped
+	static void simplify ( Span<const Vector3> positions, Span<const uint32_t> indices, uint32_t grid, MeshLevel &level );
+
+	// Coarse to full : a level is kept while it has less than half of the triangles
+	static void buildLevels ( Span<const Vector3> positions, Span<const uint32_t> indices, std::vector<MeshLevel> &levels );
+
+	// Written as the renderer sees the mesh : centered and normalized
+	static bool save ( const std::string &fileName, const Mesh &mesh, uint32_t bits = MESH_CODEC_BITS, JobSystem *jobs = NULL );
+
+	static bool readTable ( const std::string &fileName, std::vector<ProgressiveLevelInfo> &levels );
+
+	// Reads and decodes a single level
+	static bool loadLevel ( const std::string &fileName, const ProgressiveLevelInfo &info, MeshLevel &level, JobSystem *jobs = NULL );
+
+	// Area weighted mean of the face normals around each vertex
+	static void calculateNormals ( Span<const Vector3> positions, Span<const uint32_t> indices, std::vector<Vector3> &normals );
+};
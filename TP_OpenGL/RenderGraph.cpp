@@ -0,0 +1,351 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <iostream>
+
+RenderGraph::RenderGraph ( ) :
+	_width ( 0 ),
+	_height ( 0 ) {
+	RenderResource backbuffer;
+	backbuffer.name = "backbuffer";
+	backbuffer.transient = false;
+	backbuffer.desc.format = GL_NONE;
+	backbuffer.desc.width = backbuffer.desc.height = 0;
+	backbuffer.texture = 0;
+
+	_resources.push_back ( backbuffer );
+}
+
+
+RenderGraph::~RenderGraph ( ) {
+}
+
+
+uint32_t RenderGraph::importTexture ( const std::string &name, GLuint texture ) {
+	RenderResource resource;
+	resource.name = name;
+	resource.transient = false;
+	resource.desc.format = GL_NONE;
+	resource.desc.width = resource.desc.height = 0;
+	resource.texture = texture;
+
+	_resources.push_back ( resource );
+
+	return _resources.size ( ) - 1;
+}
+
+
+uint32_t RenderGraph::createTexture ( const std::string &name, const RenderTextureDesc &desc ) {
+	RenderResource resource;
+	resource.name = name;
+	resource.transient = true;
+	resource.desc = desc;
+	resource.texture = 0;
+
+	_resources.push_back ( resource );
+
+	return _resources.size ( ) - 1;
+}
+
+
+uint32_t RenderGraph::addPass ( const std::string &name, const std::vector<uint32_t> &reads, const std::vector<uint32_t> &writes,
+								bool clears, std::function<void ( GLStateCache & )> execute ) {
+	RenderPass pass;
+	pass.name = name;
+	pass.reads = reads;
+	pass.writes = writes;
+	pass.clears = clears;
+	pass.execute = execute;
+	pass.culled = false;
+	pass.fbo = 0;
+
+	_passes.push_back ( pass );
+
+	return _passes.size ( ) - 1;
+}
+
+
+// Tri topologique stable : un lecteur passe apres les ecrivains de ce qu'il
+// lit, les ecrivains d'une meme ressource gardent l'ordre de declaration
+void RenderGraph::sort ( ) {
+	uint32_t count = _passes.size ( );
+
+	std::vector<std::vector<uint32_t> > next ( count );
+	std::vector<uint32_t> incoming ( count, 0 );
+
+	for ( uint32_t r = 0; r < _resources.size ( ); ++r ) {
+		std::vector<uint32_t> writers;
+
+		for ( uint32_t p = 0; p < count; ++p ) {
+			if ( std::find ( _passes[p].writes.begin ( ), _passes[p].writes.end ( ), r ) != _passes[p].writes.end ( ) ) {
+				writers.push_back ( p );
+			}
+		}
+
+		for ( uint32_t w = 1; w < writers.size ( ); ++w ) {
+			next[writers[w - 1]].push_back ( writers[w] );
+		}
+
+		for ( uint32_t p = 0; p < count; ++p ) {
+			const std::vector<uint32_t> &reads = _passes[p].reads;
+
+			if ( std::find ( reads.begin ( ), reads.end ( ), r ) == reads.end ( ) ) {
+				continue;
+			}
+
+			for ( uint32_t w = 0; w < writers.size ( ); ++w ) {
+				if ( writers[w] != p ) {
+					next[writers[w]].push_back ( p );
+				}
+			}
+		}
+	}
+
+	for ( uint32_t p = 0; p < count; ++p ) {
+		for ( uint32_t n = 0; n < next[p].size ( ); ++n ) {
+			incoming[next[p][n]]++;
+		}
+	}
+
+	_order.clear ( );
+	std::vector<bool> done ( count, false );
+
+	while ( _order.size ( ) < count ) {
+		uint32_t p = 0;
+		while ( p < count && ( done[p] || incoming[p] > 0 ) ) {
+			p++;
+		}
+
+		if ( p == count ) {
+			std::cerr << "Render graph: dependency cycle" << std::endl;
+			exit ( -1 );
+		}
+
+		done[p] = true;
+		_order.push_back ( p );
+
+		for ( uint32_t n = 0; n < next[p].size ( ); ++n ) {
+			incoming[next[p][n]]--;
+		}
+	}
+}
+
+
+// Remonte depuis le backbuffer : une passe n'est gardee que si l'une de ses
+// sorties est encore necessaire apres elle
+void RenderGraph::cull ( ) {
+	std::vector<bool> needed ( _resources.size ( ), false );
+	needed[RENDER_BACKBUFFER] = true;
+
+	for ( int i = _order.size ( ) - 1; i >= 0; --i ) {
+		RenderPass &pass = _passes[_order[i]];
+
+		pass.culled = true;
+		for ( uint32_t w = 0; w < pass.writes.size ( ); ++w ) {
+			if ( needed[pass.writes[w]] ) {
+				pass.culled = false;
+			}
+		}
+
+		if ( pass.culled ) {
+			continue;
+		}
+
+		// Sans clear, la passe part du contenu de ses sorties : leurs
+		// ecrivains precedents sont necessaires
+		for ( uint32_t w = 0; w < pass.writes.size ( ); ++w ) {
+			needed[pass.writes[w]] = !pass.clears;
+		}
+
+		for ( uint32_t r = 0; r < pass.reads.size ( ); ++r ) {
+			needed[pass.reads[r]] = true;
+		}
+	}
+}
+
+
+// Les transients dont les durees de vie sont disjointes partagent une texture
+void RenderGraph::alias ( ) {
+	std::vector<int> first ( _resources.size ( ), -1 );
+	std::vector<int> last ( _resources.size ( ), -1 );
+
+	for ( uint32_t i = 0; i < _order.size ( ); ++i ) {
+		const RenderPass &pass = _passes[_order[i]];
+
+		if ( pass.culled ) {
+			continue;
+		}
+
+		std::vector<uint32_t> used = pass.reads;
+		used.insert ( used.end ( ), pass.writes.begin ( ), pass.writes.end ( ) );
+
+		for ( uint32_t u = 0; u < used.size ( ); ++u ) {
+			if ( first[used[u]] < 0 ) {
+				first[used[u]] = i;
+			}
+			last[used[u]] = i;
+		}
+	}
+
+	std::vector<RenderTextureDesc> descs;
+	std::vector<int> busyUntil;
+
+	for ( uint32_t i = 0; i < _order.size ( ); ++i ) {
+		for ( uint32_t r = 0; r < _resources.size ( ); ++r ) {
+			RenderResource &resource = _resources[r];
+
+			if ( !resource.transient || first[r] != ( int ) i ) {
+				continue;
+			}
+
+			uint32_t t = 0;
+			while ( t < _textures.size ( ) && !( descs[t] == resource.desc && busyUntil[t] < ( int ) i ) ) {
+				t++;
+			}
+
+			if ( t == _textures.size ( ) ) {
+				GLsizei width = resource.desc.width > 0 ? resource.desc.width : _width;
+				GLsizei height = resource.desc.height > 0 ? resource.desc.height : _height;
+
+				_textures.push_back ( ::createTexture ( GL_TEXTURE_2D ) );
+				glTextureStorage2D ( _textures.back ( ).id ( ), 1, resource.desc.format, width, height );
+
+				descs.push_back ( resource.desc );
+				busyUntil.push_back ( -1 );
+			}
+
+			resource.texture = _textures[t].id ( );
+			busyUntil[t] = last[r];
+		}
+	}
+}
+
+
+void RenderGraph::compile ( ) {
+	sort ( );
+	cull ( );
+}
+
+
+void RenderGraph::resize ( GLsizei width, GLsizei height ) {
+	if ( width == _width && height == _height ) {
+		return;
+	}
+
+	// Le GPU garde les anciennes textures tant qu'il en a besoin
+	release ( );
+
+	_width = width;
+	_height = height;
+
+	alias ( );
+	createFramebuffers ( );
+}
+
+
+// Framebuffer des passes qui n'ecrivent que dans des transients
+void RenderGraph::createFramebuffers ( ) {
+	for ( uint32_t p = 0; p < _passes.size ( ); ++p ) {
+		RenderPass &pass = _passes[p];
+
+		if ( pass.culled || pass.writes.empty ( ) ) {
+			continue;
+		}
+
+		bool transient = true;
+		for ( uint32_t w = 0; w < pass.writes.size ( ); ++w ) {
+			transient = transient && _resources[pass.writes[w]].transient;
+		}
+
+		if ( !transient ) {
+			continue;
+		}
+
+		_framebuffers.push_back ( createFramebuffer ( ) );
+		pass.fbo = _framebuffers.back ( ).id ( );
+
+		std::vector<GLenum> colors;
+
+		for ( uint32_t w = 0; w < pass.writes.size ( ); ++w ) {
+			const RenderResource &resource = _resources[pass.writes[w]];
+			GLenum format = resource.desc.format;
+
+			if ( format == GL_DEPTH_COMPONENT32F || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT16 ) {
+				glNamedFramebufferTexture ( pass.fbo, GL_DEPTH_ATTACHMENT, resource.texture, 0 );
+			}
+			else {
+				colors.push_back ( GL_COLOR_ATTACHMENT0 + colors.size ( ) );
+				glNamedFramebufferTexture ( pass.fbo, colors.back ( ), resource.texture, 0 );
+			}
+		}
+
+		if ( colors.empty ( ) ) {
+			glNamedFramebufferDrawBuffer ( pass.fbo, GL_NONE );
+		}
+		else {
+			glNamedFramebufferDrawBuffers ( pass.fbo, colors.size ( ), &colors[0] );
+		}
+
+		GLenum Status = glCheckNamedFramebufferStatus ( pass.fbo, GL_DRAW_FRAMEBUFFER );
+
+		if ( Status != GL_FRAMEBUFFER_COMPLETE ) {
+			printf ( "FB error, status: 0x%x\n", Status );
+			exit ( -1 );
+		}
+	}
+}
+
+
+void RenderGraph::execute ( GLStateCache &state ) {
+	for ( uint32_t i = 0; i < _order.size ( ); ++i ) {
+		RenderPass &pass = _passes[_order[i]];
+
+		if ( pass.culled ) {
+			continue;
+		}
+
+		if ( std::find ( pass.writes.begin ( ), pass.writes.end ( ), ( uint32_t ) RENDER_BACKBUFFER ) != pass.writes.end ( ) ) {
+			state.bindFramebuffer ( 0 );
+		}
+		else if ( pass.fbo != 0 ) {
+			state.bindFramebuffer ( pass.fbo );
+		}
+
+		pass.execute ( state );
+	}
+}
+
+
+void RenderGraph::release ( ) {
+	for ( uint32_t r = 0; r < _resources.size ( ); ++r ) {
+		if ( _resources[r].transient ) {
+			_resources[r].texture = 0;
+		}
+	}
+
+	for ( uint32_t p = 0; p < _passes.size ( ); ++p ) {
+		_passes[p].fbo = 0;
+	}
+
+	_textures.clear ( );
+	_framebuffers.clear ( );
+	_width = _height = 0;
+}
+
+
+void RenderGraph::print ( ) const {
+	std::cout << "Render graph:\n";
+
+	for ( uint32_t i = 0; i < _order.size ( ); ++i ) {
+		const RenderPass &pass = _passes[_order[i]];
+
+		std::cout << "  " << i << ". " << pass.name << ( pass.culled ? " (culled)" : "" ) << std::endl;
+	}
+
+	uint32_t transients = 0;
+	for ( uint32_t r = 0; r < _resources.size ( ); ++r ) {
+		transients += _resources[r].transient ? 1 : 0;
+	}
+
+	std::cout << "  " << transients << " transient textures in " << _textures.size ( ) << " allocations" << std::endl;
+}
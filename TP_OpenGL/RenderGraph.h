@@ -0,0 +1,109 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "GL/glew.h"
+
+#include "GLState.h"
+#include "GpuResource.h"
+
+#define RENDER_BACKBUFFER 0
+
+/////////////////////////////
+// RenderTextureDesc : a size of 0 x 0 follows the backbuffer (RenderGraph::resize)
+struct RenderTextureDesc {
+	GLenum format;
+	GLsizei width;
+	GLsizei height;
+
+	bool operator==( const RenderTextureDesc &d ) const {
+		return format == d.format && width == d.width && height == d.height;
+	}
+};
+
+/////////////////////////////
+// RenderResource
+struct RenderResource {
+	std::string name;
+
+	// Transient textures are created by the graph and may share memory
+	// with other transients whose lifetimes do not overlap
+	bool transient;
+	RenderTextureDesc desc;
+	GLuint texture;
+};
+
+/////////////////////////////
+// RenderPass
+struct RenderPass {
+	std::string name;
+	std::vector<uint32_t> reads;
+	std::vector<uint32_t> writes;
+
+	// The pass overwrites its outputs entirely : earlier writers are not
+	// needed. Otherwise it draws over all of them, as if it read them
+	bool clears;
+
+	std::function<void ( GLStateCache & )> execute;
+
+	bool culled;
+	GLuint fbo;
+};
+
+/////////////////////////////
+// RenderGraph
+// Passes declare the textures they sample and the attachments they write.
+// compile() orders them and drops the ones whose outputs never reach the
+// backbuffer. resize() then aliases the transient attachments of the kept
+// passes and makes a framebuffer for each pass writing only transients,
+// which execute() binds before the pass.
+class RenderGraph {
+
+public:
+	RenderGraph ( );
+	~RenderGraph ( );
+
+	// Resource 0 is the backbuffer
+	uint32_t importTexture ( const std::string &name, GLuint texture );
+	uint32_t createTexture ( const std::string &name, const RenderTextureDesc &desc );
+
+	uint32_t addPass ( const std::string &name, const std::vector<uint32_t> &reads, const std::vector<uint32_t> &writes,
+					   bool clears, std::function<void ( GLStateCache & )> execute );
+
+	void compile ( );
+
+	// Size of the backbuffer : the textures and framebuffers are made again
+	// when it changes. Called before execute(), every frame
+	void resize ( GLsizei width, GLsizei height );
+
+	void execute ( GLStateCache &state );
+
+	// Deletes the textures and framebuffers created by resize()
+	void release ( );
+
+	GLuint texture ( uint32_t resource ) const { return _resources[resource].texture; }
+
+	// 0 when the pass is culled or writes the backbuffer
+	GLuint framebuffer ( uint32_t pass ) const { return _passes[pass].fbo; }
+
+	void print ( ) const;
+
+private:
+	void sort ( );
+	void cull ( );
+	void alias ( );
+	void createFramebuffers ( );
+
+	std::vector<RenderResource> _resources;
+	std::vector<RenderPass> _passes;
+	std::vector<uint32_t> _order;
+
+	// Physical textures backing the transient resources, and the pass framebuffers
+	std::vector<Texture> _textures;
+	std::vector<Framebuffer> _framebuffers;
+	GLsizei _width;
+	GLsizei _height;
+};
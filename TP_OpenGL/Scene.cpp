@@ -0,0 +1,348 @@
+#include "Scene.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+Scene::Scene ( ) :
+	_declaredNodes ( 0 ) {
+}
+
+
+Scene::~Scene ( ) {
+}
+
+
+void Scene::clear ( ) {
+	_meshes.clear ( );
+	_lights.clear ( );
+	_nodes.clear ( );
+	_grids.clear ( );
+	_declaredNodes = 0;
+}
+
+
+// Trois flottants, faux si la ligne s'arrete avant
+static bool readVector ( std::istringstream &line, glm::vec3 &v ) {
+	return !!( line >> v.x >> v.y >> v.z );
+}
+
+
+bool Scene::load ( const std::string &fileName ) {
+	std::ifstream file ( fileName );
+
+	if ( !file.is_open ( ) ) {
+		printf ( "Impossible to open the scene %s\n", fileName.c_str ( ) );
+		return false;
+	}
+
+	clear ( );
+
+	// Les parents sont cherches par nom : une table pour les grosses scenes
+	std::unordered_map<std::string, uint32_t> names;
+
+	std::string text;
+	uint32_t lineNumber = 0;
+
+	while ( std::getline ( file, text ) ) {
+		lineNumber++;
+
+		size_t comment = text.find ( '#' );
+		if ( comment != std::string::npos ) {
+			text.resize ( comment );
+		}
+
+		std::istringstream line ( text );
+		std::string statement;
+
+		if ( !( line >> statement ) ) {
+			continue;
+		}
+
+		bool ok = true;
+
+		if ( statement == "mesh" ) {
+			SceneMesh mesh;
+			mesh.scale = glm::vec3 ( 1.0f, 1.0f, 1.0f );
+			mesh.translate = glm::vec3 ( 0.0f, 0.0f, 0.0f );
+			mesh.trianglesPerCluster = 128;
+			mesh.occluder = false;
+			mesh.spin = 0.0f;
+			mesh.deform = 0.0f;
+
+			ok = !!( line >> mesh.name >> mesh.file );
+
+			std::string key;
+			while ( ok && line >> key ) {
+				if ( key == "scale" )				ok = readVector ( line, mesh.scale );
+				else if ( key == "translate" )		ok = readVector ( line, mesh.translate );
+				else if ( key == "clusters" )		ok = !!( line >> mesh.trianglesPerCluster );
+				else if ( key == "occluder" )		mesh.occluder = true;
+				else if ( key == "dynamic" )		ok = !!( line >> mesh.spin );
+				else if ( key == "deform" )			ok = !!( line >> mesh.deform );
+				else								ok = false;
+			}
+
+			if ( ok ) {
+				addMesh ( mesh );
+			}
+		}
+		else if ( statement == "light" ) {
+			SceneLight light;
+			light.color = glm::vec3 ( 1.0f, 1.0f, 1.0f );
+			light.radius = 5.0f;
+			light.intensity = 10.0f;
+
+			ok = readVector ( line, light.position );
+
+			std::string key;
+			while ( ok && line >> key ) {
+				if ( key == "color" )				ok = readVector ( line, light.color );
+				else if ( key == "radius" )			ok = !!( line >> light.radius );
+				else if ( key == "intensity" )		ok = !!( line >> light.intensity );
+				else								ok = false;
+			}
+
+			if ( ok ) {
+				_lights.push_back ( light );
+			}
+		}
+		else if ( statement == "node" ) {
+			std::string name, parentName, meshName;
+			glm::vec3 color ( 1.0f, 1.0f, 1.0f ), translate ( 0.0f, 0.0f, 0.0f ), scale ( 1.0f, 1.0f, 1.0f ), axis ( 0.0f, 1.0f, 0.0f );
+			float degrees = 0.0f, spin = 0.0f;
+
+			ok = !!( line >> name >> parentName );
+
+			std::string key;
+			while ( ok && line >> key ) {
+				if ( key == "mesh" )				ok = !!( line >> meshName );
+				else if ( key == "color" )			ok = readVector ( line, color );
+				else if ( key == "translate" )		ok = readVector ( line, translate );
+				else if ( key == "rotate" )			ok = !!( line >> degrees ) && readVector ( line, axis );
+				else if ( key == "scale" )			ok = readVector ( line, scale );
+				else if ( key == "spin" )			ok = !!( line >> spin );
+				else								ok = false;
+			}
+
+			uint32_t parent = SCENE_NONE;
+			uint32_t mesh = SCENE_NONE;
+
+			if ( ok && parentName != "-" ) {
+				std::unordered_map<std::string, uint32_t>::const_iterator it = names.find ( parentName );
+				ok = it != names.end ( );
+				parent = ok ? it->second : SCENE_NONE;
+			}
+
+			if ( ok && !meshName.empty ( ) ) {
+				mesh = findMesh ( meshName );
+				ok = mesh != SCENE_NONE;
+			}
+
+			if ( ok ) {
+				glm::mat4 local = glm::translate ( glm::mat4 ( 1.0f ), translate );
+				local = glm::rotate ( local, glm::radians ( degrees ), axis );
+				local = glm::scale ( local, scale );
+
+				uint32_t id = addNode ( name, parent, mesh, local, color );
+				_nodes[id].spin = spin;
+
+				names[name] = id;
+			}
+		}
+		else if ( statement == "grid" ) {
+			std::string meshName, parentName;
+			SceneGrid grid;
+			grid.color = glm::vec3 ( 1.0f, 1.0f, 1.0f );
+
+			ok = !!( line >> meshName >> parentName >> grid.count >> grid.extent );
+
+			std::string key;
+			while ( ok && line >> key ) {
+				if ( key == "color" )				ok = readVector ( line, grid.color );
+				else								ok = false;
+			}
+
+			grid.mesh = ok ? findMesh ( meshName ) : SCENE_NONE;
+			grid.parent = SCENE_NONE;
+			ok = ok && grid.mesh != SCENE_NONE;
+
+			if ( ok && parentName != "-" ) {
+				std::unordered_map<std::string, uint32_t>::const_iterator it = names.find ( parentName );
+				ok = it != names.end ( );
+				grid.parent = ok ? it->second : SCENE_NONE;
+			}
+
+			if ( ok ) {
+				_grids.push_back ( grid );
+			}
+		}
+		else {
+			ok = false;
+		}
+
+		if ( !ok ) {
+			printf ( "%s:%u: invalid statement '%s'\n", fileName.c_str ( ), lineNumber, text.c_str ( ) );
+			clear ( );
+			return false;
+		}
+	}
+
+	_declaredNodes = _nodes.size ( );
+	setGridCount ( 0 );
+
+	return true;
+}
+
+
+uint32_t Scene::addMesh ( const SceneMesh &mesh ) {
+	_meshes.push_back ( mesh );
+
+	return _meshes.size ( ) - 1;
+}
+
+
+uint32_t Scene::addNode ( const std::string &name, uint32_t parent, uint32_t mesh, const glm::mat4 &local, const glm::vec3 &color ) {
+	SceneNode node;
+	node.name = name;
+	node.parent = parent;
+	node.mesh = mesh;
+	node.color = color;
+	node.local = local;
+	node.world = local;
+	node.dirty = true;
+	node.spin = 0.0f;
+	node.angle = 0.0f;
+	node.base = local;
+
+	_nodes.push_back ( node );
+
+	return _nodes.size ( ) - 1;
+}
+
+
+uint32_t Scene::findMesh ( const std::string &name ) const {
+	for ( uint32_t i = 0; i < _meshes.size ( ); ++i ) {
+		if ( _meshes[i].name == name ) {
+			return i;
+		}
+	}
+
+	return SCENE_NONE;
+}
+
+
+uint32_t Scene::findNode ( const std::string &name ) const {
+	for ( uint32_t i = 0; i < _nodes.size ( ); ++i ) {
+		if ( _nodes[i].name == name ) {
+			return i;
+		}
+	}
+
+	return SCENE_NONE;
+}
+
+
+void Scene::setGridCount ( uint32_t count ) {
+	_nodes.resize ( _declaredNodes );
+
+	for ( uint32_t g = 0; g < _grids.size ( ); ++g ) {
+		generateGrid ( _grids[g], count > 0 ? count : _grids[g].count );
+	}
+}
+
+
+// Meme disposition que l'ancienne grille de copies : une seule copie est centree
+void Scene::generateGrid ( const SceneGrid &grid, uint32_t count ) {
+	uint32_t side = 1;
+	while ( side * side < count ) {
+		side++;
+	}
+
+	float spacing = grid.extent / side;
+	float scale = 1.0f / side;
+	float half = grid.extent * 0.5f;
+
+	_nodes.reserve ( _nodes.size ( ) + count );
+
+	for ( uint32_t i = 0; i < count; ++i ) {
+		float x = ( i % side + 0.5f ) * spacing - half;
+		float z = ( i / side + 0.5f ) * spacing - half;
+
+		if ( count == 1 ) {
+			x = z = 0.0f;
+		}
+
+		glm::mat4 local = glm::translate ( glm::mat4 ( 1.0f ), glm::vec3 ( x, 0.0f, z ) );
+		local = glm::scale ( local, glm::vec3 ( scale, scale, scale ) );
+
+		addNode ( "", grid.parent, grid.mesh, local, grid.color );
+	}
+}
+
+
+void Scene::setLocal ( uint32_t node, const glm::mat4 &local ) {
+	_nodes[node].local = local;
+	_nodes[node].base = local;
+	_nodes[node].angle = 0.0f;
+	_nodes[node].dirty = true;
+}
+
+
+void Scene::animate ( double dt ) {
+	for ( uint32_t i = 0; i < _nodes.size ( ); ++i ) {
+		SceneNode &node = _nodes[i];
+
+		if ( node.spin == 0.0f ) {
+			continue;
+		}
+
+		node.angle += ( float ) ( node.spin * dt );
+		node.local = glm::rotate ( node.base, node.angle, glm::vec3 ( 0.0f, 1.0f, 0.0f ) );
+		node.dirty = true;
+	}
+}
+
+
+uint32_t Scene::updateTransforms ( std::vector<uint32_t> *changed ) {
+	_updated.assign ( _nodes.size ( ), 0 );
+
+	uint32_t count = 0;
+
+	// Parents avant enfants : le monde du parent est deja a jour
+	for ( uint32_t i = 0; i < _nodes.size ( ); ++i ) {
+		SceneNode &node = _nodes[i];
+
+		bool parentUpdated = node.parent != SCENE_NONE && _updated[node.parent];
+
+		if ( !node.dirty && !parentUpdated ) {
+			continue;
+		}
+
+		node.world = node.parent != SCENE_NONE ? _nodes[node.parent].world * node.local : node.local;
+		node.dirty = false;
+
+		_updated[i] = 1;
+		count++;
+
+		if ( changed != NULL ) {
+			changed->push_back ( i );
+		}
+	}
+
+	return count;
+}
+
+
+bool Scene::animated ( uint32_t node ) const {
+	for ( uint32_t i = node; i != SCENE_NONE; i = _nodes[i].parent ) {
+		if ( _nodes[i].spin != 0.0f ) {
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+// CPU side of the scene : no GL call in here
+
+#define SCENE_NONE 0xFFFFFFFFu
+
+/////////////////////////////
+// SceneMesh : a model file and the transform applied when it is loaded
+struct SceneMesh {
+	std::string name;
+	std::string file;
+	glm::vec3 scale;
+	glm::vec3 translate;
+	uint32_t trianglesPerCluster;
+	bool occluder;			// always rasterized by the CPU occlusion culling
+	float spin;				// radians per second of its vertices around y, rewritten and
+							// streamed every frame. 0 : static, in the geometry arena
+	float deform;			// amplitude of a wave along the normals, streamed too. Its
+							// normals and bounds are recomputed every frame
+};
+
+/////////////////////////////
+// SceneLight
+// The first light casts the shadow, the others are point lights without
+// shadow, shaded through the light clusters
+struct SceneLight {
+	glm::vec3 position;
+	glm::vec3 color;
+	float radius;			// no light beyond
+	float intensity;
+};
+
+/////////////////////////////
+// SceneNode
+// The world transform is parent world * local. Nodes are stored parents
+// first, so that one pass in order propagates the changes.
+struct SceneNode {
+	std::string name;
+	uint32_t parent;		// SCENE_NONE for a root
+	uint32_t mesh;			// SCENE_NONE for a pure transform
+	glm::vec3 color;
+
+	glm::mat4 local;
+	glm::mat4 world;
+	bool dirty;				// local changed since the last update
+
+	float spin;				// radians per second around the local y axis, 0 : static
+	float angle;
+	glm::mat4 base;			// local transform without the spin
+};
+
+/////////////////////////////
+// SceneGrid : copies of a mesh laid out on a square grid, generated after the declared nodes
+struct SceneGrid {
+	uint32_t mesh;
+	uint32_t parent;
+	uint32_t count;
+	float extent;			// side of the square covered by the grid
+	glm::vec3 color;
+};
+
+/////////////////////////////
+// Scene
+// Text file, one statement per line, '#' starts a comment :
+//   mesh <name> <file> [scale x y z] [translate x y z] [clusters n] [occluder] [dynamic radians/s] [deform amplitude]
+//   light <x> <y> <z> [color r g b] [radius r] [intensity i]
+//   node <name> <parent|-> [mesh <name>] [color r g b] [translate x y z]
+//        [rotate degrees x y z] [scale x y z] [spin radians/s]
+//   grid <mesh> <parent|-> <count> <extent> [color r g b]
+class Scene {
+
+public:
+	Scene ( );
+	~Scene ( );
+
+	bool load ( const std::string &fileName );
+	void clear ( );
+
+	uint32_t addMesh ( const SceneMesh &mesh );
+	uint32_t addNode ( const std::string &name, uint32_t parent, uint32_t mesh, const glm::mat4 &local, const glm::vec3 &color );
+	uint32_t findMesh ( const std::string &name ) const;
+	uint32_t findNode ( const std::string &name ) const;
+
+	// Regenerates the grid nodes, count copies each (0 : the count of the file)
+	void setGridCount ( uint32_t count );
+
+	void setLocal ( uint32_t node, const glm::mat4 &local );
+
+	// Turns the spinning nodes, their subtrees become dirty
+	void animate ( double dt );
+
+	// Recomputes the world transform of the dirty nodes and of their
+	// descendants, appends their ids to changed (optional) and returns their count
+	uint32_t updateTransforms ( std::vector<uint32_t> *changed = NULL );
+
+	const std::vector<SceneMesh> &meshes ( ) const { return _meshes; }
+	const std::vector<SceneLight> &lights ( ) const { return _lights; }
+	const std::vector<SceneNode> &nodes ( ) const { return _nodes; }
+	const SceneNode &node ( uint32_t id ) const { return _nodes[id]; }
+	uint32_t nodeCount ( ) const { return _nodes.size ( ); }
+
+	// True when the node or one of its ancestors spins
+	bool animated ( uint32_t node ) const;
+
+private:
+	void generateGrid ( const SceneGrid &grid, uint32_t count );
+
+	std::vector<SceneMesh> _meshes;
+	std::vector<SceneLight> _lights;
+	std::vector<SceneNode> _nodes;
+	std::vector<SceneGrid> _grids;
+
+	uint32_t _declaredNodes;	// nodes of the file, the grid copies follow
+	std::vector<uint8_t> _updated;
+};
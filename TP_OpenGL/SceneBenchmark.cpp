@@ -0,0 +1,346 @@
+#include "SceneBenchmark.h"
+#include "LinearArena.h"
+#include "LooseOctree.h"
+#include "Scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// Copies of each grid of the scene
+#define BENCH_SCENE_GRID 64
+
+// Cameras of each octree query
+#define BENCH_SCENE_VIEWS 16
+
+// Racine de l'octree, les boites debordent autour
+#define BENCH_SCENE_ROOT 40.0f
+#define BENCH_SCENE_SPREAD 50.0f
+
+// The checks of the scene graph
+struct SceneCounts {
+	uint32_t nodes;
+	uint32_t depth;			// of the deepest node, 0 for a root
+	uint32_t moved;			// nodes given a new local transform
+	uint32_t updated;		// nodes reported by updateTransforms after them
+	uint32_t wrongUpdates;	// reports that are not the subtree of the moved node
+	uint32_t wrongWorlds;	// world transforms that are not parent world * local
+};
+
+// The queries of one state of the octree
+struct OctreePhase {
+	const char *name;
+	uint32_t objects;
+	uint32_t visible;		// over all the views
+	uint32_t wrongViews;	// query differs from the brute force
+	uint32_t nodesVisited;
+	uint32_t objectsTested;
+	double octreeMs;
+	double bruteForceMs;
+};
+
+// Tirage reproductible : le meme nuage de boites a chaque execution
+static float random01 ( uint32_t &state ) {
+	state = state * 1664525u + 1013904223u;
+	return ( state >> 8 ) * ( 1.0f / 16777216.0f );
+}
+
+
+static bool descendsFrom ( const Scene &scene, uint32_t node, uint32_t ancestor ) {
+	for ( uint32_t i = node; i != SCENE_NONE; i = scene.node ( i ).parent ) {
+		if ( i == ancestor ) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+static uint32_t checkWorlds ( const Scene &scene ) {
+	uint32_t wrong = 0;
+
+	for ( uint32_t i = 0; i < scene.nodeCount ( ); ++i ) {
+		const SceneNode &node = scene.node ( i );
+		glm::mat4 expected = node.parent != SCENE_NONE ? scene.node ( node.parent ).world * node.local : node.local;
+
+		float error = 0.0f;
+		for ( uint32_t c = 0; c < 4; ++c ) {
+			for ( uint32_t r = 0; r < 4; ++r ) {
+				error = std::max ( error, std::fabs ( node.world[c][r] - expected[c][r] ) );
+			}
+		}
+
+		wrong += error > 1e-5f;
+	}
+
+	return wrong;
+}
+
+
+static bool checkTransforms ( Scene &scene, SceneCounts &counts ) {
+	bool ok = true;
+
+	scene.setGridCount ( BENCH_SCENE_GRID );
+
+	counts = SceneCounts ( );
+	counts.nodes = scene.nodeCount ( );
+
+	// Parents avant enfants, sinon une passe ne suffit pas
+	for ( uint32_t i = 0; i < scene.nodeCount ( ); ++i ) {
+		uint32_t parent = scene.node ( i ).parent;
+
+		if ( parent != SCENE_NONE && parent >= i ) {
+			fprintf ( stderr, "Scene: the node %u is stored before its parent %u\n", i, parent );
+			return false;
+		}
+
+		uint32_t depth = 0;
+		for ( uint32_t p = parent; p != SCENE_NONE; p = scene.node ( p ).parent ) {
+			depth++;
+		}
+
+		counts.depth = std::max ( counts.depth, depth );
+	}
+
+	if ( counts.depth < 2 ) {
+		fprintf ( stderr, "Scene: no node of the scene has a grandparent\n" );
+		ok = false;
+	}
+
+	// Tout est neuf au chargement, puis plus rien ne change
+	std::vector<uint32_t> changed;
+
+	if ( scene.updateTransforms ( &changed ) != scene.nodeCount ( ) || scene.updateTransforms ( ) != 0 ) {
+		fprintf ( stderr, "Scene: the first update does not cover every node exactly once\n" );
+		ok = false;
+	}
+
+	std::vector<uint32_t> expected;
+
+	// Chaque noeud a son tour : exactement son sous-arbre est recalcule
+	for ( uint32_t n = 0; n < scene.nodeCount ( ); ++n ) {
+		glm::mat4 local = glm::translate ( scene.node ( n ).local, glm::vec3 ( 0.5f, 0.25f, -0.5f ) );
+		scene.setLocal ( n, local );
+
+		changed.clear ( );
+		uint32_t count = scene.updateTransforms ( &changed );
+
+		expected.clear ( );
+		for ( uint32_t i = 0; i < scene.nodeCount ( ); ++i ) {
+			if ( descendsFrom ( scene, i, n ) ) {
+				expected.push_back ( i );
+			}
+		}
+
+		counts.moved++;
+		counts.updated += count;
+
+		if ( count != changed.size ( ) || changed != expected ) {
+			fprintf ( stderr, "Scene: moving the node %u updates %u nodes, its subtree has %u\n", n, count, ( uint32_t ) expected.size ( ) );
+			counts.wrongUpdates++;
+		}
+
+		counts.wrongWorlds += checkWorlds ( scene );
+	}
+
+	// Les rotations : les sous-arbres des noeuds qui tournent
+	scene.animate ( 0.25 );
+
+	changed.clear ( );
+	scene.updateTransforms ( &changed );
+
+	expected.clear ( );
+	for ( uint32_t i = 0; i < scene.nodeCount ( ); ++i ) {
+		if ( scene.animated ( i ) ) {
+			expected.push_back ( i );
+		}
+	}
+
+	if ( changed != expected ) {
+		fprintf ( stderr, "Scene: animating updates %u nodes, %u are below a spin\n", ( uint32_t ) changed.size ( ), ( uint32_t ) expected.size ( ) );
+		counts.wrongUpdates++;
+	}
+
+	counts.wrongWorlds += checkWorlds ( scene );
+
+	if ( counts.wrongWorlds > 0 ) {
+		fprintf ( stderr, "Scene: %u world transforms are not parent world * local\n", counts.wrongWorlds );
+	}
+
+	return ok && counts.wrongUpdates == 0 && counts.wrongWorlds == 0;
+}
+
+
+// Queries every camera, and compares with every box tested against the frustum
+static void queryViews ( LooseOctree &octree, const std::vector<glm::vec3> &mins, const std::vector<glm::vec3> &maxs,
+						 LinearArena &arena, OctreePhase &phase ) {
+	glm::mat4 projection = glm::perspective ( glm::radians ( 60.0f ), 16.0f / 9.0f, 0.1f, 80.0f );
+
+	phase.objects = octree.objects ( );
+
+	for ( uint32_t v = 0; v < BENCH_SCENE_VIEWS; ++v ) {
+		// Autour de la racine, dedans et dehors, vers des points varies
+		float angle = 6.2831853f * v / BENCH_SCENE_VIEWS;
+		float distance = v % 2 == 0 ? 60.0f : 15.0f;
+		glm::vec3 eye ( std::cos ( angle ) * distance, ( v % 3 ) * 10.0f - 10.0f, std::sin ( angle ) * distance );
+		glm::vec3 target ( ( v % 4 ) * 5.0f - 7.5f, 0.0f, 0.0f );
+		glm::mat4 viewProjection = projection * glm::lookAt ( eye, target, glm::vec3 ( 0.0f, 1.0f, 0.0f ) );
+
+		arena.reset ( );
+
+		ArenaVector<uint32_t> visible ( ( ArenaAllocator<uint32_t> ( &arena ) ) );
+		octree.query ( viewProjection, visible );
+
+		phase.octreeMs += octree.stats ( ).ms;
+		phase.nodesVisited += octree.stats ( ).nodesVisited;
+		phase.objectsTested += octree.stats ( ).objectsTested;
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now ( );
+
+		ArenaVector<uint32_t> expected ( ( ArenaAllocator<uint32_t> ( &arena ) ) );
+		for ( uint32_t id = 0; id < mins.size ( ); ++id ) {
+			if ( octree.contains ( id ) && octree.intersects ( mins[id], maxs[id] ) ) {
+				expected.push_back ( id );
+			}
+		}
+
+		phase.bruteForceMs += std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - start ).count ( );
+
+		// L'octree rend les ids dans l'ordre de ses noeuds
+		std::sort ( visible.begin ( ), visible.end ( ) );
+
+		phase.visible += visible.size ( );
+
+		if ( visible != expected ) {
+			fprintf ( stderr, "Scene: the octree query of the view %u (%s) finds %u boxes, the brute force %u\n", v, phase.name,
+					  ( uint32_t ) visible.size ( ), ( uint32_t ) expected.size ( ) );
+			phase.wrongViews++;
+		}
+	}
+}
+
+
+static void scatterBox ( uint32_t &seed, glm::vec3 &min, glm::vec3 &max ) {
+	glm::vec3 center (
+		( random01 ( seed ) * 2.0f - 1.0f ) * BENCH_SCENE_SPREAD,
+		( random01 ( seed ) * 2.0f - 1.0f ) * BENCH_SCENE_SPREAD,
+		( random01 ( seed ) * 2.0f - 1.0f ) * BENCH_SCENE_SPREAD );
+
+	// Surtout des petites boites, quelques grandes pour les noeuds hauts
+	float half = random01 ( seed ) < 0.05f ? 2.0f + random01 ( seed ) * 8.0f : 0.05f + random01 ( seed ) * 1.5f;
+
+	min = center - half;
+	max = center + half;
+}
+
+
+static void writeSceneJSON ( FILE *file, const char *sceneFile, const SceneCounts &counts, const std::vector<OctreePhase> &phases ) {
+	char date[32];
+	time_t now = time ( NULL );
+	strftime ( date, sizeof ( date ), "%Y-%m-%dT%H:%M:%SZ", gmtime ( &now ) );
+
+	fprintf ( file, "{\n" );
+	fprintf ( file, "  \"benchmark\": \"scene\",\n" );
+	fprintf ( file, "  \"date\": \"%s\",\n", date );
+	fprintf ( file, "  \"scene\": {\n" );
+	fprintf ( file, "    \"file\": \"%s\",\n", sceneFile );
+	fprintf ( file, "    \"nodes\": %u,\n", counts.nodes );
+	fprintf ( file, "    \"depth\": %u,\n", counts.depth );
+	fprintf ( file, "    \"moved\": %u,\n", counts.moved );
+	fprintf ( file, "    \"updated\": %u,\n", counts.updated );
+	fprintf ( file, "    \"wrong_updates\": %u,\n", counts.wrongUpdates );
+	fprintf ( file, "    \"wrong_worlds\": %u\n", counts.wrongWorlds );
+	fprintf ( file, "  },\n" );
+	fprintf ( file, "  \"octree\": [\n" );
+
+	for ( uint32_t i = 0; i < phases.size ( ); ++i ) {
+		const OctreePhase &phase = phases[i];
+
+		fprintf ( file, "    { \"phase\": \"%s\", \"objects\": %u, \"views\": %u, \"visible\": %u, \"wrong_views\": %u, "
+				  "\"nodes_visited\": %u, \"objects_tested\": %u, \"octree_ms\": %.4f, \"brute_force_ms\": %.4f }%s\n",
+				  phase.name, phase.objects, BENCH_SCENE_VIEWS, phase.visible, phase.wrongViews, phase.nodesVisited,
+				  phase.objectsTested, phase.octreeMs, phase.bruteForceMs, i + 1 < phases.size ( ) ? "," : "" );
+	}
+
+	fprintf ( file, "  ]\n" );
+	fprintf ( file, "}\n" );
+}
+
+
+bool benchmarkScene ( const char *output, const char *sceneFile, uint32_t objects ) {
+	Scene scene;
+
+	if ( !scene.load ( sceneFile ) ) {
+		return false;
+	}
+
+	SceneCounts counts;
+	bool ok = checkTransforms ( scene, counts );
+
+	// Les boites, dont certaines hors de la racine
+	std::vector<glm::vec3> mins ( objects ), maxs ( objects );
+	uint32_t seed = 1;
+
+	LooseOctree octree;
+	octree.init ( glm::vec3 ( 0.0f, 0.0f, 0.0f ), BENCH_SCENE_ROOT, 6 );
+
+	for ( uint32_t id = 0; id < objects; ++id ) {
+		scatterBox ( seed, mins[id], maxs[id] );
+		octree.insert ( id, mins[id], maxs[id] );
+	}
+
+	LinearArena arena;
+	arena.init ( objects * 2 * sizeof ( uint32_t ) + 1024 );
+
+	std::vector<OctreePhase> phases;
+
+	OctreePhase inserted = { "inserted" };
+	queryViews ( octree, mins, maxs, arena, inserted );
+	phases.push_back ( inserted );
+
+	// Un tiers des boites bouge, un huitieme disparait
+	for ( uint32_t id = 0; id < objects; ++id ) {
+		if ( id % 8 == 7 ) {
+			octree.remove ( id );
+		}
+		else if ( id % 3 == 0 ) {
+			scatterBox ( seed, mins[id], maxs[id] );
+			octree.update ( id, mins[id], maxs[id] );
+		}
+	}
+
+	OctreePhase moved = { "moved and removed" };
+	queryViews ( octree, mins, maxs, arena, moved );
+	phases.push_back ( moved );
+
+	if ( moved.objects != objects - objects / 8 ) {
+		fprintf ( stderr, "Scene: the octree holds %u boxes after the removals, not %u\n", moved.objects, objects - objects / 8 );
+		ok = false;
+	}
+
+	for ( uint32_t i = 0; i < phases.size ( ); ++i ) {
+		ok = ok && phases[i].wrongViews == 0;
+	}
+
+	FILE *file = output != NULL ? fopen ( output, "w" ) : stdout;
+
+	if ( file == NULL ) {
+		printf ( "Impossible to open %s\n", output );
+		return false;
+	}
+
+	writeSceneJSON ( file, sceneFile, counts, phases );
+
+	if ( file != stdout ) {
+		fclose ( file );
+		fprintf ( stderr, "Results written to %s\n", output );
+	}
+
+	return ok;
+}
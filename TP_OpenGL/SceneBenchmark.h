@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+// Scene graph and loose octree of tp_scene. The scene file is parsed, then
+// each node is moved in turn : updateTransforms must report exactly its
+// subtree, and every world transform must be parent world * local. Boxes
+// scattered around the octree, some outside its root, are then queried
+// from several cameras, before and after moving and removing some of them :
+// the result must be the brute force test of every box against the frustum.
+// False when a check fails. The counts and times are written as JSON to
+// output, or to stdout when output is NULL. No GL context is needed.
+bool benchmarkScene ( const char *output, const char *sceneFile, uint32_t objects );
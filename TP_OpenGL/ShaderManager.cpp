@@ -0,0 +1,400 @@
+#include "ShaderManager.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+// Intervalle entre deux verifications des fichiers (secondes)
+#define SHADER_POLL_INTERVAL 0.25
+
+static std::string readFile ( const std::string &path ) {
+	std::ifstream t ( path );
+	std::stringstream buffer;
+	buffer << t.rdbuf ( );
+
+	return buffer.str ( );
+}
+
+static time_t fileTime ( const std::string &path ) {
+	struct stat info;
+
+	if ( stat ( path.c_str ( ), &info ) != 0 ) {
+		return 0;
+	}
+
+	return info.st_mtime;
+}
+
+static double now ( ) {
+	return std::chrono::duration<double> ( std::chrono::steady_clock::now ( ).time_since_epoch ( ) ).count ( );
+}
+
+// FNV-1a 64 bits
+static uint64_t hash ( uint64_t h, const std::string &s ) {
+	for ( size_t i = 0; i < s.size ( ); ++i ) {
+		h ^= ( unsigned char ) s[i];
+		h *= 1099511628211ull;
+	}
+
+	// Separateur : "ab" + "c" ne doit pas donner "a" + "bc"
+	h ^= 0xFF;
+	h *= 1099511628211ull;
+
+	return h;
+}
+
+static void printShaderLog ( GLuint shader, const std::string &file ) {
+	GLint res;
+	glGetShaderiv ( shader, GL_COMPILE_STATUS, &res );
+
+	if ( res ) {
+		return;
+	}
+
+	std::cerr << "shader compilation error: " << file << std::endl;
+
+	char message[1000];
+
+	GLsizei readSize;
+	glGetShaderInfoLog ( shader, 1000, &readSize, message );
+	message[999] = '\0';
+
+	std::cerr << message << std::endl;
+}
+
+
+ShaderManager::ShaderManager ( ) :
+	_binaries ( false ),
+	_parallel ( false ),
+	_lastPoll ( 0.0 ) {
+	_stats.cached = 0;
+	_stats.compiled = 0;
+	_stats.reloaded = 0;
+	_stats.failed = 0;
+}
+
+
+ShaderManager::~ShaderManager ( ) {
+}
+
+
+void ShaderManager::init ( const std::string &cacheDirectory ) {
+	_cacheDirectory = cacheDirectory;
+
+#ifdef _WIN32
+	_mkdir ( _cacheDirectory.c_str ( ) );
+#else
+	mkdir ( _cacheDirectory.c_str ( ), 0755 );
+#endif
+
+	// Un binaire n'est valable que pour le driver qui l'a produit
+	_driver = std::string ( ( const char* ) glGetString ( GL_VENDOR ) ) + "|" +
+			  std::string ( ( const char* ) glGetString ( GL_RENDERER ) ) + "|" +
+			  std::string ( ( const char* ) glGetString ( GL_VERSION ) );
+
+	GLint formats = 0;
+	glGetIntegerv ( GL_NUM_PROGRAM_BINARY_FORMATS, &formats );
+	_binaries = formats > 0;
+
+	_parallel = GLEW_KHR_parallel_shader_compile != 0;
+	if ( _parallel ) {
+		// Laisse le driver choisir le nombre de threads
+		glMaxShaderCompilerThreadsKHR ( 0xFFFFFFFF );
+	}
+
+	std::cout << "Shader cache: " << ( _binaries ? _cacheDirectory : "unsupported" )
+			  << ", parallel compile: " << ( _parallel ? "yes" : "no" ) << std::endl;
+}
+
+
+uint32_t ShaderManager::load ( const std::string &vertexFile, const std::string &fragmentFile, const std::string &defines ) {
+	Entry entry;
+	entry.files[0] = vertexFile;
+	entry.files[1] = fragmentFile;
+	entry.defines = defines;
+	entry.program = 0;
+	entry.pending = 0;
+	entry.shaders[0] = entry.shaders[1] = 0;
+	entry.key = 0;
+	entry.fromCache = false;
+
+	_entries.push_back ( entry );
+	submit ( _entries.back ( ), true );
+
+	return _entries.size ( ) - 1;
+}
+
+
+uint32_t ShaderManager::loadCompute ( const std::string &computeFile, const std::string &defines ) {
+	return load ( computeFile, "", defines );
+}
+
+
+bool ShaderManager::wait ( ) {
+	bool ok = true;
+
+	for ( uint32_t i = 0; i < _entries.size ( ); ++i ) {
+		ok = wait ( i ) && ok;
+	}
+
+	return ok;
+}
+
+
+bool ShaderManager::wait ( uint32_t id ) {
+	while ( _entries[id].pending != 0 ) {
+		resolve ( _entries[id], true );
+	}
+
+	return _entries[id].program != 0;
+}
+
+
+bool ShaderManager::update ( ) {
+	bool replaced = false;
+
+	for ( uint32_t i = 0; i < _entries.size ( ); ++i ) {
+		if ( _entries[i].pending != 0 ) {
+			replaced = resolve ( _entries[i], false ) || replaced;
+		}
+	}
+
+	if ( now ( ) - _lastPoll < SHADER_POLL_INTERVAL ) {
+		return replaced;
+	}
+	_lastPoll = now ( );
+
+	for ( uint32_t i = 0; i < _entries.size ( ); ++i ) {
+		Entry &entry = _entries[i];
+
+		if ( fileTime ( entry.files[0] ) == entry.times[0] && fileTime ( entry.files[1] ) == entry.times[1] ) {
+			continue;
+		}
+
+		std::cout << "Reloading " << entry.files[0] << ( entry.files[1].empty ( ) ? "" : " / " + entry.files[1] ) << std::endl;
+
+		// Une nouvelle modification remplace la compilation en cours
+		discard ( entry );
+		submit ( entry, true );
+	}
+
+	return replaced;
+}
+
+
+void ShaderManager::submit ( Entry &entry, bool useCache ) {
+	entry.times[0] = fileTime ( entry.files[0] );
+	entry.times[1] = fileTime ( entry.files[1] );
+
+	bool compute = entry.files[1].empty ( );
+	uint32_t stages = compute ? 1 : 2;
+
+	std::string sources[2] = { readFile ( entry.files[0] ), compute ? "" : readFile ( entry.files[1] ) };
+
+	for ( uint32_t s = 0; s < stages && !entry.defines.empty ( ); ++s ) {
+		size_t version = sources[s].find ( "#version" );
+		size_t line = version == std::string::npos ? 0 : sources[s].find ( '\n', version );
+
+		// #line garde les numeros de ligne du fichier dans les erreurs
+		if ( line != std::string::npos ) {
+			sources[s].insert ( line + 1, entry.defines + "#line 2\n" );
+		}
+	}
+
+	entry.key = hash ( hash ( hash ( 14695981039346656037ull, _driver ), sources[0] ), sources[1] );
+
+	if ( useCache && loadBinary ( entry ) ) {
+		return;
+	}
+
+	const GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+
+	entry.pending = glCreateProgram ( );
+	entry.fromCache = false;
+
+	for ( uint32_t s = 0; s < stages; ++s ) {
+		const char* ptr = sources[s].c_str ( );
+		GLint length = sources[s].length ( );
+
+		entry.shaders[s] = glCreateShader ( compute ? GL_COMPUTE_SHADER : types[s] );
+		glShaderSource ( entry.shaders[s], 1, &ptr, &length );
+		glCompileShader ( entry.shaders[s] );
+
+		glAttachShader ( entry.pending, entry.shaders[s] );
+	}
+
+	if ( _binaries ) {
+		glProgramParameteri ( entry.pending, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+	}
+
+	// Pas de lecture d'etat ici : la compilation peut continuer en arriere plan
+	glLinkProgram ( entry.pending );
+}
+
+
+// Returns true when the pending program replaced the current one
+bool ShaderManager::resolve ( Entry &entry, bool block ) {
+	GLint res;
+
+	if ( !block && _parallel ) {
+		glGetProgramiv ( entry.pending, GL_COMPLETION_STATUS_KHR, &res );
+
+		if ( !res ) {
+			return false;
+		}
+	}
+
+	glGetProgramiv ( entry.pending, GL_LINK_STATUS, &res );
+
+	if ( !res && entry.fromCache ) {
+		// Binaire refuse (driver mis a jour...) : on recompile
+		discard ( entry );
+		submit ( entry, false );
+		return false;
+	}
+
+	if ( !res ) {
+		printShaderLog ( entry.shaders[0], entry.files[0] );
+		if ( entry.shaders[1] != 0 ) {
+			printShaderLog ( entry.shaders[1], entry.files[1] );
+		}
+
+		std::cerr << "program link error" << std::endl;
+
+		char message[1000];
+
+		GLsizei readSize;
+		glGetProgramInfoLog ( entry.pending, 1000, &readSize, message );
+		message[999] = '\0';
+
+		std::cerr << message << std::endl;
+
+		if ( entry.program != 0 ) {
+			std::cerr << "keeping the previous program" << std::endl;
+		}
+
+		_stats.failed++;
+		discard ( entry );
+		return false;
+	}
+
+	if ( entry.fromCache ) {
+		_stats.cached++;
+	}
+	else {
+		_stats.compiled++;
+		saveBinary ( entry );
+	}
+
+	bool reload = entry.program != 0;
+
+	if ( reload ) {
+		glDeleteProgram ( entry.program );
+		_stats.reloaded++;
+	}
+
+	entry.program = entry.pending;
+	entry.pending = 0;
+
+	for ( uint32_t s = 0; s < 2; ++s ) {
+		if ( entry.shaders[s] != 0 ) {
+			glDetachShader ( entry.program, entry.shaders[s] );
+			glDeleteShader ( entry.shaders[s] );
+			entry.shaders[s] = 0;
+		}
+	}
+
+	return reload;
+}
+
+
+void ShaderManager::release ( ) {
+	for ( uint32_t i = 0; i < _entries.size ( ); ++i ) {
+		discard ( _entries[i] );
+
+		glDeleteProgram ( _entries[i].program );
+		_entries[i].program = 0;
+	}
+}
+
+
+void ShaderManager::discard ( Entry &entry ) {
+	for ( uint32_t s = 0; s < 2; ++s ) {
+		glDeleteShader ( entry.shaders[s] );
+		entry.shaders[s] = 0;
+	}
+
+	glDeleteProgram ( entry.pending );
+	entry.pending = 0;
+}
+
+
+std::string ShaderManager::cachePath ( uint64_t key ) const {
+	char name[32];
+	sprintf ( name, "%016llx.bin", ( unsigned long long ) key );
+
+	return _cacheDirectory + "/" + name;
+}
+
+
+bool ShaderManager::loadBinary ( Entry &entry ) {
+	if ( !_binaries ) {
+		return false;
+	}
+
+	std::ifstream file ( cachePath ( entry.key ).c_str ( ), std::ios::binary );
+
+	if ( !file ) {
+		return false;
+	}
+
+	GLenum format;
+	file.read ( ( char* ) &format, sizeof ( format ) );
+
+	if ( !file ) {
+		return false;
+	}
+
+	std::vector<char> binary ( ( std::istreambuf_iterator<char> ( file ) ), std::istreambuf_iterator<char> ( ) );
+
+	if ( binary.empty ( ) ) {
+		return false;
+	}
+
+	entry.pending = glCreateProgram ( );
+	entry.fromCache = true;
+
+	glProgramBinary ( entry.pending, format, &binary[0], binary.size ( ) );
+
+	return true;
+}
+
+
+void ShaderManager::saveBinary ( const Entry &entry ) const {
+	if ( !_binaries ) {
+		return;
+	}
+
+	GLint length = 0;
+	glGetProgramiv ( entry.pending, GL_PROGRAM_BINARY_LENGTH, &length );
+
+	if ( length <= 0 ) {
+		return;
+	}
+
+	std::vector<char> binary ( length );
+	GLenum format;
+	glGetProgramBinary ( entry.pending, length, NULL, &format, &binary[0] );
+
+	std::ofstream file ( cachePath ( entry.key ).c_str ( ), std::ios::binary );
+	file.write ( ( const char* ) &format, sizeof ( format ) );
+	file.write ( &binary[0], binary.size ( ) );
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <ctime>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "GL/glew.h"
+
+/////////////////////////////
+// ShaderStats
+struct ShaderStats {
+	uint32_t cached;		// programs loaded with glProgramBinary
+	uint32_t compiled;		// programs compiled from source
+	uint32_t reloaded;		// successful hot reloads
+	uint32_t failed;		// compilations or links that failed
+};
+
+/////////////////////////////
+// ShaderManager
+// Builds the programs from their vertex and fragment files, or from one
+// compute file. Linked programs
+// are saved with glGetProgramBinary, keyed by a hash of the sources and of
+// the driver strings, so a warm start skips compilation. Every program is
+// submitted before any status is read : with GL_KHR_parallel_shader_compile
+// the driver compiles them on its own threads.
+// update() reloads the edited files and keeps the previous program when
+// the new one does not build.
+class ShaderManager {
+
+public:
+	ShaderManager ( );
+	~ShaderManager ( );
+
+	void init ( const std::string &cacheDirectory );
+
+	// Starts building a program, returns its id. The defines are inserted
+	// right after the #version line of both files
+	uint32_t load ( const std::string &vertexFile, const std::string &fragmentFile, const std::string &defines = "" );
+	uint32_t loadCompute ( const std::string &computeFile, const std::string &defines = "" );
+
+	// Blocks until every submitted program is built, false if one has no working version
+	bool wait ( );
+	bool wait ( uint32_t id );
+
+	// Polls the files and the pending reloads, true when a program was replaced
+	bool update ( );
+
+	// Deletes every program, the ids stay valid but give 0
+	void release ( );
+
+	GLuint program ( uint32_t id ) const { return _entries[id].program; }
+	const ShaderStats &stats ( ) const { return _stats; }
+
+private:
+	// A compute program has its file first and no second file
+	struct Entry {
+		std::string files[2];
+		std::string defines;
+		time_t times[2];
+
+		GLuint program;			// last working program, 0 until the first build
+		GLuint pending;			// program being built
+		GLuint shaders[2];
+		uint64_t key;
+		bool fromCache;
+	};
+
+	void submit ( Entry &entry, bool useCache );
+	bool resolve ( Entry &entry, bool block );
+	void discard ( Entry &entry );
+
+	bool loadBinary ( Entry &entry );
+	void saveBinary ( const Entry &entry ) const;
+	std::string cachePath ( uint64_t key ) const;
+
+	std::vector<Entry> _entries;
+	std::string _cacheDirectory;
+	std::string _driver;
+
+	bool _binaries;			// at least one binary format is supported
+	bool _parallel;			// GL_KHR_parallel_shader_compile
+
+	double _lastPoll;
+	ShaderStats _stats;
+};
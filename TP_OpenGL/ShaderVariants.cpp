@@ -0,0 +1,72 @@
+#include "ShaderVariants.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+ShaderVariants::ShaderVariants ( ) :
+	_manager ( NULL ) {
+}
+
+
+ShaderVariants::~ShaderVariants ( ) {
+}
+
+
+void ShaderVariants::init ( ShaderManager *manager, const std::string &vertexFile, const std::string &fragmentFile ) {
+	_manager = manager;
+	_files[0] = vertexFile;
+	_files[1] = fragmentFile;
+}
+
+
+void ShaderVariants::request ( uint32_t key ) {
+	if ( _variants.find ( key ) != _variants.end ( ) ) {
+		return;
+	}
+
+	_variants[key] = _manager->load ( _files[0], _files[1], defines ( key ) );
+}
+
+
+GLuint ShaderVariants::program ( uint32_t key ) {
+	request ( key );
+
+	uint32_t id = _variants[key];
+
+	// Premiere utilisation : on attend la compilation
+	if ( _manager->program ( id ) == 0 && !_manager->wait ( id ) ) {
+		std::cerr << _files[0] << " / " << _files[1] << ": variant 0x" << std::hex << key << std::dec << " does not build" << std::endl;
+		exit ( -1 );
+	}
+
+	return _manager->program ( id );
+}
+
+
+std::string ShaderVariants::defines ( uint32_t key ) {
+	std::ostringstream out;
+
+	out << "#define SHADOW_FILTER " << ( key & SHADER_SHADOW_FILTER_MASK ) << "\n";
+
+	if ( key & SHADER_SPECULAR ) {
+		out << "#define SPECULAR\n";
+	}
+	if ( key & SHADER_DEBUG_NORMALS ) {
+		out << "#define DEBUG_NORMALS\n";
+	}
+	if ( key & SHADER_VERTEX_NORMAL ) {
+		out << "#define VERTEX_NORMAL\n";
+	}
+	if ( key & SHADER_INSTANCED ) {
+		out << "#define INSTANCED\n";
+	}
+	if ( key & SHADER_CLUSTERED_LIGHTS ) {
+		out << "#define CLUSTERED_LIGHTS\n";
+	}
+	if ( key & SHADER_SHARPEN ) {
+		out << "#define SHARPEN\n";
+	}
+
+	return out.str ( );
+}
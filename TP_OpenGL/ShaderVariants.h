@@ -0,0 +1,48 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <stdint.h>
+
+#include "ShaderManager.h"
+
+// Permutation key bits, each one turns into a #define in the sources
+#define SHADER_SHADOW_FILTER_MASK	0x3			// SHADOW_FILTER n, see ShadowFilterMode
+#define SHADER_SPECULAR				( 1 << 2 )	// SPECULAR
+#define SHADER_DEBUG_NORMALS		( 1 << 3 )	// DEBUG_NORMALS : outputs the normal as color
+#define SHADER_VERTEX_NORMAL		( 1 << 4 )	// VERTEX_NORMAL : normals from the vertex buffer, else from derivatives
+#define SHADER_INSTANCED			( 1 << 5 )	// INSTANCED : model and color from the instance buffer
+#define SHADER_CLUSTERED_LIGHTS		( 1 << 6 )	// CLUSTERED_LIGHTS : adds the point lights of the fragment's cluster
+#define SHADER_SHARPEN				( 1 << 7 )	// SHARPEN : contrast adaptive sharpening of the upscale
+
+#define SHADER_SHADOW_FILTER( mode ) ( ( uint32_t ) ( mode ) & SHADER_SHADOW_FILTER_MASK )
+
+/////////////////////////////
+// ShaderVariants
+// The permutations of one vertex/fragment pair. A permutation is only
+// built the first time its key is requested.
+class ShaderVariants {
+
+public:
+	ShaderVariants ( );
+	~ShaderVariants ( );
+
+	void init ( ShaderManager *manager, const std::string &vertexFile, const std::string &fragmentFile );
+
+	// Submits the build without waiting for it
+	void request ( uint32_t key );
+
+	// Current program of the permutation, built on first use
+	GLuint program ( uint32_t key );
+
+	uint32_t count ( ) const { return _variants.size ( ); }
+
+	static std::string defines ( uint32_t key );
+
+private:
+	ShaderManager *_manager;
+	std::string _files[2];
+
+	// key -> ShaderManager id
+	std::map<uint32_t, uint32_t> _variants;
+};
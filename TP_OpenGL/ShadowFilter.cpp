@@ -0,0 +1,64 @@
+#include "ShadowFilter.h"
+
+#include <algorithm>
+
+ShadowFilter::ShadowFilter ( ) :
+	_mode ( SHADOW_PCF_ROTATED ),
+	_samples ( 12 ),
+	_radius ( 1.5f ),
+	_lightSize ( 0.02f ),
+	_bias ( 0.005f ) {
+}
+
+
+ShadowFilter::~ShadowFilter ( ) {
+}
+
+
+void ShadowFilter::init ( ) {
+	GLfloat border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	// Comparaison materielle : le filtrage lineaire donne un PCF 2x2 gratuit
+	_compareSampler = createSampler ( );
+	GLuint compare = _compareSampler.id ( );
+	glSamplerParameteri ( compare, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE );
+	glSamplerParameteri ( compare, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL );
+	glSamplerParameteri ( compare, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glSamplerParameteri ( compare, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glSamplerParameteri ( compare, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER );
+	glSamplerParameteri ( compare, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER );
+	glSamplerParameterfv ( compare, GL_TEXTURE_BORDER_COLOR, border );
+
+	// Lecture brute de la profondeur pour la recherche de bloqueurs
+	_depthSampler = createSampler ( );
+	GLuint depth = _depthSampler.id ( );
+	glSamplerParameteri ( depth, GL_TEXTURE_COMPARE_MODE, GL_NONE );
+	glSamplerParameteri ( depth, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glSamplerParameteri ( depth, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glSamplerParameteri ( depth, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER );
+	glSamplerParameteri ( depth, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER );
+	glSamplerParameterfv ( depth, GL_TEXTURE_BORDER_COLOR, border );
+}
+
+
+void ShadowFilter::release ( ) {
+	_compareSampler.reset ( );
+	_depthSampler.reset ( );
+}
+
+
+void ShadowFilter::bind ( GLStateCache &state, GLuint program, GLuint depthTexture, GLsizei size, GLuint compareUnit, GLuint depthUnit ) const {
+	state.bindTexture ( compareUnit, depthTexture );
+	state.bindSampler ( compareUnit, _compareSampler.id ( ) );
+
+	state.bindTexture ( depthUnit, depthTexture );
+	state.bindSampler ( depthUnit, _depthSampler.id ( ) );
+
+	glProgramUniform1i ( program, glGetUniformLocation ( program, "shadowMap" ), compareUnit );
+	glProgramUniform1i ( program, glGetUniformLocation ( program, "shadowDepth" ), depthUnit );
+	glProgramUniform1i ( program, glGetUniformLocation ( program, "shadow_samples" ), std::min ( std::max ( _samples, 1u ), 32u ) );
+	glProgramUniform1f ( program, glGetUniformLocation ( program, "shadow_radius" ), _radius / size );
+	glProgramUniform1f ( program, glGetUniformLocation ( program, "shadow_light_size" ), _lightSize );
+	glProgramUniform1f ( program, glGetUniformLocation ( program, "shadow_bias" ), _bias );
+}
+
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "GL/glew.h"
+
+#include "GLState.h"
+#include "GpuResource.h"
+
+/////////////////////////////
+// ShadowFilterMode : value of SHADOW_FILTER in basic.fsl, part of the shader variant key
+enum ShadowFilterMode {
+	SHADOW_HARD = 0,			// one hardware comparison (2x2 bilinear PCF)
+	SHADOW_PCF_POISSON = 1,		// fixed Poisson disk of hardware comparisons
+	SHADOW_PCF_ROTATED = 2,		// Poisson disk rotated per pixel
+	SHADOW_PCSS = 3				// blocker search, then rotated PCF sized by the penumbra
+};
+
+/////////////////////////////
+// ShadowFilter
+// Owns the two sampler objects used to read the shadow map : a comparison
+// sampler (sampler2DShadow) and a raw depth sampler for the PCSS blocker
+// search. The texture itself keeps its default parameters.
+class ShadowFilter {
+
+public:
+	ShadowFilter ( );
+	~ShadowFilter ( );
+
+	void init ( );
+	void release ( );
+
+	// Binds the shadow map on both units and sets the filter uniforms,
+	// the program must be the variant built for _mode
+	void bind ( GLStateCache &state, GLuint program, GLuint depthTexture, GLsizei size, GLuint compareUnit, GLuint depthUnit ) const;
+
+	ShadowFilterMode _mode;
+	uint32_t _samples;		// 1..32
+	float _radius;			// kernel radius in texels
+	float _lightSize;		// PCSS light size in shadow map uv
+	float _bias;			// maximum slope scaled bias
+
+private:
+	Sampler _compareSampler;
+	Sampler _depthSampler;
+};
@@ -0,0 +1,361 @@
+#include "ShadowMap.h"
+
+#include <algorithm>
+
+static const ShadowRegion EMPTY_REGION = { 0, 0, 0, 0 };
+
+// Plus petit rectangle contenant a et b
+static ShadowRegion unite ( const ShadowRegion &a, const ShadowRegion &b ) {
+	if ( a.empty ( ) ) return b;
+	if ( b.empty ( ) ) return a;
+
+	ShadowRegion res = {
+		std::min ( a.x0, b.x0 ), std::min ( a.y0, b.y0 ),
+		std::max ( a.x1, b.x1 ), std::max ( a.y1, b.y1 )
+	};
+
+	return res;
+}
+
+static bool overlaps ( const ShadowRegion &a, const ShadowRegion &b ) {
+	return !a.empty ( ) && !b.empty ( ) &&
+		a.x0 < b.x1 && b.x0 < a.x1 &&
+		a.y0 < b.y1 && b.y0 < a.y1;
+}
+
+static void scissor ( const ShadowRegion &r ) {
+	glScissor ( r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0 );
+}
+
+
+ShadowMap::ShadowMap ( ) :
+	_size ( 0 ),
+	_current ( 0 ),
+	_lightView ( 1.0f ), _lightProjection ( 1.0f ), _lightVP ( 1.0f ),
+	_dirty ( EMPTY_REGION ), _restore ( EMPTY_REGION ), _lastDynamic ( EMPTY_REGION ) {
+	_stats.drawn = 0;
+	_stats.culled = 0;
+	_stats.staticRedrawn = false;
+}
+
+
+ShadowMap::~ShadowMap ( ) {
+}
+
+
+Texture ShadowMap::createDepthTexture ( GLsizei size ) {
+	Texture texture = ::createTexture ( GL_TEXTURE_2D );
+	glTextureStorage2D ( texture.id ( ), 1, GL_DEPTH_COMPONENT32F, size, size );
+
+	return texture;
+}
+
+
+Framebuffer ShadowMap::createFramebuffer ( GLuint depthTexture ) {
+	Framebuffer fbo = ::createFramebuffer ( );
+	glNamedFramebufferTexture ( fbo.id ( ), GL_DEPTH_ATTACHMENT, depthTexture, 0 );
+
+	GLenum Status = glCheckNamedFramebufferStatus ( fbo.id ( ), GL_FRAMEBUFFER );
+
+	if ( Status != GL_FRAMEBUFFER_COMPLETE ) {
+		printf ( "FB error, status: 0x%x\n", Status );
+		exit ( -1 );
+	}
+
+	return fbo;
+}
+
+
+void ShadowMap::init ( GLsizei size ) {
+	_size = size;
+
+	_staticDepth	= createDepthTexture ( size );
+	_staticFbo		= createFramebuffer ( _staticDepth.id ( ) );
+	_depth			= createDepthTexture ( size );
+	_fbo			= createFramebuffer ( _depth.id ( ) );
+
+	_current = _staticDepth.id ( );
+
+	invalidate ( );
+}
+
+
+void ShadowMap::release ( ) {
+	_staticFbo.reset ( );
+	_staticDepth.reset ( );
+	_fbo.reset ( );
+	_depth.reset ( );
+	_current = 0;
+
+	_commands.release ( );
+}
+
+
+uint32_t ShadowMap::addCaster ( const ShadowCaster &caster ) {
+	_casters.push_back ( caster );
+
+	if ( !caster.dynamic ) {
+		ShadowRegion region;
+		if ( project ( caster, region ) ) {
+			invalidateRegion ( region );
+		}
+	}
+
+	return _casters.size ( ) - 1;
+}
+
+
+void ShadowMap::setCasterModel ( uint32_t id, const glm::mat4 &model ) {
+	ShadowCaster &caster = _casters[id];
+
+	if ( caster.dynamic ) {
+		caster.model = model;
+		return;
+	}
+
+	if ( caster.model == model ) {
+		return;
+	}
+
+	// L'ancienne et la nouvelle emprise doivent etre redessinees
+	ShadowRegion region;
+	if ( project ( caster, region ) ) {
+		invalidateRegion ( region );
+	}
+
+	caster.model = model;
+
+	if ( project ( caster, region ) ) {
+		invalidateRegion ( region );
+	}
+}
+
+
+void ShadowMap::setCasterInstances ( uint32_t id, uint32_t baseInstance, uint32_t instanceCount, const Vector3 &bbMin, const Vector3 &bbMax ) {
+	ShadowCaster &caster = _casters[id];
+
+	// Les instances ont pu changer sans que la boite change : on redessine
+	ShadowRegion region;
+	if ( !caster.dynamic && project ( caster, region ) ) {
+		invalidateRegion ( region );
+	}
+
+	caster.baseInstance = baseInstance;
+	caster.instanceCount = instanceCount;
+	caster.bbMin = bbMin;
+	caster.bbMax = bbMax;
+
+	if ( !caster.dynamic && project ( caster, region ) ) {
+		invalidateRegion ( region );
+	}
+}
+
+
+// Un niveau de detail remplace l'autre : meme emprise, autre profondeur
+void ShadowMap::setCasterGeometry ( uint32_t id, const GeometryAllocation &geometry ) {
+	ShadowCaster &caster = _casters[id];
+	caster.geometry = geometry;
+
+	ShadowRegion region;
+	if ( !caster.dynamic && project ( caster, region ) ) {
+		invalidateRegion ( region );
+	}
+}
+
+
+void ShadowMap::setLight ( const glm::mat4 &view, const glm::mat4 &projection ) {
+	if ( view == _lightView && projection == _lightProjection ) {
+		return;
+	}
+
+	_lightView			= view;
+	_lightProjection	= projection;
+	_lightVP			= projection * view;
+
+	invalidate ( );
+}
+
+
+void ShadowMap::invalidate ( ) {
+	ShadowRegion full = { 0, 0, _size, _size };
+	invalidateRegion ( full );
+}
+
+
+void ShadowMap::invalidateRegion ( const ShadowRegion &region ) {
+	_dirty = unite ( _dirty, region );
+}
+
+
+// Projette la boite englobante du caster dans la shadow map.
+// Renvoie false si le caster est hors du frustum de la lumiere.
+bool ShadowMap::project ( const ShadowCaster &caster, ShadowRegion &region ) const {
+	// Mesh sans sommet : boite vide
+	if ( caster.bbMin.x > caster.bbMax.x || caster.bbMin.y > caster.bbMax.y || caster.bbMin.z > caster.bbMax.z ) {
+		return false;
+	}
+
+	glm::mat4 mvp = _lightVP * caster.model;
+
+	Vector3 ndcMin (  1e30f,  1e30f,  1e30f );
+	Vector3 ndcMax ( -1e30f, -1e30f, -1e30f );
+
+	for ( uint32_t i = 0; i < 8; ++i ) {
+		glm::vec4 corner (
+			( i & 1 ) ? caster.bbMax.x : caster.bbMin.x,
+			( i & 2 ) ? caster.bbMax.y : caster.bbMin.y,
+			( i & 4 ) ? caster.bbMax.z : caster.bbMin.z,
+			1.0f );
+
+		glm::vec4 clip = mvp * corner;
+		Vector3 ndc = Vector3 ( clip ) / clip.w;
+
+		ndcMin = glm::min ( ndcMin, ndc );
+		ndcMax = glm::max ( ndcMax, ndc );
+	}
+
+	if ( ndcMax.x < -1.0f || ndcMin.x > 1.0f ||
+		 ndcMax.y < -1.0f || ndcMin.y > 1.0f ||
+		 ndcMax.z < -1.0f || ndcMin.z > 1.0f ) {
+		return false;
+	}
+
+	// Limite a la shadow map avant la conversion en texels
+	ndcMin = glm::max ( ndcMin, Vector3 ( -1.0f, -1.0f, -1.0f ) );
+	ndcMax = glm::min ( ndcMax, Vector3 ( 1.0f, 1.0f, 1.0f ) );
+
+	// Un texel de marge pour les aretes du rasterizer
+	float half = _size * 0.5f;
+	region.x0 = std::max ( 0, ( GLint ) ( ( ndcMin.x + 1.0f ) * half ) - 1 );
+	region.y0 = std::max ( 0, ( GLint ) ( ( ndcMin.y + 1.0f ) * half ) - 1 );
+	region.x1 = std::min ( _size, ( GLint ) ( ( ndcMax.x + 1.0f ) * half ) + 2 );
+	region.y1 = std::min ( _size, ( GLint ) ( ( ndcMax.y + 1.0f ) * half ) + 2 );
+
+	return !region.empty ( );
+}
+
+
+// Un seul appel indirect par suite de casters partageant la meme matrice
+void ShadowMap::draw ( const std::vector<uint32_t> &casters, GLint mvpLoc ) {
+	for ( uint32_t i = 0; i < casters.size ( ); ) {
+		const glm::mat4 &model = _casters[casters[i]].model;
+		glm::mat4 depthMVP = _lightVP * model;
+
+		glUniformMatrix4fv ( mvpLoc, 1, GL_FALSE, &depthMVP[0][0] );
+
+		_commands.clear ( );
+
+		for ( ; i < casters.size ( ) && _casters[casters[i]].model == model; ++i ) {
+			const ShadowCaster &caster = _casters[casters[i]];
+			_commands.add ( caster.geometry, caster.instanceCount, caster.baseInstance );
+		}
+
+		_commands.draw ( );
+	}
+
+	_stats.drawn += casters.size ( );
+}
+
+
+void ShadowMap::render ( GLStateCache &state, GLuint program, const GeometryArena &arena ) {
+	_stats.drawn = 0;
+	_stats.culled = 0;
+	_stats.staticRedrawn = false;
+
+	state.viewport ( 0, 0, _size, _size );
+	state.useProgram ( program );
+	state.bindVertexArray ( arena.vao ( ) );
+	state.depthFunc ( GL_LESS );
+	state.depthMask ( GL_TRUE );
+
+	GLint mvpLoc = glGetUniformLocation ( program, "depthMVP" );
+
+	std::vector<uint32_t> visible;
+
+	/**** Static casters : only the invalidated region ****/
+	if ( !_dirty.empty ( ) ) {
+		state.bindFramebuffer ( _staticFbo.id ( ) );
+
+		state.enable ( GL_SCISSOR_TEST, true );
+		scissor ( _dirty );
+
+		glClear ( GL_DEPTH_BUFFER_BIT );
+
+		for ( uint32_t i = 0; i < _casters.size ( ); ++i ) {
+			const ShadowCaster &caster = _casters[i];
+			ShadowRegion region;
+
+			if ( caster.dynamic ) {
+				continue;
+			}
+
+			if ( project ( caster, region ) && overlaps ( region, _dirty ) ) {
+				visible.push_back ( i );
+			}
+			else {
+				_stats.culled++;
+			}
+		}
+
+		draw ( visible, mvpLoc );
+
+		state.enable ( GL_SCISSOR_TEST, false );
+
+		_restore = unite ( _restore, _dirty );
+		_dirty = EMPTY_REGION;
+		_stats.staticRedrawn = true;
+	}
+
+	/**** Dynamic casters : drawn over a copy of the cache ****/
+	visible.clear ( );
+	ShadowRegion dynamicRegion = EMPTY_REGION;
+
+	for ( uint32_t i = 0; i < _casters.size ( ); ++i ) {
+		ShadowRegion region;
+
+		if ( !_casters[i].dynamic ) {
+			continue;
+		}
+
+		if ( project ( _casters[i], region ) ) {
+			visible.push_back ( i );
+			dynamicRegion = unite ( dynamicRegion, region );
+		}
+		else {
+			_stats.culled++;
+		}
+	}
+
+	if ( visible.empty ( ) && _lastDynamic.empty ( ) ) {
+		// Rien de dynamique : le cache est utilise tel quel
+		_current = _staticDepth.id ( );
+	}
+	else {
+		// Restaure la copie la ou le cache a change et la ou les casters
+		// dynamiques etaient ou sont maintenant
+		if ( _current != _depth.id ( ) ) {
+			ShadowRegion full = { 0, 0, _size, _size };
+			_restore = full;
+		}
+
+		ShadowRegion copy = unite ( _restore, unite ( _lastDynamic, dynamicRegion ) );
+
+		if ( !copy.empty ( ) ) {
+			glCopyImageSubData (
+				_staticDepth.id ( ), GL_TEXTURE_2D, 0, copy.x0, copy.y0, 0,
+				_depth.id ( ), GL_TEXTURE_2D, 0, copy.x0, copy.y0, 0,
+				copy.x1 - copy.x0, copy.y1 - copy.y0, 1 );
+		}
+
+		if ( !visible.empty ( ) ) {
+			state.bindFramebuffer ( _fbo.id ( ) );
+
+			draw ( visible, mvpLoc );
+		}
+
+		_current = _depth.id ( );
+		_lastDynamic = dynamicRegion;
+	}
+
+	_restore = EMPTY_REGION;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "GL/glew.h"
+
+#include "Mesh.h"
+#include "GeometryArena.h"
+#include "GLState.h"
+#include "GpuResource.h"
+
+/////////////////////////////
+// ShadowCaster
+struct ShadowCaster {
+	GeometryAllocation geometry;
+	uint32_t baseInstance;
+	uint32_t instanceCount;
+	glm::mat4 model;
+
+	// Bounding box of all the instances, in model space
+	Vector3 bbMin;
+	Vector3 bbMax;
+
+	// Static casters are drawn once in the cache, dynamic ones every frame
+	bool dynamic;
+};
+
+/////////////////////////////
+// ShadowRegion : texel rectangle of the shadow map, empty when x0 >= x1
+struct ShadowRegion {
+	GLint x0, y0, x1, y1;
+
+	bool empty ( ) const {
+		return x0 >= x1 || y0 >= y1;
+	}
+};
+
+/////////////////////////////
+// ShadowStats
+struct ShadowStats {
+	uint32_t drawn;
+	uint32_t culled;
+	bool staticRedrawn;
+};
+
+/////////////////////////////
+// ShadowMap
+// Static casters are rendered once into a cached depth texture which is
+// only touched again inside invalidated regions. Dynamic casters are drawn
+// every frame on top of a copy of the cache.
+class ShadowMap {
+
+public:
+	ShadowMap ( );
+	~ShadowMap ( );
+
+	void init ( GLsizei size );
+	void release ( );
+
+	uint32_t addCaster ( const ShadowCaster &caster );
+	void setCasterModel ( uint32_t id, const glm::mat4 &model );
+	void setCasterInstances ( uint32_t id, uint32_t baseInstance, uint32_t instanceCount, const Vector3 &bbMin, const Vector3 &bbMax );
+	void setCasterGeometry ( uint32_t id, const GeometryAllocation &geometry );
+
+	// A different light view or projection invalidates the whole cache
+	void setLight ( const glm::mat4 &view, const glm::mat4 &projection );
+
+	void invalidate ( );
+	void invalidateRegion ( const ShadowRegion &region );
+
+	// The arena VAO is bound for the whole pass
+	void render ( GLStateCache &state, GLuint program, const GeometryArena &arena );
+
+	GLuint depthTexture ( ) const { return _current; }
+	GLsizei size ( ) const { return _size; }
+	const ShadowStats &stats ( ) const { return _stats; }
+
+private:
+	bool project ( const ShadowCaster &caster, ShadowRegion &region ) const;
+	void draw ( const std::vector<uint32_t> &casters, GLint mvpLoc );
+
+	static Texture createDepthTexture ( GLsizei size );
+	static Framebuffer createFramebuffer ( GLuint depthTexture );
+
+	GLsizei _size;
+
+	Texture _staticDepth;
+	Framebuffer _staticFbo;
+	Texture _depth;
+	Framebuffer _fbo;
+	GLuint _current;		// one of the two depth textures
+
+	glm::mat4 _lightView;
+	glm::mat4 _lightProjection;
+	glm::mat4 _lightVP;
+
+	std::vector<ShadowCaster> _casters;
+	DrawCommandBuilder _commands;
+
+	ShadowRegion _dirty;
+	ShadowRegion _restore;
+	ShadowRegion _lastDynamic;
+
+	ShadowStats _stats;
+};
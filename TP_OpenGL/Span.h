@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/////////////////////////////
+// Span : borrowed view of contiguous elements, valid while the owner lives
+// and does not grow. Functions that only traverse an array take one, so
+// that any vector (or arena vector) is passed without a copy.
+template <typename T>
+class Span {
+
+public:
+	Span ( ) : _data ( NULL ), _size ( 0 ) { }
+	Span ( T *data, size_t size ) : _data ( data ), _size ( size ) { }
+
+	template <typename A>
+	Span ( const std::vector<typename std::remove_const<T>::type, A> &vector ) :
+		_data ( vector.empty ( ) ? NULL : &vector[0] ),
+		_size ( vector.size ( ) ) {
+	}
+
+	template <typename A>
+	Span ( std::vector<typename std::remove_const<T>::type, A> &vector ) :
+		_data ( vector.empty ( ) ? NULL : &vector[0] ),
+		_size ( vector.size ( ) ) {
+	}
+
+	T *data ( ) const { return _data; }
+	size_t size ( ) const { return _size; }
+	bool empty ( ) const { return _size == 0; }
+
+	T *begin ( ) const { return _data; }
+	T *end ( ) const { return _data + _size; }
+
+	T &operator[]( size_t i ) const { return _data[i]; }
+
+private:
+	T *_data;
+	size_t _size;
+};
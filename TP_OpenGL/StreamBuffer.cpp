@@ -0,0 +1,311 @@
+#include "StreamBuffer.h"
+#include "GeometryArena.h"
+#include "Instancing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+/////////////////////////////
+// StreamBuffer
+
+StreamBuffer::StreamBuffer ( ) :
+	_data ( NULL ),
+	_regionSize ( 0 ),
+	_alignment ( 1 ),
+	_head ( 0 ),
+	_region ( 0 ) {
+	std::fill ( _fences, _fences + STREAM_FRAMES, ( GLsync ) 0 );
+	resetStats ( );
+}
+
+
+StreamBuffer::~StreamBuffer ( ) {
+}
+
+
+void StreamBuffer::init ( GLsizeiptr regionSize, GLsizeiptr alignment ) {
+	release ( );
+
+	_alignment = std::max<GLsizeiptr> ( alignment, 1 );
+	_regionSize = ( regionSize + _alignment - 1 ) / _alignment * _alignment;
+	_head = 0;
+	_region = 0;
+
+	// Ecrit par le CPU seulement, visible sans glFlushMappedBufferRange
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	_buffer = createBuffer ( );
+	glNamedBufferStorage ( _buffer.id ( ), _regionSize * STREAM_FRAMES, NULL, flags );
+	_data = ( uint8_t* ) glMapNamedBufferRange ( _buffer.id ( ), 0, _regionSize * STREAM_FRAMES, flags );
+
+	if ( _data == NULL ) {
+		printf ( "Impossible to map the stream buffer (%u bytes)\n", ( uint32_t ) ( _regionSize * STREAM_FRAMES ) );
+	}
+}
+
+
+void StreamBuffer::release ( ) {
+	for ( uint32_t i = 0; i < STREAM_FRAMES; ++i ) {
+		if ( _fences[i] != 0 ) {
+			glDeleteSync ( _fences[i] );
+			_fences[i] = 0;
+		}
+	}
+
+	if ( _data != NULL ) {
+		glUnmapNamedBuffer ( _buffer.id ( ) );
+		_data = NULL;
+	}
+
+	_buffer.reset ( );
+}
+
+
+void StreamBuffer::reserve ( GLsizeiptr regionSize ) {
+	if ( regionSize <= _regionSize ) {
+		return;
+	}
+
+	// Le GPU lit peut-etre encore l'ancien buffer
+	for ( uint32_t i = 0; i < STREAM_FRAMES; ++i ) {
+		wait ( i );
+	}
+
+	init ( regionSize, _alignment );
+}
+
+
+void StreamBuffer::wait ( uint32_t region ) {
+	if ( _fences[region] == 0 ) {
+		return;
+	}
+
+	// Deja passee : le cas normal avec trois regions
+	GLenum status = glClientWaitSync ( _fences[region], 0, 0 );
+
+	if ( status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED ) {
+		auto start = std::chrono::high_resolution_clock::now ( );
+
+		do {
+			status = glClientWaitSync ( _fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000 );
+		} while ( status == GL_TIMEOUT_EXPIRED );
+
+		_stats.waits++;
+		_stats.waitMs += std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - start ).count ( );
+	}
+
+	glDeleteSync ( _fences[region] );
+	_fences[region] = 0;
+}
+
+
+void StreamBuffer::begin ( ) {
+	_region = ( _region + 1 ) % STREAM_FRAMES;
+	_head = 0;
+
+	wait ( _region );
+
+	_stats.frames++;
+}
+
+
+void StreamBuffer::end ( ) {
+	// Rien d'ecrit : pas de fence a attendre plus tard
+	if ( _head == 0 ) {
+		return;
+	}
+
+	_fences[_region] = glFenceSync ( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+}
+
+
+void *StreamBuffer::allocate ( GLsizeiptr size, GLintptr &offset ) {
+	GLsizeiptr start = ( _head + _alignment - 1 ) / _alignment * _alignment;
+
+	if ( _data == NULL || start + size > _regionSize ) {
+		_stats.overflows++;
+		return NULL;
+	}
+
+	_head = start + size;
+	_stats.bytes += size;
+
+	offset = _region * _regionSize + start;
+	return _data + offset;
+}
+
+
+void StreamBuffer::resetStats ( ) {
+	_stats = StreamStats ( );
+}
+
+
+/////////////////////////////
+// DynamicMesh
+
+DynamicMesh::DynamicMesh ( ) :
+	_indexCount ( 0 ),
+	_deform ( 0.0f ),
+	_gpuNormals ( false ) {
+}
+
+
+DynamicMesh::DynamicMesh ( DynamicMesh &&other ) :
+	_vertices ( std::move ( other._vertices ) ),
+	_normals ( std::move ( other._normals ) ),
+	_indexCount ( other._indexCount ),
+	_indexBuffer ( std::move ( other._indexBuffer ) ),
+	_vao ( std::move ( other._vao ) ),
+	_deform ( other._deform ),
+	_gpuNormals ( other._gpuNormals ),
+	_indices ( std::move ( other._indices ) ),
+	_offsets ( std::move ( other._offsets ) ),
+	_faces ( std::move ( other._faces ) ),
+	_deformed ( std::move ( other._deformed ) ),
+	_deformedNormals ( std::move ( other._deformedNormals ) ),
+	_faceNormals ( std::move ( other._faceNormals ) ),
+	_draws ( std::move ( other._draws ) ) {
+	other._indexCount = 0;
+}
+
+
+DynamicMesh::~DynamicMesh ( ) {
+}
+
+
+DynamicMesh &DynamicMesh::operator=( DynamicMesh &&other ) {
+	if ( this != &other ) {
+		_vertices = std::move ( other._vertices );
+		_normals = std::move ( other._normals );
+		_indexCount = other._indexCount;
+		_indexBuffer = std::move ( other._indexBuffer );
+		_vao = std::move ( other._vao );
+		_deform = other._deform;
+		_gpuNormals = other._gpuNormals;
+		_indices = std::move ( other._indices );
+		_offsets = std::move ( other._offsets );
+		_faces = std::move ( other._faces );
+		_deformed = std::move ( other._deformed );
+		_deformedNormals = std::move ( other._deformedNormals );
+		_faceNormals = std::move ( other._faceNormals );
+		_draws = std::move ( other._draws );
+		other._indexCount = 0;
+	}
+	return *this;
+}
+
+
+void DynamicMesh::init ( std::vector<Vector3> &vertices, std::vector<Vector3> &normals, Span<const uint32_t> indices, float deform ) {
+	std::swap ( _vertices, vertices );
+	std::swap ( _normals, normals );
+	_indexCount = indices.size ( );
+	_deform = deform;
+
+	// Les normales recalculees viennent des faces : l'adjacence est construite une fois
+	if ( _deform != 0.0f ) {
+		_indices.assign ( indices.begin ( ), indices.end ( ) );
+		Mesh::buildAdjacency ( indices, _vertices.size ( ), _offsets, _faces );
+
+		_deformed.resize ( _vertices.size ( ) );
+		_deformedNormals.resize ( _vertices.size ( ) );
+		_faceNormals.resize ( _indexCount / 3 );
+	}
+
+	// Les indices ne changent jamais : stockage immuable
+	_indexBuffer = createBuffer ( );
+	glNamedBufferStorage ( _indexBuffer.id ( ), indices.size ( ) * sizeof ( uint32_t ), indices.data ( ), 0 );
+
+	_vao = createVertexArray ( );
+	GeometryArena::setAttributes ( _vao.id ( ) );
+	glVertexArrayElementBuffer ( _vao.id ( ), _indexBuffer.id ( ) );
+}
+
+
+void DynamicMesh::release ( ) {
+	_vao.reset ( );
+	_indexBuffer.reset ( );
+}
+
+
+void DynamicMesh::setInstanceBuffer ( GLuint buffer ) {
+	glVertexArrayVertexBuffer ( _vao.id ( ), 2, buffer, 0, sizeof ( Instance ) );
+}
+
+
+void DynamicMesh::setNormalBuffer ( GLuint buffer ) {
+	_gpuNormals = true;
+	glVertexArrayVertexBuffer ( _vao.id ( ), 1, buffer, 0, sizeof ( Vector3 ) );
+}
+
+
+bool DynamicMesh::stream ( StreamBuffer &stream, float angle, const Vector3 &axis, float phase, GLintptr &offset, JobSystem *jobs ) {
+	Vector3 *out = ( Vector3* ) stream.allocate ( frameSize ( ), offset );
+
+	if ( out == NULL ) {
+		return false;
+	}
+
+	// Positions puis normales, ecrites directement dans la memoire mappee
+	if ( _deform == 0.0f ) {
+		Mesh::rotate ( _vertices, out, angle, axis );
+		Mesh::rotate ( _normals, out + _vertices.size ( ), angle, axis );
+	}
+	else {
+		Mesh::wave ( _vertices, _normals, &_deformed[0], _deform, DYNAMIC_WAVE_FREQUENCY, phase );
+		Mesh::rotate ( _deformed, out, angle, axis );
+
+		// Sinon les normales sont calculees par le GPU a partir des positions du stream
+		if ( !_gpuNormals ) {
+			Mesh::calculateFaceNormals ( _deformed, _indices, &_faceNormals[0], jobs );
+			Mesh::calculateVertexNormals ( _faceNormals, _offsets, _faces, &_deformedNormals[0], jobs );
+			Mesh::rotate ( _deformedNormals, out + _vertices.size ( ), angle, axis );
+		}
+	}
+
+	glVertexArrayVertexBuffer ( _vao.id ( ), 0, stream.buffer ( ), offset, sizeof ( Vector3 ) );
+
+	if ( !_gpuNormals ) {
+		glVertexArrayVertexBuffer ( _vao.id ( ), 1, stream.buffer ( ), offset + _vertices.size ( ) * sizeof ( Vector3 ), sizeof ( Vector3 ) );
+	}
+
+	return true;
+}
+
+
+void DynamicMesh::clear ( ) {
+	_draws.clear ( );
+}
+
+
+void DynamicMesh::add ( uint32_t instanceCount, uint32_t baseInstance ) {
+	if ( instanceCount > 0 ) {
+		_draws.push_back ( std::make_pair ( instanceCount, baseInstance ) );
+	}
+}
+
+
+void DynamicMesh::draw ( GLStateCache &state ) {
+	if ( _draws.empty ( ) ) {
+		return;
+	}
+
+	state.bindVertexArray ( _vao.id ( ) );
+
+	for ( uint32_t i = 0; i < _draws.size ( ); ++i ) {
+		glDrawElementsInstancedBaseInstance ( GL_TRIANGLES, _indexCount, GL_UNSIGNED_INT, NULL, _draws[i].first, _draws[i].second );
+		DrawCommandBuilder::drawCalls++;
+	}
+}
+
+
+float DynamicMesh::radius ( ) const {
+	float radius = 0.0f;
+
+	for ( uint32_t i = 0; i < _vertices.size ( ); ++i ) {
+		radius = std::max ( radius, glm::dot ( _vertices[i], _vertices[i] ) );
+	}
+
+	return sqrt ( radius ) + fabs ( _deform );
+}
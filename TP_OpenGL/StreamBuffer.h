@@ -0,0 +1,151 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include "GL/glew.h"
+
+#include "Mesh.h"
+#include "GLState.h"
+#include "GpuResource.h"
+#include "Span.h"
+
+// Regions of a stream buffer : the CPU writes one while the GPU reads the others
+#define STREAM_FRAMES 3
+
+// Waves per unit along y of a deforming DynamicMesh
+#define DYNAMIC_WAVE_FREQUENCY 4.0f
+
+/////////////////////////////
+// StreamStats : counters since the last resetStats
+struct StreamStats {
+	uint32_t frames;
+	uint32_t waits;			// frames whose region was still read by the GPU
+	double waitMs;			// time blocked on those fences
+	uint64_t bytes;
+	uint32_t overflows;		// allocations refused, the region was full
+};
+
+/////////////////////////////
+// StreamBuffer
+// One buffer created with glBufferStorage, mapped persistent and coherent
+// once for its whole life, split in STREAM_FRAMES regions. begin() waits
+// for the fence of the region it reuses, end() fences it after the draws
+// of the frame : the driver never has to synchronize a buffer update.
+class StreamBuffer {
+
+public:
+	StreamBuffer ( );
+	~StreamBuffer ( );
+
+	// alignment : of every allocation, GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT for uniforms
+	void init ( GLsizeiptr regionSize, GLsizeiptr alignment );
+	void release ( );
+
+	// Grows the regions, after waiting for the GPU on all of them
+	void reserve ( GLsizeiptr regionSize );
+
+	void begin ( );
+	void end ( );
+
+	// Space in the region of the frame, NULL when it is full. offset is
+	// from the start of the buffer, ready for glBindBufferRange
+	void *allocate ( GLsizeiptr size, GLintptr &offset );
+
+	GLuint buffer ( ) const { return _buffer.id ( ); }
+	GLsizeiptr regionSize ( ) const { return _regionSize; }
+	GLsizeiptr alignment ( ) const { return _alignment; }
+
+	const StreamStats &stats ( ) const { return _stats; }
+	void resetStats ( );
+
+private:
+	void wait ( uint32_t region );
+
+	Buffer _buffer;
+	uint8_t *_data;
+
+	GLsizeiptr _regionSize;
+	GLsizeiptr _alignment;
+	GLsizeiptr _head;			// first free byte of the current region
+	uint32_t _region;
+
+	GLsync _fences[STREAM_FRAMES];
+
+	StreamStats _stats;
+};
+
+/////////////////////////////
+// DynamicMesh
+// A mesh whose vertices are rewritten on the CPU every frame (a rotation
+// here), streamed through a StreamBuffer. The indices and the instances do
+// not move : only the two vertex bindings of its VAO follow the stream.
+// A deforming mesh also has its rest vertices moved by a wave along their
+// normals. Its normals are then recomputed every frame : on the CPU with
+// the Mesh reference, or on the GPU from the streamed positions, in which
+// case only the positions are streamed and binding 1 reads the normals of
+// a MeshCompute buffer.
+class DynamicMesh {
+
+public:
+	DynamicMesh ( );
+	DynamicMesh ( DynamicMesh &&other );
+	~DynamicMesh ( );
+
+	DynamicMesh &operator=( DynamicMesh &&other );
+
+	// deform : amplitude of the wave, 0 for a rigid mesh
+	void init ( std::vector<Vector3> &vertices, std::vector<Vector3> &normals, Span<const uint32_t> indices, float deform = 0.0f );
+	void release ( );
+
+	void setInstanceBuffer ( GLuint buffer );
+
+	// Normals computed on the GPU, 3 floats per vertex : the positions only are streamed
+	void setNormalBuffer ( GLuint buffer );
+
+	// Vertices and normals turned by angle around axis, written in the stream.
+	// phase : of the wave of a deforming mesh. offset : of the positions
+	bool stream ( StreamBuffer &stream, float angle, const Vector3 &axis, float phase, GLintptr &offset, JobSystem *jobs = NULL );
+
+	// Draws of the frame, in the order of the instance runs
+	void clear ( );
+	void add ( uint32_t instanceCount, uint32_t baseInstance );
+
+	// Its own VAO is bound
+	void draw ( GLStateCache &state );
+
+	// Bytes streamed per frame
+	GLsizeiptr frameSize ( ) const { return _vertices.size ( ) * ( _gpuNormals ? 1 : 2 ) * sizeof ( Vector3 ); }
+
+	// Radius of the rest vertices around the origin, plus the amplitude of
+	// the wave : the bounds of every rotation and deformation
+	float radius ( ) const;
+
+	float deform ( ) const { return _deform; }
+	uint32_t vertexCount ( ) const { return _vertices.size ( ); }
+	const std::vector<uint32_t> &indices ( ) const { return _indices; }
+
+private:
+	DynamicMesh ( const DynamicMesh & ) = delete;
+	DynamicMesh &operator=( const DynamicMesh & ) = delete;
+
+	std::vector<Vector3> _vertices;		// rest pose
+	std::vector<Vector3> _normals;
+	uint32_t _indexCount;
+
+	Buffer _indexBuffer;
+	VertexArray _vao;
+
+	// Deforming mesh : its triangles, the faces of each vertex and the
+	// vertices of the frame before the rotation
+	float _deform;
+	bool _gpuNormals;
+	std::vector<uint32_t> _indices;
+	std::vector<uint32_t> _offsets;
+	std::vector<uint32_t> _faces;
+	std::vector<Vector3> _deformed;
+	std::vector<Vector3> _deformedNormals;
+	std::vector<Vector3> _faceNormals;
+
+	std::vector<std::pair<uint32_t, uint32_t> > _draws;	// instance count, base instance
+};
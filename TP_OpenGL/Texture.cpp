@@ -1,56 +1,8 @@
 #include "Texture.h"
 
-GLuint loadBMP_custom ( const char * imagepath ) {
-
-	printf ( "Reading image %s\n", imagepath );
-
-	// Data read from the header of the BMP file
-	unsigned char header[54];
-	unsigned int dataPos;
-	unsigned int imageSize;
-	unsigned int width, height;
-	// Actual RGB data
-	unsigned char * data;
-
-	// Open the file
-	FILE * file = fopen ( imagepath, "rb" );
-	if ( !file ) { printf ( "%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath ); getchar ( ); return 0; }
-
-	// Read the header, i.e. the 54 first bytes
-
-	// If less than 54 bytes are read, problem
-	if ( fread ( header, 1, 54, file ) != 54 ) {
-		printf ( "Not a correct BMP file\n" );
-		return 0;
-	}
-	// A BMP files always begins with "BM"
-	if ( header[0] != 'B' || header[1] != 'M' ) {
-		printf ( "Not a correct BMP file\n" );
-		return 0;
-	}
-	// Make sure this is a 24bpp file
-	if ( *( int* ) &( header[0x1E] ) != 0 ) { printf ( "Not a correct BMP file\n" );    return 0; }
-	if ( *( int* ) &( header[0x1C] ) != 24 ) { printf ( "Not a correct BMP file\n" );    return 0; }
-
-	// Read the information about the image
-	dataPos = *( int* ) &( header[0x0A] );
-	imageSize = *( int* ) &( header[0x22] );
-	width = *( int* ) &( header[0x12] );
-	height = *( int* ) &( header[0x16] );
-
-	// Some BMP files are misformatted, guess missing information
-	if ( imageSize == 0 )    imageSize = width*height * 3; // 3 : one byte for each Red, Green and Blue component
-	if ( dataPos == 0 )      dataPos = 54; // The BMP header is done that way
-
-	// Create a buffer
-	data = new unsigned char[imageSize];
-
-	// Read the actual data from the file into the buffer
-	fread ( data, 1, imageSize, file );
-
-	// Everything is in memory now, the file wan be closed
-	fclose ( file );
+#include <cstdio>
 
+Texture uploadTexture ( const Image &image ) {
 	// Create one OpenGL texture
 	GLuint textureID;
 	glGenTextures ( 1, &textureID );
@@ -59,10 +11,7 @@ GLuint loadBMP_custom ( const char * imagepath ) {
 	glBindTexture ( GL_TEXTURE_2D, textureID );
 
 	// Give the image to OpenGL
-	glTexImage2D ( GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data );
-
-	// OpenGL has now copied the data. Free our own version
-	delete[] data;
+	glTexImage2D ( GL_TEXTURE_2D, 0, GL_RGBA8, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &image.pixels[0] );
 
 	// Poor filtering, or ...
 	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -75,7 +24,19 @@ GLuint loadBMP_custom ( const char * imagepath ) {
 	glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
 	glGenerateMipmap ( GL_TEXTURE_2D );
 
-	// Return the ID of the texture we just created
-	return textureID;
+	// Return the texture we just created, deleted with its handle
+	return Texture ( textureID );
 }
 
+
+GLuint loadBMP_custom ( const char * imagepath ) {
+	printf ( "Reading image %s\n", imagepath );
+
+	Image image;
+
+	if ( !decodeBMP ( imagepath, image ) ) {
+		return 0;
+	}
+
+	return uploadTexture ( image ).release ( );
+}
@@ -2,6 +2,15 @@
 
 #include <GL/glew.h>
 
+#include "GpuResource.h"
+#include "Image.h"
+
 #include <iostream>
+#include <vector>
+#include <stdint.h>
+
+// Mipmapped RGBA8 texture of an image decoded on the CPU (Image.h)
+Texture uploadTexture ( const Image &image );
 
+// The caller owns the returned name
 GLuint loadBMP_custom ( const char * imagepath );
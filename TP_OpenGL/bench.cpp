@@ -0,0 +1,106 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "GeometryBenchmark.h"
+#include "JobBenchmark.h"
+#include "LightBenchmark.h"
+#include "MeshCodec.h"
+#include "OcclusionBenchmark.h"
+#include "SceneBenchmark.h"
+
+// Benchmarks of the program without GL : the same options as TP_OpenGL,
+// for the machines without a display and for the profiles of the
+// optimized builds. Exits with -1 when a benchmark finds a wrong result
+int main ( int argc, char **argv ) {
+	bool bench_jobs = false;
+	bool bench_geometry = false;
+	bool bench_codec = false;
+	bool bench_lights = false;
+	bool bench_occlusion = false;
+	bool bench_scene = false;
+	const char *bench_json = NULL;			// stdout when not given
+	uint64_t bench_triangles = 1310720;		// icospheres up to 8 subdivisions
+	uint32_t codec_bits = MESH_CODEC_BITS;
+	uint32_t light_count = 10000;
+	uint32_t job_threads = 0;
+
+	for ( int i = 1; i < argc; ++i ) {
+		if ( strcmp ( argv[i], "--bench-jobs" ) == 0 ) {
+			bench_jobs = true;
+		}
+		else if ( strcmp ( argv[i], "--bench-geometry" ) == 0 ) {
+			bench_geometry = true;
+		}
+		else if ( strcmp ( argv[i], "--bench-codec" ) == 0 ) {
+			bench_codec = true;
+		}
+		else if ( strcmp ( argv[i], "--bench-lights" ) == 0 ) {
+			bench_lights = true;
+		}
+		else if ( strcmp ( argv[i], "--bench-occlusion" ) == 0 ) {
+			bench_occlusion = true;
+		}
+		else if ( strcmp ( argv[i], "--bench-scene" ) == 0 ) {
+			bench_scene = true;
+		}
+		else if ( strcmp ( argv[i], "--bench-json" ) == 0 && i + 1 < argc ) {
+			bench_json = argv[++i];
+		}
+		else if ( strcmp ( argv[i], "--bench-triangles" ) == 0 && i + 1 < argc ) {
+			bench_triangles = strtoull ( argv[++i], NULL, 10 );
+		}
+		else if ( strcmp ( argv[i], "--codec-bits" ) == 0 && i + 1 < argc ) {
+			codec_bits = atoi ( argv[++i] );
+		}
+		else if ( strcmp ( argv[i], "--lights" ) == 0 && i + 1 < argc ) {
+			light_count = atoi ( argv[++i] );
+		}
+		else if ( strcmp ( argv[i], "--threads" ) == 0 && i + 1 < argc ) {
+			job_threads = atoi ( argv[++i] );
+		}
+	}
+
+	if ( !bench_jobs && !bench_geometry && !bench_codec && !bench_lights && !bench_occlusion && !bench_scene ) {
+		printf ( "Usage: %s [--bench-jobs] [--bench-geometry] [--bench-codec] [--bench-lights] [--bench-occlusion] [--bench-scene]\n"
+				 "       [--bench-json file] [--bench-triangles n] [--codec-bits n] [--lights n] [--threads n]\n", argv[0] );
+		return -1;
+	}
+
+	// Toutes les mesures demandees, l'echec d'une seule fait echouer le programme
+	bool ok = true;
+
+	if ( bench_jobs ) {
+		ok = benchmarkJobs ( job_threads ) && ok;
+	}
+
+	if ( bench_geometry ) {
+		ok = benchmarkGeometry ( bench_json, bench_triangles, job_threads ) && ok;
+	}
+
+	if ( bench_codec ) {
+		std::vector<std::string> files;
+		files.push_back ( "buddha.off" );
+		files.push_back ( "max.off" );
+
+		ok = benchmarkCodec ( bench_json, files, codec_bits, job_threads ) && ok;
+	}
+
+	if ( bench_lights ) {
+		ok = benchmarkLights ( bench_json, light_count, job_threads ) && ok;
+	}
+
+	// Boites de 24 x 24 x 24 positions autour du mur
+	if ( bench_occlusion ) {
+		ok = benchmarkOcclusion ( bench_json, 24 ) && ok;
+	}
+
+	// La hierarchie de orbits.scene, 20000 boites dans l'octree
+	if ( bench_scene ) {
+		ok = benchmarkScene ( bench_json, "orbits.scene", 20000 ) && ok;
+	}
+
+	return ok ? 0 : -1;
+}
@@ -3,21 +3,47 @@
 #include <sstream>
 #include <ctime>
 #include <vector>
+#include <algorithm>
 #include <list>
-
-#include "Mesh.h";
-#include "Texture.h";
+#include <deque>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+#include "Mesh.h"
+#include "Texture.h"
+#include "ShadowMap.h"
+#include "ShadowFilter.h"
+#include "Instancing.h"
+#include "GeometryArena.h"
+#include "OcclusionCulling.h"
+#include "GLState.h"
+#include "RenderGraph.h"
+#include "ShaderManager.h"
+#include "ShaderVariants.h"
+#include "FrameLoop.h"
+#include "AssetLoader.h"
+#include "JobSystem.h"
+#include "LinearArena.h"
+#include "Scene.h"
+#include "LooseOctree.h"
+#include "StreamBuffer.h"
+#include "MeshCodec.h"
+#include "ProgressiveMesh.h"
+#include "LightClusters.h"
+#include "DynamicResolution.h"
+#include "MeshCompute.h"
 #include "Global.h"
 
 #include <GL/glew.h>
-#include <GL/glfw3.h>
-#include <GL/GL.h>
+#include <GLFW/glfw3.h>
+#include <GL/gl.h>
 
-#include <glm\glm\vec3.hpp>
-#include <glm\glm\mat4x4.hpp>
-//#include <glm\glm\gtx\transform.hpp>
-#include <glm\glm\gtc\matrix_transform.hpp>
-#include <glm\glm\gtc\type_ptr.hpp>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+//#include <glm/gtx/transform.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 
 #ifndef M_PI
@@ -28,10 +54,79 @@
 #define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
 #define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
 
+// Levels of the scene octree below its root
+#define OCTREE_DEPTH 8
+
+// Binding of the SceneUniforms block of basic.vsl
+#define SCENE_UNIFORMS_BINDING 0
+
+// Bindings of the clustered lighting in basic.fsl : its uniform block and its three storage buffers
+#define CLUSTER_UNIFORMS_BINDING 1
+#define CLUSTER_LIGHTS_BINDING 0
+#define CLUSTER_RANGES_BINDING 1
+#define CLUSTER_INDICES_BINDING 2
+
+// Strength of the --upscale sharpen filter, 0 to 1
+#define UPSCALE_SHARPNESS 0.5f
+
+// Radians per second of the wave of the deforming meshes
+#define DEFORM_WAVE_SPEED 3.0
+
 int WIDTH, HEIGHT;
 
-void render ( GLFWwindow* );
+// Size the scene is drawn at : WIDTH x HEIGHT, less with the dynamic resolution
+int RENDER_WIDTH, RENDER_HEIGHT;
+
+void update ( double );
+void render ( GLFWwindow*, double );
 void init ( );
+void shutdown ( );
+void uploadAssets ( bool );
+void reportFirstFrame ( );
+void buildRenderGraph ( );
+uint32_t sceneShaderKey ( );
+void benchmarkInstances ( GLFWwindow* );
+void runHeadless ( GLFWwindow* );
+void printFrameStats ( uint64_t );
+bool validateNormals ( const char* );
+void assignLights ( double );
+
+// Command line options
+const char *scene_file = "default.scene";
+uint32_t instance_count = 0;		// copies per grid of the scene, 0 : as in the file
+bool bench_instances = false;
+bool debug_depth_view = false;
+bool gl_stats = false;
+int shadow_filter = -1;
+bool specular = false;
+bool debug_normals = false;
+bool depth_prepass = false;
+bool front_to_back = false;
+bool headless = false;
+uint32_t headless_frames = 100;
+OcclusionSource occlusion = OCCLUSION_OFF;
+double fps_cap = 0.0;
+bool vsync = false;
+double update_rate = 60.0;
+bool frame_stats = false;
+uint32_t job_threads = 0;
+uint32_t codec_bits = MESH_CODEC_BITS;
+const char *encode_input = NULL;		// --encode-mesh : OFF or OBJ file to compress
+const char *encode_output = NULL;
+const char *progressive_input = NULL;	// --encode-progressive : OFF or OBJ file to cut in levels
+const char *progressive_output = NULL;
+uint32_t upload_budget = 8;				// MB copied to the arena per frame, 0 : no limit
+uint32_t light_count = 0;				// --lights : point lights added around the scene
+bool dynamic_res = false;
+double frame_budget = 16.0;				// --frame-budget : GPU ms per frame the dynamic resolution aims at
+float min_scale = 0.5f;
+bool upscale_sharpen = false;			// --upscale sharpen, else bilinear
+const char *res_trace = NULL;			// --res-trace : CSV of the GPU time and scale of every frame
+bool deform_gpu = true;					// --deform-normals gather|scatter on the GPU, cpu : Mesh reference
+const char *validate_normals = NULL;	// --validate-normals [file] : GPU normals and bounds against the CPU
+
+// Start of the process : the time to the first frame is measured from here
+std::chrono::high_resolution_clock::time_point program_start;
 
 #define glInfo(a) std::cout << #a << ": " << glGetString(a) << std::endl
 
@@ -47,9 +142,147 @@ void debug ( GLenum, // source
 	std::cout << "DEBUG: " << message << std::endl;
 }
 
-int main ( void ) {
+int main ( int argc, char **argv ) {
 	GLFWwindow* window;
 
+	program_start = std::chrono::high_resolution_clock::now ( );
+
+	for ( int i = 1; i < argc; ++i ) {
+		if ( strcmp ( argv[i], "--instances" ) == 0 && i + 1 < argc ) {
+			instance_count = atoi ( argv[++i] );
+		}
+		else if ( strcmp ( argv[i], "--scene" ) == 0 && i + 1 < argc ) {
+			scene_file = argv[++i];
+		}
+		else if ( strcmp ( argv[i], "--bench-instances" ) == 0 ) {
+			bench_instances = true;
+		}
+		else if ( strcmp ( argv[i], "--debug-depth" ) == 0 ) {
+			debug_depth_view = true;
+		}
+		else if ( strcmp ( argv[i], "--gl-stats" ) == 0 ) {
+			gl_stats = true;
+		}
+		else if ( strcmp ( argv[i], "--shadow-filter" ) == 0 && i + 1 < argc ) {
+			shadow_filter = atoi ( argv[++i] );
+		}
+		else if ( strcmp ( argv[i], "--specular" ) == 0 ) {
+			specular = true;
+		}
+		else if ( strcmp ( argv[i], "--debug-normals" ) == 0 ) {
+			debug_normals = true;
+		}
+		else if ( strcmp ( argv[i], "--depth-prepass" ) == 0 ) {
+			depth_prepass = true;
+		}
+		else if ( strcmp ( argv[i], "--front-to-back" ) == 0 ) {
+			front_to_back = true;
+		}
+		else if ( strcmp ( argv[i], "--headless" ) == 0 ) {
+			headless = true;
+		}
+		else if ( strcmp ( argv[i], "--frames" ) == 0 && i + 1 < argc ) {
+			headless_frames = atoi ( argv[++i] );
+		}
+		else if ( strcmp ( argv[i], "--occlusion" ) == 0 && i + 1 < argc ) {
+			i++;
+			occlusion = strcmp ( argv[i], "cpu" ) == 0 ? OCCLUSION_CPU : strcmp ( argv[i], "gpu" ) == 0 ? OCCLUSION_GPU : OCCLUSION_OFF;
+		}
+		else if ( strcmp ( argv[i], "--fps-cap" ) == 0 && i + 1 < argc ) {
+			fps_cap = atof ( argv[++i] );
+		}
+		else if ( strcmp ( argv[i], "--vsync" ) == 0 ) {
+			vsync = true;
+		}
+		else if ( strcmp ( argv[i], "--update-rate" ) == 0 && i + 1 < argc ) {
+			update_rate = std::max ( atof ( argv[++i] ), 1.0 );
+		}
+		else if ( strcmp ( argv[i], "--frame-stats" ) == 0 ) {
+			frame_stats = true;
+		}
+		else if ( strcmp ( argv[i], "--threads" ) == 0 && i + 1 < argc ) {
+			job_threads = atoi ( argv[++i] );
+		}
+		else if ( strcmp ( argv[i], "--codec-bits" ) == 0 && i + 1 < argc ) {
+			codec_bits = atoi ( argv[++i] );
+		}
+		else if ( strcmp ( argv[i], "--encode-mesh" ) == 0 && i + 2 < argc ) {
+			encode_input = argv[++i];
+			encode_output = argv[++i];
+		}
+		else if ( strcmp ( argv[i], "--encode-progressive" ) == 0 && i + 2 < argc ) {
+			progressive_input = argv[++i];
+			progressive_output = argv[++i];
+		}
+		else if ( strcmp ( argv[i], "--upload-budget" ) == 0 && i + 1 < argc ) {
+			upload_budget = atoi ( argv[++i] );
+		}
+		else if ( strcmp ( argv[i], "--dynamic-res" ) == 0 ) {
+			dynamic_res = true;
+		}
+		else if ( strcmp ( argv[i], "--frame-budget" ) == 0 && i + 1 < argc ) {
+			frame_budget = atof ( argv[++i] );
+		}
+		else if ( strcmp ( argv[i], "--min-scale" ) == 0 && i + 1 < argc ) {
+			min_scale = ( float ) atof ( argv[++i] );
+		}
+		else if ( strcmp ( argv[i], "--upscale" ) == 0 && i + 1 < argc ) {
+			upscale_sharpen = strcmp ( argv[++i], "sharpen" ) == 0;
+		}
+		else if ( strcmp ( argv[i], "--res-trace" ) == 0 && i + 1 < argc ) {
+			res_trace = argv[++i];
+		}
+		else if ( strcmp ( argv[i], "--lights" ) == 0 && i + 1 < argc ) {
+			light_count = atoi ( argv[++i] );
+		}
+		else if ( strcmp ( argv[i], "--deform-normals" ) == 0 && i + 1 < argc ) {
+			i++;
+			deform_gpu = strcmp ( argv[i], "cpu" ) != 0;
+			MeshCompute::scatter = strcmp ( argv[i], "scatter" ) == 0;
+		}
+		else if ( strcmp ( argv[i], "--validate-normals" ) == 0 ) {
+			validate_normals = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : "buddha.off";
+		}
+	}
+
+	// Le mesh est compresse tel que le rendu le voit : centre et normalise
+	if ( encode_input != NULL ) {
+		JobSystem jobs;
+		jobs.init ( job_threads );
+
+		size_t length = strlen ( encode_input );
+		Mesh mesh = length >= 4 && strcmp ( encode_input + length - 4, ".obj" ) == 0 ?
+			Mesh::loadOBJ ( encode_input, false, &jobs ) : Mesh::loadOFF ( encode_input, false, &jobs );
+
+		if ( !MeshCodec::save ( encode_output, mesh, codec_bits, &jobs ) ) {
+			return -1;
+		}
+
+		printf ( "%s: %u vertices, %u faces written to %s\n", encode_input, mesh._vertexCount, mesh._facesCount, encode_output );
+		return 0;
+	}
+
+	// Niveaux du plus grossier au complet, chacun compresse
+	if ( progressive_input != NULL ) {
+		JobSystem jobs;
+		jobs.init ( job_threads );
+
+		size_t length = strlen ( progressive_input );
+		Mesh mesh = length >= 4 && strcmp ( progressive_input + length - 4, ".obj" ) == 0 ?
+			Mesh::loadOBJ ( progressive_input, false, &jobs ) : Mesh::loadOFF ( progressive_input, false, &jobs );
+
+		std::vector<ProgressiveLevelInfo> levels;
+		if ( !ProgressiveMesh::save ( progressive_output, mesh, codec_bits, &jobs ) || !ProgressiveMesh::readTable ( progressive_output, levels ) ) {
+			return -1;
+		}
+
+		printf ( "%s: %u levels written to %s\n", progressive_input, ( uint32_t ) levels.size ( ), progressive_output );
+		for ( uint32_t l = 0; l < levels.size ( ); ++l ) {
+			printf ( "  level %u: %u triangles, %u bytes\n", l, levels[l].triangles, levels[l].size );
+		}
+		return 0;
+	}
+
 	/* Initialize the library */
 	if ( !glfwInit ( ) ) {
 		std::cerr << "Could not init glfw" << std::endl;
@@ -57,7 +290,10 @@ int main ( void ) {
 	}
 
 	// This is a debug context, this is slow, but debugs, which is interesting
-	glfwWindowHint ( GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE );
+	// The benchmark and the headless mode run without it, in a hidden window
+	bool hidden = bench_instances || headless || validate_normals != NULL;
+	glfwWindowHint ( GLFW_OPENGL_DEBUG_CONTEXT, hidden ? GL_FALSE : GL_TRUE );
+	glfwWindowHint ( GLFW_VISIBLE, hidden ? GL_FALSE : GL_TRUE );
 
 	/* Create a windowed mode window and its OpenGL context */
 	window = glfwCreateWindow ( 800, 800, "OpenGL PORTAL", NULL, NULL );
@@ -90,234 +326,519 @@ int main ( void ) {
 
 	glDebugMessageCallback ( GLDEBUGPROC ( debug ), nullptr );
 
+	// The render graph sizes its targets when it is built
+	glfwGetFramebufferSize ( window, &WIDTH, &HEIGHT );
+
 	// This is our openGL init function which creates ressources
 	init ( );
 
+	if ( bench_instances ) {
+		uploadAssets ( true );
+		benchmarkInstances ( window );
+		shutdown ( );
+		glfwTerminate ( );
+		return 0;
+	}
+
+	if ( headless ) {
+		uploadAssets ( true );
+		runHeadless ( window );
+		shutdown ( );
+		glfwTerminate ( );
+		return 0;
+	}
+
+	if ( validate_normals != NULL ) {
+		bool ok = validateNormals ( validate_normals );
+		shutdown ( );
+		glfwTerminate ( );
+		return ok ? 0 : -1;
+	}
+
+	// The meshes keep loading in the background : the first frames draw what is ready
+	FrameLoop loop;
+	loop.init ( update_rate, fps_cap, vsync );
+
+	double last_stats = glfwGetTime ( );
+	bool first_frame = true;
+
 	/* Loop until the user closes the window */
 	while ( !glfwWindowShouldClose ( window ) ) {
-		/* Render here */
-		render ( window );
+		uint32_t updates = loop.begin ( );
+
+		uploadAssets ( false );
+
+		/* Advance the simulation by fixed steps */
+		for ( uint32_t i = 0; i < updates; ++i ) {
+			update ( loop.step ( ) );
+		}
+
+		/* Render here, between the two last states */
+		render ( window, loop.alpha ( ) );
 
 		/* Swap front and back buffers */
 		glfwSwapBuffers ( window );
 
+		if ( first_frame ) {
+			reportFirstFrame ( );
+			first_frame = false;
+		}
+
 		/* Poll for and process events */
 		glfwPollEvents ( );
+
+		loop.end ( );
+
+		if ( frame_stats && glfwGetTime ( ) - last_stats > 5.0 ) {
+			loop.print ( );
+			last_stats = glfwGetTime ( );
+		}
 	}
 
+	loop.print ( );
+
+	shutdown ( );
 	glfwTerminate ( );
 	return 0;
 }
 
-// Build a shader from a string
-GLuint buildShader ( GLenum const shaderType, std::string const src ) {
-	GLuint shader = glCreateShader ( shaderType );
+/****************************************************************
+******* INTERESTING STUFFS HERE ********************************
+***************************************************************/
 
-	const char* ptr = src.c_str ( );
-	GLint length = src.length ( );
+// GPU side of a scene mesh, filled when its asset is uploaded
+struct SceneMeshState {
+	uint32_t asset;
+	bool loaded;			// a level is in the arena : the mesh is drawn
+	bool complete;			// the full mesh is : it may hide the others
+	uint32_t level;
+	GeometryAllocation geometry;
+	Vector3 bbMin, bbMax;
+	std::vector<MeshCluster> clusters;
+	uint32_t occluder;
+	uint32_t caster;
+	uint32_t baseInstance;
+	uint32_t instanceCount;
+	bool animated;			// one of its nodes moves : its shadow is redrawn with it
+
+	// Vertices rotated every frame : drawn from the stream, not from the arena
+	uint32_t dynamic;		// index in gs.dynamic_meshes, SCENE_NONE when static
+	double angle;
+	double previous_angle;
+
+	// Deforming : phase of its wave, its normals and bounds from the GPU
+	uint32_t compute;		// mesh of gs.mesh_compute, SCENE_NONE for the CPU normals
+	double phase;
+	double previous_phase;
+};
+
+// An asset in the arena, not fully copied yet
+struct PendingUpload {
+	MeshAsset asset;
+	uint32_t mesh;
+	GeometryAllocation geometry;
+	size_t progress;		// bytes copied
+};
+
+// Layout std140 of the SceneUniforms block of basic.vsl
+struct SceneUniforms {
+	glm::mat4 mvp;
+	glm::mat4 scene_model;
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 lightspace_matrix;
+	glm::vec4 light_worldspace;
+	glm::vec4 light_pos;
+};
+
+// Layout std140 of the ClusterUniforms block of basic.fsl
+struct ClusterUniforms {
+	glm::mat4 view;
+	glm::vec4 params;		// tiles per pixel in x and y, slice scale and bias
+};
 
-	glShaderSource ( shader, 1, &ptr, &length );
+// Store the global state of your program
+struct {
+	ShaderManager shaders;
+	ShaderVariants basic_shader; // a shader
+	ShaderVariants shadowmap_shader;
+	ShaderVariants upscale_shader;
+	uint32_t texture_shader;
+
+	ShadowMap shadowMap;
+	ShadowFilter shadowFilter;
+
+	GpuMesh quad;
+
+	// All the meshes share the buffers and the VAO of the arena
+	GeometryArena arena;
+
+	// Per-instance transforms and colors : the instances of each mesh are
+	// contiguous. Those modified in a frame are staged in instance_stream
+	InstanceBuffer instances;
+	StreamBuffer instance_stream;
+
+	DrawCommandBuilder sceneCommands;
+
+	// Per-frame data written in place in persistently mapped buffers,
+	// three frames in flight : uniforms of the passes, dynamic vertices
+	StreamBuffer uniform_stream;
+	StreamBuffer vertex_stream;
+	std::vector<DynamicMesh> dynamic_meshes;
+
+	// Normals and bounds of the deforming meshes, from their streamed positions
+	MeshCompute mesh_compute;
+
+	// Point lights of the scene after the first one and the --lights ones,
+	// which turn around the scene at their own speed. Assigned to the
+	// clusters every frame, streamed as three storage buffers
+	LightClusters light_clusters;
+	StreamBuffer light_stream;
+	std::vector<ClusterLight> lights;
+	std::vector<float> light_speeds;
+	std::vector<ClusterLight> frame_lights;
+	GLintptr light_offsets[3];			// lights, cluster ranges, indices in the stream
+	GLsizeiptr light_sizes[3];
+
+	// Meshes, lights and node hierarchy of the scene file. The octree holds
+	// the world bounds of the nodes whose mesh is loaded
+	Scene scene;
+	LooseOctree octree;
+	std::vector<SceneMeshState> meshes;
+	std::vector<uint32_t> node_instance;		// SCENE_NONE for the nodes without a mesh
+	std::vector<uint32_t> instance_node;
+	std::vector<uint32_t> changed_nodes;
+
+	// Temporaries of the frame, dropped at once when the next one starts
+	LinearArena frame_arena;
+
+	// Meshes read and prepared by jobs, uploaded here
+	JobSystem jobs;
+	AssetLoader loader;
+	MemoryStats load_memory;		// heap counters when the loading started
+
+	// Assets waiting for the arena, copied a few MB per frame : a frame
+	// never stalls on a large mesh, the coarse levels go first
+	std::deque<PendingUpload> uploads;
+	std::chrono::high_resolution_clock::time_point load_start;
+	bool load_reported;
+
+	// The target of the dynamic resolution is a transient of the graph :
+	// its color, and the pass that leaves its depth for the read back
+	RenderGraph graph;
+	uint32_t scene_color;
+	uint32_t scene_pass;
+	GLStateCache state;
+
+	// GL_SAMPLES_PASSED of the depth pre-pass and of the scene pass (headless)
+	Query samples_queries[2];
+
+	// Offscreen target of the scene and its scale, from the GPU time of the frames
+	DynamicResolution dynamic_res;
+
+	OcclusionCuller occlusion;
+} gs;
 
-	glCompileShader ( shader );
+Vector3 light_pos;
 
-	GLint res;
-	glGetShaderiv ( shader, GL_COMPILE_STATUS, &res );
-	if ( !res ) {
-		std::cerr << "shader compilation error" << std::endl;
+glm::mat4 model;
+glm::mat4 projection;
+glm::mat4 light_projection;
 
-		char message[1000];
+// Camera of the frame, shared by the depth pre-pass and the scene pass :
+// GL_EQUAL needs both to compute exactly the same positions
+glm::vec3 camera_pos;
+glm::mat4 camera_view;
+glm::mat4 camera_mvp;
+
+// Simulation state : the camera turns around the scene at a fixed rate,
+// render() interpolates between the previous and the current angle
+double camera_angle = 0.0;
+double previous_camera_angle = 0.0;
+double light_angle = 0.0;
+double previous_light_angle = 0.0;
+
+// Spreads the 10 bits of v over every third bit
+static uint32_t spreadBits ( uint32_t v ) {
+	v = ( v | ( v << 16 ) ) & 0x030000FF;
+	v = ( v | ( v << 8 ) ) & 0x0300F00F;
+	v = ( v | ( v << 4 ) ) & 0x030C30C3;
+	v = ( v | ( v << 2 ) ) & 0x09249249;
+	return v;
+}
 
-		GLsizei readSize;
-		glGetShaderInfoLog ( shader, 1000, &readSize, message );
-		message[999] = '\0';
+// World bounds of one instance of a loaded mesh in the octree
+void updateNodeBounds ( uint32_t node ) {
+	const SceneMeshState &state = gs.meshes[gs.scene.node ( node ).mesh];
 
-		std::cerr << message << std::endl;
+	Vector3 min, max;
+	gs.instances.calculateBounds ( gs.node_instance[node], 1, state.bbMin, state.bbMax, min, max );
+	gs.octree.update ( node, min, max );
+}
 
-		glfwTerminate ( );
-		exit ( -1 );
+// Instance range and bounds of the shadow caster of a loaded mesh
+void updateCasterBounds ( uint32_t m ) {
+	const SceneMeshState &state = gs.meshes[m];
+
+	// Only the arena is drawn in the shadow map
+	if ( state.dynamic != SCENE_NONE ) {
+		return;
 	}
 
-	return shader;
+	Vector3 min, max;
+	gs.instances.calculateBounds ( state.baseInstance, state.instanceCount, state.bbMin, state.bbMax, min, max );
+	gs.shadowMap.setCasterInstances ( state.caster, state.baseInstance, state.instanceCount, min, max );
 }
 
-// read a file content into a string
-std::string fileGetContents ( const std::string path ) {
-	std::ifstream t ( path );
-	std::stringstream buffer;
-	buffer << t.rdbuf ( );
+// Every instance of the loaded meshes, the culling rebuilds them each frame
+void buildSceneCommands ( ) {
+	gs.sceneCommands.clear ( );
 
-	return buffer.str ( );
+	for ( uint32_t m = 0; m < gs.meshes.size ( ); ++m ) {
+		if ( gs.meshes[m].loaded && gs.meshes[m].dynamic == SCENE_NONE ) {
+			gs.sceneCommands.add ( gs.meshes[m].geometry, gs.meshes[m].instanceCount, gs.meshes[m].baseInstance );
+		}
+	}
 }
 
-// build a program with a vertex shader and a fragment shader
-GLuint buildProgram ( const std::string vertexFile, const std::string fragmentFile ) {
-	auto vshader = buildShader ( GL_VERTEX_SHADER, fileGetContents ( vertexFile ) );
-	auto fshader = buildShader ( GL_FRAGMENT_SHADER, fileGetContents ( fragmentFile ) );
+// Lays out the instances mesh by mesh. The nodes of a mesh follow a Morton
+// order, so that the instances kept by a frustum query form long runs
+void layoutInstances ( ) {
+	const Scene &scene = gs.scene;
+	gs.scene.updateTransforms ( );
+
+	// Cube around the instance origins : octree root and Morton grid
+	Vector3 min ( 1e30f, 1e30f, 1e30f ), max ( -1e30f, -1e30f, -1e30f );
+
+	for ( uint32_t n = 0; n < scene.nodeCount ( ); ++n ) {
+		if ( scene.node ( n ).mesh != SCENE_NONE ) {
+			min = glm::min ( min, Vector3 ( scene.node ( n ).world[3] ) );
+			max = glm::max ( max, Vector3 ( scene.node ( n ).world[3] ) );
+		}
+	}
 
-	GLuint program = glCreateProgram ( );
+	if ( min.x > max.x ) {
+		min = max = Vector3 ( 0.0f, 0.0f, 0.0f );
+	}
 
-	glAttachShader ( program, vshader );
-	glAttachShader ( program, fshader );
+	Vector3 extent = ( max - min ) * 0.5f;
+	float half = std::max ( extent.x, std::max ( extent.y, extent.z ) ) + 1.0f;
+	Vector3 corner = ( min + max ) * 0.5f - Vector3 ( half, half, half );
 
-	glLinkProgram ( program );
+	gs.octree.init ( ( min + max ) * 0.5f, half, OCTREE_DEPTH );
 
-	GLint res;
-	glGetProgramiv ( program, GL_LINK_STATUS, &res );
-	if ( !res ) {
-		std::cerr << "program link error" << std::endl;
+	gs.node_instance.assign ( scene.nodeCount ( ), SCENE_NONE );
+	gs.instance_node.clear ( );
+	gs.instances.clear ( );
 
-		char message[1000];
+	std::vector<std::pair<uint32_t, uint32_t> > order;
 
-		GLsizei readSize;
-		glGetProgramInfoLog ( program, 1000, &readSize, message );
-		message[999] = '\0';
+	for ( uint32_t m = 0; m < gs.meshes.size ( ); ++m ) {
+		SceneMeshState &state = gs.meshes[m];
 
-		std::cerr << message << std::endl;
+		order.clear ( );
 
-		glfwTerminate ( );
-		exit ( -1 );
+		for ( uint32_t n = 0; n < scene.nodeCount ( ); ++n ) {
+			if ( scene.node ( n ).mesh != m ) {
+				continue;
+			}
+
+			Vector3 p = ( Vector3 ( scene.node ( n ).world[3] ) - corner ) / ( 2.0f * half ) * 1023.0f;
+			p = glm::min ( glm::max ( p, Vector3 ( 0.0f, 0.0f, 0.0f ) ), Vector3 ( 1023.0f, 1023.0f, 1023.0f ) );
+			uint32_t code = spreadBits ( ( uint32_t ) p.x ) | ( spreadBits ( ( uint32_t ) p.y ) << 1 ) | ( spreadBits ( ( uint32_t ) p.z ) << 2 );
+
+			order.push_back ( std::make_pair ( code, n ) );
+		}
+
+		std::sort ( order.begin ( ), order.end ( ) );
+
+		state.baseInstance = gs.instances.count ( );
+		state.instanceCount = order.size ( );
+		state.animated = false;
+
+		for ( uint32_t i = 0; i < order.size ( ); ++i ) {
+			const SceneNode &node = scene.node ( order[i].second );
+
+			gs.node_instance[order[i].second] = gs.instances.add ( node.world, node.color );
+			gs.instance_node.push_back ( order[i].second );
+
+			state.animated = state.animated || scene.animated ( order[i].second );
+		}
 	}
 
-	return program;
-}
+	gs.instances.upload ( );
+	gs.arena.setInstanceBuffer ( gs.instances.buffer ( ) );
 
-/****************************************************************
-******* INTERESTING STUFFS HERE ********************************
-***************************************************************/
+	// A frame may move or sort every instance
+	gs.instance_stream.reserve ( gs.instances.count ( ) * sizeof ( Instance ) );
 
-// Store the global state of your program
-struct {
-	GLuint program; // a shader
-	GLuint shadowmap_program;
-	GLuint texture_program;
+	for ( uint32_t d = 0; d < gs.dynamic_meshes.size ( ); ++d ) {
+		gs.dynamic_meshes[d].setInstanceBuffer ( gs.instances.buffer ( ) );
+	}
 
-	GLuint fbo;
-	GLuint depthTexture;
+	// The bounds of a mesh come with its asset
+	for ( uint32_t m = 0; m < gs.meshes.size ( ); ++m ) {
+		if ( !gs.meshes[m].loaded ) {
+			continue;
+		}
 
-	//GLuint vao_quad;
-	GLuint vertexBuffer_texture;
-	GLuint uvBuffer_texture;
+		for ( uint32_t k = gs.meshes[m].baseInstance; k < gs.meshes[m].baseInstance + gs.meshes[m].instanceCount; ++k ) {
+			updateNodeBounds ( gs.instance_node[k] );
+		}
 
-	GLuint vao; // a vertex array object
-	GLuint vertexBuffer;
-	GLuint normalBuffer;
+		updateCasterBounds ( m );
+	}
 
-	GLuint vao_ground; // a vertex array object
-	GLuint vertexBuffer_ground;
-	GLuint normalBuffer_ground;
-} gs;
+	buildSceneCommands ( );
+}
 
-GLuint mesh_size;
-GLuint ground_size;
-Vector3 light_pos;
+// Regenerates the grids of the scene with count copies each (0 : as in the file)
+void placeInstances ( uint32_t count ) {
+	gs.scene.setGridCount ( count );
+	layoutInstances ( );
+}
 
-glm::mat4 model;
-glm::mat4 projection;
-glm::mat4 light_projection;
+// Moves the instances of the nodes whose transform changed, render() sends them
+void syncScene ( ) {
+	gs.changed_nodes.clear ( );
 
-void init ( ) {
-	// Build our program and an empty VAO
-	gs.program = buildProgram ( "basic.vsl", "basic.fsl" );
-	gs.shadowmap_program = buildProgram ( "shadowmap.vsl", "shadowmap.fsl" );
-	gs.texture_program = buildProgram ( "texture.vsl", "texture.fsl" );
+	if ( gs.scene.updateTransforms ( &gs.changed_nodes ) == 0 ) {
+		return;
+	}
 
-	//Mesh mesh = Mesh::loadOFF ( "buddha.off", false );
-	Mesh mesh	= Mesh::loadOBJ ( "suzanne.obj", false );
-	Mesh ground = Mesh::loadOBJ ( "cube.obj", false );
+	ArenaVector<uint8_t> moved ( gs.meshes.size ( ), 0, ArenaAllocator<uint8_t> ( &gs.frame_arena ) );
 
-	//mesh.rotate ( M_PI / 2, Vector3 ( 1.0f, .0f, .0f ) ); // for girl.obj
-	mesh.scale ( Vector3 ( 3.0f, 3.0f, 3.0f ) );
+	for ( uint32_t i = 0; i < gs.changed_nodes.size ( ); ++i ) {
+		uint32_t node = gs.changed_nodes[i];
+		uint32_t instance = gs.node_instance[node];
 
-	ground.scale ( Vector3 ( 10.0f, .25f, 10.0f ) );
-	ground.translate ( Vector3 ( .0f, -3.0f, .0f ) );
+		if ( instance == SCENE_NONE ) {
+			continue;
+		}
 
-	mesh.indexData ( );
-	ground.indexData ( );
-	
-	mesh_size	= mesh._indexVertexCount;
-	ground_size = ground._indexVertexCount;
+		const SceneNode &n = gs.scene.node ( node );
+		gs.instances.set ( instance, n.world );
 
-	/**** Init Mesh buffers ****/
-	{ 
-		glCreateVertexArrays ( 1, &gs.vao );
-		glBindVertexArray ( gs.vao );
+		if ( gs.meshes[n.mesh].loaded ) {
+			updateNodeBounds ( node );
+			moved[n.mesh] = 1;
+		}
+	}
 
-		// init vertex buffer
-		glGenBuffers ( 1, &gs.vertexBuffer );
-		glBindBuffer ( GL_ARRAY_BUFFER, gs.vertexBuffer );
-		glBufferData ( GL_ARRAY_BUFFER, mesh._indexVertexCount * sizeof ( Vector3 ), &mesh._indexVertices[0], GL_STATIC_DRAW );
+	for ( uint32_t m = 0; m < gs.meshes.size ( ); ++m ) {
+		if ( moved[m] ) {
+			updateCasterBounds ( m );
+		}
+	}
+}
 
-		glBindBuffer ( GL_ARRAY_BUFFER, gs.vertexBuffer );
-		glEnableVertexArrayAttrib ( gs.vao, 1 );
-		glVertexAttribPointer ( 1, 3, GL_FLOAT, GL_FALSE, 0, 0 );
+void init ( ) {
+	resetMemoryPeak ( );
+	gs.load_memory = memoryStats ( );
 
-		glBindBuffer ( GL_ARRAY_BUFFER, 0 );
+	// Build our program and an empty VAO
+	auto shaders_start = std::chrono::high_resolution_clock::now ( );
 
-		// init normal buffer
-		glGenBuffers ( 1, &gs.normalBuffer );
-		glBindBuffer ( GL_ARRAY_BUFFER, gs.normalBuffer );
-		glBufferData ( GL_ARRAY_BUFFER, mesh._indexVertexCount * sizeof ( Vector3 ), &mesh._indexNormals[0], GL_STATIC_DRAW );
-		glBindBuffer ( GL_ARRAY_BUFFER, 0 );
+	if ( shadow_filter >= 0 ) {
+		gs.shadowFilter._mode = ( ShadowFilterMode ) SHADER_SHADOW_FILTER ( shadow_filter );
+	}
+
+	// Only the permutations used by the passes, all submitted before the first status query
+	gs.shaders.init ( "shader_cache" );
+	gs.basic_shader.init ( &gs.shaders, "basic.vsl", "basic.fsl" );
+	gs.basic_shader.request ( sceneShaderKey ( ) );
+	gs.shadowmap_shader.init ( &gs.shaders, "shadowmap.vsl", "shadowmap.fsl" );
+	gs.shadowmap_shader.request ( SHADER_INSTANCED );
+	gs.texture_shader = gs.shaders.load ( "texture.vsl", "texture.fsl" );
+
+	if ( dynamic_res ) {
+		gs.upscale_shader.init ( &gs.shaders, "upscale.vsl", "upscale.fsl" );
+		gs.upscale_shader.request ( upscale_sharpen ? SHADER_SHARPEN : 0 );
+	}
 
-		glBindBuffer ( GL_ARRAY_BUFFER, gs.normalBuffer );
-		glEnableVertexArrayAttrib ( gs.vao, 2 );
-		glVertexAttribPointer ( 2, 3, GL_FLOAT, GL_FALSE, 0, ( void* ) 0 );
-		
-		glBindBuffer ( GL_ARRAY_BUFFER, 0 );
+	if ( deform_gpu || validate_normals != NULL ) {
+		gs.mesh_compute.init ( &gs.shaders );
+	}
 
-		glBindVertexArray ( 0 );
+	if ( !gs.shaders.wait ( ) ) {
+		shutdown ( );
+		glfwTerminate ( );
+		exit ( -1 );
 	}
 
-	/**** Init Ground buffers ****/
+	printf ( "Shaders: %u from cache, %u compiled in %.1f ms\n", gs.shaders.stats ( ).cached, gs.shaders.stats ( ).compiled,
+			 std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - shaders_start ).count ( ) );
+
+	/**** Load the scene, its meshes on the job system ****/
 	{
-		glCreateVertexArrays ( 1, &gs.vao_ground );
-		glBindVertexArray ( gs.vao_ground );
+		auto scene_start = std::chrono::high_resolution_clock::now ( );
 
-		// init vertex buffer
-		glGenBuffers ( 1, &gs.vertexBuffer_ground );
-		glBindBuffer ( GL_ARRAY_BUFFER, gs.vertexBuffer_ground );
-		glBufferData ( GL_ARRAY_BUFFER, ground._indexVertexCount * sizeof ( Vector3 ), &ground._indexVertices[0], GL_STATIC_DRAW );
+		if ( !gs.scene.load ( scene_file ) ) {
+			shutdown ( );
+			glfwTerminate ( );
+			exit ( -1 );
+		}
 
-		glBindBuffer ( GL_ARRAY_BUFFER, gs.vertexBuffer_ground );
-		glEnableVertexArrayAttrib ( gs.vao_ground, 1 );
-		glVertexAttribPointer ( 1, 3, GL_FLOAT, GL_FALSE, 0, 0 );
+		gs.scene.setGridCount ( instance_count );
 
-		glBindBuffer ( GL_ARRAY_BUFFER, 0 );
+		printf ( "Scene %s: %u meshes, %u nodes, %u lights, read in %.1f ms\n", scene_file, ( uint32_t ) gs.scene.meshes ( ).size ( ),
+				 gs.scene.nodeCount ( ), ( uint32_t ) gs.scene.lights ( ).size ( ),
+				 std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - scene_start ).count ( ) );
 
-		// init normal buffer
-		glGenBuffers ( 1, &gs.normalBuffer_ground );
-		glBindBuffer ( GL_ARRAY_BUFFER, gs.normalBuffer_ground );
-		glBufferData ( GL_ARRAY_BUFFER, ground._indexVertexCount * sizeof ( Vector3 ), &ground._indexNormals[0], GL_STATIC_DRAW );
-		glBindBuffer ( GL_ARRAY_BUFFER, 0 );
+		gs.frame_arena.init ( 64 * 1024 );
 
-		glBindBuffer ( GL_ARRAY_BUFFER, gs.normalBuffer_ground );
-		glEnableVertexArrayAttrib ( gs.vao_ground, 2 );
-		glVertexAttribPointer ( 2, 3, GL_FLOAT, GL_FALSE, 0, ( void* ) 0 );
+		gs.jobs.init ( job_threads );
+		gs.loader.init ( &gs.jobs );
 
-		glBindBuffer ( GL_ARRAY_BUFFER, 0 );
+		gs.meshes.resize ( gs.scene.meshes ( ).size ( ) );
 
-		glBindVertexArray ( 0 );
-	}
+		gs.load_start = std::chrono::high_resolution_clock::now ( );
+		gs.load_reported = false;
+
+		for ( uint32_t m = 0; m < gs.meshes.size ( ); ++m ) {
+			const SceneMesh &sceneMesh = gs.scene.meshes ( )[m];
+			Vector3 scale = sceneMesh.scale;
+			Vector3 translate = sceneMesh.translate;
 
+			gs.meshes[m].loaded = false;
+			gs.meshes[m].complete = false;
+			gs.meshes[m].level = 0;
+			gs.meshes[m].dynamic = SCENE_NONE;
+			gs.meshes[m].angle = gs.meshes[m].previous_angle = 0.0;
+			gs.meshes[m].compute = SCENE_NONE;
+			gs.meshes[m].phase = gs.meshes[m].previous_phase = 0.0;
+			gs.meshes[m].asset = gs.loader.loadMesh ( sceneMesh.file, [scale, translate] ( Mesh &mesh ) {
+				mesh.scale ( scale );
 
-	/**** Init Framebuffer ****/
+				if ( translate != Vector3 ( 0.0f, 0.0f, 0.0f ) ) {
+					mesh.translate ( translate );
+				}
+			}, sceneMesh.trianglesPerCluster );
+		}
+	}
+
+	/**** Init geometry arena ****/
 	{
-		glGenTextures ( 1, &gs.depthTexture );
-		glBindTexture ( GL_TEXTURE_2D, gs.depthTexture );
-		glTexStorage2D ( GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, 4096, 4096 );
+		gs.arena.init ( 1 << 20, 4 << 20 );
 
-		glGenFramebuffers ( 1, &gs.fbo );
-		glBindFramebuffer ( GL_FRAMEBUFFER, gs.fbo );
-		glFramebufferTexture2D ( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gs.depthTexture, 0 );		
+		gs.occlusion.init ( occlusion, 256, 256 );
 
-		GLenum Status = glCheckFramebufferStatus ( GL_FRAMEBUFFER );
+		gs.instances.init ( gs.scene.nodeCount ( ) );
+		gs.instance_stream.init ( gs.scene.nodeCount ( ) * sizeof ( Instance ), 16 );
 
-		if ( Status != GL_FRAMEBUFFER_COMPLETE ) {
-			printf ( "FB error, status: 0x%x\n", Status );
-			exit(-1);
-		}
+		// The vertex regions grow with the dynamic meshes
+		GLint alignment = 256;
+		glGetIntegerv ( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment );
 
-		glBindFramebuffer ( GL_FRAMEBUFFER, 0 );
+		gs.uniform_stream.init ( 16 * 1024, alignment );
+		gs.vertex_stream.init ( 64 * 1024, sizeof ( Vector3 ) );
+	}
+
+	/**** Init ShadowMap ****/
+	{
+		// Filtered lookups allow a smaller map than the previous 4096x4096
+		gs.shadowMap.init ( 2048 );
+		gs.shadowFilter.init ( );
 	}
 
 
@@ -327,15 +848,26 @@ void init ( ) {
 	{
 		//gs.depthTexture = loadBMP_custom ( "uvtemplate.bmp" );
 
-		glGenBuffers ( 1, &gs.vertexBuffer_texture );
-		glBindBuffer ( GL_ARRAY_BUFFER, gs.vertexBuffer_texture );
-		glBufferData ( GL_ARRAY_BUFFER, sizeof ( g_vertex_buffer_data2 ), g_vertex_buffer_data2, GL_STATIC_DRAW );
+		GpuMesh &quad = gs.quad;
+
+		quad.positions = createBuffer ( );
+		glNamedBufferData ( quad.positions.id ( ), sizeof ( g_vertex_buffer_data2 ), g_vertex_buffer_data2, GL_STATIC_DRAW );
+
+		quad.uvs = createBuffer ( );
+		glNamedBufferData ( quad.uvs.id ( ), sizeof ( g_uv_buffer_data2 ), g_uv_buffer_data2, GL_STATIC_DRAW );
 
-		glGenBuffers ( 1, &gs.uvBuffer_texture );
-		glBindBuffer ( GL_ARRAY_BUFFER, gs.uvBuffer_texture );
-		glBufferData ( GL_ARRAY_BUFFER, sizeof ( g_uv_buffer_data2 ), g_uv_buffer_data2, GL_STATIC_DRAW );
+		quad.vertexCount = 6;
 
-		glBindBuffer ( GL_ARRAY_BUFFER, 0 );
+		quad.vao = createVertexArray ( );
+		GLuint vao = quad.vao.id ( );
+		glVertexArrayVertexBuffer ( vao, 0, quad.positions.id ( ), 0, 3 * sizeof ( GLfloat ) );
+		glVertexArrayVertexBuffer ( vao, 1, quad.uvs.id ( ), 0, 2 * sizeof ( GLfloat ) );
+		glEnableVertexArrayAttrib ( vao, 0 );
+		glEnableVertexArrayAttrib ( vao, 1 );
+		glVertexArrayAttribFormat ( vao, 0, 3, GL_FLOAT, GL_FALSE, 0 );
+		glVertexArrayAttribFormat ( vao, 1, 2, GL_FLOAT, GL_FALSE, 0 );
+		glVertexArrayAttribBinding ( vao, 0, 0 );
+		glVertexArrayAttribBinding ( vao, 1, 1 );
 	}
 
 	/**** Init matrix ****/
@@ -344,182 +876,1229 @@ void init ( ) {
 		GLfloat near_plane = .1f, far_plane = 100.0f;
 		projection = glm::perspective ( 45.0f, ( GLfloat ) 800 / ( GLfloat ) 800, near_plane, far_plane );
 		light_projection = glm::ortho ( -10.0f, 10.0f, -10.0f, 10.0f, near_plane, far_plane );
+
+		gs.light_clusters.setProjection ( projection, near_plane, far_plane );
 	}
 	
-	glEnable ( GL_DEPTH_TEST );
-	glDepthFunc ( GL_LESS );
+	gs.state.enable ( GL_DEPTH_TEST, true );
+	gs.state.depthFunc ( GL_LESS );
+
+	// The shadow follows the first light of the scene
+	light_pos = gs.scene.lights ( ).empty ( ) ? Vector3 ( 10.0f, -8.0f, 4.0f ) : gs.scene.lights ( )[0].position;
+
+	/**** Init clustered lights ****/
+	{
+		const std::vector<SceneLight> &lights = gs.scene.lights ( );
+
+		for ( uint32_t i = 1; i < lights.size ( ); ++i ) {
+			ClusterLight light;
+			light.position = glm::vec4 ( lights[i].position, lights[i].radius );
+			light.color = glm::vec4 ( lights[i].color * lights[i].intensity, 0.0f );
+			gs.lights.push_back ( light );
+		}
+
+		gs.light_speeds.assign ( gs.lights.size ( ), 0.0f );
+
+		// Au dessus du sol de default.scene, vitesses de -1 a 1 radian par seconde
+		std::vector<ClusterLight> scattered;
+		LightClusters::scatter ( light_count, glm::vec3 ( -10.0f, -2.5f, -10.0f ), glm::vec3 ( 10.0f, 3.0f, 10.0f ), 0.5f, 2.0f, 10.0f, 1, scattered );
+
+		for ( uint32_t i = 0; i < scattered.size ( ); ++i ) {
+			gs.lights.push_back ( scattered[i] );
+			gs.light_speeds.push_back ( ( ( i * 2654435761u ) >> 8 & 0xFFFF ) / 32768.0f - 1.0f );
+		}
+
+		if ( !gs.lights.empty ( ) ) {
+			GLint alignment = 256;
+			glGetIntegerv ( GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment );
 
-	light_pos = Vector3 ( 10.0f, -8.0f, 4.0f );
+			// Grows with the indices of the frame
+			gs.light_stream.init ( gs.lights.size ( ) * sizeof ( ClusterLight ) + LIGHT_CLUSTERS_COUNT * sizeof ( ClusterRange ) + 64 * 1024, alignment );
+
+			printf ( "Clustered lights: %u, %ux%ux%u clusters\n", ( uint32_t ) gs.lights.size ( ), LIGHT_CLUSTERS_X, LIGHT_CLUSTERS_Y, LIGHT_CLUSTERS_Z );
+		}
+	}
+
+	// The draws are rebuilt as the meshes arrive
+	layoutInstances ( );
+
+	gs.samples_queries[0] = createQuery ( GL_SAMPLES_PASSED );
+	gs.samples_queries[1] = createQuery ( GL_SAMPLES_PASSED );
+
+	if ( dynamic_res ) {
+		gs.dynamic_res.init ( frame_budget, min_scale, 1.0f );
+
+		if ( res_trace != NULL ) {
+			gs.dynamic_res.openTrace ( res_trace );
+		}
+
+		printf ( "Dynamic resolution: %.2f ms budget, scale %.2f to 1, %s upscale\n", frame_budget, min_scale, upscale_sharpen ? "sharpened" : "bilinear" );
+	}
+
+	buildRenderGraph ( );
 }
 
-void render ( GLFWwindow* window ) {	
-	glfwGetFramebufferSize ( window, &WIDTH, &HEIGHT );
+// Deletes every GL object while the context is still current : the
+// owners are globals, their destructors would run after glfwTerminate
+void shutdown ( ) {
+	gs.quad.release ( );
+	gs.samples_queries[0].reset ( );
+	gs.samples_queries[1].reset ( );
+
+	gs.dynamic_res.release ( );
+	gs.graph.release ( );
+	gs.occlusion.release ( );
+	gs.sceneCommands.release ( );
+	gs.instances.release ( );
+
+	for ( uint32_t d = 0; d < gs.dynamic_meshes.size ( ); ++d ) {
+		gs.dynamic_meshes[d].release ( );
+	}
+	gs.mesh_compute.release ( );
+	gs.uniform_stream.release ( );
+	gs.vertex_stream.release ( );
+	gs.instance_stream.release ( );
+	gs.light_stream.release ( );
+
+	gs.arena.release ( );
+	gs.shadowFilter.release ( );
+	gs.shadowMap.release ( );
+	gs.shaders.release ( );
+}
 
-	/**************************** ShadowMap Pass ****************************/
-	{
-		glViewport ( 0, 0, 4096, 4096 );
-		
-		glBindFramebuffer ( GL_DRAW_FRAMEBUFFER, gs.fbo );
-		
-		glClear ( GL_DEPTH_BUFFER_BIT );
+// Marks a mesh loaded : its instances enter the octree and the draws
+void addLoadedMesh ( uint32_t m ) {
+	SceneMeshState &state = gs.meshes[m];
 
-		glUseProgram ( gs.shadowmap_program );
+	state.loaded = true;
 
-		glm::mat4 view = glm::lookAt ( 
-			-light_pos, 
-			glm::vec3 ( 0, 0, 0 ), 
-			glm::vec3 ( 0, 1, 0 ) );
+	// The instances are already placed : they enter the octree and the draws
+	for ( uint32_t k = state.baseInstance; k < state.baseInstance + state.instanceCount; ++k ) {
+		updateNodeBounds ( gs.instance_node[k] );
+	}
+
+	buildSceneCommands ( );
+}
+
+// Once every mesh is in the arena at full detail
+void reportLoading ( ) {
+	if ( gs.load_reported || gs.loader.pending ( ) != 0 || !gs.uploads.empty ( ) ) {
+		return;
+	}
+
+	gs.load_reported = true;
+
+	// Heap used by the whole loading, the file texts live in arenas
+	MemoryStats memory = memoryStats ( );
+	printf ( "Loading: %llu allocations, peak %.2f MB, %.2f MB kept\n", ( unsigned long long ) ( memory.allocations - gs.load_memory.allocations ),
+			 ( memory.peak - gs.load_memory.bytes ) / 1048576.0, ( ( double ) memory.bytes - gs.load_memory.bytes ) / 1048576.0 );
+
+	auto now = std::chrono::high_resolution_clock::now ( );
+	printf ( "Time to full detail: %.1f ms (%.1f ms after the loading started)\n",
+			 std::chrono::duration<double, std::milli> ( now - program_start ).count ( ),
+			 std::chrono::duration<double, std::milli> ( now - gs.load_start ).count ( ) );
+}
+
+// Ce qui est pret est dessine : le reste des meshes arrive pendant les images suivantes
+void reportFirstFrame ( ) {
+	uint32_t drawn = 0, complete = 0;
+	for ( uint32_t m = 0; m < gs.meshes.size ( ); ++m ) {
+		drawn += gs.meshes[m].loaded;
+		complete += gs.meshes[m].complete;
+	}
+
+	printf ( "Time to first frame: %.1f ms, %u of %u meshes drawn, %u at full detail\n",
+			 std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - program_start ).count ( ),
+			 drawn, ( uint32_t ) gs.meshes.size ( ), complete );
+}
+
+// A mesh turned or deformed on the CPU every frame : neither occluder nor
+// shadow caster, its bounds hold every rotation and deformation
+void onDynamicAssetLoaded ( uint32_t m, MeshAsset &asset ) {
+	SceneMeshState &state = gs.meshes[m];
+	float deform = gs.scene.meshes ( )[m].deform;
+
+	// Un sommet par position, sinon la deformation ouvre les aretes vives.
+	// Les normales au repos sont celles de la reference
+	if ( deform != 0.0f ) {
+		Mesh::weldPositions ( asset.vertices, asset.indices );
 
-		/*GLfloat radius = 20.0f;
-		GLfloat camX = sin ( glfwGetTime ( ) ) * radius;
-		GLfloat camZ = cos ( glfwGetTime ( ) ) * radius;
-		glm::mat4 view = glm::lookAt (
-			glm::vec3 ( camX, 0.0f, camZ ),
-			glm::vec3 ( 0.0f, 0.0f, 0.0f ),
-			glm::vec3 ( 0.0f, 1.0f, 0.0f ) );*/
+		std::vector<uint32_t> offsets, faces;
+		std::vector<Vector3> faceNormals ( asset.indices.size ( ) / 3 );
+		Mesh::buildAdjacency ( asset.indices, asset.vertices.size ( ), offsets, faces );
+		Mesh::calculateFaceNormals ( asset.vertices, asset.indices, faceNormals.empty ( ) ? NULL : &faceNormals[0], &gs.jobs );
+
+		asset.normals.resize ( asset.vertices.size ( ) );
+		Mesh::calculateVertexNormals ( faceNormals, offsets, faces, asset.normals.empty ( ) ? NULL : &asset.normals[0], &gs.jobs );
+	}
+
+	state.dynamic = gs.dynamic_meshes.size ( );
+	gs.dynamic_meshes.push_back ( DynamicMesh ( ) );
+
+	DynamicMesh &mesh = gs.dynamic_meshes.back ( );
+	mesh.init ( asset.vertices, asset.normals, asset.indices, deform );
+	mesh.setInstanceBuffer ( gs.instances.buffer ( ) );
+
+	if ( deform != 0.0f && deform_gpu ) {
+		state.compute = gs.mesh_compute.addMesh ( mesh.indices ( ), mesh.vertexCount ( ) );
+		mesh.setNormalBuffer ( gs.mesh_compute.normals ( state.compute ) );
+	}
+
+	float radius = mesh.radius ( );
+	state.bbMin = Vector3 ( -radius, -radius, -radius );
+	state.bbMax = Vector3 ( radius, radius, radius );
+
+	// Une region tient les sommets de tous les maillages dynamiques
+	GLsizeiptr size = 0;
+	for ( uint32_t d = 0; d < gs.dynamic_meshes.size ( ); ++d ) {
+		size += gs.dynamic_meshes[d].frameSize ( );
+	}
+	gs.vertex_stream.reserve ( size );
+
+	state.level = asset.level;
+	state.complete = true;
+
+	addLoadedMesh ( m );
+}
+
+// Reserves the arena space of a finished asset, uploadAssets() fills it.
+// When waiting nothing is drawn before the end : only the full levels are kept
+void onAssetLoaded ( MeshAsset &asset, bool wait ) {
+	if ( asset.levelCount > 1 ) {
+		printf ( "Asset %s: %u vertices, %u triangles, level %u/%u, loaded in %.1f ms\n", asset.fileName.c_str ( ), ( uint32_t ) asset.vertices.size ( ),
+				 ( uint32_t ) asset.indices.size ( ) / 3, asset.level + 1, asset.levelCount, asset.ms );
+	}
+	else {
+		printf ( "Asset %s: %u vertices, %u triangles, loaded in %.1f ms\n", asset.fileName.c_str ( ), ( uint32_t ) asset.vertices.size ( ),
+				 ( uint32_t ) asset.indices.size ( ) / 3, asset.ms );
+	}
 
-		glm::mat4 depthMVP = light_projection * view * model;
+	uint32_t m = 0;
+	while ( m < gs.meshes.size ( ) && gs.meshes[m].asset != asset.id ) {
+		m++;
+	}
 
-		GLuint depthMatrixLoc = glGetUniformLocation ( gs.shadowmap_program, "depthMVP" );
+	if ( m == gs.meshes.size ( ) ) {
+		return;
+	}
 
-		glUniformMatrix4fv ( depthMatrixLoc, 1, GL_FALSE, &depthMVP[0][0] );
+	bool last = asset.level + 1 == asset.levelCount;
 
-		glBindVertexArray ( gs.vao );
-		{
-			glDrawArrays ( GL_TRIANGLES, 0, mesh_size );
+	// Les maillages dynamiques gardent leurs sommets au repos sur le CPU : le niveau complet seulement
+	if ( gs.scene.meshes ( )[m].spin != 0.0f || gs.scene.meshes ( )[m].deform != 0.0f ) {
+		if ( last ) {
+			onDynamicAssetLoaded ( m, asset );
 		}
-		glBindVertexArray ( 0 );
+		return;
+	}
+
+	if ( wait && !last ) {
+		return;
+	}
+
+	// Un niveau illisible garde le precedent a l'ecran
+	if ( asset.indices.empty ( ) && gs.meshes[m].loaded ) {
+		return;
+	}
 
-		glBindVertexArray ( gs.vao_ground );
-		{
-			glDrawArrays ( GL_TRIANGLES, 0, ground_size );
+	// Un niveau plus fin remplace celui qui n'est pas encore copie
+	for ( std::deque<PendingUpload>::iterator it = gs.uploads.begin ( ); it != gs.uploads.end ( ); ++it ) {
+		if ( it->mesh == m ) {
+			gs.arena.free ( it->geometry );
+			gs.uploads.erase ( it );
+			break;
 		}
-		glBindVertexArray ( 0 );
+	}
 
-		glUseProgram ( 0 );
+	gs.uploads.push_back ( PendingUpload ( ) );
 
-		glBindFramebuffer ( GL_DRAW_FRAMEBUFFER, 0 );
+	PendingUpload &upload = gs.uploads.back ( );
+	upload.mesh = m;
+	upload.progress = 0;
+	std::swap ( upload.asset, asset );
+
+	if ( !gs.arena.reserve ( upload.asset.vertices.size ( ), upload.asset.indices.size ( ), upload.geometry ) ) {
+		gs.uploads.pop_back ( );
 	}
-	/**********************************************************************/
+}
 
+// A level entirely in the arena replaces the previous one in the draws,
+// the shadow casters and, at full detail, the occluders
+void onAssetUploaded ( PendingUpload &upload ) {
+	uint32_t m = upload.mesh;
+	SceneMeshState &state = gs.meshes[m];
+	MeshAsset &asset = upload.asset;
 
+	if ( state.loaded ) {
+		gs.arena.free ( state.geometry );
+	}
 
-	/**************************** [DEBUG] Rendu Depth Texture *******************/
-	if (false)
-	{
-		glClear ( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+	state.geometry = upload.geometry;
+	state.level = asset.level;
+	state.bbMin = asset.bbMin;
+	state.bbMax = asset.bbMax;
+	std::swap ( state.clusters, asset.clusters );
+
+	if ( asset.level + 1 == asset.levelCount ) {
+		state.occluder = gs.occlusion.addOccluder ( asset.vertices, asset.indices );
+		state.complete = true;
+	}
 
-		glUseProgram ( gs.texture_program );
+	if ( state.loaded ) {
+		gs.shadowMap.setCasterGeometry ( state.caster, state.geometry );
+		updateCasterBounds ( m );
+	}
+	else {
+		// Still meshes are cached in the shadow map, the animated ones redrawn every frame
+		ShadowCaster caster;
+		caster.geometry = state.geometry;
+		caster.model = model;
+		caster.dynamic = state.animated;
+		caster.baseInstance = state.baseInstance;
+		caster.instanceCount = state.instanceCount;
+		gs.instances.calculateBounds ( state.baseInstance, state.instanceCount, state.bbMin, state.bbMax, caster.bbMin, caster.bbMax );
+		state.caster = gs.shadowMap.addCaster ( caster );
+	}
 
-		GLuint matrixLoc = glGetUniformLocation ( gs.texture_program, "MVP" );
+	addLoadedMesh ( m );
 
-		glm::mat4 view = glm::lookAt (
-			glm::vec3 ( 0, 0, 2 ), 
-			glm::vec3 ( 0, 0, 0 ), 
-			glm::vec3 ( 0, 1, 0 ) );
-		glm::mat4 MVP = projection * view * model;
+	if ( asset.levelCount > 1 ) {
+		printf ( "Mesh %s: level %u/%u drawn, %.1f ms after the loading started\n", asset.fileName.c_str ( ), asset.level + 1, asset.levelCount,
+				 std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - gs.load_start ).count ( ) );
+	}
+}
 
-		glUniformMatrix4fv ( matrixLoc, 1, GL_FALSE, &MVP[0][0] );
+// Takes the assets finished by the jobs, one per frame, or all of them
+// when waiting. Then copies at most upload_budget MB into the arena : the
+// first queued go first, the rest continues in the next frames
+void uploadAssets ( bool wait ) {
+	MeshAsset asset;
 
-		glActiveTexture ( GL_TEXTURE0 );
-		glBindTexture ( GL_TEXTURE_2D, gs.depthTexture );
+	if ( !wait ) {
+		if ( gs.loader.poll ( asset ) ) {
+			onAssetLoaded ( asset, false );
+		}
+	}
+	else {
+		while ( gs.loader.wait ( asset ) ) {
+			onAssetLoaded ( asset, true );
+		}
+	}
 
-		GLuint textureLoc = glGetUniformLocation ( gs.texture_program, "texture_sampler" );
+	size_t budget = wait || upload_budget == 0 ? ( size_t ) -1 : ( size_t ) upload_budget << 20;
 
-		glUniform1i ( textureLoc, 0 );
+	while ( !gs.uploads.empty ( ) && budget > 0 ) {
+		PendingUpload &upload = gs.uploads.front ( );
+		const MeshAsset &data = upload.asset;
+		size_t progress = upload.progress;
 
-		glEnableVertexAttribArray ( 0 );
-		glBindBuffer ( GL_ARRAY_BUFFER, gs.vertexBuffer_texture );
-		glVertexAttribPointer (	0, 3, GL_FLOAT, GL_FALSE, 0, ( void* ) 0 );
+		bool done = gs.arena.upload ( upload.geometry, data.vertices, data.normals, data.indices, upload.progress, budget );
+		budget -= upload.progress - progress;
 
-		glEnableVertexAttribArray ( 1 );
-		glBindBuffer ( GL_ARRAY_BUFFER, gs.uvBuffer_texture );
-		glVertexAttribPointer ( 1, 2, GL_FLOAT, GL_FALSE, 0, ( void* ) 0 );
+		if ( !done ) {
+			break;
+		}
 
-		glDrawArrays ( GL_TRIANGLES, 0, 6 );
+		onAssetUploaded ( upload );
+		gs.uploads.pop_front ( );
+	}
 
-		glDisableVertexAttribArray ( 0 );
-		glDisableVertexAttribArray ( 1 );
-		glBindBuffer ( GL_ARRAY_BUFFER, 0 );
-		glUseProgram ( 0 );
-	
-		glBindTexture ( GL_TEXTURE_2D, gs.depthTexture );
-		glGenerateMipmap ( GL_TEXTURE_2D );
+	reportLoading ( );
+}
+
+// After the arena draws, each one with its own VAO
+void drawDynamicMeshes ( GLStateCache &state ) {
+	for ( uint32_t d = 0; d < gs.dynamic_meshes.size ( ); ++d ) {
+		gs.dynamic_meshes[d].draw ( state );
+	}
+}
+
+// Rotates and deforms the vertices of the dynamic meshes into the region of
+// the frame, then the GPU recomputes the normals of the deforming ones
+void streamDynamicMeshes ( double alpha ) {
+	for ( uint32_t m = 0; m < gs.meshes.size ( ); ++m ) {
+		const SceneMeshState &state = gs.meshes[m];
+
+		if ( !state.loaded || state.dynamic == SCENE_NONE ) {
+			continue;
+		}
+
+		double angle = state.previous_angle + ( state.angle - state.previous_angle ) * alpha;
+		double phase = state.previous_phase + ( state.phase - state.previous_phase ) * alpha;
+		GLintptr offset;
+
+		// Region pleine : rien a dessiner plutot que des sommets en cours d'ecriture
+		if ( !gs.dynamic_meshes[state.dynamic].stream ( gs.vertex_stream, ( float ) angle, Vector3 ( 0.0f, 1.0f, 0.0f ), ( float ) phase, offset, &gs.jobs ) ) {
+			gs.dynamic_meshes[state.dynamic].clear ( );
+		}
+		else if ( state.compute != SCENE_NONE ) {
+			gs.mesh_compute.compute ( gs.state, state.compute, gs.vertex_stream.buffer ( ), offset );
+		}
+	}
+}
+
+// Moves the lights, assigns them to the clusters of the camera and writes
+// the lights, the ranges and the indices in the region of the frame
+void assignLights ( double alpha ) {
+	if ( gs.lights.empty ( ) ) {
+		return;
+	}
+
+	double angle = previous_light_angle + ( light_angle - previous_light_angle ) * alpha;
+
+	gs.frame_lights.resize ( gs.lights.size ( ) );
+
+	for ( uint32_t i = 0; i < gs.lights.size ( ); ++i ) {
+		float a = ( float ) ( angle * gs.light_speeds[i] );
+		float c = cosf ( a ), s = sinf ( a );
+		const glm::vec4 &p = gs.lights[i].position;
+
+		gs.frame_lights[i].position = glm::vec4 ( c * p.x + s * p.z, p.y, c * p.z - s * p.x, p.w );
+		gs.frame_lights[i].color = gs.lights[i].color;
 	}
-	/**********************************************************************/
+
+	gs.light_clusters.assign ( gs.frame_lights, camera_view, &gs.jobs );
+
+	const std::vector<ClusterRange> &ranges = gs.light_clusters.ranges ( );
+	const std::vector<uint32_t> &indices = gs.light_clusters.indices ( );
+
+	gs.light_sizes[0] = gs.frame_lights.size ( ) * sizeof ( ClusterLight );
+	gs.light_sizes[1] = ranges.size ( ) * sizeof ( ClusterRange );
+	gs.light_sizes[2] = std::max<GLsizeiptr> ( indices.size ( ) * sizeof ( uint32_t ), sizeof ( uint32_t ) );
+
+	// Trop d'indices pour la region : elle grandit avant d'etre reprise
+	GLsizeiptr size = gs.light_sizes[0] + gs.light_sizes[1] + gs.light_sizes[2] + 3 * gs.light_stream.alignment ( );
+	if ( size > gs.light_stream.regionSize ( ) ) {
+		gs.light_stream.reserve ( size + size / 2 );
+	}
+
+	gs.light_stream.begin ( );
+
+	const void *sources[3] = { gs.frame_lights.data ( ), ranges.data ( ), indices.empty ( ) ? NULL : indices.data ( ) };
+
+	for ( uint32_t b = 0; b < 3; ++b ) {
+		void *data = gs.light_stream.allocate ( gs.light_sizes[b], gs.light_offsets[b] );
+
+		if ( data != NULL && sources[b] != NULL ) {
+			memcpy ( data, sources[b], gs.light_sizes[b] );
+		}
+	}
+}
+
+// Permutation of basic.vsl/fsl for the current options
+uint32_t sceneShaderKey ( ) {
+	uint32_t key = SHADER_SHADOW_FILTER ( gs.shadowFilter._mode ) | SHADER_VERTEX_NORMAL | SHADER_INSTANCED;
+
+	if ( specular ) {
+		key |= SHADER_SPECULAR;
+	}
+	if ( debug_normals ) {
+		key |= SHADER_DEBUG_NORMALS;
+	}
+	if ( !gs.lights.empty ( ) ) {
+		key |= SHADER_CLUSTERED_LIGHTS;
+	}
+
+	return key;
+}
+
+/**************************** ShadowMap Pass ****************************/
+void shadowPass ( GLStateCache &state ) {
+	glm::mat4 view = glm::lookAt ( 
+		-light_pos, 
+		glm::vec3 ( 0, 0, 0 ), 
+		glm::vec3 ( 0, 1, 0 ) );
+
+	/*GLfloat radius = 20.0f;
+	GLfloat camX = sin ( glfwGetTime ( ) ) * radius;
+	GLfloat camZ = cos ( glfwGetTime ( ) ) * radius;
+	glm::mat4 view = glm::lookAt (
+		glm::vec3 ( camX, 0.0f, camZ ),
+		glm::vec3 ( 0.0f, 0.0f, 0.0f ),
+		glm::vec3 ( 0.0f, 1.0f, 0.0f ) );*/
+
+	// Only redraws what was invalidated since the last frame
+	gs.shadowMap.setLight ( view, light_projection );
+	gs.shadowMap.render ( state, gs.shadowmap_shader.program ( SHADER_INSTANCED ), gs.arena );
+}
+/**********************************************************************/
+
+
+
+/**************************** [DEBUG] Rendu Depth Texture *******************/
+void debugDepthPass ( GLStateCache &state ) {
+	state.viewport ( 0, 0, WIDTH, HEIGHT );
+	state.depthMask ( GL_TRUE );
+	state.depthFunc ( GL_LESS );
+	state.colorMask ( GL_TRUE );
+
+	glClear ( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+
+	GLuint program = gs.shaders.program ( gs.texture_shader );
+
+	state.useProgram ( program );
+
+	GLuint matrixLoc = glGetUniformLocation ( program, "MVP" );
+
+	glm::mat4 view = glm::lookAt (
+		glm::vec3 ( 0, 0, 2 ), 
+		glm::vec3 ( 0, 0, 0 ), 
+		glm::vec3 ( 0, 1, 0 ) );
+	glm::mat4 MVP = projection * view * model;
+
+	glUniformMatrix4fv ( matrixLoc, 1, GL_FALSE, &MVP[0][0] );
+
+	state.bindTexture ( 0, gs.shadowMap.depthTexture ( ) );
+	state.bindSampler ( 0, 0 );
+
+	GLuint textureLoc = glGetUniformLocation ( program, "texture_sampler" );
+
+	glUniform1i ( textureLoc, 0 );
+
+	state.bindVertexArray ( gs.quad.vao.id ( ) );
+
+	glDrawArrays ( GL_TRIANGLES, 0, gs.quad.vertexCount );
+}
+/**********************************************************************/
 
 
 	
-	/**************************** Rendu scene ****************************/
-	if (true)
-	{
-		glViewport ( 0, 0, WIDTH, HEIGHT );
+/**************************** Depth pre-pass ****************************/
+void depthPrepass ( GLStateCache &state ) {
+	state.viewport ( 0, 0, RENDER_WIDTH, RENDER_HEIGHT );
+	state.depthMask ( GL_TRUE );
+	state.depthFunc ( GL_LESS );
+	state.colorMask ( GL_FALSE );
+
+	glClear ( GL_DEPTH_BUFFER_BIT );
+
+	// The shadow map program : same transform as basic.vsl, no shading
+	GLuint program = gs.shadowmap_shader.program ( SHADER_INSTANCED );
+
+	state.useProgram ( program );
+
+	glUniformMatrix4fv ( glGetUniformLocation ( program, "depthMVP" ), 1, GL_FALSE, glm::value_ptr ( camera_mvp ) );
+
+	if ( headless ) {
+		glBeginQuery ( GL_SAMPLES_PASSED, gs.samples_queries[0].id ( ) );
+	}
+
+	state.bindVertexArray ( gs.arena.vao ( ) );
+	gs.sceneCommands.draw ( );
+
+	drawDynamicMeshes ( state );
+
+	if ( headless ) {
+		glEndQuery ( GL_SAMPLES_PASSED );
+	}
+}
+/**********************************************************************/
+
+
+
+/**************************** Rendu scene ****************************/
+void scenePass ( GLStateCache &state ) {
+	state.viewport ( 0, 0, RENDER_WIDTH, RENDER_HEIGHT );
+	state.colorMask ( GL_TRUE );
+
+	if ( depth_prepass ) {
+		// Only the visible fragment of each pixel is shaded
+		state.depthFunc ( GL_EQUAL );
+		state.depthMask ( GL_FALSE );
+
+		glClear ( GL_COLOR_BUFFER_BIT );
+	}
+	else {
+		state.depthFunc ( GL_LESS );
+		state.depthMask ( GL_TRUE );
 
 		glClear ( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+	}
 
-		glUseProgram ( gs.program );
-
-		GLfloat radius = 20.0f;
-		GLfloat camX = sin ( glfwGetTime ( ) * 0.5f ) * radius;
-		GLfloat camZ = cos ( glfwGetTime ( ) * 0.5f ) * radius;
-		glm::mat4 view = glm::lookAt ( 
-			glm::vec3 ( camX, 0.0f, camZ ), 
-			glm::vec3 ( 0.0f, 0.0f, 0.0f ), 
-			glm::vec3 ( 0.0f, 1.0f, 0.0f ) );
-		glm::mat4 light_view = glm::lookAt (
-			-light_pos,
-			glm::vec3 ( 0, 0, 0 ),
-			glm::vec3 ( 0, 1, 0 ) );
-		glm::mat4 lightspace_matrix = light_projection * light_view;
-
-		/*glm::mat4 depthMVP = light_projection * lightView * model;
-		glm::mat4 biasMatrix (
-			0.5, 0.0, 0.0, 0.0,
-			0.0, 0.5, 0.0, 0.0,
-			0.0, 0.0, 0.5, 0.0,
-			0.5, 0.5, 0.5, 1.0
-			);
-		glm::mat4 depthBiasMVP = biasMatrix * depthMVP;*/
-	
-		GLint modelLoc = glGetUniformLocation ( gs.program, "model" );
-		GLint viewLoc = glGetUniformLocation ( gs.program, "view" );
-		GLint projLoc = glGetUniformLocation ( gs.program, "projection" );
-		GLint lightMatrixLoc = glGetUniformLocation ( gs.program, "lightspace_matrix" );
-		GLint biasLoc = glGetUniformLocation ( gs.program, "depth_bias_mvp" );
-		GLint textureLoc = glGetUniformLocation ( gs.program, "shadowMap" );
-		GLint lightLoc = glGetUniformLocation ( gs.program, "light_pos" );
+	GLuint program = gs.basic_shader.program ( sceneShaderKey ( ) );
+
+	state.useProgram ( program );
 
-		glUniformMatrix4fv ( viewLoc, 1, GL_FALSE, glm::value_ptr ( view ) );
-		glUniformMatrix4fv ( projLoc, 1, GL_FALSE, glm::value_ptr ( projection ) );
-		glUniformMatrix4fv ( modelLoc, 1, GL_FALSE, glm::value_ptr ( model ) );
-		glUniformMatrix4fv ( lightMatrixLoc, 1, GL_FALSE, glm::value_ptr ( lightspace_matrix ) );
-		//glUniformMatrix4fv ( biasLoc, 1, GL_FALSE, glm::value_ptr ( depthBiasMVP ) );
+	glm::mat4 view = camera_view;
+	glm::mat4 light_view = glm::lookAt (
+		-light_pos,
+		glm::vec3 ( 0, 0, 0 ),
+		glm::vec3 ( 0, 1, 0 ) );
+	glm::mat4 lightspace_matrix = light_projection * light_view;
 
-		glUniform3f ( lightLoc, light_pos.x, light_pos.y, light_pos.z );
+	/*glm::mat4 depthMVP = light_projection * lightView * model;
+	glm::mat4 biasMatrix (
+		0.5, 0.0, 0.0, 0.0,
+		0.0, 0.5, 0.0, 0.0,
+		0.0, 0.0, 0.5, 0.0,
+		0.5, 0.5, 0.5, 1.0
+		);
+	glm::mat4 depthBiasMVP = biasMatrix * depthMVP;*/
 
-		glUniform1i ( textureLoc, 0 );
+	// Written in the region of the frame, no glUniform* call
+	GLintptr offset;
+	SceneUniforms *uniforms = ( SceneUniforms* ) gs.uniform_stream.allocate ( sizeof ( SceneUniforms ), offset );
 
-		glProgramUniform3f ( gs.program, 3, .235f, .709f, .313f );
-		glProgramUniform3f ( gs.program, 4, light_pos.x, light_pos.y, light_pos.z );
+	if ( uniforms == NULL ) {
+		return;
+	}
+
+	uniforms->mvp = camera_mvp;
+	uniforms->scene_model = model;
+	uniforms->view = view;
+	uniforms->projection = projection;
+	uniforms->lightspace_matrix = lightspace_matrix;
+	uniforms->light_worldspace = glm::vec4 ( light_pos, 1.0f );
+	uniforms->light_pos = glm::vec4 ( light_pos, 1.0f );
 
-		glActiveTexture ( GL_TEXTURE0 );
-		glBindTexture ( GL_TEXTURE_2D, gs.depthTexture );
+	glBindBufferRange ( GL_UNIFORM_BUFFER, SCENE_UNIFORMS_BINDING, gs.uniform_stream.buffer ( ), offset, sizeof ( SceneUniforms ) );
 
-		glBindVertexArray ( gs.vao );
-		{		
-			glDrawArrays ( GL_TRIANGLES, 0, mesh_size );
+	if ( !gs.lights.empty ( ) ) {
+		ClusterUniforms *clusters = ( ClusterUniforms* ) gs.uniform_stream.allocate ( sizeof ( ClusterUniforms ), offset );
+
+		if ( clusters == NULL ) {
+			return;
 		}
-		glBindVertexArray ( 0 );
 
-		glProgramUniform3f ( gs.program, 3, 1, 1, 1 );
+		clusters->view = view;
+		clusters->params = glm::vec4 ( ( float ) LIGHT_CLUSTERS_X / RENDER_WIDTH, ( float ) LIGHT_CLUSTERS_Y / RENDER_HEIGHT,
+									   gs.light_clusters.sliceScale ( ), gs.light_clusters.sliceBias ( ) );
 
-		glBindVertexArray ( gs.vao_ground );
-		{
-			glDrawArrays ( GL_TRIANGLES, 0, ground_size );
+		glBindBufferRange ( GL_UNIFORM_BUFFER, CLUSTER_UNIFORMS_BINDING, gs.uniform_stream.buffer ( ), offset, sizeof ( ClusterUniforms ) );
+		glBindBufferRange ( GL_SHADER_STORAGE_BUFFER, CLUSTER_LIGHTS_BINDING, gs.light_stream.buffer ( ), gs.light_offsets[0], gs.light_sizes[0] );
+		glBindBufferRange ( GL_SHADER_STORAGE_BUFFER, CLUSTER_RANGES_BINDING, gs.light_stream.buffer ( ), gs.light_offsets[1], gs.light_sizes[1] );
+		glBindBufferRange ( GL_SHADER_STORAGE_BUFFER, CLUSTER_INDICES_BINDING, gs.light_stream.buffer ( ), gs.light_offsets[2], gs.light_sizes[2] );
+	}
+
+	gs.shadowFilter.bind ( state, program, gs.shadowMap.depthTexture ( ), gs.shadowMap.size ( ), 0, 1 );
+
+	if ( headless ) {
+		glBeginQuery ( GL_SAMPLES_PASSED, gs.samples_queries[1].id ( ) );
+	}
+
+	// One indirect draw for every mesh and every instance
+	state.bindVertexArray ( gs.arena.vao ( ) );
+	gs.sceneCommands.draw ( );
+
+	drawDynamicMeshes ( state );
+
+	if ( headless ) {
+		glEndQuery ( GL_SAMPLES_PASSED );
+	}
+}
+/**********************************************************************/
+
+
+
+/**************************** Upscale ****************************/
+void upscalePass ( GLStateCache &state ) {
+	gs.dynamic_res.upscale ( state, gs.upscale_shader.program ( upscale_sharpen ? SHADER_SHARPEN : 0 ), gs.graph.texture ( gs.scene_color ),
+							 WIDTH, HEIGHT, UPSCALE_SHARPNESS );
+}
+/**********************************************************************/
+
+// The passes only declare what they read and write : the graph orders
+// them and drops the ones whose output is overwritten
+void buildRenderGraph ( ) {
+	std::vector<uint32_t> none;
+	std::vector<uint32_t> shadow ( 1, gs.graph.importTexture ( "shadow_depth", gs.shadowMap.depthTexture ( ) ) );
+	std::vector<uint32_t> backbuffer ( 1, RENDER_BACKBUFFER );
+
+	// With the dynamic resolution, the scene goes to a target of the graph
+	// at the backbuffer size, stretched onto the backbuffer by the upscale.
+	// The graph makes and binds the framebuffers of the passes drawing in it
+	std::vector<uint32_t> scene = backbuffer;
+	std::vector<uint32_t> sceneDepth = backbuffer;
+
+	if ( dynamic_res ) {
+		RenderTextureDesc color = { GL_RGBA8, 0, 0 };
+		RenderTextureDesc depth = { GL_DEPTH_COMPONENT24, 0, 0 };
+
+		gs.scene_color = gs.graph.createTexture ( "scene_color", color );
+		sceneDepth.assign ( 1, gs.graph.createTexture ( "scene_depth", depth ) );
+
+		scene.assign ( 1, gs.scene_color );
+		scene.push_back ( sceneDepth[0] );
+	}
+
+	// Lays down the depth the scene pass tests with GL_EQUAL
+	if ( depth_prepass ) {
+		gs.graph.addPass ( "depth_prepass", none, sceneDepth, true, depthPrepass );
+	}
+
+	gs.scene_pass = gs.graph.addPass ( "scene", shadow, scene, !depth_prepass, scenePass );
+
+	if ( dynamic_res ) {
+		gs.graph.addPass ( "upscale", std::vector<uint32_t> ( 1, gs.scene_color ), backbuffer, true, upscalePass );
+	}
+
+	// --debug-depth : the shadow map replaces the scene, whose passes are culled
+	if ( debug_depth_view ) {
+		gs.graph.addPass ( "debug_depth", shadow, backbuffer, true, debugDepthPass );
+	}
+
+	// Declared last, scheduled first : the scene reads its output
+	gs.graph.addPass ( "shadow", none, shadow, false, shadowPass );
+
+	gs.graph.compile ( );
+	gs.graph.resize ( WIDTH, HEIGHT );
+	gs.graph.print ( );
+}
+
+// Calls add ( count, first ) for each run of consecutive candidate instances
+template <typename Add>
+void addVisibleRuns ( const uint8_t *candidates, uint32_t first, uint32_t count, Add add ) {
+	uint32_t runStart = first;
+	uint32_t runCount = 0;
+
+	for ( uint32_t k = first; k < first + count; ++k ) {
+		if ( candidates[k] ) {
+			if ( runCount == 0 ) {
+				runStart = k;
+			}
+			runCount++;
+			continue;
+		}
+
+		if ( runCount > 0 ) {
+			add ( runCount, runStart );
+		}
+		runCount = 0;
+	}
+
+	if ( runCount > 0 ) {
+		add ( runCount, runStart );
+	}
+}
+
+// Rebuilds the scene draws with only the instances the octree finds in
+// the frustum, then, with occlusion culling, the instances and clusters
+// that pass the Hi-Z test
+void cullScene ( ) {
+	gs.occlusion.resetStats ( );
+
+	ArenaVector<uint32_t> visible ( &gs.frame_arena );
+	visible.reserve ( gs.octree.objects ( ) );
+	gs.octree.query ( camera_mvp, visible );
+
+	// Un drapeau par instance, dans l'ordre du buffer
+	ArenaVector<uint8_t> candidates ( gs.instances.count ( ) + 1, 0, ArenaAllocator<uint8_t> ( &gs.frame_arena ) );
+
+	for ( uint32_t i = 0; i < visible.size ( ); ++i ) {
+		candidates[gs.node_instance[visible[i]]] = 1;
+	}
+
+	if ( occlusion == OCCLUSION_CPU ) {
+		// The occluder meshes (the ground) and the nearest other instances hide the rest
+		ArenaVector<OccluderInstance> list ( &gs.frame_arena );
+		ArenaVector<std::pair<float, uint32_t> > nearest ( &gs.frame_arena );
+		nearest.reserve ( gs.instances.count ( ) );
+
+		for ( uint32_t m = 0; m < gs.meshes.size ( ); ++m ) {
+			const SceneMeshState &state = gs.meshes[m];
+
+			// A coarse level is not inside the full mesh : it could hide what is visible
+			if ( !state.complete || state.dynamic != SCENE_NONE ) {
+				continue;
+			}
+
+			for ( uint32_t k = state.baseInstance; k < state.baseInstance + state.instanceCount; ++k ) {
+				if ( gs.scene.meshes ( )[m].occluder ) {
+					OccluderInstance occluder = { state.occluder, gs.instances.instance ( k ).model };
+					list.push_back ( occluder );
+				}
+				else {
+					glm::vec3 d = glm::vec3 ( model * gs.instances.instance ( k ).model[3] ) - camera_pos;
+					nearest.push_back ( std::make_pair ( glm::dot ( d, d ), k ) );
+				}
+			}
 		}
-		glBindVertexArray ( 0 );
 
-		glUseProgram ( 0 );
+		uint32_t occluders = std::min ( ( uint32_t ) nearest.size ( ), 16u );
+		std::partial_sort ( nearest.begin ( ), nearest.begin ( ) + occluders, nearest.end ( ) );
+
+		for ( uint32_t i = 0; i < occluders; ++i ) {
+			uint32_t k = nearest[i].second;
+			OccluderInstance occluder = { gs.meshes[gs.scene.node ( gs.instance_node[k] ).mesh].occluder, gs.instances.instance ( k ).model };
+			list.push_back ( occluder );
+		}
+
+		if ( !list.empty ( ) ) {
+			gs.occlusion.rasterize ( camera_mvp, &list[0], list.size ( ) );
+		}
 	}
-	/**********************************************************************/
+
+	gs.sceneCommands.clear ( );
+
+	for ( uint32_t m = 0; m < gs.meshes.size ( ); ++m ) {
+		const SceneMeshState &state = gs.meshes[m];
+
+		if ( !state.loaded ) {
+			continue;
+		}
+
+		// Only tested against the frustum, they have no occluder nor clusters
+		if ( state.dynamic != SCENE_NONE ) {
+			DynamicMesh &mesh = gs.dynamic_meshes[state.dynamic];
+			mesh.clear ( );
+
+			addVisibleRuns ( &candidates[0], state.baseInstance, state.instanceCount, [&mesh] ( uint32_t count, uint32_t first ) {
+				mesh.add ( count, first );
+			} );
+			continue;
+		}
+
+		if ( occlusion != OCCLUSION_OFF ) {
+			OcclusionObject object = { state.geometry, &state.clusters, state.baseInstance, state.instanceCount, state.bbMin, state.bbMax, &candidates[0] };
+			gs.occlusion.cull ( object, gs.instances, camera_mvp, gs.sceneCommands );
+			continue;
+		}
+
+		addVisibleRuns ( &candidates[0], state.baseInstance, state.instanceCount, [&state] ( uint32_t count, uint32_t first ) {
+			gs.sceneCommands.add ( state.geometry, count, first );
+		} );
+	}
+}
+
+// Fixed step of the simulation
+void update ( double dt ) {
+	previous_camera_angle = camera_angle;
+	camera_angle += 0.5 * dt;
+
+	gs.scene.animate ( dt );
+
+	previous_light_angle = light_angle;
+	light_angle += dt;
+
+	for ( uint32_t m = 0; m < gs.meshes.size ( ); ++m ) {
+		gs.meshes[m].previous_angle = gs.meshes[m].angle;
+		gs.meshes[m].angle += gs.scene.meshes ( )[m].spin * dt;
+
+		if ( gs.scene.meshes ( )[m].deform != 0.0f ) {
+			gs.meshes[m].previous_phase = gs.meshes[m].phase;
+			gs.meshes[m].phase += DEFORM_WAVE_SPEED * dt;
+		}
+	}
+}
+
+void render ( GLFWwindow* window, double alpha ) {	
+	glfwGetFramebufferSize ( window, &WIDTH, &HEIGHT );
+	gs.graph.resize ( WIDTH, HEIGHT );
+
+	RENDER_WIDTH = WIDTH;
+	RENDER_HEIGHT = HEIGHT;
+
+	// Size picked from the GPU times of the previous frames, this one is timed
+	if ( dynamic_res ) {
+		gs.dynamic_res.begin ( WIDTH, HEIGHT );
+
+		RENDER_WIDTH = gs.dynamic_res.width ( );
+		RENDER_HEIGHT = gs.dynamic_res.height ( );
+	}
+
+	uint64_t allocations = threadAllocations ( );
+	gs.frame_arena.reset ( );
+
+	// Waits, if ever, for the GPU to be done with the regions of three frames ago
+	gs.uniform_stream.begin ( );
+	gs.vertex_stream.begin ( );
+	gs.instance_stream.begin ( );
+
+	// Edited shaders are swapped in once they build
+	if ( gs.shaders.update ( ) ) {
+		gs.state.invalidate ( );
+	}
+
+	double angle = previous_camera_angle + ( camera_angle - previous_camera_angle ) * alpha;
+
+	GLfloat radius = 20.0f;
+	GLfloat camX = sin ( angle ) * radius;
+	GLfloat camZ = cos ( angle ) * radius;
+	camera_pos = glm::vec3 ( camX, 0.0f, camZ );
+	camera_view = glm::lookAt (
+		camera_pos,
+		glm::vec3 ( 0.0f, 0.0f, 0.0f ),
+		glm::vec3 ( 0.0f, 1.0f, 0.0f ) );
+	camera_mvp = projection * camera_view * model;
+
+	assignLights ( alpha );
+
+	// Transforms changed by the simulation
+	syncScene ( );
+
+	// Nearest instances first so that the depth test rejects what is behind
+	if ( front_to_back ) {
+		Vector3 eye = Vector3 ( glm::inverse ( model ) * glm::vec4 ( camera_pos, 1.0f ) );
+
+		for ( uint32_t m = 0; m < gs.meshes.size ( ); ++m ) {
+			const SceneMeshState &state = gs.meshes[m];
+
+			if ( state.instanceCount < 2 || !gs.instances.sortFrontToBack ( state.baseInstance, state.instanceCount, eye, gs.frame_arena, &gs.instance_node[0] ) ) {
+				continue;
+			}
+
+			for ( uint32_t k = state.baseInstance; k < state.baseInstance + state.instanceCount; ++k ) {
+				gs.node_instance[gs.instance_node[k]] = k;
+			}
+		}
+	}
+
+	// The moved and sorted instances, copied by the GPU from the stream
+	gs.instances.upload ( &gs.instance_stream );
+
+	cullScene ( );
+
+	// After the culling : a full region clears the draws of its mesh
+	streamDynamicMeshes ( alpha );
+
+	gs.state.resetStats ( );
+	gs.graph.execute ( gs.state );
+
+	if ( dynamic_res ) {
+		gs.dynamic_res.end ( );
+	}
+
+	gs.uniform_stream.end ( );
+	gs.vertex_stream.end ( );
+	gs.instance_stream.end ( );
+	gs.light_stream.end ( );
+
+	// Depth of this frame, for the pyramid of a later one
+	if ( occlusion == OCCLUSION_GPU ) {
+		gs.occlusion.readback ( RENDER_WIDTH, RENDER_HEIGHT, camera_mvp, dynamic_res ? gs.graph.framebuffer ( gs.scene_pass ) : 0 );
+	}
+
+	if ( gl_stats ) {
+		printFrameStats ( threadAllocations ( ) - allocations );
+	}
+}
+
+// --gl-stats : the counters of this frame, once it is submitted
+void printFrameStats ( uint64_t heapAllocations ) {
+	const GLStateStats &state = gs.state.stats ( );
+	printf ( "GL state calls: %u issued, %u redundant skipped\n", state.issued, state.redundant );
+
+	printf ( "Frame memory: %u scratch allocations (%u bytes), %llu heap allocations\n", gs.frame_arena.allocations ( ),
+			 ( uint32_t ) gs.frame_arena.used ( ), ( unsigned long long ) heapAllocations );
+
+	const OctreeStats &octree = gs.octree.stats ( );
+	printf ( "Frustum: %u objects, %u nodes visited, %u boxes tested, %u taken whole, %.3f ms\n", gs.octree.objects ( ),
+			 octree.nodesVisited, octree.objectsTested, octree.objectsAccepted, octree.ms );
+
+	const StreamStats &uniforms = gs.uniform_stream.stats ( );
+	const StreamStats &vertices = gs.vertex_stream.stats ( );
+	const StreamStats &instances = gs.instance_stream.stats ( );
+	printf ( "Streams: %u uniform + %u vertex + %u instance bytes/frame, %u fence waits, %.3f ms waited since the start\n",
+			 ( uint32_t ) ( uniforms.bytes / std::max ( uniforms.frames, 1u ) ), ( uint32_t ) ( vertices.bytes / std::max ( vertices.frames, 1u ) ),
+			 ( uint32_t ) ( instances.bytes / std::max ( instances.frames, 1u ) ), uniforms.waits + vertices.waits + instances.waits,
+			 uniforms.waitMs + vertices.waitMs + instances.waitMs );
+
+	if ( !gs.lights.empty ( ) ) {
+		const LightClusterStats &stats = gs.light_clusters.stats ( );
+		printf ( "Lights: %u, %u in the frustum, %u indices, %u at most per cluster, %u box tests, %.3f ms\n", stats.lights,
+				 stats.visibleLights, stats.indices, stats.maxPerCluster, stats.tests, stats.ms );
+	}
+
+	if ( dynamic_res ) {
+		printf ( "Resolution: %dx%d of %dx%d (scale %.2f), %.3f GPU ms for a %.2f ms budget\n", RENDER_WIDTH, RENDER_HEIGHT, WIDTH, HEIGHT,
+				 gs.dynamic_res.scale ( ), gs.dynamic_res.lastGpuMs ( ), gs.dynamic_res.budget ( ) );
+	}
+
+	// Boite du dernier calcul termine, sans attendre le GPU
+	for ( uint32_t m = 0; m < gs.meshes.size ( ); ++m ) {
+		Vector3 min, max;
+		if ( gs.meshes[m].compute != SCENE_NONE && gs.meshes[m].loaded && gs.mesh_compute.bounds ( gs.meshes[m].compute, min, max ) ) {
+			printf ( "Deform %s: GPU %s normals, bounds (%.3f %.3f %.3f) (%.3f %.3f %.3f)\n", gs.scene.meshes ( )[m].name.c_str ( ),
+					 MeshCompute::scatter ? "scattered" : "gathered", min.x, min.y, min.z, max.x, max.y, max.z );
+		}
+	}
+
+	if ( occlusion != OCCLUSION_OFF ) {
+		const OcclusionStats &stats = gs.occlusion.stats ( );
+		printf ( "Culling: %u objects, %u outside, %u occluded, %u/%u clusters culled, %.3f ms\n", stats.objects, stats.frustumCulled,
+				 stats.occluded, stats.clustersCulled, stats.clusters, stats.ms );
+	}
+}
+
+// Draw calls and CPU time per frame for 1 to 100k instances of the mesh,
+// with one indirect draw per pass and with one draw per instance
+void benchmarkInstances ( GLFWwindow* window ) {
+	const uint32_t counts[] = { 1, 10, 100, 1000, 10000, 100000 };
+	const uint32_t frames = 50;
+
+	printf ( "%10s %10s %12s %14s %14s %16s\n", "instances", "mode", "draws/frame", "cpu ms/frame", "total ms/frame", "state calls" );
+
+	for ( uint32_t c = 0; c < sizeof ( counts ) / sizeof ( counts[0] ); ++c ) {
+		placeInstances ( counts[c] );
+
+		for ( uint32_t mode = 0; mode < 2; ++mode ) {
+			DrawCommandBuilder::separateDraws = ( mode == 1 );
+
+			double cpu = 0.0, total = 0.0;
+			uint32_t drawCalls = 0;
+			GLStateStats stats;
+
+			for ( uint32_t f = 0; f < frames + 5; ++f ) {
+				// Both passes are measured : the shadow cache is dropped every frame
+				gs.shadowMap.invalidate ( );
+				DrawCommandBuilder::drawCalls = 0;
+
+				auto start = std::chrono::high_resolution_clock::now ( );
+				render ( window, 1.0 );
+				auto submitted = std::chrono::high_resolution_clock::now ( );
+				glFinish ( );
+				auto finished = std::chrono::high_resolution_clock::now ( );
+
+				// 5 frames of warm up
+				if ( f >= 5 ) {
+					cpu += std::chrono::duration<double, std::milli> ( submitted - start ).count ( );
+					total += std::chrono::duration<double, std::milli> ( finished - start ).count ( );
+					drawCalls += DrawCommandBuilder::drawCalls;
+					stats = gs.state.stats ( );
+				}
+
+				glfwPollEvents ( );
+			}
+
+			// Calls issued / calls skipped by the state cache
+			printf ( "%10u %10s %12u %14.3f %14.3f %7u/%-8u\n", counts[c], mode == 0 ? "instanced" : "separate",
+					 drawCalls / frames, cpu / frames, total / frames, stats.issued, stats.redundant );
+		}
+	}
+
+	DrawCommandBuilder::separateDraws = false;
+}
+
+// Renders a fixed number of frames without a visible window and reports
+// the fragments written by the depth pre-pass and shaded by the scene pass
+void runHeadless ( GLFWwindow* window ) {
+	FrameHistogram frameTimes;
+	uint64_t prepass = 0, shaded = 0, allocations = 0, lastAllocations = 0;
+	OcclusionStats culling = OcclusionStats ( );
+	OctreeStats frustum = OctreeStats ( );
+
+	gs.uniform_stream.resetStats ( );
+	gs.vertex_stream.resetStats ( );
+	gs.instance_stream.resetStats ( );
+	gs.dynamic_res.resetStats ( );
+
+	// One fixed step per frame : the same frames on every run
+	for ( uint32_t f = 0; f < headless_frames; ++f ) {
+		auto start = std::chrono::high_resolution_clock::now ( );
+		uint64_t heap = threadAllocations ( );
+		update ( 1.0 / update_rate );
+		render ( window, 1.0 );
+		lastAllocations = threadAllocations ( ) - heap;
+		allocations += lastAllocations;
+		glFinish ( );
+		frameTimes.add ( std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - start ).count ( ) );
+
+		GLuint64 samples = 0;
+
+		if ( depth_prepass ) {
+			glGetQueryObjectui64v ( gs.samples_queries[0].id ( ), GL_QUERY_RESULT, &samples );
+			prepass += samples;
+		}
+
+		glGetQueryObjectui64v ( gs.samples_queries[1].id ( ), GL_QUERY_RESULT, &samples );
+		shaded += samples;
+
+		const OcclusionStats &stats = gs.occlusion.stats ( );
+		culling.objects += stats.objects;
+		culling.frustumCulled += stats.frustumCulled;
+		culling.occluded += stats.occluded;
+		culling.clusters += stats.clusters;
+		culling.clustersCulled += stats.clustersCulled;
+		culling.occluderTriangles += stats.occluderTriangles;
+		culling.ms += stats.ms;
+
+		frustum.nodesVisited += gs.octree.stats ( ).nodesVisited;
+		frustum.objectsTested += gs.octree.stats ( ).objectsTested;
+		frustum.objectsAccepted += gs.octree.stats ( ).objectsAccepted;
+		frustum.ms += gs.octree.stats ( ).ms;
+
+		glfwPollEvents ( );
+	}
+
+	uint32_t frames = headless_frames > 0 ? headless_frames : 1;
+	double pixels = ( double ) WIDTH * HEIGHT;
+
+	printf ( "Headless: %u frames, %u instances, depth pre-pass %s, front to back %s\n", headless_frames, gs.instances.count ( ),
+			 depth_prepass ? "on" : "off", front_to_back ? "on" : "off" );
+	printf ( "  ms/frame:                   %.3f (p50 %.2f, p95 %.2f, p99 %.2f)\n", frameTimes.mean ( ),
+			 frameTimes.percentile ( 50 ), frameTimes.percentile ( 95 ), frameTimes.percentile ( 99 ) );
+	printf ( "  pre-pass fragments/frame:   %llu\n", ( unsigned long long ) ( prepass / frames ) );
+	printf ( "  shaded fragments/frame:     %llu (%.3f per pixel)\n", ( unsigned long long ) ( shaded / frames ), shaded / frames / pixels );
+	// The first frames also count the allocations of the driver compiling its shaders
+	printf ( "  heap allocations/frame:     %llu, %llu in the last frame (frame scratch peak %u bytes)\n", ( unsigned long long ) ( allocations / frames ),
+			 ( unsigned long long ) lastAllocations, ( uint32_t ) gs.frame_arena.peak ( ) );
+	// Steady state : the assets are on the GPU, their CPU copies are gone
+	MemoryStats memory = memoryStats ( );
+	printf ( "  heap in use:                %.2f MB (peak %.2f MB)\n", memory.bytes / 1048576.0, memory.peak / 1048576.0 );
+	printf ( "  octree, per frame:          %u objects, %u nodes visited, %u boxes tested, %u taken whole, %.3f ms\n", gs.octree.objects ( ),
+			 frustum.nodesVisited / frames, frustum.objectsTested / frames, frustum.objectsAccepted / frames, frustum.ms / frames );
+	// A wait means the GPU was still reading a region three frames later
+	const StreamStats &uniforms = gs.uniform_stream.stats ( );
+	const StreamStats &vertices = gs.vertex_stream.stats ( );
+	const StreamStats &instances = gs.instance_stream.stats ( );
+	printf ( "  streams, per frame:         %llu uniform bytes, %llu vertex bytes, %llu instance bytes, %u fence waits in all (%.3f ms)\n",
+			 ( unsigned long long ) ( uniforms.bytes / frames ), ( unsigned long long ) ( vertices.bytes / frames ),
+			 ( unsigned long long ) ( instances.bytes / frames ), uniforms.waits + vertices.waits + instances.waits,
+			 uniforms.waitMs + vertices.waitMs + instances.waitMs );
+
+	// GPU time of the frames read back so far, the last ones are still in flight
+	if ( dynamic_res ) {
+		const DynamicResolutionStats &stats = gs.dynamic_res.stats ( );
+		uint32_t timed = std::max ( stats.frames, 1u );
+		printf ( "  dynamic resolution:         scale %.3f (%.3f to %.3f), %.3f GPU ms/frame, %u/%u frames over %.2f ms, %u size changes\n",
+				 stats.scale / timed, stats.minScale, stats.maxScale, stats.gpuMs / timed, stats.overBudget, stats.frames, frame_budget, stats.changes );
+	}
+
+	if ( occlusion != OCCLUSION_OFF ) {
+		printf ( "  occlusion (%s), per frame:\n", occlusion == OCCLUSION_CPU ? "cpu occluders" : "gpu depth read back" );
+		printf ( "    objects tested:           %u\n", culling.objects / frames );
+		printf ( "    outside the frustum:      %u\n", culling.frustumCulled / frames );
+		printf ( "    occluded:                 %u\n", culling.occluded / frames );
+		printf ( "    clusters culled:          %u / %u\n", culling.clustersCulled / frames, culling.clusters / frames );
+		printf ( "    occluder triangles:       %u\n", culling.occluderTriangles / frames );
+		printf ( "    cpu ms:                   %.3f\n", culling.ms / frames );
+	}
+}
+
+// Angle in degrees between two normals, 0 when both are null
+static double normalError ( const Vector3 &a, const Vector3 &b ) {
+	double la = glm::length ( a ), lb = glm::length ( b );
+
+	if ( la == 0.0 || lb == 0.0 ) {
+		return la == lb ? 0.0 : 180.0;
+	}
+
+	double c = std::min ( std::max ( glm::dot ( a, b ) / ( la * lb ), -1.0 ), 1.0 );
+	return acos ( c ) * 180.0 / M_PI;
+}
+
+// The file deformed as a scene mesh would be, its normals and bounds
+// computed by the Mesh reference on the CPU and by MeshCompute, gathered
+// then scattered. The positions start at an offset, as in a stream
+bool validateNormals ( const char *fileName ) {
+	const uint32_t runs = 10;
+	const double tolerance = 0.5;		// degrees
+
+	std::cout.setstate ( std::ios::failbit );
+
+	size_t length = strlen ( fileName );
+	Mesh mesh = length >= 4 && strcmp ( fileName + length - 4, ".obj" ) == 0 ?
+		Mesh::loadOBJ ( fileName, false, &gs.jobs ) : Mesh::loadOFF ( fileName, true, &gs.jobs );
+	mesh.indexData ( &gs.jobs );
+
+	std::cout.clear ( );
+
+	std::vector<Vector3> vertices, normals;
+	std::vector<uint32_t> indices;
+	mesh.weldIndexData ( vertices, normals, indices );
+	Mesh::weldPositions ( vertices, indices );
+
+	uint32_t vertexCount = vertices.size ( ), triangleCount = indices.size ( ) / 3;
+
+	if ( vertexCount == 0 || triangleCount == 0 ) {
+		printf ( "Impossible to validate %s : no triangle\n", fileName );
+		return false;
+	}
+
+	std::vector<uint32_t> offsets, faces;
+	Mesh::buildAdjacency ( indices, vertexCount, offsets, faces );
+
+	std::vector<Vector3> faceNormals ( triangleCount ), restNormals ( vertexCount );
+	Mesh::calculateFaceNormals ( vertices, indices, &faceNormals[0], &gs.jobs );
+	Mesh::calculateVertexNormals ( faceNormals, offsets, faces, &restNormals[0], &gs.jobs );
+
+	std::vector<Vector3> deformed ( vertexCount );
+	Mesh::wave ( vertices, restNormals, &deformed[0], 0.02f, DYNAMIC_WAVE_FREQUENCY, 1.0f );
+
+	// Reference : la meilleure de plusieurs executions
+	std::vector<Vector3> referenceNormals ( vertexCount );
+	double cpuMs = 1e30;
+
+	for ( uint32_t r = 0; r < runs; ++r ) {
+		auto start = std::chrono::high_resolution_clock::now ( );
+		Mesh::calculateFaceNormals ( deformed, indices, &faceNormals[0], &gs.jobs );
+		Mesh::calculateVertexNormals ( faceNormals, offsets, faces, &referenceNormals[0], &gs.jobs );
+		cpuMs = std::min ( cpuMs, std::chrono::duration<double, std::milli> ( std::chrono::high_resolution_clock::now ( ) - start ).count ( ) );
+	}
+
+	Vector3 bbMin = deformed[0], bbMax = deformed[0];
+	for ( uint32_t v = 1; v < vertexCount; ++v ) {
+		bbMin = glm::min ( bbMin, deformed[v] );
+		bbMax = glm::max ( bbMax, deformed[v] );
+	}
+
+	// Un sommet de decalage : position_offset est verifie aussi
+	GLintptr offset = sizeof ( Vector3 );
+	Buffer positions = createBuffer ( );
+	glNamedBufferStorage ( positions.id ( ), offset + vertexCount * sizeof ( Vector3 ), NULL, GL_DYNAMIC_STORAGE_BIT );
+	glNamedBufferSubData ( positions.id ( ), offset, vertexCount * sizeof ( Vector3 ), &deformed[0] );
+
+	uint32_t id = gs.mesh_compute.addMesh ( indices, vertexCount );
+	Query timer = createQuery ( GL_TIME_ELAPSED );
+
+	printf ( "%s: %u vertices, %u triangles, CPU reference %.3f ms\n", fileName, vertexCount, triangleCount, cpuMs );
+
+	bool ok = true;
+	std::vector<float> gpuFaceNormals ( triangleCount * 4 ), gpuNormals ( vertexCount * 3 );
+
+	for ( uint32_t mode = 0; mode < 2; ++mode ) {
+		MeshCompute::scatter = mode == 1;
+
+		double gpuMs = 1e30;
+
+		for ( uint32_t r = 0; r < runs; ++r ) {
+			glBeginQuery ( GL_TIME_ELAPSED, timer.id ( ) );
+			gs.mesh_compute.compute ( gs.state, id, positions.id ( ), offset );
+			glEndQuery ( GL_TIME_ELAPSED );
+
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v ( timer.id ( ), GL_QUERY_RESULT, &elapsed );
+			gpuMs = std::min ( gpuMs, elapsed / 1e6 );
+		}
+
+		Vector3 gpuMin, gpuMax;
+		bool bounds = gs.mesh_compute.bounds ( id, gpuMin, gpuMax, true );
+
+		glGetNamedBufferSubData ( gs.mesh_compute.faceNormals ( id ), 0, gpuFaceNormals.size ( ) * sizeof ( float ), &gpuFaceNormals[0] );
+		glGetNamedBufferSubData ( gs.mesh_compute.normals ( id ), 0, gpuNormals.size ( ) * sizeof ( float ), &gpuNormals[0] );
+
+		double faceError = 0.0, vertexError = 0.0;
+		uint32_t faceOver = 0, vertexOver = 0;
+
+		for ( uint32_t t = 0; t < triangleCount; ++t ) {
+			double e = normalError ( faceNormals[t], Vector3 ( gpuFaceNormals[4 * t], gpuFaceNormals[4 * t + 1], gpuFaceNormals[4 * t + 2] ) );
+			faceError = std::max ( faceError, e );
+			faceOver += e > tolerance;
+		}
+
+		for ( uint32_t v = 0; v < vertexCount; ++v ) {
+			double e = normalError ( referenceNormals[v], Vector3 ( gpuNormals[3 * v], gpuNormals[3 * v + 1], gpuNormals[3 * v + 2] ) );
+			vertexError = std::max ( vertexError, e );
+			vertexOver += e > tolerance;
+		}
+
+		// Le min et le max de floats sont exacts : la boite doit etre identique
+		bool boundsMatch = bounds && gpuMin == bbMin && gpuMax == bbMax;
+
+		printf ( "  GPU %-9s %.3f ms, face normals max %.4f deg (%u over %.1f), vertex normals max %.4f deg (%u over %.1f), bounds %s\n",
+				 mode == 1 ? "scattered" : "gathered", gpuMs, faceError, faceOver, tolerance, vertexError, vertexOver, tolerance,
+				 boundsMatch ? "exact" : "differ" );
+
+		if ( !boundsMatch ) {
+			printf ( "    CPU bounds (%g %g %g) (%g %g %g), GPU (%g %g %g) (%g %g %g)\n", bbMin.x, bbMin.y, bbMin.z, bbMax.x, bbMax.y, bbMax.z,
+					 gpuMin.x, gpuMin.y, gpuMin.z, gpuMax.x, gpuMax.y, gpuMax.z );
+		}
+
+		ok = ok && faceOver == 0 && vertexOver == 0 && boundsMatch;
+	}
+
+	MeshCompute::scatter = false;
+
+	printf ( "Normals and bounds %s the CPU reference\n", ok ? "match" : "do not match" );
+	return ok;
 }
@@ -0,0 +1,18 @@
+# Merges the raw profiles Clang wrote in TP_PGO_DIR into the default.profdata
+# read by TP_PGO=USE. Run by the pgo-train target :
+#   cmake -DLLVM_PROFDATA=<llvm-profdata> -DTP_PGO_DIR=<dir> -P PgoMerge.cmake
+
+file(GLOB profiles "${TP_PGO_DIR}/*.profraw")
+
+if(NOT profiles)
+	message(FATAL_ERROR "No profile in ${TP_PGO_DIR} : was the build configured with TP_PGO=GENERATE ?")
+endif()
+
+execute_process(
+	COMMAND ${LLVM_PROFDATA} merge -output=${TP_PGO_DIR}/default.profdata ${profiles}
+	RESULT_VARIABLE result
+)
+
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "llvm-profdata merge failed")
+endif()